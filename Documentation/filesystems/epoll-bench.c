@@ -0,0 +1,200 @@
+/*
+ * epoll-bench.c: epoll event throughput with many producers
+ *
+ * One epoll set watches the read ends of a number of pipes. Producer
+ * threads write one byte at a time to their share of the pipes, as fast
+ * as they can, while a consumer thread waits in epoll_wait() and drains
+ * every pipe it gets an event for. After the run the events and wakeups
+ * per second seen by the consumer are printed.
+ *
+ * Every write wakes the pipe's wait queue and so runs the epoll poll
+ * callback, which makes this mostly a test of the callback and ready
+ * list paths in fs/eventpoll.c.
+ *
+ * Build:  gcc -O2 -o epoll-bench epoll-bench.c -lpthread
+ * Usage:  epoll-bench [-p producers] [-f fds] [-s seconds] [-l]
+ *
+ *   -p  number of producer threads (default 4)
+ *   -f  number of pipes (default 1024, needs a high enough ulimit -n)
+ *   -s  duration of the run (default 5)
+ *   -l  level triggered instead of EPOLLET
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/time.h>
+
+#define MAX_EVENTS	256
+
+static int nr_producers = 4;
+static int nr_fds = 1024;
+static int seconds = 5;
+static int edge = 1;
+
+static int (*pipes)[2];
+static int epfd;
+static volatile int stop;
+
+static unsigned long long writes_done;
+static unsigned long long events_seen, wakeups_seen;
+
+static pthread_mutex_t count_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void *producer(void *arg)
+{
+	long id = (long)arg;
+	unsigned long long writes = 0;
+	unsigned int seed = id + 1;
+	int first, count;
+
+	/* each producer owns a slice of the pipes */
+	count = nr_fds / nr_producers;
+	first = id * count;
+	if (id == nr_producers - 1)
+		count = nr_fds - first;
+
+	while (!stop) {
+		int i = first + rand_r(&seed) % count;
+
+		/* a full pipe just means the consumer is behind */
+		if (write(pipes[i][1], "x", 1) == 1)
+			writes++;
+	}
+
+	pthread_mutex_lock(&count_lock);
+	writes_done += writes;
+	pthread_mutex_unlock(&count_lock);
+	return NULL;
+}
+
+static void *consumer(void *arg)
+{
+	struct epoll_event ev[MAX_EVENTS];
+	char buf[4096];
+	int i, n;
+
+	while (!stop) {
+		n = epoll_wait(epfd, ev, MAX_EVENTS, 100);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("epoll_wait");
+			exit(1);
+		}
+		if (n)
+			wakeups_seen++;
+		events_seen += n;
+
+		for (i = 0; i < n; i++) {
+			int fd = ev[i].data.fd;
+
+			/* EPOLLET needs the pipe drained to report it again */
+			while (read(fd, buf, sizeof(buf)) == sizeof(buf))
+				;
+		}
+	}
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	pthread_t *threads, cons;
+	struct epoll_event ev;
+	double start, elapsed;
+	long i;
+	int c;
+
+	while ((c = getopt(argc, argv, "p:f:s:l")) != -1) {
+		switch (c) {
+		case 'p':
+			nr_producers = atoi(optarg);
+			break;
+		case 'f':
+			nr_fds = atoi(optarg);
+			break;
+		case 's':
+			seconds = atoi(optarg);
+			break;
+		case 'l':
+			edge = 0;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-p producers] [-f fds] "
+				"[-s seconds] [-l]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (nr_producers < 1 || nr_fds < nr_producers || seconds < 1) {
+		fprintf(stderr, "bad arguments\n");
+		return 1;
+	}
+
+	pipes = calloc(nr_fds, sizeof(*pipes));
+	threads = calloc(nr_producers, sizeof(*threads));
+	if (!pipes || !threads) {
+		perror("calloc");
+		return 1;
+	}
+
+	epfd = epoll_create(nr_fds);
+	if (epfd < 0) {
+		perror("epoll_create");
+		return 1;
+	}
+
+	for (i = 0; i < nr_fds; i++) {
+		if (pipe(pipes[i])) {
+			perror("pipe");
+			return 1;
+		}
+		fcntl(pipes[i][0], F_SETFL, O_NONBLOCK);
+		fcntl(pipes[i][1], F_SETFL, O_NONBLOCK);
+
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN | (edge ? EPOLLET : 0);
+		ev.data.fd = pipes[i][0];
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD, pipes[i][0], &ev)) {
+			perror("epoll_ctl");
+			return 1;
+		}
+	}
+
+	start = now();
+	pthread_create(&cons, NULL, consumer, NULL);
+	for (i = 0; i < nr_producers; i++)
+		pthread_create(&threads[i], NULL, producer, (void *)i);
+
+	sleep(seconds);
+	stop = 1;
+
+	for (i = 0; i < nr_producers; i++)
+		pthread_join(threads[i], NULL);
+	pthread_join(cons, NULL);
+	elapsed = now() - start;
+
+	printf("%d producers, %d fds, %s triggered, %.1f s\n",
+	       nr_producers, nr_fds, edge ? "edge" : "level", elapsed);
+	printf("writes:  %12llu  %10.0f/s\n", writes_done,
+	       writes_done / elapsed);
+	printf("events:  %12llu  %10.0f/s\n", events_seen,
+	       events_seen / elapsed);
+	printf("wakeups: %12llu  %10.0f/s  (%.1f events each)\n",
+	       wakeups_seen, wakeups_seen / elapsed,
+	       wakeups_seen ? (double)events_seen / wakeups_seen : 0.0);
+
+	return 0;
+}
@@ -0,0 +1,410 @@
+/*
+ * fuse-bench.c: loopback FUSE throughput, with and without splice
+ *
+ * A minimal FUSE daemon, talking to /dev/fuse directly, that exports a
+ * single file ("data") backed by a regular file. After mounting it, the
+ * program writes and then reads back the file through the mount point
+ * and prints the throughput of both. With -s the daemon moves the file
+ * data with splice() instead of read()/write() on /dev/fuse:
+ *
+ *   - WRITE requests are spliced from /dev/fuse into a pipe and from the
+ *     pipe into the backing file; the data pages are never copied.
+ *   - READ replies are spliced from the backing file into a pipe and
+ *     from the pipe into /dev/fuse, one copy into the page cache.
+ *
+ * A spliced request must fit into a pipe (16 pages), so with -s the
+ * maximum write is 14 pages and max_read is set to the same.
+ *
+ * Build against the headers of the kernel under test (make
+ * headers_install), as root:
+ *
+ *   gcc -O2 -o fuse-bench fuse-bench.c
+ *   mkdir -p /mnt/fb
+ *   fuse-bench -m 64 /mnt/fb /tmp/backing
+ *   fuse-bench -s -m 64 /mnt/fb /tmp/backing
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <linux/fuse.h>
+
+#define DATA_INO	2
+#define BENCH_IO	(1 << 20)
+
+static int use_splice;
+static unsigned int max_write;
+static int fuse_fd, back_fd;
+static int pipefd[2];
+static char *buf;
+static size_t bufsize;
+
+static void die(const char *msg)
+{
+	perror(msg);
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void reply(uint64_t unique, int error, const void *arg, size_t len)
+{
+	struct fuse_out_header oh;
+	struct iovec iov[2];
+
+	oh.len = sizeof(oh) + len;
+	oh.error = error;
+	oh.unique = unique;
+	iov[0].iov_base = &oh;
+	iov[0].iov_len = sizeof(oh);
+	iov[1].iov_base = (void *)arg;
+	iov[1].iov_len = len;
+
+	/* ENOENT means the request was interrupted, that's fine */
+	if (writev(fuse_fd, iov, 2) < 0 && errno != ENOENT)
+		die("reply");
+}
+
+static void fill_attr(uint64_t ino, struct fuse_attr *attr)
+{
+	struct stat st;
+
+	memset(attr, 0, sizeof(*attr));
+	attr->ino = ino;
+	if (ino == FUSE_ROOT_ID) {
+		attr->mode = S_IFDIR | 0755;
+		attr->nlink = 2;
+		return;
+	}
+	if (fstat(back_fd, &st))
+		die("fstat");
+	attr->mode = S_IFREG | 0644;
+	attr->nlink = 1;
+	attr->size = st.st_size;
+	attr->blocks = st.st_blocks;
+	attr->blksize = 4096;
+}
+
+/* Read exactly len bytes from fd */
+static void read_full(int fd, void *p, size_t len)
+{
+	ssize_t n;
+
+	while (len) {
+		n = read(fd, p, len);
+		if (n <= 0)
+			die("read");
+		p = (char *)p + n;
+		len -= n;
+	}
+}
+
+/* Move exactly len bytes from in to out with splice() */
+static void splice_full(int in, loff_t *inoff, int out, loff_t *outoff,
+			size_t len)
+{
+	ssize_t n;
+
+	while (len) {
+		n = splice(in, inoff, out, outoff, len, SPLICE_F_MOVE);
+		if (n <= 0)
+			die("splice");
+		len -= n;
+	}
+}
+
+static void do_read(struct fuse_in_header *ih, struct fuse_read_in *in)
+{
+	struct fuse_out_header oh;
+	struct stat st;
+	uint64_t unique = ih->unique;
+	loff_t off = in->offset;
+	size_t size = in->size;
+	ssize_t n;
+
+	if (!use_splice) {
+		/* this overwrites the request */
+		n = pread(back_fd, buf, size, off);
+		if (n < 0)
+			reply(unique, -errno, NULL, 0);
+		else
+			reply(unique, 0, buf, n);
+		return;
+	}
+
+	/* the header goes first, so the size must be known up front */
+	if (fstat(back_fd, &st))
+		die("fstat");
+	if (off >= st.st_size)
+		size = 0;
+	else if (off + size > st.st_size)
+		size = st.st_size - off;
+
+	oh.len = sizeof(oh) + size;
+	oh.error = 0;
+	oh.unique = unique;
+	if (write(pipefd[1], &oh, sizeof(oh)) != sizeof(oh))
+		die("write pipe");
+	splice_full(back_fd, &off, pipefd[1], NULL, size);
+	n = splice(pipefd[0], NULL, fuse_fd, NULL, oh.len, 0);
+	if (n < 0 && errno == ENOENT) {
+		/* interrupted: drop what is left in the pipe */
+		while (read(pipefd[0], buf, bufsize) == bufsize)
+			;
+	} else if (n != oh.len)
+		die("splice reply");
+}
+
+static void do_write(struct fuse_in_header *ih, struct fuse_write_in *in,
+		     const void *data)
+{
+	struct fuse_write_out out;
+	loff_t off = in->offset;
+
+	memset(&out, 0, sizeof(out));
+	if (use_splice)
+		splice_full(pipefd[0], NULL, back_fd, &off, in->size);
+	else if (pwrite(back_fd, data, in->size, off) != in->size) {
+		reply(ih->unique, -EIO, NULL, 0);
+		return;
+	}
+	out.size = in->size;
+	reply(ih->unique, 0, &out, sizeof(out));
+}
+
+static void dispatch(struct fuse_in_header *ih, void *arg)
+{
+	switch (ih->opcode) {
+	case FUSE_INIT: {
+		struct fuse_init_in *in = arg;
+		struct fuse_init_out out;
+
+		memset(&out, 0, sizeof(out));
+		out.major = FUSE_KERNEL_VERSION;
+		out.minor = FUSE_KERNEL_MINOR_VERSION;
+		out.max_readahead = in->max_readahead;
+		out.flags = in->flags & (FUSE_ASYNC_READ | FUSE_BIG_WRITES);
+		out.max_write = max_write;
+		reply(ih->unique, 0, &out, sizeof(out));
+		break;
+	}
+	case FUSE_LOOKUP: {
+		struct fuse_entry_out out;
+
+		if (ih->nodeid != FUSE_ROOT_ID || strcmp(arg, "data")) {
+			reply(ih->unique, -ENOENT, NULL, 0);
+			break;
+		}
+		memset(&out, 0, sizeof(out));
+		out.nodeid = DATA_INO;
+		out.entry_valid = 1;
+		out.attr_valid = 1;
+		fill_attr(DATA_INO, &out.attr);
+		reply(ih->unique, 0, &out, sizeof(out));
+		break;
+	}
+	case FUSE_SETATTR: {
+		struct fuse_setattr_in *in = arg;
+
+		if ((in->valid & FATTR_SIZE) && ftruncate(back_fd, in->size)) {
+			reply(ih->unique, -errno, NULL, 0);
+			break;
+		}
+	}
+		/* fall through */
+	case FUSE_GETATTR: {
+		struct fuse_attr_out out;
+
+		memset(&out, 0, sizeof(out));
+		out.attr_valid = 1;
+		fill_attr(ih->nodeid, &out.attr);
+		reply(ih->unique, 0, &out, sizeof(out));
+		break;
+	}
+	case FUSE_OPEN:
+	case FUSE_OPENDIR: {
+		struct fuse_open_out out;
+
+		memset(&out, 0, sizeof(out));
+		reply(ih->unique, 0, &out, sizeof(out));
+		break;
+	}
+	case FUSE_READ:
+		do_read(ih, arg);
+		break;
+	case FUSE_WRITE:
+		do_write(ih, arg, (char *)arg + sizeof(struct fuse_write_in));
+		break;
+	case FUSE_FSYNC:
+		fdatasync(back_fd);
+		/* fall through */
+	case FUSE_FLUSH:
+	case FUSE_RELEASE:
+	case FUSE_RELEASEDIR:
+		reply(ih->unique, 0, NULL, 0);
+		break;
+	case FUSE_FORGET:
+		break;
+	default:
+		reply(ih->unique, -ENOSYS, NULL, 0);
+		break;
+	}
+}
+
+static void daemon_loop(void)
+{
+	struct fuse_in_header *ih = (struct fuse_in_header *)buf;
+	ssize_t n;
+
+	for (;;) {
+		if (use_splice)
+			n = splice(fuse_fd, NULL, pipefd[1], NULL, bufsize, 0);
+		else
+			n = read(fuse_fd, buf, bufsize);
+		if (n < 0) {
+			if (errno == ENODEV)
+				return;		/* unmounted */
+			if (errno == EINTR || errno == ENOENT)
+				continue;
+			die("read request");
+		}
+
+		if (use_splice) {
+			read_full(pipefd[0], ih, sizeof(*ih));
+			if (ih->opcode == FUSE_WRITE) {
+				/* leave the data in the pipe for do_write() */
+				read_full(pipefd[0], ih + 1,
+					  sizeof(struct fuse_write_in));
+			} else
+				read_full(pipefd[0], ih + 1, n - sizeof(*ih));
+		}
+		dispatch(ih, ih + 1);
+	}
+}
+
+static void bench(const char *mnt, unsigned int mib)
+{
+	char path[4096], *io;
+	double t;
+	unsigned int i;
+	int fd;
+
+	io = malloc(BENCH_IO);
+	if (!io)
+		die("malloc");
+	memset(io, 0x5a, BENCH_IO);
+	snprintf(path, sizeof(path), "%s/data", mnt);
+
+	fd = open(path, O_RDWR);
+	if (fd < 0)
+		die(path);
+
+	t = now();
+	for (i = 0; i < mib; i++)
+		if (write(fd, io, BENCH_IO) != BENCH_IO)
+			die("write");
+	fsync(fd);
+	t = now() - t;
+	printf("write: %u MiB in %.2f s, %.1f MiB/s\n", mib, t, mib / t);
+
+	/* drop the page cache so the reads go to the daemon */
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	lseek(fd, 0, SEEK_SET);
+
+	t = now();
+	for (i = 0; i < mib; i++)
+		if (read(fd, io, BENCH_IO) != BENCH_IO)
+			die("read");
+	t = now() - t;
+	printf("read:  %u MiB in %.2f s, %.1f MiB/s\n", mib, t, mib / t);
+
+	close(fd);
+	free(io);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *mnt, *backing;
+	unsigned int mib = 64;
+	char opts[256];
+	pid_t pid;
+	int c;
+
+	while ((c = getopt(argc, argv, "sm:")) != -1) {
+		switch (c) {
+		case 's':
+			use_splice = 1;
+			break;
+		case 'm':
+			mib = atoi(optarg);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind + 2 != argc || !mib)
+		goto usage;
+	mnt = argv[optind];
+	backing = argv[optind + 1];
+
+	/* a spliced request has to fit in one pipe, see above */
+	max_write = use_splice ? 14 * 4096 : 32 * 4096;
+	bufsize = max_write + 4096;
+	buf = malloc(bufsize);
+	if (!buf)
+		die("malloc");
+	if (use_splice && pipe(pipefd))
+		die("pipe");
+
+	back_fd = open(backing, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (back_fd < 0)
+		die(backing);
+	fuse_fd = open("/dev/fuse", O_RDWR);
+	if (fuse_fd < 0)
+		die("/dev/fuse");
+
+	snprintf(opts, sizeof(opts),
+		 "fd=%d,rootmode=40000,user_id=0,group_id=0,max_read=%u",
+		 fuse_fd, max_write);
+	if (mount("fuse-bench", mnt, "fuse", MS_NOSUID | MS_NODEV, opts))
+		die("mount");
+
+	pid = fork();
+	if (pid < 0)
+		die("fork");
+	if (!pid) {
+		daemon_loop();
+		exit(0);
+	}
+	close(fuse_fd);
+
+	printf("%s, max_write %u\n", use_splice ? "splice" : "read/write",
+	       max_write);
+	bench(mnt, mib);
+
+	if (umount(mnt))
+		perror("umount");
+	waitpid(pid, NULL, 0);
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: %s [-s] [-m MiB] mountpoint backing-file\n",
+		argv[0]);
+	return 1;
+}
@@ -0,0 +1,162 @@
+/*
+ * ubifs-commit-stall.c: synchronous write latency across UBIFS commits
+ *
+ * Appends small records to a file and fdatasync()s after each one, the
+ * way a database journal does, rewriting the file from the start when it
+ * reaches its maximum size. Every record goes into the UBIFS journal, so
+ * the journal fills and gets committed over and over. The program prints
+ * the latency distribution of the write + fdatasync pairs, whose tail is
+ * dominated by the writes that had to wait for a commit, and the commit
+ * statistics of the file-system from debugfs before and after the run.
+ *
+ * Setup on nandsim, 128 MiB NAND with 128 KiB erase blocks, with delays
+ * so that the index writes of a commit take a realistic time:
+ *
+ *   modprobe nandsim first_id_byte=0xec second_id_byte=0xf1 \
+ *                    third_id_byte=0x00 fourth_id_byte=0x15 do_delays=1
+ *   modprobe ubi mtd=0
+ *   ubimkvol /dev/ubi0 -N data -m
+ *   mount -t ubifs ubi0:data /mnt
+ *   mount -t debugfs none /sys/kernel/debug
+ *
+ *   gcc -O2 -o ubifs-commit-stall ubifs-commit-stall.c
+ *   ubifs-commit-stall -n 20000 /mnt ubi0_0
+ *
+ * The "waits for commit" and "avg/max wait time" lines of the statistics
+ * are the time tasks spent blocked by commits; "ends in background" counts
+ * the commits that writers left to the background thread.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+
+#define NR_BUCKETS	32	/* powers of 2 microseconds */
+
+static unsigned long long hist[NR_BUCKETS];
+static unsigned long long nr_writes, total_us, max_us;
+
+static unsigned long long now_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+static void die(const char *msg)
+{
+	perror(msg);
+	exit(1);
+}
+
+static void print_cmt_stats(const char *vol)
+{
+	char path[128], line[256];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "/sys/kernel/debug/ubifs/%s/commit_stats",
+		 vol);
+	f = fopen(path, "r");
+	if (!f)
+		return;
+	while (fgets(line, sizeof(line), f))
+		printf("  %s", line);
+	fclose(f);
+}
+
+static unsigned long long percentile(double pct)
+{
+	unsigned long long want = nr_writes * pct / 100, seen = 0;
+	int i;
+
+	for (i = 0; i < NR_BUCKETS; i++) {
+		seen += hist[i];
+		if (seen > want)
+			return 1ULL << i;
+	}
+	return 1ULL << (NR_BUCKETS - 1);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int writes = 10000, rec_size = 512, max_kib = 4096;
+	unsigned long long t, us, off = 0;
+	char path[256], *rec;
+	int fd, c, b;
+
+	while ((c = getopt(argc, argv, "n:r:m:")) != -1) {
+		switch (c) {
+		case 'n':
+			writes = atoi(optarg);
+			break;
+		case 'r':
+			rec_size = atoi(optarg);
+			break;
+		case 'm':
+			max_kib = atoi(optarg);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (argc - optind < 1 || argc - optind > 2 || !rec_size)
+		goto usage;
+
+	rec = malloc(rec_size);
+	if (!rec)
+		die("malloc");
+	snprintf(path, sizeof(path), "%s/commit-stall.dat", argv[optind]);
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		die(path);
+
+	if (argv[optind + 1]) {
+		printf("before:\n");
+		print_cmt_stats(argv[optind + 1]);
+	}
+
+	while (nr_writes < writes) {
+		memset(rec, nr_writes, rec_size);
+		t = now_us();
+		if (pwrite(fd, rec, rec_size, off) != rec_size)
+			die("pwrite");
+		if (fdatasync(fd))
+			die("fdatasync");
+		us = now_us() - t;
+
+		off += rec_size;
+		if (off + rec_size > max_kib * 1024ULL)
+			off = 0;
+
+		for (b = 0; b < NR_BUCKETS - 1 && (1ULL << b) <= us; b++)
+			;
+		hist[b]++;
+		nr_writes++;
+		total_us += us;
+		if (us > max_us)
+			max_us = us;
+	}
+
+	close(fd);
+	unlink(path);
+
+	printf("%llu writes of %u bytes + fdatasync\n", nr_writes, rec_size);
+	printf("  avg %llu us, 50%% < %llu us, 99%% < %llu us, "
+	       "99.9%% < %llu us, max %llu us\n", total_us / nr_writes,
+	       percentile(50), percentile(99), percentile(99.9), max_us);
+	if (argv[optind + 1]) {
+		printf("after:\n");
+		print_cmt_stats(argv[optind + 1]);
+	}
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: %s [-n writes] [-r record bytes] "
+		"[-m max file KiB] dir [ubiX_Y]\n", argv[0]);
+	return 1;
+}
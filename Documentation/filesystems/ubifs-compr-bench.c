@@ -0,0 +1,194 @@
+/*
+ * ubifs-compr-bench.c: UBIFS write speed, CPU use and compression ratio
+ *
+ * Copies sample files into a directory of a mounted UBIFS once per
+ * compressor, selecting the compressor of each copy with the
+ * UBIFS_IOC_SETCOMPR ioctl, and prints for every file and compressor the
+ * write rate (write + fsync), the CPU time the system spent, busy time of
+ * all the CPUs from /proc/stat so that the write back done by pdflush is
+ * counted too, and the compression ratio, out/in bytes of the compressor
+ * statistics in debugfs.
+ *
+ * Use one sample per kind of data, for instance a text file, an
+ * executable, a JPEG picture and an MP3 file: the "skipped" column of the
+ * statistics shows how many blocks of each were recognized as compressed
+ * data already and stored without trying to compress them.
+ *
+ * Setup on nandsim, 128 MiB NAND with 128 KiB erase blocks:
+ *
+ *   modprobe nandsim first_id_byte=0xec second_id_byte=0xf1 \
+ *                    third_id_byte=0x00 fourth_id_byte=0x15
+ *   modprobe ubi mtd=0
+ *   ubimkvol /dev/ubi0 -N data -m
+ *   mount -t ubifs ubi0:data /mnt
+ *   mount -t debugfs none /sys/kernel/debug
+ *
+ *   gcc -O2 -I../../include -o ubifs-compr-bench ubifs-compr-bench.c
+ *   ubifs-compr-bench /mnt notes.txt busybox photo.jpg song.mp3
+ *
+ * The statistics are global, so nothing else should write to a UBIFS
+ * during the run.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <libgen.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <mtd/ubifs-user.h>
+
+#define STATS	"/sys/kernel/debug/ubifs/compr_stats"
+#define CHUNK	(64 * 1024)
+
+static const char * const compr_names[] = { "none", "lzo", "zlib" };
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void die(const char *msg)
+{
+	perror(msg);
+	exit(1);
+}
+
+/* Busy jiffies of all the CPUs: user, nice, system, irq and softirq */
+static unsigned long long cpu_busy(void)
+{
+	unsigned long long user, nice, sys, idle, iowait, irq, softirq;
+	FILE *f = fopen("/proc/stat", "r");
+
+	if (!f || fscanf(f, "cpu %llu %llu %llu %llu %llu %llu %llu", &user,
+			 &nice, &sys, &idle, &iowait, &irq, &softirq) != 7)
+		die("/proc/stat");
+	fclose(f);
+	return user + nice + sys + irq + softirq;
+}
+
+/* Total in and out KiB of all the compressors */
+static int compr_kib(unsigned long long *in, unsigned long long *out)
+{
+	char line[256], name[32];
+	unsigned long blocks, skipped, no_gain;
+	unsigned long long i, o;
+	FILE *f = fopen(STATS, "r");
+
+	*in = *out = 0;
+	if (!f)
+		return -1;
+	while (fgets(line, sizeof(line), f))
+		if (sscanf(line, "%31s %lu %lu %lu %llu %llu", name, &blocks,
+			   &skipped, &no_gain, &i, &o) == 6) {
+			*in += i;
+			*out += o;
+		}
+	fclose(f);
+	return 0;
+}
+
+static void bench(const char *dir, const char *name, const char *data,
+		  size_t size, int32_t compr)
+{
+	unsigned long long busy, in0, out0, in1, out1;
+	char path[512];
+	double t, ratio = 100;
+	size_t off;
+	int fd, have_stats;
+
+	snprintf(path, sizeof(path), "%s/compr-bench.%s", dir,
+		 compr_names[compr]);
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		die(path);
+	if (ioctl(fd, UBIFS_IOC_SETCOMPR, &compr)) {
+		fprintf(stderr, "%s: cannot select %s: %s\n", path,
+			compr_names[compr], strerror(errno));
+		close(fd);
+		unlink(path);
+		return;
+	}
+
+	sync();
+	have_stats = !compr_kib(&in0, &out0);
+	busy = cpu_busy();
+	t = now();
+	for (off = 0; off < size; off += CHUNK) {
+		size_t len = size - off < CHUNK ? size - off : CHUNK;
+
+		if (write(fd, data + off, len) != len)
+			die("write");
+	}
+	if (fsync(fd))
+		die("fsync");
+	t = now() - t;
+	busy = cpu_busy() - busy;
+	close(fd);
+
+	if (have_stats && compr) {
+		compr_kib(&in1, &out1);
+		if (in1 > in0)
+			ratio = 100.0 * (out1 - out0) / (in1 - in0);
+	}
+	printf("%-20.20s %-5s %8.2f MB/s %8.1f ms CPU/MiB %6.1f%%\n", name,
+	       compr_names[compr], size / t / 1e6,
+	       busy * 1000.0 / sysconf(_SC_CLK_TCK) / (size / 1048576.0),
+	       ratio);
+	unlink(path);
+}
+
+int main(int argc, char *argv[])
+{
+	int i, fd;
+	int32_t compr;
+	struct stat st;
+	char *data;
+
+	if (argc < 3) {
+		fprintf(stderr, "usage: %s ubifs-dir file...\n", argv[0]);
+		return 1;
+	}
+
+	printf("%-20s %-5s %13s %17s %7s\n", "file", "compr", "write",
+	       "CPU", "out/in");
+	for (i = 2; i < argc; i++) {
+		fd = open(argv[i], O_RDONLY);
+		if (fd < 0 || fstat(fd, &st))
+			die(argv[i]);
+		if (!st.st_size)
+			continue;
+		data = malloc(st.st_size);
+		if (!data)
+			die("malloc");
+		if (read(fd, data, st.st_size) != st.st_size)
+			die(argv[i]);
+		close(fd);
+
+		for (compr = 0; compr < 3; compr++)
+			bench(argv[1], basename(argv[i]), data, st.st_size,
+			      compr);
+		free(data);
+	}
+
+	printf("\n");
+	fd = open(STATS, O_RDONLY);
+	if (fd >= 0) {
+		char buf[1024];
+		ssize_t n = read(fd, buf, sizeof(buf));
+
+		if (n > 0)
+			fwrite(buf, 1, n, stdout);
+		close(fd);
+	}
+	return 0;
+}
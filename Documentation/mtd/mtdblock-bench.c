@@ -0,0 +1,143 @@
+/*
+ * mtdblock-bench.c: random 4 KiB writes through the mtdblock cache
+ *
+ * Writes random 4 KiB blocks to a region at the start of /dev/mtdblockN
+ * with O_DIRECT, so each write reaches mtdblock instead of staying in the
+ * page cache, then closes the device, which writes back the dirty erase
+ * blocks. It prints the write rate, the time of the final write back and
+ * the mtdblock statistics of /proc/mtdblock taken before the close.
+ *
+ * The erase_writes column is the number of erase + program cycles the run
+ * cost. With the region larger than cache_blocks erase blocks most writes
+ * miss and evict a dirty block; with a region which fits, the dirty blocks
+ * are only written back on expiry and on close. Comparing runs with the
+ * mtdblock cache_blocks parameter at 1 (old behaviour) and larger shows
+ * the difference:
+ *
+ *   modprobe mtdram total_size=8192 erase_size=128
+ *   modprobe mtdblock
+ *   gcc -O2 -o mtdblock-bench mtdblock-bench.c
+ *   echo 1 > /sys/module/mtdblock/parameters/cache_blocks
+ *   mtdblock-bench -r 1024 /dev/mtdblock0
+ *   echo 8 > /sys/module/mtdblock/parameters/cache_blocks
+ *   mtdblock-bench -r 1024 /dev/mtdblock0
+ *
+ * On nandsim (128 MiB, 128 KiB erase blocks) use do_delays=1 so that the
+ * erase and program times are simulated:
+ *
+ *   modprobe nandsim first_id_byte=0xec second_id_byte=0xf1 \
+ *                    third_id_byte=0x00 fourth_id_byte=0x15 do_delays=1
+ *
+ * Raising cache_blocks takes effect at once, lowering it only on devices
+ * opened afterwards, since an open device keeps the buffers it has.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
+#include <linux/fs.h>
+
+#define BS	4096
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void show_stats(void)
+{
+	char line[256];
+	FILE *f = fopen("/proc/mtdblock", "r");
+
+	if (!f)
+		return;
+	while (fgets(line, sizeof(line), f))
+		fputs(line, stdout);
+	fclose(f);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long long size;
+	unsigned long region = 1024, blocks, i;
+	unsigned int writes = 1000;
+	int fd, c, flags = O_RDWR | O_DIRECT;
+	double t, t_close;
+	void *buf;
+
+	while ((c = getopt(argc, argv, "n:r:s:b")) != -1) {
+		switch (c) {
+		case 'n':
+			writes = atoi(optarg);
+			break;
+		case 'r':
+			region = atol(optarg);
+			break;
+		case 's':
+			srandom(atoi(optarg));
+			break;
+		case 'b':
+			flags &= ~O_DIRECT;
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind != argc - 1 || !region)
+		goto usage;
+
+	fd = open(argv[optind], flags);
+	if (fd < 0) {
+		perror(argv[optind]);
+		return 1;
+	}
+	if (ioctl(fd, BLKGETSIZE64, &size) < 0) {
+		perror("BLKGETSIZE64");
+		return 1;
+	}
+	blocks = region * 1024 / BS;
+	if (blocks > size / BS)
+		blocks = size / BS;
+	if (posix_memalign(&buf, BS, BS)) {
+		perror("posix_memalign");
+		return 1;
+	}
+
+	t = now();
+	for (i = 0; i < writes; i++) {
+		off_t off = (off_t)(random() % blocks) * BS;
+
+		memset(buf, random(), BS);
+		if (pwrite(fd, buf, BS, off) != BS) {
+			perror("pwrite");
+			return 1;
+		}
+	}
+	/* with -b, push the page cache down to mtdblock */
+	fsync(fd);
+	t = now() - t;
+
+	show_stats();
+
+	t_close = now();
+	close(fd);
+	t_close = now() - t_close;
+
+	printf("%u random %d KiB writes in %lu KiB: %.1f writes/s, "
+	       "%.3f s to write back on close\n", writes, BS / 1024,
+	       blocks * BS / 1024, writes / t, t_close);
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: %s [-n writes] [-r region KiB] [-s seed] [-b] "
+		"/dev/mtdblockN\n", argv[0]);
+	return 1;
+}
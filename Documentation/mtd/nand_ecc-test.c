@@ -0,0 +1,271 @@
+/*
+ * nand_ecc-test.c: check and benchmark the software Hamming ECC
+ *
+ * Builds drivers/mtd/nand/nand_ecc.c in STANDALONE mode and checks it
+ * against a reference implementation, the classic byte by byte algorithm
+ * with a parity table that nand_ecc.c used before 2.6.27:
+ *
+ *   - the ECC of random blocks has to be the same as the reference one;
+ *   - a random bit flip in the data has to be corrected;
+ *   - a random bit flip in the ECC has to be reported as corrected
+ *     without touching the data;
+ *   - two bit flips in the data have to be reported as uncorrectable.
+ *
+ * It then prints the throughput of nand_calculate_ecc(), of the
+ * reference and of nand_correct_data() with and without a bit flip.
+ * Running it before and after a change to nand_ecc.c compares the two
+ * versions.
+ *
+ * Build:  gcc -O2 -o nand_ecc-test nand_ecc-test.c
+ *         (add -DCONFIG_MTD_NAND_ECC_SMC for the SmartMedia byte order)
+ * Usage:  nand_ecc-test [-s 256|512] [-n blocks] [-m MiB]
+ *
+ * In the kernel, the same paths can be exercised on nandsim, which uses
+ * software ECC and flips random bits on page reads with bitflips=N; the
+ * corrected and failed counts show up in its log and in the ECC stats of
+ * the MTD device.
+ */
+
+#define STANDALONE
+/* the uncorrectable errors are expected, see check() */
+#define printk(fmt...)	do { } while (0)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "../../drivers/mtd/nand/nand_ecc.c"
+
+/* bits 0-5: column parities cp0..cp5, bit 6: parity of the byte */
+static unsigned char ref_table[256];
+
+static void ref_init(void)
+{
+	static const unsigned char cpmask[6] = {
+		0x55, 0xaa, 0x33, 0xcc, 0x0f, 0xf0
+	};
+	int i, j;
+
+	for (i = 0; i < 256; i++) {
+		for (j = 0; j < 6; j++)
+			ref_table[i] |= __builtin_parity(i & cpmask[j]) << j;
+		ref_table[i] |= __builtin_parity(i) << 6;
+	}
+}
+
+static void ref_calculate_ecc(const unsigned char *buf, int size,
+			      unsigned char *code)
+{
+	unsigned int reg1 = 0, reg2 = 0, reg3 = 0, rpe, rpo;
+	unsigned char lo, hi;
+	int i;
+
+	for (i = 0; i < size; i++) {
+		unsigned char idx = ref_table[buf[i]];
+
+		reg1 ^= idx & 0x3f;
+		if (idx & 0x40) {
+			reg3 ^= i;
+			reg2 ^= ~i;
+		}
+	}
+
+	/* bit k of reg2 is rp(2k), bit k of reg3 is rp(2k + 1) */
+	rpe = reg2 & 0x1ff;
+	rpo = reg3 & 0x1ff;
+	lo = hi = 0;
+	for (i = 0; i < 4; i++) {
+		lo |= ((rpe >> i) & 1) << (2 * i);
+		lo |= ((rpo >> i) & 1) << (2 * i + 1);
+		hi |= ((rpe >> (i + 4)) & 1) << (2 * i);
+		hi |= ((rpo >> (i + 4)) & 1) << (2 * i + 1);
+	}
+#ifdef CONFIG_MTD_NAND_ECC_SMC
+	code[0] = ~lo;
+	code[1] = ~hi;
+#else
+	code[0] = ~hi;
+	code[1] = ~lo;
+#endif
+	code[2] = ~(reg1 << 2);
+	if (size == 512)
+		code[2] &= ~(((rpo >> 8) & 1) << 1 | ((rpe >> 8) & 1));
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int check(struct mtd_info *mtd, int size, int blocks)
+{
+	unsigned char *buf, *orig, code[3], ref[3], bad[3];
+	int n, pos, pos2, ret, errors = 0;
+
+	buf = malloc(size);
+	orig = malloc(size);
+	if (!buf || !orig) {
+		perror("malloc");
+		exit(1);
+	}
+
+	for (n = 0; n < blocks && errors < 10; n++) {
+		for (pos = 0; pos < size; pos++)
+			orig[pos] = random();
+		/* some all-ones (erased) and all-zeroes blocks too */
+		if (n == 0)
+			memset(orig, 0xff, size);
+		else if (n == 1)
+			memset(orig, 0, size);
+
+		nand_calculate_ecc(mtd, orig, code);
+		ref_calculate_ecc(orig, size, ref);
+		if (memcmp(code, ref, 3)) {
+			printf("block %d: ecc %02x%02x%02x, reference "
+			       "%02x%02x%02x\n", n, code[0], code[1], code[2],
+			       ref[0], ref[1], ref[2]);
+			errors++;
+			continue;
+		}
+
+		/* one bit flip in the data */
+		memcpy(buf, orig, size);
+		pos = random() % (size * 8);
+		buf[pos / 8] ^= 1 << (pos % 8);
+		nand_calculate_ecc(mtd, buf, bad);
+		ret = nand_correct_data(mtd, buf, code, bad);
+		if (ret != 1 || memcmp(buf, orig, size)) {
+			printf("block %d: data bit %d not corrected (%d)\n",
+			       n, pos, ret);
+			errors++;
+		}
+
+		/* one bit flip in the ecc */
+		memcpy(bad, code, 3);
+		pos = random() % 24;
+		bad[pos / 8] ^= 1 << (pos % 8);
+		ret = nand_correct_data(mtd, buf, bad, code);
+		if (ret != 1 || memcmp(buf, orig, size)) {
+			printf("block %d: ecc bit %d not handled (%d)\n",
+			       n, pos, ret);
+			errors++;
+		}
+
+		/* two bit flips in the data */
+		memcpy(buf, orig, size);
+		pos = random() % (size * 8);
+		do
+			pos2 = random() % (size * 8);
+		while (pos2 == pos);
+		buf[pos / 8] ^= 1 << (pos % 8);
+		buf[pos2 / 8] ^= 1 << (pos2 % 8);
+		nand_calculate_ecc(mtd, buf, bad);
+		ret = nand_correct_data(mtd, buf, code, bad);
+		if (ret != -1) {
+			printf("block %d: bits %d and %d not detected (%d)\n",
+			       n, pos, pos2, ret);
+			errors++;
+		}
+	}
+
+	free(buf);
+	free(orig);
+	return errors;
+}
+
+static void bench(struct mtd_info *mtd, int size, unsigned int mib)
+{
+	unsigned char *buf, code[3], bad[3];
+	unsigned long i, nr = ((unsigned long)mib << 20) / size;
+	volatile unsigned char sink;
+	double t;
+
+	/* a buffer which fits in the cache, so the ecc code is measured */
+	buf = malloc(64 * size);
+	if (!buf) {
+		perror("malloc");
+		exit(1);
+	}
+	for (i = 0; i < 64 * size; i++)
+		buf[i] = random();
+
+	t = now();
+	for (i = 0; i < nr; i++)
+		nand_calculate_ecc(mtd, buf + (i & 63) * size, code);
+	t = now() - t;
+	sink = code[0];
+	printf("nand_calculate_ecc:       %8.1f MiB/s\n", mib / t);
+
+	t = now();
+	for (i = 0; i < nr; i++)
+		ref_calculate_ecc(buf + (i & 63) * size, size, code);
+	t = now() - t;
+	sink = code[0];
+	printf("reference (byte by byte): %8.1f MiB/s\n", mib / t);
+
+	memcpy(bad, code, 3);
+	t = now();
+	for (i = 0; i < nr; i++)
+		sink = nand_correct_data(mtd, buf, code, bad);
+	t = now() - t;
+	printf("nand_correct_data, clean: %8.1f M/s\n", nr / t / 1e6);
+
+	/* a flip in the ecc, so the data is left alone */
+	bad[0] ^= 0x10;
+	t = now();
+	for (i = 0; i < nr; i++)
+		sink = nand_correct_data(mtd, buf, code, bad);
+	t = now() - t;
+	printf("nand_correct_data, flip:  %8.1f M/s\n", nr / t / 1e6);
+
+	(void)sink;
+	free(buf);
+}
+
+int main(int argc, char *argv[])
+{
+	struct nand_chip chip;
+	struct mtd_info mtd;
+	unsigned int mib = 256;
+	int blocks = 100000, errors, c;
+
+	chip.ecc.size = 256;
+	while ((c = getopt(argc, argv, "s:n:m:")) != -1) {
+		switch (c) {
+		case 's':
+			chip.ecc.size = atoi(optarg);
+			break;
+		case 'n':
+			blocks = atoi(optarg);
+			break;
+		case 'm':
+			mib = atoi(optarg);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (chip.ecc.size != 256 && chip.ecc.size != 512)
+		goto usage;
+	mtd.priv = &chip;
+
+	ref_init();
+	errors = check(&mtd, chip.ecc.size, blocks);
+	printf("%d byte blocks: %d blocks checked, %d errors\n",
+	       chip.ecc.size, blocks, errors);
+	if (errors)
+		return 1;
+
+	if (mib)
+		bench(&mtd, chip.ecc.size, mib);
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: %s [-s 256|512] [-n blocks] [-m MiB]\n",
+		argv[0]);
+	return 1;
+}
@@ -0,0 +1,207 @@
+/*
+ * ubi-wl-stress.c: foreground write latency under UBI wear-leveling
+ *
+ * Overwrites random blocks of a file on UBIFS, each write followed by
+ * fdatasync(), and prints the latency distribution of these writes. The
+ * overwrites keep the UBI background thread busy with erasures and, with
+ * a low wear-leveling threshold, with wear-leveling moves, so the tail
+ * latencies show how much the background works get in the way.
+ *
+ * The background thread defers its works while there is foreground I/O,
+ * see the bgt_idle_ms parameter of the ubi module. Comparing runs with it
+ * set to 0 (old behaviour) and to the default shows the difference. The
+ * UBI wear-leveling statistics are printed before and after the run, if
+ * debugfs is mounted.
+ *
+ * Setup on nandsim, 256 MiB NAND, with a kernel built with
+ * CONFIG_MTD_UBI_WL_THRESHOLD=128 so that wear-leveling kicks in quickly:
+ *
+ *   modprobe nandsim first_id_byte=0x20 second_id_byte=0xaa \
+ *                    third_id_byte=0x00 fourth_id_byte=0x15
+ *   modprobe ubi mtd=0
+ *   ubimkvol /dev/ubi0 -N test -m
+ *   mount -t ubifs ubi0:test /mnt
+ *   mount -t debugfs none /sys/kernel/debug
+ *
+ *   gcc -O2 -o ubi-wl-stress ubi-wl-stress.c
+ *   echo 0 > /sys/module/ubi/parameters/bgt_idle_ms
+ *   ubi-wl-stress -c 128 -s 60 /mnt
+ *   echo 20 > /sys/module/ubi/parameters/bgt_idle_ms
+ *   ubi-wl-stress -s 60 /mnt
+ *
+ * -c fills a file with that many MiB of static data first, which gives
+ * wear-leveling something to move; it is kept between runs.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#define NR_BUCKETS	32	/* log2 microseconds */
+
+static unsigned long long hist[NR_BUCKETS];
+static unsigned long long nr_writes, total_us, max_us;
+
+static unsigned long long now_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+static void die(const char *msg)
+{
+	perror(msg);
+	exit(1);
+}
+
+static void print_wl_stats(const char *ubi)
+{
+	char path[256], line[256];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "/sys/kernel/debug/ubi/%s/wl_stats", ubi);
+	f = fopen(path, "r");
+	if (!f)
+		return;
+	while (fgets(line, sizeof(line), f))
+		printf("  %s", line);
+	fclose(f);
+}
+
+static void fill_cold(const char *dir, unsigned int mib, char *buf,
+		      size_t bs)
+{
+	char path[4096];
+	unsigned long long left = (unsigned long long)mib << 20;
+	struct stat st;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/cold", dir);
+	if (!stat(path, &st) && st.st_size >= (off_t)left)
+		return;
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		die(path);
+	while (left) {
+		size_t n = left < bs ? left : bs;
+
+		if (write(fd, buf, n) != (ssize_t)n)
+			die("write cold");
+		left -= n;
+	}
+	fsync(fd);
+	close(fd);
+}
+
+/* The latency below which @pct percent of the writes completed */
+static unsigned long long percentile(double pct)
+{
+	unsigned long long want = nr_writes * pct / 100, seen = 0;
+	int i;
+
+	for (i = 0; i < NR_BUCKETS; i++) {
+		seen += hist[i];
+		if (seen >= want)
+			return 1ULL << i;
+	}
+	return max_us;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int seconds = 30, cold = 0, hot = 16, i;
+	const char *ubi = "ubi0", *dir;
+	size_t bs = 4096;
+	unsigned long long end, t, us;
+	char path[4096], *buf;
+	off_t blocks;
+	int c, fd;
+
+	while ((c = getopt(argc, argv, "s:b:c:f:u:")) != -1) {
+		switch (c) {
+		case 's':
+			seconds = atoi(optarg);
+			break;
+		case 'b':
+			bs = atoi(optarg);
+			break;
+		case 'c':
+			cold = atoi(optarg);
+			break;
+		case 'f':
+			hot = atoi(optarg);
+			break;
+		case 'u':
+			ubi = optarg;
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind + 1 != argc || !seconds || !bs || !hot)
+		goto usage;
+	dir = argv[optind];
+
+	buf = malloc(bs);
+	if (!buf)
+		die("malloc");
+	for (i = 0; i < bs; i++)
+		buf[i] = rand();	/* defeat UBIFS compression */
+
+	if (cold)
+		fill_cold(dir, cold, buf, bs);
+
+	snprintf(path, sizeof(path), "%s/hot", dir);
+	fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0)
+		die(path);
+	blocks = ((off_t)hot << 20) / bs;
+	if (ftruncate(fd, blocks * bs))
+		die("ftruncate");
+
+	printf("before:\n");
+	print_wl_stats(ubi);
+
+	end = now_us() + seconds * 1000000ULL;
+	while ((t = now_us()) < end) {
+		off_t off = (random() % blocks) * bs;
+
+		buf[0]++;
+		if (pwrite(fd, buf, bs, off) != (ssize_t)bs)
+			die("pwrite");
+		if (fdatasync(fd))
+			die("fdatasync");
+
+		us = now_us() - t;
+		for (i = 0; i < NR_BUCKETS - 1 && (1ULL << i) < us; i++)
+			;
+		hist[i]++;
+		nr_writes++;
+		total_us += us;
+		if (us > max_us)
+			max_us = us;
+	}
+	close(fd);
+
+	printf("after:\n");
+	print_wl_stats(ubi);
+
+	printf("%llu writes of %zu bytes, avg %llu us, p50 <%llu us, "
+	       "p99 <%llu us, p99.9 <%llu us, max %llu us\n",
+	       nr_writes, bs, nr_writes ? total_us / nr_writes : 0,
+	       percentile(50), percentile(99), percentile(99.9), max_us);
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: %s [-s seconds] [-b block size] [-c cold MiB] "
+		"[-f hot file MiB] [-u ubiX] directory\n", argv[0]);
+	return 1;
+}
@@ -0,0 +1,211 @@
+/*
+ * cfs-bg-load.c: foreground frame latency against background cpu load
+ *
+ * Puts itself in a "fg" cpu cgroup and runs a frame loop the way a
+ * foreground app renders: it wakes at the start of every frame period,
+ * does a fixed amount of cpu work, and sleeps until the next frame. In a
+ * "bg" cgroup, a number of busy loops stand for the background apps. The
+ * program prints how late the frame task woke up, how many frames took
+ * longer than the period, and the cpu.wait_stat of fg and cpu.cfs_stat of
+ * bg from the cgroup file-system.
+ *
+ * The cgroups are created below the given cpu cgroup mount. Comparing a
+ * run without limits with one where the background is capped and the
+ * foreground boosted shows the effect of both:
+ *
+ *   mount -t cgroup -o cpu none /dev/cpuctl
+ *   gcc -O2 -o cfs-bg-load cfs-bg-load.c -lrt
+ *   cfs-bg-load -n 4 /dev/cpuctl
+ *   cfs-bg-load -n 4 -q 20000 -b 1 /dev/cpuctl
+ *
+ * -q sets cpu.cfs_quota_us of bg (-1 for no cap), -b cpu.wakeup_boost of
+ * fg; both are written on every run, so leaving them out resets them.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define MAX_FRAMES	100000
+
+static long long lat_us[MAX_FRAMES];
+
+static void die(const char *msg)
+{
+	perror(msg);
+	exit(1);
+}
+
+static long long ts_ns(const struct timespec *ts)
+{
+	return ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+static long long now_ns(clockid_t clk)
+{
+	struct timespec ts;
+
+	clock_gettime(clk, &ts);
+	return ts_ns(&ts);
+}
+
+static void write_file(const char *dir, const char *name, const char *val)
+{
+	char path[512];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	f = fopen(path, "w");
+	if (!f || fputs(val, f) < 0 || fclose(f))
+		die(path);
+}
+
+static void join(const char *dir)
+{
+	char pid[16];
+
+	snprintf(pid, sizeof(pid), "%d", getpid());
+	write_file(dir, "tasks", pid);
+}
+
+static void show_file(const char *dir, const char *name)
+{
+	char path[512], line[256];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	f = fopen(path, "r");
+	if (!f) {
+		printf("  %s: not available\n", path);
+		return;
+	}
+	printf("  %s:\n", path);
+	while (fgets(line, sizeof(line), f))
+		printf("    %s", line);
+	fclose(f);
+}
+
+static int cmp_ll(const void *a, const void *b)
+{
+	long long x = *(const long long *)a, y = *(const long long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+int main(int argc, char *argv[])
+{
+	int nr_bg = 4, boost = 0, seconds = 10, frame_ms = 16, work_ms = 4;
+	long quota = -1;
+	char fg[256], bg[256], val[32];
+	long long start, next, t, cpu, lat_sum = 0;
+	int c, i, frames = 0, missed = 0;
+	struct timespec ts;
+	pid_t *pids;
+
+	while ((c = getopt(argc, argv, "n:q:b:t:f:w:")) != -1) {
+		switch (c) {
+		case 'n':
+			nr_bg = atoi(optarg);
+			break;
+		case 'q':
+			quota = atol(optarg);
+			break;
+		case 'b':
+			boost = atoi(optarg);
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 'f':
+			frame_ms = atoi(optarg);
+			break;
+		case 'w':
+			work_ms = atoi(optarg);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind != argc - 1 || frame_ms <= 0 || work_ms >= frame_ms)
+		goto usage;
+
+	snprintf(fg, sizeof(fg), "%s/fg", argv[optind]);
+	snprintf(bg, sizeof(bg), "%s/bg", argv[optind]);
+	if ((mkdir(fg, 0755) && errno != EEXIST) ||
+	    (mkdir(bg, 0755) && errno != EEXIST))
+		die("mkdir");
+	snprintf(val, sizeof(val), "%ld", quota);
+	write_file(bg, "cpu.cfs_quota_us", val);
+	snprintf(val, sizeof(val), "%d", boost);
+	write_file(fg, "cpu.wakeup_boost", val);
+
+	pids = calloc(nr_bg, sizeof(*pids));
+	if (!pids)
+		die("calloc");
+	for (i = 0; i < nr_bg; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0)
+			die("fork");
+		if (!pids[i]) {
+			join(bg);
+			for (;;)
+				;
+		}
+	}
+	join(fg);
+
+	start = next = now_ns(CLOCK_MONOTONIC);
+	while (next - start < seconds * 1000000000LL && frames < MAX_FRAMES) {
+		next += frame_ms * 1000000LL;
+		ts.tv_sec = next / 1000000000LL;
+		ts.tv_nsec = next % 1000000000LL;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts,
+				       NULL) == EINTR)
+			;
+		t = now_ns(CLOCK_MONOTONIC);
+		lat_us[frames] = (t - next) / 1000;
+		lat_sum += lat_us[frames];
+
+		/* the frame's work, in cpu time so that preemption counts */
+		cpu = now_ns(CLOCK_THREAD_CPUTIME_ID);
+		while (now_ns(CLOCK_THREAD_CPUTIME_ID) - cpu <
+		       work_ms * 1000000LL)
+			;
+		if (now_ns(CLOCK_MONOTONIC) - next > frame_ms * 1000000LL)
+			missed++;
+		frames++;
+	}
+
+	for (i = 0; i < nr_bg; i++)
+		kill(pids[i], SIGKILL);
+	while (wait(NULL) > 0)
+		;
+	join(argv[optind]);
+
+	qsort(lat_us, frames, sizeof(lat_us[0]), cmp_ll);
+	printf("%d bg loops, bg quota %ld us, fg boost %d: %d frames of "
+	       "%d ms with %d ms work\n", nr_bg, quota, boost, frames,
+	       frame_ms, work_ms);
+	if (frames)
+		printf("  wakeup latency avg %lld us, 99%% < %lld us, max %lld "
+		       "us, %d frames late (%.1f%%)\n", lat_sum / frames,
+		       lat_us[frames * 99 / 100], lat_us[frames - 1], missed,
+		       100.0 * missed / frames);
+	show_file(fg, "cpu.wait_stat");
+	show_file(bg, "cpu.cfs_stat");
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: %s [-n bg loops] [-q bg quota us] "
+		"[-b fg boost] [-t seconds] [-f frame ms] [-w work ms] "
+		"cpu-cgroup-dir\n", argv[0]);
+	return 1;
+}
@@ -0,0 +1,163 @@
+/*
+ * readahead-streams.c: throughput of interleaved sequential reads
+ *
+ * Reads a file as a media player reads a file with separate audio and
+ * video streams: several sequential streams, each over its own part of
+ * the file, all through the same file descriptor and in turn, one chunk
+ * at a time. Each read is then far from the previous one, which readahead
+ * used to take as random reads. The program prints the read rate and the
+ * readahead statistics of the backing device, from /sys/class/bdi/<bdi>/,
+ * before and after.
+ *
+ * The page cache of the file is dropped first, with fadvise. Comparing
+ * runs with context readahead off and on shows the difference; for a
+ * file on the first partition of an SD card:
+ *
+ *   gcc -O2 -o readahead-streams readahead-streams.c
+ *   echo 0 > /sys/class/bdi/179:0/read_ahead_context
+ *   readahead-streams -n 3 -b 179:0 /media/movie.avi
+ *   echo 1 > /sys/class/bdi/179:0/read_ahead_context
+ *   readahead-streams -n 3 -b 179:0 /media/movie.avi
+ *
+ * Without -b the bdi is taken from the device number of the file, which
+ * is right for whole disks and for non-block file-systems; a partition
+ * uses the bdi of its disk.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/sysmacros.h>
+
+static const char * const stat_names[] = {
+	"read_ahead_pages", "read_ahead_hits", "read_ahead_wasted"
+};
+#define NR_STATS (sizeof(stat_names) / sizeof(stat_names[0]))
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void die(const char *msg)
+{
+	perror(msg);
+	exit(1);
+}
+
+static int read_stats(const char *bdi, long long *st)
+{
+	char path[256];
+	unsigned int i;
+	FILE *f;
+
+	for (i = 0; i < NR_STATS; i++) {
+		snprintf(path, sizeof(path), "/sys/class/bdi/%s/%s", bdi,
+			 stat_names[i]);
+		f = fopen(path, "r");
+		if (!f)
+			return -1;
+		if (fscanf(f, "%lld", &st[i]) != 1)
+			st[i] = 0;
+		fclose(f);
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int streams = 2, chunk_kib = 32, i, c;
+	long long before[NR_STATS], after[NR_STATS];
+	off_t *pos, part, total = 0;
+	char bdi[64] = "", *buf;
+	int fd, have_stats, done;
+	struct stat st;
+	double t;
+
+	while ((c = getopt(argc, argv, "n:c:b:")) != -1) {
+		switch (c) {
+		case 'n':
+			streams = atoi(optarg);
+			break;
+		case 'c':
+			chunk_kib = atoi(optarg);
+			break;
+		case 'b':
+			snprintf(bdi, sizeof(bdi), "%s", optarg);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind != argc - 1 || !streams || !chunk_kib)
+		goto usage;
+
+	fd = open(argv[optind], O_RDONLY);
+	if (fd < 0 || fstat(fd, &st))
+		die(argv[optind]);
+	if (!bdi[0])
+		snprintf(bdi, sizeof(bdi), "%u:%u", major(st.st_dev),
+			 minor(st.st_dev));
+
+	buf = malloc(chunk_kib * 1024);
+	pos = calloc(streams, sizeof(*pos));
+	if (!buf || !pos)
+		die("malloc");
+	part = st.st_size / streams;
+	for (i = 0; i < streams; i++)
+		pos[i] = i * part;
+
+	fdatasync(fd);
+	if (posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED))
+		fprintf(stderr, "cannot drop the cached pages of the file\n");
+
+	have_stats = !read_stats(bdi, before);
+	t = now();
+	do {
+		done = 1;
+		for (i = 0; i < streams; i++) {
+			off_t end = (i + 1) * part;
+			size_t len = chunk_kib * 1024;
+			ssize_t ret;
+
+			if (pos[i] >= end)
+				continue;
+			if (len > end - pos[i])
+				len = end - pos[i];
+			ret = pread(fd, buf, len, pos[i]);
+			if (ret < 0)
+				die("pread");
+			if (ret == 0) {
+				pos[i] = end;
+				continue;
+			}
+			pos[i] += ret;
+			total += ret;
+			done = 0;
+		}
+	} while (!done);
+	t = now() - t;
+
+	printf("%u streams, %u KiB reads: %lld KiB in %.2f s, %.2f MB/s\n",
+	       streams, chunk_kib, (long long)total >> 10, t, total / t / 1e6);
+	if (have_stats && !read_stats(bdi, after))
+		for (i = 0; i < NR_STATS; i++)
+			printf("  %-18s %lld\n", stat_names[i],
+			       after[i] - before[i]);
+	else
+		printf("  no readahead statistics for bdi %s, use -b\n", bdi);
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: %s [-n streams] [-c chunk KiB] [-b bdi] file\n",
+		argv[0]);
+	return 1;
+}
@@ -0,0 +1,219 @@
+/*
+ * workingset-switch.c: switching between applications under memory pressure
+ *
+ * Simulates a user switching in turn between a few applications, each with
+ * a working set of file pages it touches whenever it comes to the front, the
+ * way an application touches its code and resources, while a background
+ * task streams through a large file, the way a media player or a file copy
+ * does. The streamed pages are used once; the working sets are used again
+ * on every round, but less often than the inactive list takes to go round
+ * when memory is short, so without refault detection they are evicted and
+ * read back on every switch.
+ *
+ * The program prints, per round, the average time to switch to an
+ * application (touch all its pages) and the major faults that took, and at
+ * the end the workingset counters from /proc/vmstat: the refaults of
+ * recently evicted pages and how many of them were activated.
+ *
+ * Size the working sets so that together they fit in memory but not in
+ * the inactive list, and the stream well above memory size; on a board
+ * with 128 MiB of RAM:
+ *
+ *   gcc -O2 -o workingset-switch workingset-switch.c
+ *   workingset-switch -a 4 -w 16 -s 512 -r 10 /media/tmp
+ *
+ * The files are created in the given directory on the first run and left
+ * there for the next ones; their page cache is dropped at the start.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#define CHUNK	(256 * 1024)
+
+static const char * const stat_names[] = {
+	"workingset_refault", "workingset_activate", "pgmajfault"
+};
+#define NR_STATS (sizeof(stat_names) / sizeof(stat_names[0]))
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void die(const char *msg)
+{
+	perror(msg);
+	exit(1);
+}
+
+static void read_stats(unsigned long long *st)
+{
+	char name[64];
+	unsigned long long val;
+	unsigned int i;
+	FILE *f = fopen("/proc/vmstat", "r");
+
+	memset(st, 0, NR_STATS * sizeof(*st));
+	if (!f)
+		return;
+	while (fscanf(f, "%63s %llu", name, &val) == 2)
+		for (i = 0; i < NR_STATS; i++)
+			if (!strcmp(name, stat_names[i]))
+				st[i] = val;
+	fclose(f);
+}
+
+static long majflt(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_majflt;
+}
+
+/* Open @path, creating it @mib MiB long if it is shorter */
+static int open_file(const char *path, unsigned int mib)
+{
+	off_t size = (off_t)mib << 20, off;
+	struct stat st;
+	char *buf;
+	int fd;
+
+	fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0 || fstat(fd, &st))
+		die(path);
+	if (st.st_size < size) {
+		buf = malloc(CHUNK);
+		if (!buf)
+			die("malloc");
+		memset(buf, 0x5a, CHUNK);
+		for (off = 0; off < size; off += CHUNK)
+			if (pwrite(fd, buf, CHUNK, off) != CHUNK)
+				die(path);
+		free(buf);
+	}
+	fdatasync(fd);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	return fd;
+}
+
+/* Bring an application to the front: touch each page of its working set */
+static void touch(const volatile char *map, size_t size)
+{
+	size_t off;
+	char c = 0;
+
+	for (off = 0; off < size; off += 4096)
+		c += map[off];
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int apps = 4, ws_mib = 16, stream_mib = 512, rounds = 10;
+	unsigned long long before[NR_STATS], after[NR_STATS];
+	off_t stream_off = 0, stream_size;
+	char path[512], *buf, **maps;
+	unsigned int a, r, i;
+	int c, stream_fd;
+	size_t ws_size;
+	double t, total = 0;
+	long flt, total_flt = 0;
+
+	while ((c = getopt(argc, argv, "a:w:s:r:")) != -1) {
+		switch (c) {
+		case 'a':
+			apps = atoi(optarg);
+			break;
+		case 'w':
+			ws_mib = atoi(optarg);
+			break;
+		case 's':
+			stream_mib = atoi(optarg);
+			break;
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind != argc - 1 || !apps || !ws_mib || !stream_mib)
+		goto usage;
+
+	ws_size = (size_t)ws_mib << 20;
+	maps = calloc(apps, sizeof(*maps));
+	buf = malloc(CHUNK);
+	if (!maps || !buf)
+		die("malloc");
+	for (a = 0; a < apps; a++) {
+		int fd;
+
+		snprintf(path, sizeof(path), "%s/workingset-app%u", argv[optind],
+			 a);
+		fd = open_file(path, ws_mib);
+		maps[a] = mmap(NULL, ws_size, PROT_READ, MAP_SHARED, fd, 0);
+		if (maps[a] == MAP_FAILED)
+			die("mmap");
+		close(fd);
+	}
+	snprintf(path, sizeof(path), "%s/workingset-stream", argv[optind]);
+	stream_fd = open_file(path, stream_mib);
+	stream_size = (off_t)stream_mib << 20;
+
+	read_stats(before);
+	for (r = 0; r < rounds; r++) {
+		double round_t = 0;
+		long round_flt = 0;
+
+		for (a = 0; a < apps; a++) {
+			flt = majflt();
+			t = now();
+			touch(maps[a], ws_size);
+			round_t += now() - t;
+			round_flt += majflt() - flt;
+
+			/* the stream goes on while the user is in the app */
+			for (i = 0; i < ws_size / CHUNK * 2; i++) {
+				if (pread(stream_fd, buf, CHUNK, stream_off) < 0)
+					die("pread");
+				stream_off += CHUNK;
+				if (stream_off >= stream_size)
+					stream_off = 0;
+			}
+		}
+		printf("round %2u: %8.1f ms per switch, %6ld major faults\n",
+		       r, round_t * 1000 / apps, round_flt);
+		if (r) {
+			/* the first round reads everything in cold */
+			total += round_t;
+			total_flt += round_flt;
+		}
+	}
+	read_stats(after);
+
+	if (rounds > 1)
+		printf("average after round 0: %.1f ms per switch, "
+		       "%.1f major faults per switch\n",
+		       total * 1000 / apps / (rounds - 1),
+		       (double)total_flt / apps / (rounds - 1));
+	for (i = 0; i < NR_STATS; i++)
+		printf("  %-20s %llu\n", stat_names[i], after[i] - before[i]);
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: %s [-a apps] [-w working set MiB] "
+		"[-s stream MiB] [-r rounds] dir\n", argv[0]);
+	return 1;
+}
@@ -0,0 +1,397 @@
+/*
+ * Glue code for the ARM assembler AES implementation
+ *
+ * The single block cipher is registered for users of the plain "aes"
+ * cipher; ecb, cbc and ctr are also registered as block ciphers of their
+ * own so that a whole walk is processed without an indirect call per
+ * block through the generic templates.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <crypto/aes.h>
+#include <crypto/algapi.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/string.h>
+
+asmlinkage void __aes_arm_encrypt(const u32 *key_enc, int rounds,
+				  const u8 *in, u8 *out);
+asmlinkage void __aes_arm_decrypt(const u32 *key_dec, int rounds,
+				  const u8 *in, u8 *out);
+
+static inline int aes_rounds(const struct crypto_aes_ctx *ctx)
+{
+	return 6 + ctx->key_length / 4;
+}
+
+static void aes_encrypt(struct crypto_tfm *tfm, u8 *dst, const u8 *src)
+{
+	struct crypto_aes_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	__aes_arm_encrypt(ctx->key_enc, aes_rounds(ctx), src, dst);
+}
+
+static void aes_decrypt(struct crypto_tfm *tfm, u8 *dst, const u8 *src)
+{
+	struct crypto_aes_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	__aes_arm_decrypt(ctx->key_dec, aes_rounds(ctx), src, dst);
+}
+
+static int aes_setkey(struct crypto_tfm *tfm, const u8 *in_key,
+		      unsigned int key_len)
+{
+	return crypto_aes_set_key(tfm, in_key, key_len);
+}
+
+static int ecb_aes_encrypt(struct blkcipher_desc *desc,
+			   struct scatterlist *dst, struct scatterlist *src,
+			   unsigned int nbytes)
+{
+	struct crypto_aes_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	int rounds = aes_rounds(ctx);
+	struct blkcipher_walk walk;
+	int err;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt(desc, &walk);
+
+	while ((nbytes = walk.nbytes)) {
+		u8 *in = walk.src.virt.addr;
+		u8 *out = walk.dst.virt.addr;
+
+		do {
+			__aes_arm_encrypt(ctx->key_enc, rounds, in, out);
+			in += AES_BLOCK_SIZE;
+			out += AES_BLOCK_SIZE;
+		} while ((nbytes -= AES_BLOCK_SIZE) >= AES_BLOCK_SIZE);
+
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+
+	return err;
+}
+
+static int ecb_aes_decrypt(struct blkcipher_desc *desc,
+			   struct scatterlist *dst, struct scatterlist *src,
+			   unsigned int nbytes)
+{
+	struct crypto_aes_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	int rounds = aes_rounds(ctx);
+	struct blkcipher_walk walk;
+	int err;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt(desc, &walk);
+
+	while ((nbytes = walk.nbytes)) {
+		u8 *in = walk.src.virt.addr;
+		u8 *out = walk.dst.virt.addr;
+
+		do {
+			__aes_arm_decrypt(ctx->key_dec, rounds, in, out);
+			in += AES_BLOCK_SIZE;
+			out += AES_BLOCK_SIZE;
+		} while ((nbytes -= AES_BLOCK_SIZE) >= AES_BLOCK_SIZE);
+
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+
+	return err;
+}
+
+static int cbc_aes_encrypt(struct blkcipher_desc *desc,
+			   struct scatterlist *dst, struct scatterlist *src,
+			   unsigned int nbytes)
+{
+	struct crypto_aes_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	int rounds = aes_rounds(ctx);
+	struct blkcipher_walk walk;
+	int err;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt(desc, &walk);
+
+	while ((nbytes = walk.nbytes)) {
+		u8 *in = walk.src.virt.addr;
+		u8 *out = walk.dst.virt.addr;
+
+		do {
+			crypto_xor(walk.iv, in, AES_BLOCK_SIZE);
+			__aes_arm_encrypt(ctx->key_enc, rounds, walk.iv, out);
+			memcpy(walk.iv, out, AES_BLOCK_SIZE);
+			in += AES_BLOCK_SIZE;
+			out += AES_BLOCK_SIZE;
+		} while ((nbytes -= AES_BLOCK_SIZE) >= AES_BLOCK_SIZE);
+
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+
+	return err;
+}
+
+/*
+ * Decrypting in place has to go backwards, as each plaintext block
+ * overwrites the ciphertext that the next block is chained to.
+ */
+static unsigned int cbc_aes_decrypt_inplace(struct crypto_aes_ctx *ctx,
+					    struct blkcipher_walk *walk)
+{
+	unsigned int nbytes = walk->nbytes;
+	int rounds = aes_rounds(ctx);
+	u8 *p = walk->src.virt.addr;
+	u32 last[AES_BLOCK_SIZE / sizeof(u32)];
+	u32 tmp[AES_BLOCK_SIZE / sizeof(u32)];
+
+	p += nbytes - (nbytes % AES_BLOCK_SIZE) - AES_BLOCK_SIZE;
+	memcpy(last, p, AES_BLOCK_SIZE);
+
+	for (;;) {
+		__aes_arm_decrypt(ctx->key_dec, rounds, p, (u8 *)tmp);
+		if ((nbytes -= AES_BLOCK_SIZE) < AES_BLOCK_SIZE)
+			break;
+		crypto_xor((u8 *)tmp, p - AES_BLOCK_SIZE, AES_BLOCK_SIZE);
+		memcpy(p, tmp, AES_BLOCK_SIZE);
+		p -= AES_BLOCK_SIZE;
+	}
+
+	crypto_xor((u8 *)tmp, walk->iv, AES_BLOCK_SIZE);
+	memcpy(p, tmp, AES_BLOCK_SIZE);
+	memcpy(walk->iv, last, AES_BLOCK_SIZE);
+
+	return nbytes;
+}
+
+static unsigned int cbc_aes_decrypt_segment(struct crypto_aes_ctx *ctx,
+					    struct blkcipher_walk *walk)
+{
+	unsigned int nbytes = walk->nbytes;
+	int rounds = aes_rounds(ctx);
+	u8 *in = walk->src.virt.addr;
+	u8 *out = walk->dst.virt.addr;
+	u8 *iv = walk->iv;
+
+	do {
+		__aes_arm_decrypt(ctx->key_dec, rounds, in, out);
+		crypto_xor(out, iv, AES_BLOCK_SIZE);
+		iv = in;
+		in += AES_BLOCK_SIZE;
+		out += AES_BLOCK_SIZE;
+	} while ((nbytes -= AES_BLOCK_SIZE) >= AES_BLOCK_SIZE);
+
+	memcpy(walk->iv, iv, AES_BLOCK_SIZE);
+
+	return nbytes;
+}
+
+static int cbc_aes_decrypt(struct blkcipher_desc *desc,
+			   struct scatterlist *dst, struct scatterlist *src,
+			   unsigned int nbytes)
+{
+	struct crypto_aes_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	struct blkcipher_walk walk;
+	int err;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt(desc, &walk);
+
+	while (walk.nbytes) {
+		if (walk.src.virt.addr == walk.dst.virt.addr)
+			nbytes = cbc_aes_decrypt_inplace(ctx, &walk);
+		else
+			nbytes = cbc_aes_decrypt_segment(ctx, &walk);
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+
+	return err;
+}
+
+static int ctr_aes_crypt(struct blkcipher_desc *desc,
+			 struct scatterlist *dst, struct scatterlist *src,
+			 unsigned int nbytes)
+{
+	struct crypto_aes_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	int rounds = aes_rounds(ctx);
+	u32 ks[AES_BLOCK_SIZE / sizeof(u32)];
+	struct blkcipher_walk walk;
+	int err;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt_block(desc, &walk, AES_BLOCK_SIZE);
+
+	while ((nbytes = walk.nbytes) >= AES_BLOCK_SIZE) {
+		u8 *in = walk.src.virt.addr;
+		u8 *out = walk.dst.virt.addr;
+
+		do {
+			__aes_arm_encrypt(ctx->key_enc, rounds, walk.iv,
+					  (u8 *)ks);
+			crypto_xor((u8 *)ks, in, AES_BLOCK_SIZE);
+			memcpy(out, ks, AES_BLOCK_SIZE);
+			crypto_inc(walk.iv, AES_BLOCK_SIZE);
+			in += AES_BLOCK_SIZE;
+			out += AES_BLOCK_SIZE;
+		} while ((nbytes -= AES_BLOCK_SIZE) >= AES_BLOCK_SIZE);
+
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+
+	/* the final partial block, if any, is always contiguous */
+	if (walk.nbytes) {
+		u8 *in = walk.src.virt.addr;
+		u8 *out = walk.dst.virt.addr;
+
+		__aes_arm_encrypt(ctx->key_enc, rounds, walk.iv, (u8 *)ks);
+		crypto_xor((u8 *)ks, in, nbytes);
+		memcpy(out, ks, nbytes);
+		crypto_inc(walk.iv, AES_BLOCK_SIZE);
+		err = blkcipher_walk_done(desc, &walk, 0);
+	}
+
+	return err;
+}
+
+static struct crypto_alg aes_alg = {
+	.cra_name		= "aes",
+	.cra_driver_name	= "aes-asm",
+	.cra_priority		= 200,
+	.cra_flags		= CRYPTO_ALG_TYPE_CIPHER,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct crypto_aes_ctx),
+	.cra_alignmask		= 3,
+	.cra_module		= THIS_MODULE,
+	.cra_list		= LIST_HEAD_INIT(aes_alg.cra_list),
+	.cra_u	= {
+		.cipher	= {
+			.cia_min_keysize	= AES_MIN_KEY_SIZE,
+			.cia_max_keysize	= AES_MAX_KEY_SIZE,
+			.cia_setkey		= aes_setkey,
+			.cia_encrypt		= aes_encrypt,
+			.cia_decrypt		= aes_decrypt
+		}
+	}
+};
+
+static struct crypto_alg ecb_aes_alg = {
+	.cra_name		= "ecb(aes)",
+	.cra_driver_name	= "ecb-aes-asm",
+	.cra_priority		= 300,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct crypto_aes_ctx),
+	.cra_alignmask		= 3,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_list		= LIST_HEAD_INIT(ecb_aes_alg.cra_list),
+	.cra_u			= {
+		.blkcipher = {
+			.min_keysize		= AES_MIN_KEY_SIZE,
+			.max_keysize		= AES_MAX_KEY_SIZE,
+			.setkey			= aes_setkey,
+			.encrypt		= ecb_aes_encrypt,
+			.decrypt		= ecb_aes_decrypt,
+		}
+	}
+};
+
+static struct crypto_alg cbc_aes_alg = {
+	.cra_name		= "cbc(aes)",
+	.cra_driver_name	= "cbc-aes-asm",
+	.cra_priority		= 300,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct crypto_aes_ctx),
+	.cra_alignmask		= 3,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_list		= LIST_HEAD_INIT(cbc_aes_alg.cra_list),
+	.cra_u			= {
+		.blkcipher = {
+			.min_keysize		= AES_MIN_KEY_SIZE,
+			.max_keysize		= AES_MAX_KEY_SIZE,
+			.ivsize			= AES_BLOCK_SIZE,
+			.setkey			= aes_setkey,
+			.encrypt		= cbc_aes_encrypt,
+			.decrypt		= cbc_aes_decrypt,
+		}
+	}
+};
+
+static struct crypto_alg ctr_aes_alg = {
+	.cra_name		= "ctr(aes)",
+	.cra_driver_name	= "ctr-aes-asm",
+	.cra_priority		= 300,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= 1,
+	.cra_ctxsize		= sizeof(struct crypto_aes_ctx),
+	.cra_alignmask		= 3,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_list		= LIST_HEAD_INIT(ctr_aes_alg.cra_list),
+	.cra_u			= {
+		.blkcipher = {
+			.min_keysize		= AES_MIN_KEY_SIZE,
+			.max_keysize		= AES_MAX_KEY_SIZE,
+			.ivsize			= AES_BLOCK_SIZE,
+			.setkey			= aes_setkey,
+			.encrypt		= ctr_aes_crypt,
+			.decrypt		= ctr_aes_crypt,
+		}
+	}
+};
+
+static int __init aes_arm_init(void)
+{
+	int ret;
+
+	ret = crypto_register_alg(&aes_alg);
+	if (ret)
+		goto aes_err;
+
+	ret = crypto_register_alg(&ecb_aes_alg);
+	if (ret)
+		goto ecb_aes_err;
+
+	ret = crypto_register_alg(&cbc_aes_alg);
+	if (ret)
+		goto cbc_aes_err;
+
+	ret = crypto_register_alg(&ctr_aes_alg);
+	if (ret)
+		goto ctr_aes_err;
+
+out:
+	return ret;
+
+ctr_aes_err:
+	crypto_unregister_alg(&cbc_aes_alg);
+cbc_aes_err:
+	crypto_unregister_alg(&ecb_aes_alg);
+ecb_aes_err:
+	crypto_unregister_alg(&aes_alg);
+aes_err:
+	printk(KERN_ERR "aes-arm: failed to register algorithms\n");
+	goto out;
+}
+
+static void __exit aes_arm_fini(void)
+{
+	crypto_unregister_alg(&ctr_aes_alg);
+	crypto_unregister_alg(&cbc_aes_alg);
+	crypto_unregister_alg(&ecb_aes_alg);
+	crypto_unregister_alg(&aes_alg);
+}
+
+module_init(aes_arm_init);
+module_exit(aes_arm_fini);
+
+MODULE_DESCRIPTION("Rijndael (AES) Cipher Algorithm, ARM asm optimized");
+MODULE_LICENSE("GPL");
+MODULE_ALIAS("aes");
+MODULE_ALIAS("aes-asm");
+MODULE_ALIAS("ecb(aes)");
+MODULE_ALIAS("cbc(aes)");
+MODULE_ALIAS("ctr(aes)");
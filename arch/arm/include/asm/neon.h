@@ -0,0 +1,80 @@
+/*
+ * arch/arm/include/asm/neon.h
+ *
+ * Kernel-mode use of the NEON (Advanced SIMD) unit.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#ifndef __ASM_ARM_NEON_H
+#define __ASM_ARM_NEON_H
+
+/*
+ * memcpy() hands copies of at least this many bytes to memcpy_neon();
+ * below it saving and lazily restoring the NEON state costs more than
+ * the faster copy gains.
+ */
+#define NEON_MEMCPY_MIN		2048
+
+#ifndef __ASSEMBLY__
+#include <linux/hardirq.h>
+#include <linux/percpu.h>
+#include <asm/hwcap.h>
+
+#define cpu_has_neon()		(!!(elf_hwcap & HWCAP_NEON))
+
+#ifdef CONFIG_KERNEL_MODE_NEON
+/*
+ * NEON instructions in the kernel must be bracketed by
+ * kernel_neon_begin()/kernel_neon_end(). The section runs with
+ * preemption disabled and must not sleep. Interrupt and softirq
+ * context may not use NEON: kernel_neon_allowed() tells whether the
+ * caller can, otherwise it has to fall back to integer code.
+ */
+extern void kernel_neon_begin(void);
+extern void kernel_neon_end(void);
+
+/* set once NEON is detected, cleared while the VFP is suspended */
+extern int kernel_neon_available;
+
+/* non-zero while this CPU is inside a kernel_neon_begin() section */
+DECLARE_PER_CPU(int, kernel_neon_busy);
+
+static inline int kernel_neon_allowed(void)
+{
+	/*
+	 * A preemptible caller can only see its own section's flag, as
+	 * sections run with preemption disabled.
+	 */
+	return kernel_neon_available && !in_interrupt() &&
+		!__raw_get_cpu_var(kernel_neon_busy);
+}
+
+/* arch/arm/lib/xor-neon.S, used by the xor_block templates in asm/xor.h */
+extern void __xor_neon_2(unsigned long, unsigned long *, unsigned long *);
+extern void __xor_neon_3(unsigned long, unsigned long *, unsigned long *,
+			 unsigned long *);
+extern void __xor_neon_4(unsigned long, unsigned long *, unsigned long *,
+			 unsigned long *, unsigned long *);
+extern void __xor_neon_5(unsigned long, unsigned long *, unsigned long *,
+			 unsigned long *, unsigned long *, unsigned long *);
+#else
+static inline int kernel_neon_allowed(void)
+{
+	return 0;
+}
+#endif
+
+#ifdef CONFIG_NEON_MEMCPY
+extern void *memcpy_neon(void *dst, const void *src, size_t n);
+extern void *__memcpy_arm(void *dst, const void *src, size_t n);
+extern void __copy_page_arm(void *to, const void *from);
+#endif
+
+#ifdef CONFIG_CRC32_NEON
+extern void crc32_le_fold_neon(u32 acc[4], const u8 *p, size_t nblocks);
+#endif
+#endif /* __ASSEMBLY__ */
+
+#endif /* __ASM_ARM_NEON_H */
@@ -133,7 +133,11 @@ extern void __cpu_copy_user_page(void *to, const void *from,
 #define clear_user_page(addr,vaddr,pg)	 __cpu_clear_user_page(addr, vaddr)
 #define copy_user_page(to,from,vaddr,pg) __cpu_copy_user_page(to, from, vaddr)
 
+#ifdef CONFIG_NEON_MEMCPY
+extern void clear_page(void *page);
+#else
 #define clear_page(page)	memzero((void *)(page), PAGE_SIZE)
+#endif
 extern void copy_page(void *to, const void *from);
 
 #undef STRICT_MM_TYPECHECKS
@@ -132,6 +132,90 @@ static struct xor_block_template xor_block_arm4regs = {
 	.do_5	= xor_arm4regs_5,
 };
 
+#ifdef CONFIG_KERNEL_MODE_NEON
+#include <asm/neon.h>
+
+/*
+ * The NEON loops work on 64 bytes at a time; anything else, and callers
+ * that may not use NEON (see kernel_neon_allowed()), get arm4regs.
+ */
+#define XOR_NEON_OK(bytes)	(!((bytes) & 63) && kernel_neon_allowed())
+
+static void
+xor_neon_2(unsigned long bytes, unsigned long *p1, unsigned long *p2)
+{
+	if (!XOR_NEON_OK(bytes)) {
+		xor_arm4regs_2(bytes, p1, p2);
+		return;
+	}
+
+	kernel_neon_begin();
+	__xor_neon_2(bytes, p1, p2);
+	kernel_neon_end();
+}
+
+static void
+xor_neon_3(unsigned long bytes, unsigned long *p1, unsigned long *p2,
+		unsigned long *p3)
+{
+	if (!XOR_NEON_OK(bytes)) {
+		xor_arm4regs_3(bytes, p1, p2, p3);
+		return;
+	}
+
+	kernel_neon_begin();
+	__xor_neon_3(bytes, p1, p2, p3);
+	kernel_neon_end();
+}
+
+static void
+xor_neon_4(unsigned long bytes, unsigned long *p1, unsigned long *p2,
+		unsigned long *p3, unsigned long *p4)
+{
+	if (!XOR_NEON_OK(bytes)) {
+		xor_arm4regs_4(bytes, p1, p2, p3, p4);
+		return;
+	}
+
+	kernel_neon_begin();
+	__xor_neon_4(bytes, p1, p2, p3, p4);
+	kernel_neon_end();
+}
+
+static void
+xor_neon_5(unsigned long bytes, unsigned long *p1, unsigned long *p2,
+		unsigned long *p3, unsigned long *p4, unsigned long *p5)
+{
+	if (!XOR_NEON_OK(bytes)) {
+		xor_arm4regs_5(bytes, p1, p2, p3, p4, p5);
+		return;
+	}
+
+	kernel_neon_begin();
+	__xor_neon_5(bytes, p1, p2, p3, p4, p5);
+	kernel_neon_end();
+}
+
+static struct xor_block_template xor_block_neon = {
+	.name	= "neon",
+	.do_2	= xor_neon_2,
+	.do_3	= xor_neon_3,
+	.do_4	= xor_neon_4,
+	.do_5	= xor_neon_5,
+};
+
+/*
+ * NEON is only usable once vfp_init() has run, which is a late
+ * initcall, while a built-in xor.o calibrates at core_initcall time.
+ * crypto/xor.c times these again from a late initcall.
+ */
+#define XOR_TRY_LATE_TEMPLATES				\
+	do {						\
+		if (kernel_neon_available)		\
+			xor_speed(&xor_block_neon);	\
+	} while (0)
+#endif
+
 #undef XOR_TRY_TEMPLATES
 #define XOR_TRY_TEMPLATES			\
 	do {					\
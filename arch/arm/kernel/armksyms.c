@@ -19,6 +19,7 @@
 #include <asm/system.h>
 #include <asm/uaccess.h>
 #include <asm/ftrace.h>
+#include <asm/neon.h>
 
 /*
  * libgcc functions - functions that are used internally by the
@@ -132,6 +133,18 @@ EXPORT_SYMBOL(__put_user_8);
 	/* crypto hash */
 EXPORT_SYMBOL(sha_transform);
 
+#ifdef CONFIG_CRC32_NEON
+EXPORT_SYMBOL(crc32_le_fold_neon);
+#endif
+
+#ifdef CONFIG_KERNEL_MODE_NEON
+	/* raid5 checksumming */
+EXPORT_SYMBOL(__xor_neon_2);
+EXPORT_SYMBOL(__xor_neon_3);
+EXPORT_SYMBOL(__xor_neon_4);
+EXPORT_SYMBOL(__xor_neon_5);
+#endif
+
 	/* gcc lib functions */
 EXPORT_SYMBOL(__ashldi3);
 EXPORT_SYMBOL(__ashrdi3);
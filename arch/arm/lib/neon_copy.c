@@ -0,0 +1,69 @@
+/*
+ *  linux/arch/arm/lib/neon_copy.c
+ *
+ *  NEON memcpy, copy_page and clear_page selection.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * memcpy() branches here for copies of NEON_MEMCPY_MIN bytes or more.
+ * Every entry point falls back to the integer routine whenever
+ * kernel_neon_allowed() says the caller may not use NEON: before the
+ * unit is detected at boot, while it is suspended, in interrupt context
+ * or nested in another NEON section.
+ */
+#include <linux/module.h>
+#include <linux/string.h>
+
+#include <asm/page.h>
+#include <asm/neon.h>
+
+extern void __memcpy_neon(void *dst, const void *src, size_t n);
+extern void __copy_page_neon(void *to, const void *from);
+extern void __clear_page_neon(void *page);
+
+void *memcpy_neon(void *dst, const void *src, size_t n)
+{
+	size_t bulk = n & ~63;
+
+	if (!bulk || !kernel_neon_allowed())
+		return __memcpy_arm(dst, src, n);
+
+	kernel_neon_begin();
+	__memcpy_neon(dst, src, bulk);
+	kernel_neon_end();
+
+	if (n != bulk)
+		__memcpy_arm(dst + bulk, src + bulk, n - bulk);
+
+	return dst;
+}
+EXPORT_SYMBOL(memcpy_neon);
+EXPORT_SYMBOL(__memcpy_arm);
+
+void copy_page(void *to, const void *from)
+{
+	if (!kernel_neon_allowed()) {
+		__copy_page_arm(to, from);
+		return;
+	}
+
+	kernel_neon_begin();
+	__copy_page_neon(to, from);
+	kernel_neon_end();
+}
+EXPORT_SYMBOL(__copy_page_arm);
+
+void clear_page(void *page)
+{
+	if (!kernel_neon_allowed()) {
+		__memzero(page, PAGE_SIZE);
+		return;
+	}
+
+	kernel_neon_begin();
+	__clear_page_neon(page);
+	kernel_neon_end();
+}
+EXPORT_SYMBOL(clear_page);
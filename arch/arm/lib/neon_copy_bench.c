@@ -0,0 +1,146 @@
+/*
+ *  linux/arch/arm/lib/neon_copy_bench.c
+ *
+ *  Throughput of the integer and NEON copy routines.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Loading the module prints one line per size and alignment with the
+ * MB/s of __memcpy_arm() and memcpy_neon(), followed by the page copy
+ * and clear routines. memcpy_neon() is called directly, so sizes below
+ * NEON_MEMCPY_MIN show what the threshold in memcpy() avoids.
+ */
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/gfp.h>
+#include <linux/hrtimer.h>
+#include <linux/math64.h>
+#include <linux/string.h>
+
+#include <asm/page.h>
+#include <asm/neon.h>
+
+#define BENCH_BYTES	(8 << 20)	/* copied per measurement */
+#define BENCH_ORDER	5		/* 128KiB buffers */
+
+static const size_t bench_sizes[] = {
+	64, 256, 1024, 2048, 4096, 16384, 65536,
+};
+
+/* source and destination offsets from a cache line boundary */
+static const struct {
+	unsigned int src, dst;
+} bench_align[] = {
+	{ 0, 0 }, { 0, 4 }, { 1, 0 }, { 3, 7 },
+};
+
+static unsigned int bench_mbps(u64 bytes, ktime_t start)
+{
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	if (!ns)
+		return 0;
+	/* bytes per ns * 1000 = MB/s */
+	return div64_u64(bytes * 1000, ns);
+}
+
+static unsigned int bench_memcpy(void *(*fn)(void *, const void *, size_t),
+				 void *dst, const void *src, size_t size)
+{
+	unsigned int i, loops = BENCH_BYTES / size;
+	ktime_t start = ktime_get();
+
+	for (i = 0; i < loops; i++)
+		fn(dst, src, size);
+
+	return bench_mbps((u64)loops * size, start);
+}
+
+static unsigned int bench_copy_page(void (*fn)(void *, const void *),
+				    void *dst, const void *src)
+{
+	unsigned int i, loops = BENCH_BYTES / PAGE_SIZE;
+	ktime_t start = ktime_get();
+
+	for (i = 0; i < loops; i++)
+		fn(dst + (i & 7) * PAGE_SIZE, src + (i & 7) * PAGE_SIZE);
+
+	return bench_mbps((u64)loops * PAGE_SIZE, start);
+}
+
+static void bench_memzero_page(void *page)
+{
+	__memzero(page, PAGE_SIZE);
+}
+
+static unsigned int bench_clear_page(void (*fn)(void *), void *dst)
+{
+	unsigned int i, loops = BENCH_BYTES / PAGE_SIZE;
+	ktime_t start = ktime_get();
+
+	for (i = 0; i < loops; i++)
+		fn(dst + (i & 7) * PAGE_SIZE);
+
+	return bench_mbps((u64)loops * PAGE_SIZE, start);
+}
+
+static int __init neon_copy_bench_init(void)
+{
+	unsigned long src, dst;
+	unsigned int i, j, arm, neon;
+
+	src = __get_free_pages(GFP_KERNEL, BENCH_ORDER);
+	dst = __get_free_pages(GFP_KERNEL, BENCH_ORDER);
+	if (!src || !dst) {
+		free_pages(src, BENCH_ORDER);
+		free_pages(dst, BENCH_ORDER);
+		return -ENOMEM;
+	}
+	memset((void *)src, 0x5a, PAGE_SIZE << BENCH_ORDER);
+	memset((void *)dst, 0, PAGE_SIZE << BENCH_ORDER);
+
+	if (!kernel_neon_allowed())
+		printk(KERN_INFO "neon_copy_bench: NEON not available, "
+		       "both columns use the integer copy\n");
+
+	printk(KERN_INFO "neon_copy_bench: size src dst   arm MB/s  neon MB/s\n");
+	for (i = 0; i < ARRAY_SIZE(bench_sizes); i++) {
+		for (j = 0; j < ARRAY_SIZE(bench_align); j++) {
+			void *s = (void *)src + bench_align[j].src;
+			void *d = (void *)dst + bench_align[j].dst;
+
+			arm = bench_memcpy(__memcpy_arm, d, s, bench_sizes[i]);
+			neon = bench_memcpy(memcpy_neon, d, s, bench_sizes[i]);
+			printk(KERN_INFO "neon_copy_bench: %6zu %3u %3u %9u %10u\n",
+			       bench_sizes[i], bench_align[j].src,
+			       bench_align[j].dst, arm, neon);
+		}
+	}
+
+	arm = bench_copy_page(__copy_page_arm, (void *)dst, (void *)src);
+	neon = bench_copy_page(copy_page, (void *)dst, (void *)src);
+	printk(KERN_INFO "neon_copy_bench: copy_page  %9u %10u\n", arm, neon);
+
+	arm = bench_clear_page(bench_memzero_page, (void *)dst);
+	neon = bench_clear_page(clear_page, (void *)dst);
+	printk(KERN_INFO "neon_copy_bench: clear_page %9u %10u\n", arm, neon);
+
+	free_pages(src, BENCH_ORDER);
+	free_pages(dst, BENCH_ORDER);
+
+	/* nothing to keep in memory, like tcrypt */
+	return -EAGAIN;
+}
+
+static void __exit neon_copy_bench_exit(void)
+{
+}
+
+module_init(neon_copy_bench_init);
+module_exit(neon_copy_bench_exit);
+
+MODULE_DESCRIPTION("NEON memcpy/copy_page/clear_page benchmark");
+MODULE_LICENSE("GPL");
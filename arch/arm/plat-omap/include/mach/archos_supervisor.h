@@ -3,6 +3,7 @@
 
 #include <linux/device.h>
 #include <linux/poll.h>
+#include <linux/ioctl.h>
 
 // must be in the same order of module_resistors!!
 // see common/Include/sys_atmega.h
@@ -38,6 +39,31 @@ struct archos_sv_event {
 	int size;
 };
 
+/* ioctls on the supervisor character device, masks of (1 << event id) */
+#define ARCHOS_SV_IOC_MAGIC		0xB3
+#define ARCHOS_SV_SET_EVENT_MASK	_IOW(ARCHOS_SV_IOC_MAGIC, 40, __u32)
+#define ARCHOS_SV_GET_EVENT_MASK	_IOR(ARCHOS_SV_IOC_MAGIC, 41, __u32)
+#define ARCHOS_SV_GET_STATS		_IOR(ARCHOS_SV_IOC_MAGIC, 42, \
+					     struct archos_sv_reader_stats)
+
+#define ARCHOS_SV_EVENT_DATA_SIZE	8
+
+/* record returned by read(), several per call when available */
+struct archos_sv_user_event {
+	__u32 id;
+	__u32 size;
+	__u8 data[ARCHOS_SV_EVENT_DATA_SIZE];
+};
+
+struct archos_sv_reader_stats {
+	__u32 queued;		/* events stored in the reader's ring */
+	__u32 coalesced;	/* identical updates dropped */
+	__u32 filtered;		/* events outside the event mask */
+	__u32 overruns;		/* events lost because the ring was full */
+	__u32 wakeups;		/* times the reader was woken */
+	__u32 reads;		/* read() calls that returned events */
+};
+
 struct archos_sv;
 
 struct archos_sv_ops {
@@ -0,0 +1,194 @@
+/*
+ *  linux/arch/arm/vfp/neon_test.c
+ *
+ *  Self test for kernel-mode NEON.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * The test makes a dummy vfp_state own the NEON registers, exactly as a
+ * user task does after it trapped in and had its state loaded, then uses
+ * NEON from the kernel and checks that:
+ *  - the owner's registers and FPSCR were saved into its vfp_state,
+ *  - the owner lost the hardware, so it will reload lazily,
+ *  - the unit is disabled again after kernel_neon_end(),
+ *  - the NEON computation done in between gives the right result,
+ *  - kernel_neon_allowed() is false in softirq context.
+ */
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/sched.h>
+#include <linux/interrupt.h>
+#include <linux/completion.h>
+
+#include <asm/vfp.h>
+#include <asm/neon.h>
+
+#include "vfpinstr.h"
+#include "vfp.h"
+
+static union vfp_state neon_test_owner;
+static u64 neon_test_regs[32];
+
+static void neon_test_load(const u64 *regs)
+{
+	asm volatile(
+	"	.fpu	neon\n"
+	"	vldmia	%0!, {d0-d15}\n"
+	"	vldmia	%0, {d16-d31}\n"
+	: "+r" (regs) : : "memory");
+}
+
+/* clobbers every register, then c = a + b on 4 lanes of 32 bits */
+static void neon_test_add(const u32 *a, const u32 *b, u32 *c)
+{
+	asm volatile(
+	"	.fpu	neon\n"
+	"	vmov.i32	q0, #0\n"
+	"	vmov.i32	q1, #0\n"
+	"	vmov.i32	q2, #0\n"
+	"	vmov.i32	q3, #0\n"
+	"	vmov.i32	q4, #0\n"
+	"	vmov.i32	q5, #0\n"
+	"	vmov.i32	q6, #0\n"
+	"	vmov.i32	q7, #0\n"
+	"	vmov.i32	q8, #0\n"
+	"	vmov.i32	q9, #0\n"
+	"	vmov.i32	q10, #0\n"
+	"	vmov.i32	q11, #0\n"
+	"	vmov.i32	q12, #0\n"
+	"	vmov.i32	q13, #0\n"
+	"	vmov.i32	q14, #0\n"
+	"	vmov.i32	q15, #0\n"
+	"	vld1.32	{d0-d1}, [%0]\n"
+	"	vld1.32	{d2-d3}, [%1]\n"
+	"	vadd.i32	q15, q0, q1\n"
+	"	vst1.32	{d30-d31}, [%2]\n"
+	: : "r" (a), "r" (b), "r" (c) : "memory");
+}
+
+static int neon_test_owner_state(void)
+{
+	static const u32 a[4] = { 1, 0x7fffffff, 0xffffffff, 12345678 };
+	static const u32 b[4] = { 2, 1, 1, 87654321 };
+	u32 c[4];
+	unsigned int cpu, i;
+	int errors = 0;
+
+	for (i = 0; i < ARRAY_SIZE(neon_test_regs); i++)
+		neon_test_regs[i] = 0x0123456789abcdefULL * (i + 1);
+
+	preempt_disable();
+	cpu = smp_processor_id();
+
+	/* make the dummy state the live owner of the registers */
+	kernel_neon_begin();
+	neon_test_load(neon_test_regs);
+	fmxr(FPSCR, FPSCR_ROUND_NEAREST | FPSCR_N);
+	memset(&neon_test_owner, 0, sizeof(neon_test_owner));
+	last_VFP_context[cpu] = &neon_test_owner;
+	kernel_neon_end();
+
+	kernel_neon_begin();
+	neon_test_add(a, b, c);
+	kernel_neon_end();
+
+	if (last_VFP_context[cpu] == &neon_test_owner) {
+		printk(KERN_ERR "NEON test: owner still holds the registers\n");
+		last_VFP_context[cpu] = NULL;
+		errors++;
+	}
+	if (fmrx(FPEXC) & FPEXC_EN) {
+		printk(KERN_ERR "NEON test: unit left enabled\n");
+		errors++;
+	}
+	preempt_enable();
+
+	for (i = 0; i < ARRAY_SIZE(neon_test_regs); i++) {
+		if (neon_test_owner.hard.fpregs[i] != neon_test_regs[i]) {
+			printk(KERN_ERR "NEON test: d%u not preserved: "
+			       "%016llx != %016llx\n", i,
+			       neon_test_owner.hard.fpregs[i],
+			       neon_test_regs[i]);
+			errors++;
+		}
+	}
+	if (neon_test_owner.hard.fpscr != (FPSCR_ROUND_NEAREST | FPSCR_N)) {
+		printk(KERN_ERR "NEON test: FPSCR not preserved: %08x\n",
+		       neon_test_owner.hard.fpscr);
+		errors++;
+	}
+	if (!(neon_test_owner.hard.fpexc & FPEXC_EN)) {
+		printk(KERN_ERR "NEON test: saved FPEXC not enabled\n");
+		errors++;
+	}
+
+	for (i = 0; i < 4; i++) {
+		if (c[i] != a[i] + b[i]) {
+			printk(KERN_ERR "NEON test: lane %u: %08x != %08x\n",
+			       i, c[i], a[i] + b[i]);
+			errors++;
+		}
+	}
+
+	return errors;
+}
+
+static int neon_test_softirq_allowed;
+static DECLARE_COMPLETION(neon_test_done);
+
+static void neon_test_tasklet_func(unsigned long data)
+{
+	neon_test_softirq_allowed = kernel_neon_allowed();
+	complete(&neon_test_done);
+}
+
+static DECLARE_TASKLET(neon_test_tasklet, neon_test_tasklet_func, 0);
+
+static int neon_test_softirq(void)
+{
+	tasklet_schedule(&neon_test_tasklet);
+	wait_for_completion(&neon_test_done);
+
+	if (neon_test_softirq_allowed) {
+		printk(KERN_ERR "NEON test: allowed in softirq context\n");
+		return 1;
+	}
+	return 0;
+}
+
+static int __init neon_test_init(void)
+{
+	int errors;
+
+	if (!cpu_has_neon()) {
+		printk(KERN_INFO "NEON test: no NEON unit, skipped\n");
+		return 0;
+	}
+
+	errors = neon_test_owner_state();
+	errors += neon_test_softirq();
+
+	if (errors) {
+		printk(KERN_ERR "NEON test: %d errors\n", errors);
+		return -EINVAL;
+	}
+	printk(KERN_INFO "NEON test: passed\n");
+	return 0;
+}
+
+static void __exit neon_test_exit(void)
+{
+}
+
+/*
+ * After vfp_init(), also a late_initcall, which sets HWCAP_NEON: neon_test.o
+ * is linked after vfp.o.
+ */
+late_initcall(neon_test_init);
+module_exit(neon_test_exit);
+
+MODULE_DESCRIPTION("kernel-mode NEON self test");
+MODULE_LICENSE("GPL");
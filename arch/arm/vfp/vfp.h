@@ -379,6 +379,11 @@ struct op {
 	u32 flags;
 };
 
-#if defined(CONFIG_SMP) || defined(CONFIG_PM)
+#if defined(CONFIG_SMP) || defined(CONFIG_PM) || defined(CONFIG_KERNEL_MODE_NEON)
 extern void vfp_save_state(void *location, u32 fpexc);
 #endif
+
+/*
+ * The VFP state currently loaded in the hardware of each CPU, or NULL.
+ */
+extern union vfp_state *last_VFP_context[NR_CPUS];
@@ -17,6 +17,7 @@
 
 #include <asm/thread_notify.h>
 #include <asm/vfp.h>
+#include <asm/neon.h>
 
 #include "vfpinstr.h"
 #include "vfp.h"
@@ -30,6 +31,9 @@ void vfp_null_entry(void);
 
 void (*vfp_vector)(void) = vfp_null_entry;
 union vfp_state *last_VFP_context[NR_CPUS];
+#ifdef CONFIG_NEON_SELFTEST_MODULE
+EXPORT_SYMBOL_GPL(last_VFP_context);
+#endif
 
 /*
  * Dual-use variable.
@@ -323,6 +327,60 @@ void vfp_enable(void *unused)
 	 */
 	set_copro_access(access | CPACC_FULL(10) | CPACC_FULL(11));
 }
+#ifdef CONFIG_KERNEL_MODE_NEON
+/*
+ * Kernel-side NEON support. The registers belong to whichever task's
+ * state last_VFP_context points at (on UP this need not be current, as
+ * the state is switched lazily), so save them into that task's
+ * vfp_state and drop the ownership: the task reloads its registers
+ * through the normal lazy restore path the next time it touches the
+ * unit. Preemption stays disabled until kernel_neon_end(), which leaves
+ * the unit disabled again.
+ */
+int kernel_neon_available __read_mostly;
+EXPORT_SYMBOL(kernel_neon_available);
+
+DEFINE_PER_CPU(int, kernel_neon_busy);
+EXPORT_PER_CPU_SYMBOL(kernel_neon_busy);
+
+void kernel_neon_begin(void)
+{
+	unsigned int cpu;
+	u32 fpexc;
+
+	/*
+	 * Softirqs and interrupt handlers could be running on top of
+	 * another kernel_neon_begin() section, and sections do not nest.
+	 * Callers must check kernel_neon_allowed() and use their integer
+	 * code path instead.
+	 */
+	BUG_ON(in_interrupt());
+	cpu = get_cpu();
+	BUG_ON(per_cpu(kernel_neon_busy, cpu));
+	per_cpu(kernel_neon_busy, cpu) = 1;
+
+	fpexc = fmrx(FPEXC) | FPEXC_EN;
+	fmxr(FPEXC, fpexc);
+
+	if (last_VFP_context[cpu]) {
+		vfp_save_state(last_VFP_context[cpu], fpexc);
+#ifdef CONFIG_SMP
+		last_VFP_context[cpu]->hard.cpu = cpu;
+#endif
+		last_VFP_context[cpu] = NULL;
+	}
+}
+EXPORT_SYMBOL(kernel_neon_begin);
+
+void kernel_neon_end(void)
+{
+	fmxr(FPEXC, fmrx(FPEXC) & ~FPEXC_EN);
+	__get_cpu_var(kernel_neon_busy) = 0;
+	put_cpu();
+}
+EXPORT_SYMBOL(kernel_neon_end);
+#endif /* CONFIG_KERNEL_MODE_NEON */
+
 #ifdef CONFIG_PM
 #include <linux/sysdev.h>
 
@@ -343,6 +401,11 @@ static int vfp_pm_suspend(struct sys_device *dev, pm_message_t state)
 	/* clear any information we had about last context state */
 	memset(last_VFP_context, 0, sizeof(last_VFP_context));
 
+#ifdef CONFIG_KERNEL_MODE_NEON
+	/* coprocessor access may be lost until vfp_pm_resume() */
+	kernel_neon_available = 0;
+#endif
+
 	return 0;
 }
 
@@ -354,6 +417,10 @@ static int vfp_pm_resume(struct sys_device *dev)
 	/* and disable it to ensure the next usage restores the state */
 	fmxr(FPEXC, fmrx(FPEXC) & ~FPEXC_EN);
 
+#ifdef CONFIG_KERNEL_MODE_NEON
+	kernel_neon_available = !!(elf_hwcap & HWCAP_NEON);
+#endif
+
 	return 0;
 }
 
@@ -423,6 +490,19 @@ static int __init vfp_init(void)
 		thread_register_notifier(&vfp_notifier_block);
 		vfp_pm_init();
 
+#ifdef CONFIG_NEON
+		/*
+		 * Advanced SIMD is present if MVFR1 reports integer,
+		 * single precision and load/store support.
+		 */
+		if (VFP_arch >= 2 &&
+		    (fmrx(MVFR1) & 0x000fff00) == 0x00011100)
+			elf_hwcap |= HWCAP_NEON;
+#endif
+#ifdef CONFIG_KERNEL_MODE_NEON
+		kernel_neon_available = !!(elf_hwcap & HWCAP_NEON);
+#endif
+
 		/*
 		 * We detected VFP, and the support code is
 		 * in place; report VFP support to userspace.
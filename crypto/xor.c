@@ -129,6 +129,9 @@ calibrate_xor_blocks(void)
 	} else {
 		printk(KERN_INFO "xor: measuring software checksum speed\n");
 		XOR_TRY_TEMPLATES;
+#if defined(XOR_TRY_LATE_TEMPLATES) && defined(MODULE)
+		XOR_TRY_LATE_TEMPLATES;
+#endif
 		fastest = template_list;
 		for (f = fastest; f; f = f->next)
 			if (f->speed > fastest->speed)
@@ -146,6 +149,50 @@ calibrate_xor_blocks(void)
 	return 0;
 }
 
+#if defined(XOR_TRY_LATE_TEMPLATES) && !defined(MODULE)
+/*
+ * Templates which need a unit that the architecture only brings up
+ * from a late initcall (NEON on ARM) cannot be timed at core_initcall
+ * time. Time them now and switch to one if it is faster.
+ */
+static int __init
+calibrate_xor_blocks_late(void)
+{
+	void *b1, *b2;
+	struct xor_block_template *f, *fastest = active_template;
+
+	if (!fastest)
+		return 0;
+
+	b1 = (void *) __get_free_pages(GFP_KERNEL, 2);
+	if (!b1) {
+		printk(KERN_WARNING "xor: Yikes!  No memory available.\n");
+		return -ENOMEM;
+	}
+	b2 = b1 + 2*PAGE_SIZE + BENCH_SIZE;
+
+#define xor_speed(templ)	do_xor_speed((templ), b1, b2)
+
+	XOR_TRY_LATE_TEMPLATES;
+	for (f = template_list; f; f = f->next)
+		if (f->speed > fastest->speed)
+			fastest = f;
+
+#undef xor_speed
+
+	free_pages((unsigned long)b1, 2);
+
+	if (fastest != active_template) {
+		printk(KERN_INFO "xor: using function: %s (%d.%03d MB/sec)\n",
+		       fastest->name, fastest->speed / 1000,
+		       fastest->speed % 1000);
+		active_template = fastest;
+	}
+	return 0;
+}
+late_initcall(calibrate_xor_blocks_late);
+#endif
+
 static __exit void xor_exit(void) { }
 
 MODULE_LICENSE("GPL");
@@ -4,8 +4,13 @@
 #include <linux/list.h>
 #include <linux/poll.h>
 #include <linux/miscdevice.h>
+#include <linux/spinlock.h>
+#include <linux/uaccess.h>
 #include <mach/archos_supervisor.h>
 
+#define ARCHOS_SV_READER_RING	32	/* must be a power of 2 */
+#define ARCHOS_SV_READ_BATCH	16
+
 #define cls_dev_to_archos_sv(d)		container_of(d, struct archos_sv, class_dev)
 #define dev_to_archos_sv_client(d)	container_of(d, struct archos_sv_client, dev)
 #define to_archos_sv_driver(d)		container_of(d, struct archos_sv_client_driver, drv)
@@ -16,7 +21,25 @@ static DEFINE_SPINLOCK(archos_sv_lock);
 static struct archos_sv_global_data {
 	struct archos_sv_client *client;
 	struct archos_sv *sv;
-} sv_global;
+	struct list_head readers;
+	spinlock_t readers_lock;	/* protects readers and their rings */
+} sv_global = {
+	.readers	= LIST_HEAD_INIT(sv_global.readers),
+	.readers_lock	= __SPIN_LOCK_UNLOCKED(sv_global.readers_lock),
+};
+
+/* one per open() of the supervisor character device */
+struct archos_sv_reader {
+	struct list_head node;
+	wait_queue_head_t wait;
+	unsigned long event_mask;
+	struct archos_sv_user_event ring[ARCHOS_SV_READER_RING];
+	unsigned int head;
+	unsigned int tail;
+	struct archos_sv_user_event last[ARCHOS_SV_EVENT_KEY + 1];
+	unsigned long have_last;
+	struct archos_sv_reader_stats stats;
+};
 
 static void archos_sv_classdev_release(struct device *dev)
 {
@@ -175,40 +198,184 @@ static int archos_sv_client_signal_event(struct device *dev, void *_ev)
 	return 0;
 }
 
+/*
+ * Queue an event on one reader. Updates identical to the last one queued
+ * for this reader are dropped, so a status register that is re-read on
+ * every interrupt does not wake anybody unless it actually changed.
+ * Called with readers_lock held; returns non-zero if the reader needs
+ * to be woken.
+ */
+static int archos_sv_reader_queue(struct archos_sv_reader *reader,
+				  struct archos_sv_event *ev)
+{
+	struct archos_sv_user_event uev;
+
+	if (!(reader->event_mask & (1UL << ev->id))) {
+		reader->stats.filtered++;
+		return 0;
+	}
+
+	memset(&uev, 0, sizeof(uev));
+	uev.id = ev->id;
+	uev.size = min_t(int, ev->size, ARCHOS_SV_EVENT_DATA_SIZE);
+	if (ev->data)
+		memcpy(uev.data, ev->data, uev.size);
+
+	if (ev->id == ARCHOS_SV_EVENT_STATUS_CHANGED &&
+	    test_bit(ev->id, &reader->have_last) &&
+	    !memcmp(&reader->last[ev->id], &uev, sizeof(uev))) {
+		reader->stats.coalesced++;
+		return 0;
+	}
+	reader->last[ev->id] = uev;
+	__set_bit(ev->id, &reader->have_last);
+
+	if (reader->head - reader->tail == ARCHOS_SV_READER_RING) {
+		/* keep the newest events, the oldest is lost */
+		reader->tail++;
+		reader->stats.overruns++;
+	}
+
+	reader->ring[reader->head++ & (ARCHOS_SV_READER_RING - 1)] = uev;
+	reader->stats.queued++;
+
+	/* a sleeping reader only needs one wakeup per batch */
+	if (reader->head - reader->tail == 1) {
+		reader->stats.wakeups++;
+		return 1;
+	}
+
+	return 0;
+}
+
 int archos_sv_signal_event(struct archos_sv *sv, struct archos_sv_event *ev) 
 {
+	struct archos_sv_reader *reader;
+	unsigned long flags;
+
 printk("%s\n", __FUNCTION__);
+	if (ev->id <= ARCHOS_SV_EVENT_KEY) {
+		spin_lock_irqsave(&sv_global.readers_lock, flags);
+		list_for_each_entry(reader, &sv_global.readers, node)
+			if (archos_sv_reader_queue(reader, ev))
+				wake_up_interruptible(&reader->wait);
+		spin_unlock_irqrestore(&sv_global.readers_lock, flags);
+	}
+
 	return bus_for_each_dev(&archos_sv_bus_type, NULL, (void *)ev, archos_sv_client_signal_event);
 }
 
 static int archos_sv_open(struct inode *inode, struct file *file)
 {
+	struct archos_sv_reader *reader;
+
+	reader = kzalloc(sizeof(struct archos_sv_reader), GFP_KERNEL);
+	if (!reader)
+		return -ENOMEM;
+
+	init_waitqueue_head(&reader->wait);
+	reader->event_mask = ~0UL;
+
+	spin_lock_irq(&sv_global.readers_lock);
+	list_add_tail(&reader->node, &sv_global.readers);
+	spin_unlock_irq(&sv_global.readers_lock);
+
+	file->private_data = reader;
 
 	return 0;
 }
 
 static int archos_sv_release(struct inode *inode, struct file *file)
 {
+	struct archos_sv_reader *reader = file->private_data;
+
+	spin_lock_irq(&sv_global.readers_lock);
+	list_del(&reader->node);
+	spin_unlock_irq(&sv_global.readers_lock);
+
+	kfree(reader);
 
 	return 0;
 }
 
 static int archos_sv_ioctl( struct inode *inode, struct file *file, unsigned int cmd, unsigned long arg )
 {
-	return 0;
+	struct archos_sv_reader *reader = file->private_data;
+	struct archos_sv_reader_stats stats;
+	__u32 mask;
+
+	switch (cmd) {
+	case ARCHOS_SV_SET_EVENT_MASK:
+		if (get_user(mask, (__u32 __user *)arg))
+			return -EFAULT;
+		spin_lock_irq(&sv_global.readers_lock);
+		reader->event_mask = mask;
+		spin_unlock_irq(&sv_global.readers_lock);
+		return 0;
+
+	case ARCHOS_SV_GET_EVENT_MASK:
+		spin_lock_irq(&sv_global.readers_lock);
+		mask = reader->event_mask;
+		spin_unlock_irq(&sv_global.readers_lock);
+		return put_user(mask, (__u32 __user *)arg);
+
+	case ARCHOS_SV_GET_STATS:
+		spin_lock_irq(&sv_global.readers_lock);
+		stats = reader->stats;
+		spin_unlock_irq(&sv_global.readers_lock);
+		if (copy_to_user((void __user *)arg, &stats, sizeof(stats)))
+			return -EFAULT;
+		return 0;
+	}
+
+	return -ENOTTY;
 }
 
 static ssize_t archos_sv_read(struct file *file, char __user *buffer, size_t count, loff_t *ppos)
 {
-	int len = 0;
-	return len;
+	struct archos_sv_reader *reader = file->private_data;
+	struct archos_sv_user_event events[ARCHOS_SV_READ_BATCH];
+	int max = count / sizeof(struct archos_sv_user_event);
+	int n = 0;
+	int ret;
+
+	if (max == 0)
+		return -EINVAL;
+	if (max > ARCHOS_SV_READ_BATCH)
+		max = ARCHOS_SV_READ_BATCH;
+
+	if (reader->head == reader->tail && (file->f_flags & O_NONBLOCK))
+		return -EAGAIN;
+
+	ret = wait_event_interruptible(reader->wait,
+				       reader->head != reader->tail);
+	if (ret)
+		return ret;
+
+	/* drain as much as fits in one go, under a single lock */
+	spin_lock_irq(&sv_global.readers_lock);
+	while (n < max && reader->head != reader->tail)
+		events[n++] = reader->ring[reader->tail++ &
+					   (ARCHOS_SV_READER_RING - 1)];
+	if (n)
+		reader->stats.reads++;
+	spin_unlock_irq(&sv_global.readers_lock);
+
+	if (copy_to_user(buffer, events, n * sizeof(struct archos_sv_user_event)))
+		return -EFAULT;
+
+	return n * sizeof(struct archos_sv_user_event);
 }
 
 static unsigned int archos_sv_poll(struct file * file, poll_table * wait)
 {
+	struct archos_sv_reader *reader = file->private_data;
 	unsigned int mask = 0;
 
-	//poll_wait(file, &sv->wait_queue, wait);
+	poll_wait(file, &reader->wait, wait);
+
+	if (reader->head != reader->tail)
+		mask |= POLLIN | POLLRDNORM;
 
 	return mask;
 }
@@ -11,6 +11,7 @@
 #define EVDEV_MINOR_BASE	64
 #define EVDEV_MINORS		32
 #define EVDEV_BUFFER_SIZE	64
+#define EVDEV_READ_BATCH	16
 
 #include <linux/poll.h>
 #include <linux/slab.h>
@@ -40,6 +41,10 @@ struct evdev_client {
 	struct input_event buffer[EVDEV_BUFFER_SIZE];
 	int head;
 	int tail;
+	int packet_head; /* end of the events readers may consume */
+	int abs_slot[2]; /* buffer index of ABS_X/ABS_Y in current frame */
+	unsigned int flags; /* EVDEV_BATCH_* */
+	struct input_client_stats stats;
 	spinlock_t buffer_lock; /* protects access to buffer, head and tail */
 	struct fasync_struct *fasync;
 	struct evdev *evdev;
@@ -50,19 +55,94 @@ struct evdev_client {
 static struct evdev *evdev_table[EVDEV_MINORS];
 static DEFINE_MUTEX(evdev_table_mutex);
 
-static void evdev_pass_event(struct evdev_client *client,
-			     struct input_event *event)
+static void evdev_reset_abs_slots(struct evdev_client *client)
 {
+	client->abs_slot[0] = client->abs_slot[1] = -1;
+}
+
+/*
+ * Try to merge an ABS_X/ABS_Y event into one of the same code that
+ * is still unread and belongs to the current frame. Called with
+ * buffer_lock held.
+ */
+static int evdev_coalesce_event(struct evdev_client *client,
+				struct input_event *event)
+{
+	struct input_event *prev;
+	int slot, idx;
+
+	if (event->type != EV_ABS ||
+	    (event->code != ABS_X && event->code != ABS_Y))
+		return 0;
+
+	slot = event->code == ABS_X ? 0 : 1;
+	idx = client->abs_slot[slot];
+
+	/* the reader may have consumed it, or the buffer wrapped over it */
+	if (idx < 0 ||
+	    ((idx - client->tail) & (EVDEV_BUFFER_SIZE - 1)) >=
+	    ((client->head - client->tail) & (EVDEV_BUFFER_SIZE - 1))) {
+		client->abs_slot[slot] = client->head;
+		return 0;
+	}
+
+	prev = &client->buffer[idx];
+	if (prev->type != event->type || prev->code != event->code) {
+		client->abs_slot[slot] = client->head;
+		return 0;
+	}
+
+	prev->time = event->time;
+	prev->value = event->value;
+	client->stats.coalesced++;
+
+	return 1;
+}
+
+/*
+ * Returns non-zero if new events became visible to the client's readers.
+ */
+static int evdev_pass_event(struct evdev_client *client,
+			    struct input_event *event)
+{
+	int wakeup = 0;
+
 	/*
 	 * Interrupts are disabled, just acquire the lock
 	 */
 	spin_lock(&client->buffer_lock);
 	wake_lock_timeout(&client->wake_lock, 5 * HZ);
-	client->buffer[client->head++] = *event;
-	client->head &= EVDEV_BUFFER_SIZE - 1;
+
+	if (!(client->flags & EVDEV_BATCH_COALESCE_ABS) ||
+	    !evdev_coalesce_event(client, event)) {
+		client->buffer[client->head++] = *event;
+		client->head &= EVDEV_BUFFER_SIZE - 1;
+		client->stats.queued++;
+	}
+
+	if (event->type == EV_SYN && event->code == SYN_REPORT)
+		evdev_reset_abs_slots(client);
+
+	/*
+	 * In batched mode events are published a whole frame at a time;
+	 * a nearly full buffer is published early so readers can drain it.
+	 */
+	if (!(client->flags & EVDEV_BATCH_SYN_REPORT) ||
+	    (event->type == EV_SYN && event->code == SYN_REPORT) ||
+	    ((client->head - client->tail) & (EVDEV_BUFFER_SIZE - 1)) >=
+	    EVDEV_BUFFER_SIZE / 2) {
+		if (client->packet_head != client->head) {
+			client->packet_head = client->head;
+			client->stats.wakeups++;
+			wakeup = 1;
+		}
+	}
 	spin_unlock(&client->buffer_lock);
 
-	kill_fasync(&client->fasync, SIGIO, POLL_IN);
+	if (wakeup)
+		kill_fasync(&client->fasync, SIGIO, POLL_IN);
+
+	return wakeup;
 }
 
 /*
@@ -75,6 +155,7 @@ static void evdev_event(struct input_handle *handle,
 	struct evdev_client *client;
 	struct input_event event;
 	struct timespec ts;
+	int wakeup = 0;
 
 	ktime_get_ts(&ts);
 	event.time.tv_sec = ts.tv_sec;
@@ -87,14 +168,15 @@ static void evdev_event(struct input_handle *handle,
 
 	client = rcu_dereference(evdev->grab);
 	if (client)
-		evdev_pass_event(client, &event);
+		wakeup = evdev_pass_event(client, &event);
 	else
 		list_for_each_entry_rcu(client, &evdev->client_list, node)
-			evdev_pass_event(client, &event);
+			wakeup |= evdev_pass_event(client, &event);
 
 	rcu_read_unlock();
 
-	wake_up_interruptible(&evdev->wait);
+	if (wakeup)
+		wake_up_interruptible(&evdev->wait);
 }
 
 static int evdev_fasync(int fd, struct file *file, int on)
@@ -280,6 +362,7 @@ static int evdev_open(struct inode *inode, struct file *file)
 	}
 
 	spin_lock_init(&client->buffer_lock);
+	evdev_reset_abs_slots(client);
 	wake_lock_init(&client->wake_lock, WAKE_LOCK_SUSPEND, "evdev");
 	client->evdev = evdev;
 	evdev_attach_client(evdev, client);
@@ -514,24 +597,28 @@ static ssize_t evdev_write(struct file *file, const char __user *buffer,
 	return retval;
 }
 
-static int evdev_fetch_next_event(struct evdev_client *client,
-				  struct input_event *event)
+/*
+ * Move up to 'max' published events out of the client buffer with a
+ * single acquisition of buffer_lock.
+ */
+static int evdev_fetch_events(struct evdev_client *client,
+			      struct input_event *events, int max)
 {
-	int have_event;
+	int n = 0;
 
 	spin_lock_irq(&client->buffer_lock);
 
-	have_event = client->head != client->tail;
-	if (have_event) {
-		*event = client->buffer[client->tail++];
+	while (n < max && client->packet_head != client->tail) {
+		events[n++] = client->buffer[client->tail++];
 		client->tail &= EVDEV_BUFFER_SIZE - 1;
-		if (client->head == client->tail)
-			wake_unlock(&client->wake_lock);
 	}
+	client->stats.copied += n;
+	if (client->head == client->tail)
+		wake_unlock(&client->wake_lock);
 
 	spin_unlock_irq(&client->buffer_lock);
 
-	return have_event;
+	return n;
 }
 
 static ssize_t evdev_read(struct file *file, char __user *buffer,
@@ -539,31 +626,46 @@ static ssize_t evdev_read(struct file *file, char __user *buffer,
 {
 	struct evdev_client *client = file->private_data;
 	struct evdev *evdev = client->evdev;
-	struct input_event event;
+	struct input_event events[EVDEV_READ_BATCH];
+	size_t size = evdev_event_size();
 	int retval;
+	int i, n;
 
-	if (count < evdev_event_size())
+	if (count < size)
 		return -EINVAL;
 
-	if (client->head == client->tail && evdev->exist &&
+	if (client->packet_head == client->tail && evdev->exist &&
 	    (file->f_flags & O_NONBLOCK))
 		return -EAGAIN;
 
 	retval = wait_event_interruptible(evdev->wait,
-		client->head != client->tail || !evdev->exist);
+		client->packet_head != client->tail || !evdev->exist);
 	if (retval)
 		return retval;
 
 	if (!evdev->exist)
 		return -ENODEV;
 
-	while (retval + evdev_event_size() <= count &&
-	       evdev_fetch_next_event(client, &event)) {
+	while (retval + size <= count) {
 
-		if (evdev_event_to_user(buffer + retval, &event))
-			return -EFAULT;
+		n = evdev_fetch_events(client, events,
+				min_t(size_t, EVDEV_READ_BATCH,
+				      (count - retval) / size));
+		if (!n)
+			break;
 
-		retval += evdev_event_size();
+		for (i = 0; i < n; i++) {
+			if (evdev_event_to_user(buffer + retval, &events[i]))
+				return -EFAULT;
+
+			retval += size;
+		}
+	}
+
+	if (retval > 0) {
+		spin_lock_irq(&client->buffer_lock);
+		client->stats.reads++;
+		spin_unlock_irq(&client->buffer_lock);
 	}
 
 	return retval;
@@ -576,7 +678,8 @@ static unsigned int evdev_poll(struct file *file, poll_table *wait)
 	struct evdev *evdev = client->evdev;
 
 	poll_wait(file, &evdev->wait, wait);
-	return ((client->head == client->tail) ? 0 : (POLLIN | POLLRDNORM)) |
+	return ((client->packet_head == client->tail) ?
+			0 : (POLLIN | POLLRDNORM)) |
 		(evdev->exist ? 0 : (POLLHUP | POLLERR));
 }
 
@@ -705,6 +808,7 @@ static long evdev_do_ioctl(struct file *file, unsigned int cmd,
 	struct evdev *evdev = client->evdev;
 	struct input_dev *dev = evdev->handle.dev;
 	struct input_absinfo abs;
+	struct input_client_stats stats;
 	struct ff_effect effect;
 	int __user *ip = (int __user *)p;
 	int i, t, u, v;
@@ -777,6 +881,30 @@ static long evdev_do_ioctl(struct file *file, unsigned int cmd,
 		else
 			return evdev_ungrab(evdev, client);
 
+	case EVIOCSBATCH:
+		u = (unsigned long) p;
+		if (u & ~EVDEV_BATCH_MASK)
+			return -EINVAL;
+
+		spin_lock_irq(&client->buffer_lock);
+		client->flags = u;
+		evdev_reset_abs_slots(client);
+		if (!(u & EVDEV_BATCH_SYN_REPORT))
+			client->packet_head = client->head;
+		spin_unlock_irq(&client->buffer_lock);
+
+		wake_up_interruptible(&evdev->wait);
+		return 0;
+
+	case EVIOCGSTATS:
+		spin_lock_irq(&client->buffer_lock);
+		stats = client->stats;
+		spin_unlock_irq(&client->buffer_lock);
+
+		if (copy_to_user(p, &stats, sizeof(struct input_client_stats)))
+			return -EFAULT;
+		return 0;
+
 	default:
 
 		if (_IOC_TYPE(cmd) != 'E')
@@ -76,6 +76,10 @@ extern const char raid6_empty_zero_page[PAGE_SIZE];
 #define cpu_has_feature(x) 1
 #define enable_kernel_altivec()
 #define disable_kernel_altivec()
+#define kernel_neon_begin()
+#define kernel_neon_end()
+#define kernel_neon_allowed() 1
+#define kernel_neon_available 1
 
 #endif /* __KERNEL__ */
 
@@ -115,6 +119,7 @@ void raid6_dual_recov(int disks, size_t bytes, int faila, int failb, void **ptrs
 #ifndef __KERNEL__
 
 # define jiffies	raid6_jiffies()
+# define time_before(x,y)	((long)((x) - (y)) < 0)
 # define printk 	printf
 # define GFP_KERNEL	0
 # define __get_free_pages(x,y)	((unsigned long)mmap(NULL, PAGE_SIZE << (y), PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, 0, 0))
@@ -42,6 +42,10 @@ extern const struct raid6_calls raid6_altivec1;
 extern const struct raid6_calls raid6_altivec2;
 extern const struct raid6_calls raid6_altivec4;
 extern const struct raid6_calls raid6_altivec8;
+extern const struct raid6_calls raid6_neon1;
+extern const struct raid6_calls raid6_neon2;
+extern const struct raid6_calls raid6_neon4;
+extern const struct raid6_calls raid6_neon8;
 
 const struct raid6_calls * const raid6_algos[] = {
 	&raid6_intx1,
@@ -70,6 +74,12 @@ const struct raid6_calls * const raid6_algos[] = {
 	&raid6_altivec2,
 	&raid6_altivec4,
 	&raid6_altivec8,
+#endif
+#ifdef CONFIG_KERNEL_MODE_NEON
+	&raid6_neon1,
+	&raid6_neon2,
+	&raid6_neon4,
+	&raid6_neon8,
 #endif
 	NULL
 };
@@ -0,0 +1,67 @@
+/* -*- linux-c -*- ------------------------------------------------------- *
+ *
+ *   Copyright 2002-2004 H. Peter Anvin - All Rights Reserved
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, Inc., 53 Temple Place Ste 330,
+ *   Bostom MA 02111-1307, USA; either version 2 of the License, or
+ *   (at your option) any later version; incorporated herein by reference.
+ *
+ * ----------------------------------------------------------------------- */
+
+/*
+ * raid6neon.c
+ *
+ * ARM NEON RAID-6 routine sets; the loops are in raid6neon$#.c
+ *
+ * The NEON unit may only be used between kernel_neon_begin() and
+ * kernel_neon_end(), and not at all from interrupt context; callers
+ * which cannot use it get the integer code instead.
+ */
+
+#include "raid6.h"
+
+#ifdef CONFIG_KERNEL_MODE_NEON
+
+#ifdef __KERNEL__
+# include <asm/neon.h>
+#endif
+
+extern const struct raid6_calls raid6_intx2;
+
+static int raid6_have_neon(void)
+{
+	/* NEON is only brought up by vfp_init(), a late initcall */
+	return kernel_neon_available;
+}
+
+#define RAID6_NEON(_n)							\
+	void raid6_neon##_n##_gen_syndrome_real(int disks,		\
+			unsigned long bytes, void **ptrs);		\
+									\
+	static void raid6_neon##_n##_gen_syndrome(int disks,		\
+			size_t bytes, void **ptrs)			\
+	{								\
+		if (!kernel_neon_allowed()) {				\
+			raid6_intx2.gen_syndrome(disks, bytes, ptrs);	\
+			return;						\
+		}							\
+		kernel_neon_begin();					\
+		raid6_neon##_n##_gen_syndrome_real(disks, bytes, ptrs);	\
+		kernel_neon_end();					\
+	}								\
+									\
+	const struct raid6_calls raid6_neon##_n = {			\
+		raid6_neon##_n##_gen_syndrome,				\
+		raid6_have_neon,					\
+		"neonx" #_n,						\
+		0							\
+	}
+
+RAID6_NEON(1);
+RAID6_NEON(2);
+RAID6_NEON(4);
+RAID6_NEON(8);
+
+#endif /* CONFIG_KERNEL_MODE_NEON */
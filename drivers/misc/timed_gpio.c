@@ -18,121 +18,300 @@
 #include <linux/platform_device.h>
 #include <linux/hrtimer.h>
 #include <linux/err.h>
+#include <linux/mutex.h>
 #include <linux/gpio.h>
 #include <linux/timed_output.h>
 #include <linux/timed_gpio.h>
 
 
+/*
+ * All outputs of one platform device share a single hrtimer: each output
+ * keeps the deadline of its next on/off step, and the timer is programmed
+ * for the earliest deadline plus that output's slack. When it fires, every
+ * output whose deadline has passed is stepped, so pulses that end close to
+ * each other cost a single wakeup.
+ */
+struct timed_gpio_chip;
+
 struct timed_gpio_data {
 	struct timed_output_dev dev;
-	struct hrtimer timer;
-	spinlock_t lock;
+	struct timed_gpio_chip *chip;
 	unsigned 	gpio;
 	int 		max_timeout;
 	u8 		active_low;
+
+	/* pattern state, protected by chip->lock */
+	unsigned int	pattern[TIMED_OUTPUT_PATTERN_MAX];
+	int		steps;
+	int		step;
+	int		repeat;
+	int		active;
+	ktime_t		deadline;
+	ktime_t		slack;
 };
 
+struct timed_gpio_chip {
+	struct hrtimer timer;
+	spinlock_t lock;
+	struct mutex mutex;		/* serializes timer reprogramming */
+	int num_gpios;
+	struct timed_gpio_data gpios[0];
+};
+
+static inline ktime_t ms_to_ktime(unsigned int ms)
+{
+	return ktime_set(ms / 1000, (ms % 1000) * NSEC_PER_MSEC);
+}
+
+static void gpio_set(struct timed_gpio_data *data, int on)
+{
+	gpio_direction_output(data->gpio, data->active_low ? !on : on);
+}
+
+/* move to the next step of the pattern, switching the output */
+static void gpio_step(struct timed_gpio_data *data)
+{
+	if (++data->step == data->steps) {
+		if (!data->repeat) {
+			data->active = 0;
+			gpio_set(data, 0);
+			return;
+		}
+		data->repeat--;
+		data->step = 0;
+	}
+	gpio_set(data, !(data->step & 1));
+	data->deadline = ktime_add(data->deadline,
+			ms_to_ktime(data->pattern[data->step]));
+}
+
+/* earliest deadline + slack over all running outputs, chip->lock held */
+static int gpio_next_expiry(struct timed_gpio_chip *chip, ktime_t *next)
+{
+	struct timed_gpio_data *data;
+	ktime_t expiry;
+	int i, found = 0;
+
+	for (i = 0; i < chip->num_gpios; i++) {
+		data = &chip->gpios[i];
+		if (!data->active)
+			continue;
+		expiry = ktime_add(data->deadline, data->slack);
+		if (!found || expiry.tv64 < next->tv64)
+			*next = expiry;
+		found = 1;
+	}
+
+	return found;
+}
+
 static enum hrtimer_restart gpio_timer_func(struct hrtimer *timer)
 {
-	struct timed_gpio_data *data =
-		container_of(timer, struct timed_gpio_data, timer);
+	struct timed_gpio_chip *chip =
+		container_of(timer, struct timed_gpio_chip, timer);
+	struct timed_gpio_data *data;
+	ktime_t now = hrtimer_cb_get_time(timer);
+	unsigned long flags;
+	int i, restart;
+
+	spin_lock_irqsave(&chip->lock, flags);
+
+	for (i = 0; i < chip->num_gpios; i++) {
+		data = &chip->gpios[i];
+		while (data->active && data->deadline.tv64 <= now.tv64)
+			gpio_step(data);
+	}
+	restart = gpio_next_expiry(chip, &timer->expires);
+
+	spin_unlock_irqrestore(&chip->lock, flags);
 
-	gpio_direction_output(data->gpio, data->active_low ? 1 : 0);
-	return HRTIMER_NORESTART;
+	return restart ? HRTIMER_RESTART : HRTIMER_NORESTART;
 }
 
 static int gpio_get_time(struct timed_output_dev *dev)
 {
 	struct timed_gpio_data	*data =
 		container_of(dev, struct timed_gpio_data, dev);
+	unsigned long flags;
+	u64 remaining = 0;
+	int i, total = 0;
+
+	spin_lock_irqsave(&data->chip->lock, flags);
+	if (data->active) {
+		ktime_t r = ktime_sub(data->deadline, ktime_get());
+
+		if (r.tv64 > 0)
+			remaining = ktime_to_ns(r);
+		do_div(remaining, NSEC_PER_MSEC);
+		for (i = 0; i < data->steps; i++)
+			total += data->pattern[i];
+		for (i = data->step + 1; i < data->steps; i++)
+			remaining += data->pattern[i];
+		remaining += (u64)total * data->repeat;
+	}
+	spin_unlock_irqrestore(&data->chip->lock, flags);
+
+	return min_t(u64, remaining, INT_MAX);
+}
+
+/*
+ * Load a new pattern into one output (count == 0 switches it off) and
+ * reprogram the shared timer. The timer is cancelled first so that the
+ * callback can never be restarting it behind our back.
+ */
+static void gpio_start(struct timed_gpio_data *data,
+		const unsigned int *ms, int count, int repeat)
+{
+	struct timed_gpio_chip *chip = data->chip;
+	unsigned long flags;
+	ktime_t next;
+	int i;
+
+	mutex_lock(&chip->mutex);
+	hrtimer_cancel(&chip->timer);
+
+	spin_lock_irqsave(&chip->lock, flags);
+
+	for (i = 0; i < count; i++) {
+		data->pattern[i] = ms[i];
+		/* on steps are bounded like a single enable */
+		if (!(i & 1) && data->pattern[i] > data->max_timeout)
+			data->pattern[i] = data->max_timeout;
+	}
+	data->steps = count;
+	data->step = 0;
+	data->repeat = repeat;
+	data->active = count > 0;
+	gpio_set(data, data->active);
+	if (data->active)
+		data->deadline = ktime_add(ktime_get(),
+			ms_to_ktime(data->pattern[0]));
+
+	if (gpio_next_expiry(chip, &next))
+		hrtimer_start(&chip->timer, next, HRTIMER_MODE_ABS);
 
-	if (hrtimer_active(&data->timer)) {
-		ktime_t r = hrtimer_get_remaining(&data->timer);
-		return r.tv.sec * 1000 + r.tv.nsec / 1000000;
-	} else
-		return 0;
+	spin_unlock_irqrestore(&chip->lock, flags);
+	mutex_unlock(&chip->mutex);
 }
 
 static void gpio_enable(struct timed_output_dev *dev, int value)
 {
 	struct timed_gpio_data	*data =
 		container_of(dev, struct timed_gpio_data, dev);
-	unsigned long	flags;
-
-	spin_lock_irqsave(&data->lock, flags);
+	unsigned int ms = value;
 
-	/* cancel previous timer and set GPIO according to value */
-	hrtimer_cancel(&data->timer);
-	gpio_direction_output(data->gpio, data->active_low ? !value : !!value);
+	gpio_start(data, &ms, value > 0 ? 1 : 0, 0);
+}
 
-	if (value > 0) {
-		if (value > data->max_timeout)
-			value = data->max_timeout;
+static int gpio_set_pattern(struct timed_output_dev *dev,
+		const unsigned int *ms, int count, int repeat)
+{
+	struct timed_gpio_data	*data =
+		container_of(dev, struct timed_gpio_data, dev);
+	unsigned int total = 0;
+	int i;
 
-		hrtimer_start(&data->timer,
-			ktime_set(value / 1000, (value % 1000) * 1000000),
-			HRTIMER_MODE_REL);
+	if (count > TIMED_OUTPUT_PATTERN_MAX)
+		return -EINVAL;
+	for (i = 0; i < count; i++) {
+		if (ms[i] > INT_MAX / TIMED_OUTPUT_PATTERN_MAX)
+			return -EINVAL;
+		total += ms[i];
 	}
+	/* a pattern that takes no time would spin in the timer callback */
+	if (!total)
+		return -EINVAL;
 
-	spin_unlock_irqrestore(&data->lock, flags);
+	gpio_start(data, ms, count, repeat);
+	return 0;
+}
+
+static void gpio_set_slack(struct timed_output_dev *dev, unsigned int slack_us)
+{
+	struct timed_gpio_data	*data =
+		container_of(dev, struct timed_gpio_data, dev);
+	unsigned long flags;
+
+	/* takes effect the next time the timer is programmed */
+	spin_lock_irqsave(&data->chip->lock, flags);
+	data->slack = ns_to_ktime((u64)slack_us * NSEC_PER_USEC);
+	spin_unlock_irqrestore(&data->chip->lock, flags);
+}
+
+static unsigned int gpio_get_slack(struct timed_output_dev *dev)
+{
+	struct timed_gpio_data	*data =
+		container_of(dev, struct timed_gpio_data, dev);
+
+	return ktime_to_us(data->slack);
 }
 
 static int timed_gpio_probe(struct platform_device *pdev)
 {
 	struct timed_gpio_platform_data *pdata = pdev->dev.platform_data;
 	struct timed_gpio *cur_gpio;
-	struct timed_gpio_data *gpio_data, *gpio_dat;
+	struct timed_gpio_chip *chip;
+	struct timed_gpio_data *gpio_dat;
 	int i, j, ret = 0;
 
 	if (!pdata)
 		return -EBUSY;
 
-	gpio_data = kzalloc(sizeof(struct timed_gpio_data) * pdata->num_gpios,
+	chip = kzalloc(sizeof(struct timed_gpio_chip) +
+			sizeof(struct timed_gpio_data) * pdata->num_gpios,
 			GFP_KERNEL);
-	if (!gpio_data)
+	if (!chip)
 		return -ENOMEM;
 
+	hrtimer_init(&chip->timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	chip->timer.function = gpio_timer_func;
+	spin_lock_init(&chip->lock);
+	mutex_init(&chip->mutex);
+	chip->num_gpios = pdata->num_gpios;
+
 	for (i = 0; i < pdata->num_gpios; i++) {
 		cur_gpio = &pdata->gpios[i];
-		gpio_dat = &gpio_data[i];
+		gpio_dat = &chip->gpios[i];
 
-		hrtimer_init(&gpio_dat->timer, CLOCK_MONOTONIC,
-				HRTIMER_MODE_REL);
-		gpio_dat->timer.function = gpio_timer_func;
-		spin_lock_init(&gpio_dat->lock);
+		gpio_dat->chip = chip;
+		gpio_dat->gpio = cur_gpio->gpio;
+		gpio_dat->max_timeout = cur_gpio->max_timeout;
+		gpio_dat->active_low = cur_gpio->active_low;
+		gpio_dat->slack = ns_to_ktime((u64)cur_gpio->slack_us *
+				NSEC_PER_USEC);
+		gpio_direction_output(gpio_dat->gpio, gpio_dat->active_low);
 
 		gpio_dat->dev.name = cur_gpio->name;
 		gpio_dat->dev.get_time = gpio_get_time;
 		gpio_dat->dev.enable = gpio_enable;
+		gpio_dat->dev.set_pattern = gpio_set_pattern;
+		gpio_dat->dev.set_slack = gpio_set_slack;
+		gpio_dat->dev.get_slack = gpio_get_slack;
 		ret = timed_output_dev_register(&gpio_dat->dev);
 		if (ret < 0) {
 			for (j = 0; j < i; j++)
-				timed_output_dev_unregister(&gpio_data[i].dev);
-			kfree(gpio_data);
+				timed_output_dev_unregister(&chip->gpios[j].dev);
+			hrtimer_cancel(&chip->timer);
+			kfree(chip);
 			return ret;
 		}
-
-		gpio_dat->gpio = cur_gpio->gpio;
-		gpio_dat->max_timeout = cur_gpio->max_timeout;
-		gpio_dat->active_low = cur_gpio->active_low;
-		gpio_direction_output(gpio_dat->gpio, gpio_dat->active_low);
 	}
 
-	platform_set_drvdata(pdev, gpio_data);
+	platform_set_drvdata(pdev, chip);
 
 	return 0;
 }
 
 static int timed_gpio_remove(struct platform_device *pdev)
 {
-	struct timed_gpio_platform_data *pdata = pdev->dev.platform_data;
-	struct timed_gpio_data *gpio_data = platform_get_drvdata(pdev);
+	struct timed_gpio_chip *chip = platform_get_drvdata(pdev);
 	int i;
 
-	for (i = 0; i < pdata->num_gpios; i++)
-		timed_output_dev_unregister(&gpio_data[i].dev);
+	for (i = 0; i < chip->num_gpios; i++)
+		timed_output_dev_unregister(&chip->gpios[i].dev);
 
-	kfree(gpio_data);
+	hrtimer_cancel(&chip->timer);
+	kfree(chip);
 
 	return 0;
 }
@@ -19,6 +19,8 @@
 #include <linux/device.h>
 #include <linux/fs.h>
 #include <linux/err.h>
+#include <linux/ctype.h>
+#include <linux/kernel.h>
 #include <linux/timed_output.h>
 
 static struct class *timed_output_class;
@@ -48,6 +50,92 @@ static ssize_t enable_store(
 
 static DEVICE_ATTR(enable, S_IRUGO | S_IWUSR, enable_show, enable_store);
 
+/*
+ * Parses "<repeat> <on> <off> <on> ..." with all durations in milliseconds,
+ * optionally followed by a newline, into @repeat and @ms. Returns the number
+ * of durations or -EINVAL.
+ */
+static int timed_output_parse_pattern(const char *buf, int *repeat,
+				      unsigned int *ms)
+{
+	const char *p = buf, *q;
+	char *end;
+	unsigned long val;
+	int count = 0;
+
+	while (isspace(*p))
+		p++;
+	val = simple_strtoul(p, &end, 10);
+	if (end == p || val > INT_MAX)
+		return -EINVAL;
+	*repeat = val;
+	p = end;
+
+	for (;;) {
+		for (q = p; isspace(*q); q++)
+			;
+		val = simple_strtoul(q, &end, 10);
+		if (end == q)
+			break;
+		/* more steps than a pattern can hold */
+		if (count == TIMED_OUTPUT_PATTERN_MAX)
+			return -EINVAL;
+		ms[count++] = val;
+		p = end;
+	}
+
+	if (*p == '\n')
+		p++;
+	if (*p || !count)
+		return -EINVAL;
+	return count;
+}
+
+static ssize_t pattern_store(
+		struct device *dev, struct device_attribute *attr,
+		const char *buf, size_t size)
+{
+	struct timed_output_dev *tdev = dev_get_drvdata(dev);
+	unsigned int ms[TIMED_OUTPUT_PATTERN_MAX];
+	int repeat, count, ret;
+
+	count = timed_output_parse_pattern(buf, &repeat, ms);
+	if (count < 0)
+		return count;
+
+	ret = tdev->set_pattern(tdev, ms, count, repeat);
+	if (ret < 0)
+		return ret;
+
+	return size;
+}
+
+static DEVICE_ATTR(pattern, S_IWUSR, NULL, pattern_store);
+
+static ssize_t slack_us_show(struct device *dev, struct device_attribute *attr,
+		char *buf)
+{
+	struct timed_output_dev *tdev = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", tdev->get_slack(tdev));
+}
+
+static ssize_t slack_us_store(
+		struct device *dev, struct device_attribute *attr,
+		const char *buf, size_t size)
+{
+	struct timed_output_dev *tdev = dev_get_drvdata(dev);
+	unsigned int value;
+
+	if (sscanf(buf, "%u", &value) != 1)
+		return -EINVAL;
+	tdev->set_slack(tdev, value);
+
+	return size;
+}
+
+static DEVICE_ATTR(slack_us, S_IRUGO | S_IWUSR, slack_us_show, slack_us_store);
+
 static int create_timed_output_class(void)
 {
 	if (!timed_output_class) {
@@ -81,10 +169,27 @@ int timed_output_dev_register(struct timed_output_dev *tdev)
 	if (ret < 0)
 		goto err_create_file;
 
+	if (tdev->set_pattern) {
+		ret = device_create_file(tdev->dev, &dev_attr_pattern);
+		if (ret < 0)
+			goto err_create_pattern;
+	}
+
+	if (tdev->set_slack && tdev->get_slack) {
+		ret = device_create_file(tdev->dev, &dev_attr_slack_us);
+		if (ret < 0)
+			goto err_create_slack;
+	}
+
 	dev_set_drvdata(tdev->dev, tdev);
 	tdev->state = 0;
 	return 0;
 
+err_create_slack:
+	if (tdev->set_pattern)
+		device_remove_file(tdev->dev, &dev_attr_pattern);
+err_create_pattern:
+	device_remove_file(tdev->dev, &dev_attr_enable);
 err_create_file:
 	device_destroy(timed_output_class, MKDEV(0, tdev->index));
 	printk(KERN_ERR "timed_output: Failed to register driver %s\n",
@@ -96,14 +201,85 @@ EXPORT_SYMBOL_GPL(timed_output_dev_register);
 
 void timed_output_dev_unregister(struct timed_output_dev *tdev)
 {
+	if (tdev->set_slack && tdev->get_slack)
+		device_remove_file(tdev->dev, &dev_attr_slack_us);
+	if (tdev->set_pattern)
+		device_remove_file(tdev->dev, &dev_attr_pattern);
 	device_remove_file(tdev->dev, &dev_attr_enable);
 	device_destroy(timed_output_class, MKDEV(0, tdev->index));
 	dev_set_drvdata(tdev->dev, NULL);
 }
 EXPORT_SYMBOL_GPL(timed_output_dev_unregister);
 
+#ifdef CONFIG_TIMED_OUTPUT_SELFTEST
+static const struct {
+	const char *in;
+	int count;		/* or -EINVAL */
+	int repeat;
+	unsigned int ms[3];
+} pattern_tests[] __initdata = {
+	{ "0 100",		1, 0, { 100 } },	/* no newline */
+	{ "0 100\n",		1, 0, { 100 } },
+	{ "2 100 50 100",	3, 2, { 100, 50, 100 } },
+	{ "3 100  50\n",	2, 3, { 100, 50 } },
+	{ "5",			-EINVAL },
+	{ "5\n",		-EINVAL },
+	{ "",			-EINVAL },
+	{ "-1 100",		-EINVAL },
+	{ "0 -100",		-EINVAL },
+	{ "0 100 x",		-EINVAL },
+	{ "0 100,50",		-EINVAL },
+	{ "0 100\n\n",		-EINVAL },
+};
+
+static void __init timed_output_selftest(void)
+{
+	unsigned int ms[TIMED_OUTPUT_PATTERN_MAX];
+	char buf[8 * (TIMED_OUTPUT_PATTERN_MAX + 2)];
+	int i, len, repeat, count, errors = 0;
+
+	for (i = 0; i < ARRAY_SIZE(pattern_tests); i++) {
+		count = timed_output_parse_pattern(pattern_tests[i].in,
+						   &repeat, ms);
+		if (count != pattern_tests[i].count ||
+		    (count > 0 && (repeat != pattern_tests[i].repeat ||
+				   memcmp(ms, pattern_tests[i].ms,
+					  count * sizeof(ms[0]))))) {
+			printk(KERN_ERR "timed_output: pattern \"%s\" parsed "
+			       "wrong (%d)\n", pattern_tests[i].in, count);
+			errors++;
+		}
+	}
+
+	/* exactly TIMED_OUTPUT_PATTERN_MAX steps, then one more */
+	len = sprintf(buf, "1");
+	for (i = 0; i < TIMED_OUTPUT_PATTERN_MAX; i++)
+		len += sprintf(buf + len, " %d", i + 1);
+	count = timed_output_parse_pattern(buf, &repeat, ms);
+	if (count != TIMED_OUTPUT_PATTERN_MAX ||
+	    ms[TIMED_OUTPUT_PATTERN_MAX - 1] != TIMED_OUTPUT_PATTERN_MAX) {
+		printk(KERN_ERR "timed_output: longest pattern parsed wrong "
+		       "(%d)\n", count);
+		errors++;
+	}
+	sprintf(buf + len, " 1");
+	if (timed_output_parse_pattern(buf, &repeat, ms) != -EINVAL) {
+		printk(KERN_ERR "timed_output: too long pattern accepted\n");
+		errors++;
+	}
+
+	if (errors)
+		printk(KERN_ERR "timed_output: %d self-test failures\n", errors);
+	else
+		printk(KERN_INFO "timed_output: pattern self-test passed\n");
+}
+#else
+static inline void timed_output_selftest(void) { }
+#endif
+
 static int __init timed_output_init(void)
 {
+	timed_output_selftest();
 	return create_timed_output_class();
 }
 
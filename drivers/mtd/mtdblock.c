@@ -13,32 +13,71 @@
 #include <linux/slab.h>
 #include <linux/types.h>
 #include <linux/vmalloc.h>
+#include <linux/err.h>
+#include <linux/jiffies.h>
+#include <linux/workqueue.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
 
 #include <linux/mtd/mtd.h>
 #include <linux/mtd/blktrans.h>
 #include <linux/mutex.h>
 
 
-static struct mtdblk_dev {
-	struct mtd_info *mtd;
-	int count;
-	struct mutex cache_mutex;
-	unsigned char *cache_data;
-	unsigned long cache_offset;
-	unsigned int cache_size;
-	enum { STATE_EMPTY, STATE_CLEAN, STATE_DIRTY } cache_state;
-} *mtdblks[MAX_MTD_DEVICES];
-
 /*
  * Cache stuff...
  *
  * Since typical flash erasable sectors are much larger than what Linux's
  * buffer cache can handle, we must implement read-modify-write on flash
  * sectors for each block write requests.  To avoid over-erasing flash sectors
- * and to speed things up, we locally cache a whole flash sector while it is
- * being written to until a different sector is required.
+ * and to speed things up, we locally cache whole flash sectors while they are
+ * being written to.  Up to cache_blocks sectors are kept in LRU order; a dirty
+ * sector is written back when it is evicted, when the device is flushed or
+ * released, or once it has been dirty for cache_expire_ms.
  */
 
+static unsigned int cache_blocks = 4;
+module_param(cache_blocks, uint, 0644);
+MODULE_PARM_DESC(cache_blocks, "Number of erase blocks cached per device (default 4)");
+
+static unsigned int cache_expire_ms = 5000;
+module_param(cache_expire_ms, uint, 0644);
+MODULE_PARM_DESC(cache_expire_ms, "Write back a cached erase block this many "
+		 "milliseconds after it was dirtied, 0 to only write back on "
+		 "eviction and flush (default 5000)");
+
+struct mtdblk_cache {
+	struct list_head list;
+	unsigned char *data;
+	unsigned long offset;
+	unsigned long dirtied;
+	enum { STATE_EMPTY, STATE_CLEAN, STATE_DIRTY } state;
+};
+
+static struct mtdblk_dev {
+	struct mtd_info *mtd;
+	int count;
+	struct mutex cache_mutex;
+	struct list_head cache_lru;	/* most recently used first */
+	unsigned int cache_nr;
+	unsigned int cache_size;
+	unsigned int nr_dirty;
+	struct delayed_work writeback_work;
+
+	/* statistics, see /proc/mtdblock */
+	unsigned long write_hits;
+	unsigned long write_misses;
+	unsigned long read_hits;
+	unsigned long erase_writes;
+	unsigned long wb_evict;
+	unsigned long wb_expire;
+	unsigned long wb_flush;
+	unsigned int max_dirty;
+} *mtdblks[MAX_MTD_DEVICES];
+
+/* protects mtdblks[] against /proc/mtdblock */
+static DEFINE_MUTEX(mtdblks_mutex);
+
 static void erase_callback(struct erase_info *done)
 {
 	wait_queue_head_t *wait_q = (wait_queue_head_t *)done->priv;
@@ -94,23 +133,27 @@ static int erase_write (struct mtd_info *mtd, unsigned long pos,
 }
 
 
-static int write_cached_data (struct mtdblk_dev *mtdblk)
+static int write_cached_data (struct mtdblk_dev *mtdblk,
+			      struct mtdblk_cache *cache)
 {
 	struct mtd_info *mtd = mtdblk->mtd;
 	int ret;
 
-	if (mtdblk->cache_state != STATE_DIRTY)
+	if (cache->state != STATE_DIRTY)
 		return 0;
 
 	DEBUG(MTD_DEBUG_LEVEL2, "mtdblock: writing cached data for \"%s\" "
 			"at 0x%lx, size 0x%x\n", mtd->name,
-			mtdblk->cache_offset, mtdblk->cache_size);
+			cache->offset, mtdblk->cache_size);
 
-	ret = erase_write (mtd, mtdblk->cache_offset,
-			   mtdblk->cache_size, mtdblk->cache_data);
+	ret = erase_write (mtd, cache->offset,
+			   mtdblk->cache_size, cache->data);
 	if (ret)
 		return ret;
 
+	mtdblk->erase_writes++;
+	mtdblk->nr_dirty--;
+
 	/*
 	 * Here we could argubly set the cache state to STATE_CLEAN.
 	 * However this could lead to inconsistency since we will not
@@ -118,16 +161,142 @@ static int write_cached_data (struct mtdblk_dev *mtdblk)
 	 * means.  Let's declare it empty and leave buffering tasks to
 	 * the buffer cache instead.
 	 */
-	mtdblk->cache_state = STATE_EMPTY;
+	cache->state = STATE_EMPTY;
 	return 0;
 }
 
+/* write back all dirty sectors, called with cache_mutex held */
+static int write_all_cached_data(struct mtdblk_dev *mtdblk)
+{
+	struct mtdblk_cache *cache;
+	int ret, err = 0;
+
+	list_for_each_entry(cache, &mtdblk->cache_lru, list) {
+		if (cache->state != STATE_DIRTY)
+			continue;
+		ret = write_cached_data(mtdblk, cache);
+		if (ret)
+			err = ret;
+		else
+			mtdblk->wb_flush++;
+	}
+	return err;
+}
+
+static void mtdblock_writeback(struct work_struct *work)
+{
+	struct mtdblk_dev *mtdblk = container_of(work, struct mtdblk_dev,
+						 writeback_work.work);
+	unsigned long expire = msecs_to_jiffies(cache_expire_ms);
+	unsigned long next = 0;
+	struct mtdblk_cache *cache;
+
+	mutex_lock(&mtdblk->cache_mutex);
+	list_for_each_entry(cache, &mtdblk->cache_lru, list) {
+		if (cache->state != STATE_DIRTY)
+			continue;
+		if (time_after_eq(jiffies, cache->dirtied + expire)) {
+			if (!write_cached_data(mtdblk, cache)) {
+				mtdblk->wb_expire++;
+				continue;
+			}
+			/* failed, try again later */
+			cache->dirtied = jiffies;
+		}
+		if (!next || time_before(cache->dirtied + expire, next))
+			next = cache->dirtied + expire;
+	}
+	if (next && cache_expire_ms)
+		schedule_delayed_work(&mtdblk->writeback_work,
+				      max_t(long, next - jiffies, 1));
+	mutex_unlock(&mtdblk->cache_mutex);
+}
+
+static void mark_cache_dirty(struct mtdblk_dev *mtdblk,
+			     struct mtdblk_cache *cache)
+{
+	if (cache->state == STATE_DIRTY)
+		return;
+
+	cache->state = STATE_DIRTY;
+	cache->dirtied = jiffies;
+	if (++mtdblk->nr_dirty > mtdblk->max_dirty)
+		mtdblk->max_dirty = mtdblk->nr_dirty;
+	if (cache_expire_ms && !delayed_work_pending(&mtdblk->writeback_work))
+		schedule_delayed_work(&mtdblk->writeback_work,
+				      msecs_to_jiffies(cache_expire_ms));
+}
+
+static struct mtdblk_cache *find_cache(struct mtdblk_dev *mtdblk,
+				       unsigned long sect_start)
+{
+	struct mtdblk_cache *cache;
+
+	list_for_each_entry(cache, &mtdblk->cache_lru, list)
+		if (cache->state != STATE_EMPTY && cache->offset == sect_start)
+			return cache;
+	return NULL;
+}
+
+/*
+ * Get a buffer for a sector which is not cached: a new one while there
+ * are less than cache_blocks, else the least recently used one, which is
+ * written back first if it is dirty.
+ */
+static struct mtdblk_cache *get_free_cache(struct mtdblk_dev *mtdblk)
+{
+	struct mtdblk_cache *cache = NULL;
+	int ret;
+
+	if (mtdblk->cache_nr < max(cache_blocks, 1U)) {
+		cache = kzalloc(sizeof(*cache), GFP_KERNEL);
+		if (cache) {
+			cache->data = vmalloc(mtdblk->cache_size);
+			if (cache->data) {
+				cache->state = STATE_EMPTY;
+				list_add(&cache->list, &mtdblk->cache_lru);
+				mtdblk->cache_nr++;
+				return cache;
+			}
+			kfree(cache);
+		}
+		if (!mtdblk->cache_nr)
+			/* -EINTR is not really correct, but it is the best
+			 * match documented in man 2 write for all cases.  We
+			 * could also return -EAGAIN sometimes, but why bother?
+			 */
+			return ERR_PTR(-EINTR);
+	}
+
+	cache = list_entry(mtdblk->cache_lru.prev, struct mtdblk_cache, list);
+	if (cache->state == STATE_DIRTY) {
+		ret = write_cached_data(mtdblk, cache);
+		if (ret)
+			return ERR_PTR(ret);
+		mtdblk->wb_evict++;
+	}
+	cache->state = STATE_EMPTY;
+	return cache;
+}
+
+static void free_all_cache(struct mtdblk_dev *mtdblk)
+{
+	struct mtdblk_cache *cache, *next;
+
+	list_for_each_entry_safe(cache, next, &mtdblk->cache_lru, list) {
+		list_del(&cache->list);
+		vfree(cache->data);
+		kfree(cache);
+	}
+	mtdblk->cache_nr = 0;
+}
 
 static int do_cached_write (struct mtdblk_dev *mtdblk, unsigned long pos,
 			    int len, const char *buf)
 {
 	struct mtd_info *mtd = mtdblk->mtd;
 	unsigned int sect_size = mtdblk->cache_size;
+	struct mtdblk_cache *cache;
 	size_t retlen;
 	int ret;
 
@@ -144,44 +313,51 @@ static int do_cached_write (struct mtdblk_dev *mtdblk, unsigned long pos,
 		if( size > len )
 			size = len;
 
+		cache = find_cache(mtdblk, sect_start);
+
 		if (size == sect_size) {
 			/*
 			 * We are covering a whole sector.  Thus there is no
 			 * need to bother with the cache while it may still be
-			 * useful for other partial writes.
+			 * useful for other partial writes.  A cached copy of
+			 * the sector is stale now.
 			 */
+			if (cache) {
+				if (cache->state == STATE_DIRTY)
+					mtdblk->nr_dirty--;
+				cache->state = STATE_EMPTY;
+			}
 			ret = erase_write (mtd, pos, size, buf);
 			if (ret)
 				return ret;
+			mtdblk->erase_writes++;
 		} else {
 			/* Partial sector: need to use the cache */
 
-			if (mtdblk->cache_state == STATE_DIRTY &&
-			    mtdblk->cache_offset != sect_start) {
-				ret = write_cached_data(mtdblk);
-				if (ret)
-					return ret;
-			}
+			if (cache) {
+				mtdblk->write_hits++;
+			} else {
+				cache = get_free_cache(mtdblk);
+				if (IS_ERR(cache))
+					return PTR_ERR(cache);
 
-			if (mtdblk->cache_state == STATE_EMPTY ||
-			    mtdblk->cache_offset != sect_start) {
 				/* fill the cache with the current sector */
-				mtdblk->cache_state = STATE_EMPTY;
 				ret = mtd->read(mtd, sect_start, sect_size,
-						&retlen, mtdblk->cache_data);
+						&retlen, cache->data);
 				if (ret)
 					return ret;
 				if (retlen != sect_size)
 					return -EIO;
 
-				mtdblk->cache_offset = sect_start;
-				mtdblk->cache_size = sect_size;
-				mtdblk->cache_state = STATE_CLEAN;
+				cache->offset = sect_start;
+				cache->state = STATE_CLEAN;
+				mtdblk->write_misses++;
 			}
+			list_move(&cache->list, &mtdblk->cache_lru);
 
 			/* write data to our local cache */
-			memcpy (mtdblk->cache_data + offset, buf, size);
-			mtdblk->cache_state = STATE_DIRTY;
+			memcpy (cache->data + offset, buf, size);
+			mark_cache_dirty(mtdblk, cache);
 		}
 
 		buf += size;
@@ -198,6 +374,7 @@ static int do_cached_read (struct mtdblk_dev *mtdblk, unsigned long pos,
 {
 	struct mtd_info *mtd = mtdblk->mtd;
 	unsigned int sect_size = mtdblk->cache_size;
+	struct mtdblk_cache *cache;
 	size_t retlen;
 	int ret;
 
@@ -220,9 +397,10 @@ static int do_cached_read (struct mtdblk_dev *mtdblk, unsigned long pos,
 		 * contains what we want, otherwise we read the data directly
 		 * from flash.
 		 */
-		if (mtdblk->cache_state != STATE_EMPTY &&
-		    mtdblk->cache_offset == sect_start) {
-			memcpy (buf, mtdblk->cache_data + offset, size);
+		cache = find_cache(mtdblk, sect_start);
+		if (cache) {
+			memcpy (buf, cache->data + offset, size);
+			mtdblk->read_hits++;
 		} else {
 			ret = mtd->read(mtd, pos, size, &retlen, buf);
 			if (ret)
@@ -243,23 +421,24 @@ static int mtdblock_readsect(struct mtd_blktrans_dev *dev,
 			      unsigned long block, char *buf)
 {
 	struct mtdblk_dev *mtdblk = mtdblks[dev->devnum];
-	return do_cached_read(mtdblk, block<<9, 512, buf);
+	int ret;
+
+	mutex_lock(&mtdblk->cache_mutex);
+	ret = do_cached_read(mtdblk, block<<9, 512, buf);
+	mutex_unlock(&mtdblk->cache_mutex);
+	return ret;
 }
 
 static int mtdblock_writesect(struct mtd_blktrans_dev *dev,
 			      unsigned long block, char *buf)
 {
 	struct mtdblk_dev *mtdblk = mtdblks[dev->devnum];
-	if (unlikely(!mtdblk->cache_data && mtdblk->cache_size)) {
-		mtdblk->cache_data = vmalloc(mtdblk->mtd->erasesize);
-		if (!mtdblk->cache_data)
-			return -EINTR;
-		/* -EINTR is not really correct, but it is the best match
-		 * documented in man 2 write for all cases.  We could also
-		 * return -EAGAIN sometimes, but why bother?
-		 */
-	}
-	return do_cached_write(mtdblk, block<<9, 512, buf);
+	int ret;
+
+	mutex_lock(&mtdblk->cache_mutex);
+	ret = do_cached_write(mtdblk, block<<9, 512, buf);
+	mutex_unlock(&mtdblk->cache_mutex);
+	return ret;
 }
 
 static int mtdblock_open(struct mtd_blktrans_dev *mbd)
@@ -284,13 +463,14 @@ static int mtdblock_open(struct mtd_blktrans_dev *mbd)
 	mtdblk->mtd = mtd;
 
 	mutex_init(&mtdblk->cache_mutex);
-	mtdblk->cache_state = STATE_EMPTY;
-	if ( !(mtdblk->mtd->flags & MTD_NO_ERASE) && mtdblk->mtd->erasesize) {
+	INIT_LIST_HEAD(&mtdblk->cache_lru);
+	INIT_DELAYED_WORK(&mtdblk->writeback_work, mtdblock_writeback);
+	if ( !(mtdblk->mtd->flags & MTD_NO_ERASE) && mtdblk->mtd->erasesize)
 		mtdblk->cache_size = mtdblk->mtd->erasesize;
-		mtdblk->cache_data = NULL;
-	}
 
+	mutex_lock(&mtdblks_mutex);
 	mtdblks[dev] = mtdblk;
+	mutex_unlock(&mtdblks_mutex);
 
 	DEBUG(MTD_DEBUG_LEVEL1, "ok\n");
 
@@ -305,15 +485,18 @@ static int mtdblock_release(struct mtd_blktrans_dev *mbd)
    	DEBUG(MTD_DEBUG_LEVEL1, "mtdblock_release\n");
 
 	mutex_lock(&mtdblk->cache_mutex);
-	write_cached_data(mtdblk);
+	write_all_cached_data(mtdblk);
 	mutex_unlock(&mtdblk->cache_mutex);
 
 	if (!--mtdblk->count) {
 		/* It was the last usage. Free the device */
+		mutex_lock(&mtdblks_mutex);
 		mtdblks[dev] = NULL;
+		mutex_unlock(&mtdblks_mutex);
+		cancel_delayed_work_sync(&mtdblk->writeback_work);
 		if (mtdblk->mtd->sync)
 			mtdblk->mtd->sync(mtdblk->mtd);
-		vfree(mtdblk->cache_data);
+		free_all_cache(mtdblk);
 		kfree(mtdblk);
 	}
 	DEBUG(MTD_DEBUG_LEVEL1, "ok\n");
@@ -326,7 +509,7 @@ static int mtdblock_flush(struct mtd_blktrans_dev *dev)
 	struct mtdblk_dev *mtdblk = mtdblks[dev->devnum];
 
 	mutex_lock(&mtdblk->cache_mutex);
-	write_cached_data(mtdblk);
+	write_all_cached_data(mtdblk);
 	mutex_unlock(&mtdblk->cache_mutex);
 
 	if (mtdblk->mtd->sync)
@@ -334,6 +517,61 @@ static int mtdblock_flush(struct mtd_blktrans_dev *dev)
 	return 0;
 }
 
+#ifdef CONFIG_PROC_FS
+static int mtdblock_proc_show(struct seq_file *m, void *v)
+{
+	struct mtdblk_dev *mtdblk;
+	int i;
+
+	seq_printf(m, "dev       cached dirty max_dirty   write_hits "
+		   "write_misses   read_hits erase_writes    wb_evict   "
+		   "wb_expire    wb_flush\n");
+	mutex_lock(&mtdblks_mutex);
+	for (i = 0; i < MAX_MTD_DEVICES; i++) {
+		mtdblk = mtdblks[i];
+		if (!mtdblk)
+			continue;
+		mutex_lock(&mtdblk->cache_mutex);
+		seq_printf(m, "mtdblock%-2d %5u %5u %9u %12lu %12lu %11lu "
+			   "%12lu %11lu %11lu %11lu\n", i, mtdblk->cache_nr,
+			   mtdblk->nr_dirty, mtdblk->max_dirty,
+			   mtdblk->write_hits, mtdblk->write_misses,
+			   mtdblk->read_hits, mtdblk->erase_writes,
+			   mtdblk->wb_evict, mtdblk->wb_expire,
+			   mtdblk->wb_flush);
+		mutex_unlock(&mtdblk->cache_mutex);
+	}
+	mutex_unlock(&mtdblks_mutex);
+	return 0;
+}
+
+static int mtdblock_proc_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mtdblock_proc_show, NULL);
+}
+
+static const struct file_operations mtdblock_proc_fops = {
+	.owner		= THIS_MODULE,
+	.open		= mtdblock_proc_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void __init mtdblock_proc_init(void)
+{
+	proc_create("mtdblock", 0, NULL, &mtdblock_proc_fops);
+}
+
+static void mtdblock_proc_exit(void)
+{
+	remove_proc_entry("mtdblock", NULL);
+}
+#else
+static inline void mtdblock_proc_init(void) { }
+static inline void mtdblock_proc_exit(void) { }
+#endif
+
 static void mtdblock_add_mtd(struct mtd_blktrans_ops *tr, struct mtd_info *mtd)
 {
 	struct mtd_blktrans_dev *dev = kzalloc(sizeof(*dev), GFP_KERNEL);
@@ -376,11 +614,17 @@ static struct mtd_blktrans_ops mtdblock_tr = {
 
 static int __init init_mtdblock(void)
 {
-	return register_mtd_blktrans(&mtdblock_tr);
+	int ret;
+
+	ret = register_mtd_blktrans(&mtdblock_tr);
+	if (!ret)
+		mtdblock_proc_init();
+	return ret;
 }
 
 static void __exit cleanup_mtdblock(void)
 {
+	mtdblock_proc_exit();
 	deregister_mtd_blktrans(&mtdblock_tr);
 }
 
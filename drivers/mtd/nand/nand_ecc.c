@@ -35,8 +35,9 @@
  * e.g. when running the code in a testbed or a benchmark program.
  * When STANDALONE is used, the module related macros are commented out
  * as well as the linux include files.
- * Instead a private definition of mtd_info is given to satisfy the compiler
- * (the code does not use mtd_info, so the code does not care)
+ * Instead private definitions of mtd_info and nand_chip are given, with
+ * just the fields the code uses (the ECC block size), see
+ * Documentation/mtd/nand_ecc-test.c for an example.
  */
 #ifndef STANDALONE
 #include <linux/types.h>
@@ -48,14 +49,30 @@
 #include <asm/byteorder.h>
 #else
 #include <stdint.h>
-struct mtd_info;
+#include <endian.h>
+struct nand_chip {
+	struct {
+		int size;
+	} ecc;
+};
+struct mtd_info {
+	void *priv;
+};
 #define EXPORT_SYMBOL(x)  /* x */
 
 #define MODULE_LICENSE(x)	/* x */
 #define MODULE_AUTHOR(x)	/* x */
 #define MODULE_DESCRIPTION(x)	/* x */
 
+/* <endian.h> defines both, the code below tests for __BIG_ENDIAN */
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+#undef __BIG_ENDIAN
+#endif
+#define uninitialized_var(x)	x = x
+
+#ifndef printk
 #define printk printf
+#endif
 #define KERN_ERR		""
 #endif
 
@@ -84,30 +101,6 @@ static const char invparity[256] = {
 	1, 0, 0, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 1
 };
 
-/*
- * bitsperbyte contains the number of bits per byte
- * this is only used for testing and repairing parity
- * (a precalculated value slightly improves performance)
- */
-static const char bitsperbyte[256] = {
-	0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
-	1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5,
-	1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5,
-	2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
-	1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5,
-	2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
-	2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
-	3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7,
-	1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5,
-	2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
-	2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
-	3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7,
-	2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
-	3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7,
-	3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7,
-	4, 5, 5, 6, 5, 6, 6, 7, 5, 6, 6, 7, 6, 7, 7, 8,
-};
-
 /*
  * addressbits is a lookup table to filter out the bits from the xor-ed
  * ecc data that identify the faulty location.
@@ -173,6 +166,7 @@ int nand_calculate_ecc(struct mtd_info *mtd, const unsigned char *buf,
 	uint32_t tmppar;	/* the cumulative parity for this iteration;
 				   for rp12, rp14 and rp16 at the end of the
 				   loop */
+	uint32_t t1, t2, t3;	/* partial parities within an iteration */
 
 	par = 0;
 	rp4 = 0;
@@ -189,75 +183,73 @@ int nand_calculate_ecc(struct mtd_info *mtd, const unsigned char *buf,
 	 * Also we process the data by longwords.
 	 * Note: passing unaligned data might give a performance penalty.
 	 * It is assumed that the buffers are aligned.
-	 * tmppar is the cumulative sum of this iteration.
-	 * needed for calculating rp12, rp14, rp16 and par
-	 * also used as a performance improvement for rp6, rp8 and rp10
+	 *
+	 * The 16 longwords of an iteration are xor-ed as a tree: pairs of
+	 * words first, then pairs of pairs etc. rp6, rp8 and rp10 cover the
+	 * first word pair, pair of pairs and group of eight of each bigger
+	 * group, so they are updated from the partial sums of the tree
+	 * instead of from every single word. Only rp4 needs the words
+	 * themselves. t1..t3 hold the partial sums; tmppar ends up as the
+	 * cumulative sum of this iteration, needed for calculating rp12,
+	 * rp14, rp16 and par.
 	 */
 	for (i = 0; i < eccsize_mult << 2; i++) {
+		/* longwords 0..3 */
 		cur = *bp++;
-		tmppar = cur;
 		rp4 ^= cur;
+		t1 = cur ^ *bp++;
+		rp6 ^= t1;
 		cur = *bp++;
-		tmppar ^= cur;
-		rp6 ^= tmppar;
-		cur = *bp++;
-		tmppar ^= cur;
 		rp4 ^= cur;
-		cur = *bp++;
-		tmppar ^= cur;
-		rp8 ^= tmppar;
+		t1 ^= cur;
+		t1 ^= *bp++;
+		rp8 ^= t1;
 
+		/* longwords 4..7 */
 		cur = *bp++;
-		tmppar ^= cur;
 		rp4 ^= cur;
-		rp6 ^= cur;
-		cur = *bp++;
-		tmppar ^= cur;
-		rp6 ^= cur;
+		t2 = cur ^ *bp++;
+		rp6 ^= t2;
 		cur = *bp++;
-		tmppar ^= cur;
 		rp4 ^= cur;
-		cur = *bp++;
-		tmppar ^= cur;
-		rp10 ^= tmppar;
+		t2 ^= cur;
+		t2 ^= *bp++;
+		t1 ^= t2;
+		rp10 ^= t1;
 
+		/* longwords 8..11 */
 		cur = *bp++;
-		tmppar ^= cur;
 		rp4 ^= cur;
-		rp6 ^= cur;
-		rp8 ^= cur;
-		cur = *bp++;
-		tmppar ^= cur;
-		rp6 ^= cur;
-		rp8 ^= cur;
+		t2 = cur ^ *bp++;
+		rp6 ^= t2;
 		cur = *bp++;
-		tmppar ^= cur;
 		rp4 ^= cur;
-		rp8 ^= cur;
-		cur = *bp++;
-		tmppar ^= cur;
-		rp8 ^= cur;
+		t2 ^= cur;
+		t2 ^= *bp++;
+		rp8 ^= t2;
 
+		/* longwords 12..15 */
 		cur = *bp++;
-		tmppar ^= cur;
 		rp4 ^= cur;
-		rp6 ^= cur;
+		t3 = cur ^ *bp++;
+		rp6 ^= t3;
 		cur = *bp++;
-		tmppar ^= cur;
-		rp6 ^= cur;
-		cur = *bp++;
-		tmppar ^= cur;
 		rp4 ^= cur;
-		cur = *bp++;
-		tmppar ^= cur;
+		t3 ^= cur;
+		t3 ^= *bp++;
+		t2 ^= t3;
+		tmppar = t1 ^ t2;
 
+		/*
+		 * (i & 1) - 1 is all ones for even iterations and 0 for odd
+		 * ones, likewise for the other bits of i; this avoids branches.
+		 * For 256 byte blocks rp16 just ends up equal to par and is
+		 * not used.
+		 */
 		par ^= tmppar;
-		if ((i & 0x1) == 0)
-			rp12 ^= tmppar;
-		if ((i & 0x2) == 0)
-			rp14 ^= tmppar;
-		if (eccsize_mult == 2 && (i & 0x4) == 0)
-			rp16 ^= tmppar;
+		rp12 ^= tmppar & ((i & 0x1) - 1);
+		rp14 ^= tmppar & (((i >> 1) & 0x1) - 1);
+		rp16 ^= tmppar & (((i >> 2) & 0x1) - 1);
 	}
 
 	/*
@@ -428,7 +420,7 @@ EXPORT_SYMBOL(nand_calculate_ecc);
 int nand_correct_data(struct mtd_info *mtd, unsigned char *buf,
 		      unsigned char *read_ecc, unsigned char *calc_ecc)
 {
-	unsigned char b0, b1, b2;
+	uint32_t syndrome, mask;
 	uint32_t byte_addr;
 	unsigned char bit_addr;
 	/* 256 or 512 bytes/ecc  */
@@ -436,62 +428,56 @@ int nand_correct_data(struct mtd_info *mtd, unsigned char *buf,
 			(((struct nand_chip *)mtd->priv)->ecc.size) >> 8;
 
 	/*
-	 * b0 to b2 indicate which bit is faulty (if any)
-	 * we might need the xor result  more than once,
-	 * so keep them in a local var
-	*/
+	 * The syndrome holds the xor of read and calculated ecc, one byte
+	 * per ecc byte: b0 (rp0..rp7) in bits 0-7, b1 (rp8..rp15) in bits
+	 * 8-15 and b2 (rp16, rp17, cp0..cp5) in bits 16-23. This way all
+	 * three bytes are checked at once below.
+	 */
 #ifdef CONFIG_MTD_NAND_ECC_SMC
-	b0 = read_ecc[0] ^ calc_ecc[0];
-	b1 = read_ecc[1] ^ calc_ecc[1];
+	syndrome = (read_ecc[0] ^ calc_ecc[0]) |
+		   ((read_ecc[1] ^ calc_ecc[1]) << 8);
 #else
-	b0 = read_ecc[1] ^ calc_ecc[1];
-	b1 = read_ecc[0] ^ calc_ecc[0];
+	syndrome = (read_ecc[1] ^ calc_ecc[1]) |
+		   ((read_ecc[0] ^ calc_ecc[0]) << 8);
 #endif
-	b2 = read_ecc[2] ^ calc_ecc[2];
+	syndrome |= (read_ecc[2] ^ calc_ecc[2]) << 16;
 
 	/* check if there are any bitfaults */
 
 	/* repeated if statements are slightly more efficient than switch ... */
 	/* ordered in order of likelihood */
 
-	if ((b0 | b1 | b2) == 0)
+	if (syndrome == 0)
 		return 0;	/* no error */
 
-	if ((((b0 ^ (b0 >> 1)) & 0x55) == 0x55) &&
-	    (((b1 ^ (b1 >> 1)) & 0x55) == 0x55) &&
-	    ((eccsize_mult == 1 && ((b2 ^ (b2 >> 1)) & 0x54) == 0x54) ||
-	     (eccsize_mult == 2 && ((b2 ^ (b2 >> 1)) & 0x55) == 0x55))) {
+	/*
+	 * A single bit error flips exactly one bit of each parity pair
+	 * (rp0/rp1, ..., cp4/cp5). rp16/rp17 only exist for 512 byte blocks.
+	 */
+	mask = eccsize_mult == 1 ? 0x545555 : 0x555555;
+	if (((syndrome ^ (syndrome >> 1)) & mask) == mask) {
 	/* single bit error */
 		/*
 		 * rp17/rp15/13/11/9/7/5/3/1 indicate which byte is the faulty
 		 * byte, cp 5/3/1 indicate the faulty bit.
 		 * A lookup table (called addressbits) is used to filter
 		 * the bits from the byte they are in.
-		 * A marginal optimisation is possible by having three
-		 * different lookup tables.
-		 * One as we have now (for b0), one for b2
-		 * (that would avoid the >> 1), and one for b1 (with all values
-		 * << 4). However it was felt that introducing two more tables
-		 * hardly justify the gain.
 		 *
-		 * The b2 shift is there to get rid of the lowest two bits.
-		 * We could also do addressbits[b2] >> 1 but for the
-		 * performace it does not make any difference
+		 * The shift by 18 gets cp0..cp5 and drops rp16/rp17.
 		 */
-		if (eccsize_mult == 1)
-			byte_addr = (addressbits[b1] << 4) + addressbits[b0];
-		else
-			byte_addr = (addressbits[b2 & 0x3] << 8) +
-				    (addressbits[b1] << 4) + addressbits[b0];
-		bit_addr = addressbits[b2 >> 2];
+		byte_addr = (addressbits[(syndrome >> 8) & 0xff] << 4) +
+			    addressbits[syndrome & 0xff];
+		if (eccsize_mult == 2)
+			byte_addr += addressbits[(syndrome >> 16) & 0x3] << 8;
+		bit_addr = addressbits[syndrome >> 18];
 		/* flip the bit */
 		buf[byte_addr] ^= (1 << bit_addr);
 		return 1;
 
 	}
-	/* count nr of bits; use table lookup, faster than calculating it */
-	if ((bitsperbyte[b0] + bitsperbyte[b1] + bitsperbyte[b2]) == 1)
-		return 1;	/* error in ecc data; no action needed */
+	/* a single bit set: error in ecc data; no action needed */
+	if ((syndrome & (syndrome - 1)) == 0)
+		return 1;
 
 	printk(KERN_ERR "uncorrectable error : ");
 	return -1;
@@ -28,9 +28,9 @@
  * specified, UBI does not attach any MTD device, but it is possible to do
  * later using the "UBI control device".
  *
- * At the moment we only attach UBI devices by scanning, which will become a
- * bottleneck when flashes reach certain large size. Then one may improve UBI
- * and add other methods, although it does not seem to be easy to do.
+ * UBI devices are attached by scanning, which becomes a bottleneck when
+ * flashes reach certain large size, unless the device has a valid fastmap
+ * (see fastmap.c).
  */
 
 #include <linux/err.h>
@@ -41,6 +41,8 @@
 #include <linux/miscdevice.h>
 #include <linux/log2.h>
 #include <linux/kthread.h>
+#include <linux/hrtimer.h>
+#include <linux/debugfs.h>
 #include "ubi.h"
 
 /* Maximum length of the 'mtd=' parameter */
@@ -81,6 +83,11 @@ static struct ubi_device *ubi_devices[UBI_MAX_DEVICES];
 /* Serializes UBI devices creations and removals */
 DEFINE_MUTEX(ubi_devices_mutex);
 
+#ifdef CONFIG_DEBUG_FS
+/* The "ubi" debugfs directory, which has a sub-directory per UBI device */
+struct dentry *ubi_debugfs_root;
+#endif
+
 /* Protects @ubi_devices and @ubi->ref_count */
 static DEFINE_SPINLOCK(ubi_devices_lock);
 
@@ -477,17 +484,22 @@ static void free_internal_volumes(struct ubi_device *ubi)
  * This function returns zero in case of success and a negative error code in
  * case of failure.
  *
- * Note, currently this is the only method to attach UBI devices. Hopefully in
- * the future we'll have more scalable attaching methods and avoid full media
- * scanning. But even in this case scanning will be needed as a fall-back
- * attaching method if there are some on-flash table corruptions.
+ * If the device has a valid fastmap, the scanning information is built from
+ * it instead, and only the fastmap pool is actually scanned. Full media
+ * scanning is the fall-back if there is no fastmap or it is corrupted.
  */
 static int attach_by_scanning(struct ubi_device *ubi)
 {
 	int err;
+	const char *method = "fastmap";
+	ktime_t start = ktime_get();
 	struct ubi_scan_info *si;
 
-	si = ubi_scan(ubi);
+	si = ubi_scan_fastmap(ubi);
+	if (!si) {
+		method = "scanning";
+		si = ubi_scan(ubi);
+	}
 	if (IS_ERR(si))
 		return PTR_ERR(si);
 
@@ -509,6 +521,8 @@ static int attach_by_scanning(struct ubi_device *ubi)
 		goto out_wl;
 
 	ubi_scan_destroy_si(si);
+	ubi_msg("attached by %s in %ld ms", method,
+		(long)ktime_us_delta(ktime_get(), start) / 1000);
 	return 0;
 
 out_wl:
@@ -814,6 +828,7 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num, int vid_hdr_offset)
 	err = io_init(ubi);
 	if (err)
 		goto out_free;
+	ubi_fastmap_init(ubi);
 
 	ubi->peb_buf1 = vmalloc(ubi->peb_size);
 	if (!ubi->peb_buf1)
@@ -873,6 +888,8 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num, int vid_hdr_offset)
 	if (!DBG_DISABLE_BGT)
 		ubi->thread_enabled = 1;
 	wake_up_process(ubi->bgt_thread);
+	ubi_fastmap_schedule(ubi);
+	ubi_wl_debugfs_init(ubi);
 
 	ubi_devices[ubi_num] = ubi;
 	return ubi_num;
@@ -882,6 +899,7 @@ out_uif:
 out_nofree:
 	do_free = 0;
 out_detach:
+	ubi_fastmap_close(ubi);
 	ubi_wl_close(ubi);
 	if (do_free)
 		free_user_volumes(ubi);
@@ -912,6 +930,7 @@ out_free:
  */
 int ubi_detach_mtd_dev(int ubi_num, int anyway)
 {
+	int err;
 	struct ubi_device *ubi;
 
 	if (ubi_num < 0 || ubi_num >= UBI_MAX_DEVICES)
@@ -943,9 +962,16 @@ int ubi_detach_mtd_dev(int ubi_num, int anyway)
 	 * Before freeing anything, we have to stop the background thread to
 	 * prevent it from doing anything on this device while we are freeing.
 	 */
+	ubi_wl_debugfs_exit(ubi);
 	if (ubi->bgt_thread)
 		kthread_stop(ubi->bgt_thread);
 
+	/* Leave a fastmap behind, so that the next attach is fast */
+	ubi_fastmap_close(ubi);
+	err = ubi_update_fastmap(ubi);
+	if (err)
+		ubi_warn("fastmap not written, error %d", err);
+
 	uif_close(ubi);
 	ubi_wl_close(ubi);
 	free_internal_volumes(ubi);
@@ -1028,6 +1054,11 @@ static int __init ubi_init(void)
 	if (!ubi_wl_entry_slab)
 		goto out_dev_unreg;
 
+#ifdef CONFIG_DEBUG_FS
+	/* Statistics only, UBI works without them */
+	ubi_debugfs_root = debugfs_create_dir("ubi", NULL);
+#endif
+
 	/* Attach MTD devices */
 	for (i = 0; i < mtd_devs; i++) {
 		struct mtd_dev_param *p = &mtd_dev_param[i];
@@ -1061,6 +1092,9 @@ out_detach:
 			ubi_detach_mtd_dev(ubi_devices[k]->ubi_num, 1);
 			mutex_unlock(&ubi_devices_mutex);
 		}
+#ifdef CONFIG_DEBUG_FS
+	debugfs_remove(ubi_debugfs_root);
+#endif
 	kmem_cache_destroy(ubi_wl_entry_slab);
 out_dev_unreg:
 	misc_deregister(&ubi_ctrl_cdev);
@@ -1084,6 +1118,9 @@ static void __exit ubi_exit(void)
 			ubi_detach_mtd_dev(ubi_devices[i]->ubi_num, 1);
 			mutex_unlock(&ubi_devices_mutex);
 		}
+#ifdef CONFIG_DEBUG_FS
+	debugfs_remove(ubi_debugfs_root);
+#endif
 	kmem_cache_destroy(ubi_wl_entry_slab);
 	misc_deregister(&ubi_ctrl_cdev);
 	class_remove_file(ubi_class, &ubi_version);
@@ -0,0 +1,858 @@
+/*
+ * Copyright (c) International Business Machines Corp., 2006
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See
+ * the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/*
+ * UBI fastmap sub-system.
+ *
+ * Attaching an MTD device normally means reading the EC and VID headers of
+ * every physical eraseblock, which takes time proportional to the flash size.
+ * The fastmap is a checkpoint of what scanning would find: the erase counter
+ * and the state or the LEB mapping of every PEB, and the per-volume values
+ * of the VID headers. It is stored in the internal fastmap volume, see
+ * 'struct ubi_fm_sb', and attaching only has to look for its anchor in the
+ * first %UBI_FM_MAX_START PEBs, read it and scan the PEBs of the pool.
+ *
+ * The fastmap is valid as long as the flash matches it. New LEBs may be
+ * mapped only to the PEBs of the pool, which are scanned on attach anyway.
+ * Anything else - un-mapping or re-mapping a LEB, moving a LEB to another PEB
+ * for wear-leveling, running out of pool PEBs - first invalidates the fastmap
+ * by erasing its anchor, and attaching falls back to scanning until a new
+ * fastmap is written. This happens on detach and, if the @fm_autowrite
+ * module parameter is not zero, after the device has been idle for that many
+ * seconds.
+ *
+ * If the fastmap cannot be read or does not pass the checks, the device is
+ * attached by scanning as well.
+ */
+
+#include <linux/crc32.h>
+#include <linux/err.h>
+#include <linux/moduleparam.h>
+#include "ubi.h"
+
+static int fm_autowrite = 60;
+module_param(fm_autowrite, int, 0644);
+MODULE_PARM_DESC(fm_autowrite, "write the fastmap after this many seconds "
+			       "without changes, 0 to write it only on "
+			       "detach (default 60)");
+
+/**
+ * fm_size - size of the fastmap of an UBI device.
+ * @ubi: UBI device description object
+ *
+ * The fastmap has room for a record of every PEB and of every volume the
+ * device may have.
+ */
+static int fm_size(const struct ubi_device *ubi)
+{
+	return sizeof(struct ubi_fm_sb) +
+	       ubi->peb_count * sizeof(struct ubi_fm_peb) +
+	       (UBI_MAX_VOLUMES + UBI_INT_VOL_COUNT) * sizeof(struct ubi_fm_vol);
+}
+
+/**
+ * fill_fastmap - build the fastmap data.
+ * @ubi: UBI device description object
+ * @buf: buffer of @ubi->fm_blocks LEBs to build it in
+ * @fm: the physical eraseblocks the fastmap is going to be written to
+ * @count: count of elements in @fm
+ *
+ * @ubi->fm_mutex has to be locked and no LEB change may be in progress. This
+ * function returns the count of bytes of @buf to write in case of success
+ * and %-EBUSY if a volume is being updated.
+ */
+static int fill_fastmap(struct ubi_device *ubi, void *buf,
+			struct ubi_wl_entry **fm, int count)
+{
+	int i, pnum, vol_count = 0, data_size;
+	struct ubi_fm_sb *fmsb = buf;
+	struct ubi_fm_peb *fmpeb = buf + sizeof(struct ubi_fm_sb);
+	struct ubi_fm_vol *fmvol = (void *)(fmpeb + ubi->peb_count);
+	struct ubi_wl_entry *e;
+	struct rb_node *rb;
+
+	memset(buf, 0, fm_size(ubi));
+
+	spin_lock(&ubi->wl_lock);
+	for (pnum = 0; pnum < ubi->peb_count; pnum++) {
+		e = ubi->lookuptbl[pnum];
+		if (e) {
+			/* Used, or waiting for erasure */
+			fmpeb[pnum].ec = cpu_to_be32(e->ec);
+			fmpeb[pnum].vol_id = cpu_to_be32(UBI_FM_PEB_ERASE);
+		} else
+			fmpeb[pnum].vol_id = cpu_to_be32(UBI_FM_PEB_BAD);
+	}
+
+	for (rb = rb_first(&ubi->free); rb; rb = rb_next(rb)) {
+		e = rb_entry(rb, struct ubi_wl_entry, rb);
+		fmpeb[e->pnum].vol_id = cpu_to_be32(UBI_FM_PEB_FREE);
+	}
+	if (ubi->fm_anchor)
+		fmpeb[ubi->fm_anchor->pnum].vol_id =
+						cpu_to_be32(UBI_FM_PEB_FREE);
+	for (i = ubi->fm_pool_used; i < ubi->fm_pool_size; i++)
+		fmpeb[ubi->fm_pool[i]->pnum].vol_id =
+						cpu_to_be32(UBI_FM_PEB_POOL);
+	spin_unlock(&ubi->wl_lock);
+
+	for (i = 0; i < count; i++) {
+		fmpeb[fm[i]->pnum].ec = cpu_to_be32(fm[i]->ec);
+		fmpeb[fm[i]->pnum].vol_id = cpu_to_be32(UBI_FM_PEB_FM);
+	}
+
+	spin_lock(&ubi->volumes_lock);
+	for (i = 0; i < ubi->vtbl_slots + UBI_INT_VOL_COUNT; i++) {
+		struct ubi_volume *vol = ubi->volumes[i];
+		int lnum, static_vol;
+
+		if (!vol)
+			continue;
+
+		if (vol->updating || vol->changing_leb) {
+			spin_unlock(&ubi->volumes_lock);
+			return -EBUSY;
+		}
+
+		static_vol = vol->vol_type == UBI_STATIC_VOLUME;
+		fmvol[vol_count].vol_id = cpu_to_be32(vol->vol_id);
+		fmvol[vol_count].data_pad = cpu_to_be32(vol->data_pad);
+		if (static_vol) {
+			fmvol[vol_count].used_ebs = cpu_to_be32(vol->used_ebs);
+			fmvol[vol_count].last_data_size =
+					cpu_to_be32(vol->last_eb_bytes);
+			fmvol[vol_count].vol_type = UBI_VID_STATIC;
+		} else
+			fmvol[vol_count].vol_type = UBI_VID_DYNAMIC;
+		if (vol->vol_id == UBI_LAYOUT_VOLUME_ID)
+			fmvol[vol_count].compat = UBI_LAYOUT_VOLUME_COMPAT;
+		vol_count += 1;
+
+		for (lnum = 0; lnum < vol->reserved_pebs; lnum++) {
+			pnum = vol->eba_tbl[lnum];
+			if (pnum < 0)
+				continue;
+			fmpeb[pnum].vol_id = cpu_to_be32(vol->vol_id);
+			fmpeb[pnum].lnum = cpu_to_be32(lnum);
+		}
+	}
+	spin_unlock(&ubi->volumes_lock);
+
+	data_size = ubi->peb_count * sizeof(struct ubi_fm_peb) +
+		    vol_count * sizeof(struct ubi_fm_vol);
+	fmsb->magic = cpu_to_be32(UBI_FM_SB_MAGIC);
+	fmsb->version = UBI_FM_FMT_VERSION;
+	fmsb->data_size = cpu_to_be32(data_size);
+	fmsb->data_crc = cpu_to_be32(crc32(UBI_CRC32_INIT, fmpeb, data_size));
+	fmsb->peb_count = cpu_to_be32(ubi->peb_count);
+	fmsb->vol_count = cpu_to_be32(vol_count);
+	fmsb->pool_size = cpu_to_be32(ubi->fm_pool_size - ubi->fm_pool_used);
+	fmsb->block_count = cpu_to_be32(count);
+	for (i = 0; i < count; i++)
+		fmsb->block_pnum[i] = cpu_to_be32(fm[i]->pnum);
+	fmsb->sqnum = cpu_to_be64(ubi_next_sqnum(ubi));
+	fmsb->hdr_crc = cpu_to_be32(crc32(UBI_CRC32_INIT, fmsb,
+					  UBI_FM_SB_SIZE_CRC));
+
+	return sizeof(struct ubi_fm_sb) + data_size;
+}
+
+/**
+ * write_fastmap - write a new fastmap.
+ * @ubi: UBI device description object
+ *
+ * @ubi->fm_mutex has to be locked and no LEB change may be in progress. This
+ * function returns zero in case of success and a negative error code in case
+ * of failure.
+ */
+static int write_fastmap(struct ubi_device *ubi)
+{
+	int i, err, len, size, count = 0;
+	struct ubi_wl_entry *fm[UBI_FM_MAX_BLOCKS];
+	struct ubi_vid_hdr *vid_hdr;
+	void *buf;
+
+	buf = vmalloc(ubi->fm_blocks * ubi->leb_size);
+	if (!buf)
+		return -ENOMEM;
+
+	vid_hdr = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
+	if (!vid_hdr) {
+		err = -ENOMEM;
+		goto out_free;
+	}
+
+	for (count = 0; count < ubi->fm_blocks; count++) {
+		fm[count] = ubi_wl_get_fm_peb(ubi, count == 0);
+		if (!fm[count]) {
+			dbg_gen("no free PEB for fastmap block %d", count);
+			err = -ENOSPC;
+			goto out_put;
+		}
+	}
+
+	ubi_wl_fill_pool(ubi);
+	size = fill_fastmap(ubi, buf, fm, count);
+	if (size < 0) {
+		err = size;
+		goto out_pool;
+	}
+	memset(buf + size, 0xFF, ubi->fm_blocks * ubi->leb_size - size);
+
+	/* The anchor goes last, the fastmap is not there until it is written */
+	for (i = count - 1; i >= 0; i--) {
+		vid_hdr->vol_type = UBI_VID_DYNAMIC;
+		vid_hdr->vol_id = cpu_to_be32(UBI_FM_VOLUME_ID);
+		vid_hdr->lnum = cpu_to_be32(i);
+		vid_hdr->compat = UBI_FM_VOLUME_COMPAT;
+		vid_hdr->sqnum = cpu_to_be64(ubi_next_sqnum(ubi));
+		err = ubi_io_write_vid_hdr(ubi, fm[i]->pnum, vid_hdr);
+		if (err)
+			goto out_pool;
+
+		len = min(ubi->leb_size, size - i * ubi->leb_size);
+		if (len <= 0)
+			continue;
+		len = ALIGN(len, ubi->min_io_size);
+		err = ubi_io_write_data(ubi, buf + i * ubi->leb_size,
+					fm[i]->pnum, 0, len);
+		if (err)
+			goto out_pool;
+	}
+
+	for (i = 0; i < count; i++)
+		ubi->fm[i] = fm[i];
+	ubi->fm_cnt = count;
+	ubi->fm_valid = 1;
+	dbg_gen("fastmap written, anchor at PEB %d", fm[0]->pnum);
+
+	ubi_free_vid_hdr(ubi, vid_hdr);
+	vfree(buf);
+	return 0;
+
+out_pool:
+	ubi_wl_return_pool(ubi);
+out_put:
+	/* The anchor has not been written yet, so it is not special here */
+	for (i = 0; i < count; i++)
+		ubi_wl_put_fm_peb(ubi, fm[i], 0);
+	ubi_free_vid_hdr(ubi, vid_hdr);
+out_free:
+	vfree(buf);
+	return err;
+}
+
+/**
+ * ubi_update_fastmap - write the fastmap if it is not valid.
+ * @ubi: UBI device description object
+ *
+ * This function returns zero in case of success, %-EBUSY if a LEB change is
+ * in progress, and other negative error codes in case of failure.
+ */
+int ubi_update_fastmap(struct ubi_device *ubi)
+{
+	int err = 0;
+
+	if (ubi->fm_disabled || ubi->ro_mode)
+		return 0;
+
+	mutex_lock(&ubi->fm_mutex);
+	if (ubi->fm_valid)
+		goto out_unlock;
+	if (atomic_read(&ubi->fm_busy)) {
+		err = -EBUSY;
+		goto out_unlock;
+	}
+
+	err = write_fastmap(ubi);
+	if (err && err != -EBUSY)
+		ubi_err("cannot write the fastmap, error %d", err);
+
+out_unlock:
+	mutex_unlock(&ubi->fm_mutex);
+	return err;
+}
+
+/**
+ * ubi_fastmap_invalidate - make sure the fastmap is not used on next attach.
+ * @ubi: UBI device description object
+ *
+ * This function has to be called before the flash stops matching the
+ * fastmap. It erases the fastmap anchor and returns the fastmap PEBs and the
+ * unused pool PEBs. Returns zero in case of success and a negative error code
+ * in case of failure, in which case UBI is switched to R/O mode.
+ */
+int ubi_fastmap_invalidate(struct ubi_device *ubi)
+{
+	int i, err = 0;
+
+	/*
+	 * The fastmap may become valid only when no LEB change is in progress,
+	 * and the callers are in the middle of one, so it cannot become valid
+	 * under our feet.
+	 */
+	if (!ubi->fm_valid)
+		return 0;
+
+	mutex_lock(&ubi->fm_mutex);
+	if (!ubi->fm_valid)
+		goto out_unlock;
+
+	err = ubi_wl_put_fm_peb(ubi, ubi->fm[0], 1);
+	if (err) {
+		ubi_ro_mode(ubi);
+		goto out_unlock;
+	}
+	ubi->fm_valid = 0;
+
+	for (i = 1; i < ubi->fm_cnt; i++) {
+		err = ubi_wl_put_fm_peb(ubi, ubi->fm[i], 0);
+		if (err) {
+			ubi_ro_mode(ubi);
+			break;
+		}
+	}
+	ubi->fm_cnt = 0;
+	ubi_wl_return_pool(ubi);
+	dbg_gen("fastmap invalidated");
+	ubi_fastmap_schedule(ubi);
+
+out_unlock:
+	mutex_unlock(&ubi->fm_mutex);
+	return err;
+}
+
+/**
+ * ubi_fastmap_start_change - note that a LEB change is starting.
+ * @ubi: UBI device description object
+ *
+ * The fastmap is not written until the change ends.
+ */
+void ubi_fastmap_start_change(struct ubi_device *ubi)
+{
+	if (ubi->fm_disabled)
+		return;
+
+	mutex_lock(&ubi->fm_mutex);
+	atomic_inc(&ubi->fm_busy);
+	ubi->fm_last_change = jiffies;
+	mutex_unlock(&ubi->fm_mutex);
+}
+
+/**
+ * ubi_fastmap_end_change - note that a LEB change has ended.
+ * @ubi: UBI device description object
+ */
+void ubi_fastmap_end_change(struct ubi_device *ubi)
+{
+	if (ubi->fm_disabled)
+		return;
+
+	atomic_dec(&ubi->fm_busy);
+}
+
+/**
+ * fm_work_fn - write the fastmap once the device is idle.
+ * @work: the &struct ubi_device @fm_work
+ */
+static void fm_work_fn(struct work_struct *work)
+{
+	struct ubi_device *ubi = container_of(work, struct ubi_device,
+					      fm_work.work);
+	unsigned long idle = fm_autowrite * HZ, since;
+
+	if (fm_autowrite <= 0)
+		return;
+
+	mutex_lock(&ubi->fm_mutex);
+	since = jiffies - ubi->fm_last_change;
+	mutex_unlock(&ubi->fm_mutex);
+
+	if (since < idle) {
+		schedule_delayed_work(&ubi->fm_work, idle - since);
+		return;
+	}
+
+	if (ubi_update_fastmap(ubi) == -EBUSY)
+		schedule_delayed_work(&ubi->fm_work, idle);
+}
+
+/**
+ * ubi_fastmap_schedule - schedule writing of the fastmap.
+ * @ubi: UBI device description object
+ */
+void ubi_fastmap_schedule(struct ubi_device *ubi)
+{
+	if (ubi->fm_disabled || ubi->fm_valid || fm_autowrite <= 0)
+		return;
+
+	schedule_delayed_work(&ubi->fm_work, fm_autowrite * HZ);
+}
+
+/**
+ * ubi_fastmap_init - initialize the fastmap part of an UBI device.
+ * @ubi: UBI device description object
+ *
+ * This function has to be called once the I/O parameters of the device are
+ * known. It disables the fastmap if it would be too large.
+ */
+void ubi_fastmap_init(struct ubi_device *ubi)
+{
+	BUILD_BUG_ON(sizeof(struct ubi_fm_sb) != 192);
+	BUILD_BUG_ON(sizeof(struct ubi_fm_vol) != 20);
+	BUILD_BUG_ON(sizeof(struct ubi_fm_peb) != 12);
+
+	mutex_init(&ubi->fm_mutex);
+	atomic_set(&ubi->fm_busy, 0);
+	INIT_DELAYED_WORK(&ubi->fm_work, fm_work_fn);
+
+	ubi->fm_blocks = DIV_ROUND_UP(fm_size(ubi), ubi->leb_size);
+	if (ubi->fm_blocks > UBI_FM_MAX_BLOCKS) {
+		ubi_warn("fastmap would take %d PEBs, fastmap disabled",
+			 ubi->fm_blocks);
+		ubi->fm_disabled = 1;
+	}
+	ubi->fm_pool_max = clamp(ubi->peb_count / 20, 1, UBI_FM_MAX_POOL_SIZE);
+}
+
+/**
+ * ubi_fastmap_close - stop writing the fastmap in background.
+ * @ubi: UBI device description object
+ */
+void ubi_fastmap_close(struct ubi_device *ubi)
+{
+	cancel_delayed_work_sync(&ubi->fm_work);
+}
+
+/**
+ * find_anchor - find the fastmap anchor.
+ * @ubi: UBI device description object
+ * @vh: VID header buffer to use
+ * @sqnum: the sequence number of the anchor is returned here
+ *
+ * This function returns the PEB number of the newest fastmap anchor, %-ENOENT
+ * if there is none, and other negative error codes in case of failure.
+ */
+static int find_anchor(struct ubi_device *ubi, struct ubi_vid_hdr *vh,
+		       unsigned long long *sqnum)
+{
+	int pnum, err, anchor = -ENOENT;
+
+	for (pnum = 0; pnum < UBI_FM_MAX_START && pnum < ubi->peb_count;
+	     pnum++) {
+		err = ubi_io_is_bad(ubi, pnum);
+		if (err < 0)
+			return err;
+		if (err)
+			continue;
+
+		err = ubi_io_read_vid_hdr(ubi, pnum, vh, 0);
+		if (err < 0)
+			return err;
+		if (err && err != UBI_IO_BITFLIPS)
+			continue;
+
+		if (be32_to_cpu(vh->vol_id) != UBI_FM_VOLUME_ID ||
+		    be32_to_cpu(vh->lnum) != 0)
+			continue;
+		if (anchor < 0 || be64_to_cpu(vh->sqnum) > *sqnum) {
+			anchor = pnum;
+			*sqnum = be64_to_cpu(vh->sqnum);
+		}
+	}
+
+	return anchor;
+}
+
+/**
+ * check_fm_sb - check the fastmap super block.
+ * @ubi: UBI device description object
+ * @fmsb: the super block
+ * @anchor: the PEB it was read from
+ *
+ * This function returns zero if the super block is good and %1 if not.
+ */
+static int check_fm_sb(const struct ubi_device *ubi,
+		       const struct ubi_fm_sb *fmsb, int anchor)
+{
+	int i, block_count, vol_count, data_size;
+	uint32_t crc;
+
+	if (be32_to_cpu(fmsb->magic) != UBI_FM_SB_MAGIC) {
+		dbg_err("bad fastmap magic %#08x", be32_to_cpu(fmsb->magic));
+		return 1;
+	}
+
+	crc = crc32(UBI_CRC32_INIT, fmsb, UBI_FM_SB_SIZE_CRC);
+	if (crc != be32_to_cpu(fmsb->hdr_crc)) {
+		dbg_err("bad fastmap super block CRC %#08x, must be %#08x",
+			be32_to_cpu(fmsb->hdr_crc), crc);
+		return 1;
+	}
+
+	if (fmsb->version != UBI_FM_FMT_VERSION) {
+		ubi_warn("unknown fastmap format version %d", fmsb->version);
+		return 1;
+	}
+
+	if (be32_to_cpu(fmsb->peb_count) != ubi->peb_count) {
+		dbg_err("fastmap is for %d PEBs, not %d",
+			be32_to_cpu(fmsb->peb_count), ubi->peb_count);
+		return 1;
+	}
+
+	block_count = be32_to_cpu(fmsb->block_count);
+	vol_count = be32_to_cpu(fmsb->vol_count);
+	data_size = be32_to_cpu(fmsb->data_size);
+	if (block_count < 1 || block_count > UBI_FM_MAX_BLOCKS ||
+	    vol_count < 0 || vol_count > UBI_MAX_VOLUMES + UBI_INT_VOL_COUNT ||
+	    be32_to_cpu(fmsb->pool_size) > UBI_FM_MAX_POOL_SIZE ||
+	    data_size != ubi->peb_count * sizeof(struct ubi_fm_peb) +
+			 vol_count * sizeof(struct ubi_fm_vol) ||
+	    sizeof(struct ubi_fm_sb) + data_size >
+					block_count * ubi->leb_size) {
+		dbg_err("bad fastmap super block");
+		return 1;
+	}
+
+	if (be32_to_cpu(fmsb->block_pnum[0]) != anchor)
+		return 1;
+	for (i = 1; i < block_count; i++)
+		if (be32_to_cpu(fmsb->block_pnum[i]) >= ubi->peb_count)
+			return 1;
+
+	return 0;
+}
+
+/**
+ * add_seb - add a physical eraseblock to one of the scanning lists.
+ * @list: the list to add to
+ * @pnum: physical eraseblock number
+ * @ec: erase counter
+ *
+ * This function returns zero in case of success and %-ENOMEM in case of
+ * failure.
+ */
+static int add_seb(struct list_head *list, int pnum, int ec)
+{
+	struct ubi_scan_leb *seb;
+
+	seb = kmalloc(sizeof(struct ubi_scan_leb), GFP_KERNEL);
+	if (!seb)
+		return -ENOMEM;
+
+	seb->pnum = pnum;
+	seb->ec = ec;
+	list_add_tail(&seb->u.list, list);
+	return 0;
+}
+
+/**
+ * build_si - build scanning information from the fastmap.
+ * @ubi: UBI device description object
+ * @si: scanning information to fill
+ * @fmsb: the fastmap super block
+ * @data: the fastmap records
+ * @vh: VID header buffer to use
+ *
+ * This function returns zero in case of success, %1 if the fastmap turned out
+ * to be inconsistent, and a negative error code in case of failure.
+ */
+static int build_si(struct ubi_device *ubi, struct ubi_scan_info *si,
+		    const struct ubi_fm_sb *fmsb, const void *data,
+		    struct ubi_vid_hdr *vh)
+{
+	int i, err, pnum, ec, *pool, pool_size, pool_cnt = 0, fm_cnt = 0;
+	int vol_count = be32_to_cpu(fmsb->vol_count);
+	int block_count = be32_to_cpu(fmsb->block_count);
+	const struct ubi_fm_peb *fmpeb = data;
+	const struct ubi_fm_vol *fmvol = (void *)(fmpeb + ubi->peb_count);
+	const struct ubi_fm_vol *v;
+
+	for (i = 0; i < vol_count; i++) {
+		int vol_id = be32_to_cpu(fmvol[i].vol_id);
+
+		if ((vol_id < 0 || vol_id >= UBI_MAX_VOLUMES) &&
+		    vol_id != UBI_LAYOUT_VOLUME_ID)
+			return 1;
+		if (fmvol[i].vol_type != UBI_VID_DYNAMIC &&
+		    fmvol[i].vol_type != UBI_VID_STATIC)
+			return 1;
+	}
+
+	/* Scan the pool first, its free PEBs go to @si->fm_pool */
+	pool_size = be32_to_cpu(fmsb->pool_size);
+	pool = kmalloc(pool_size * sizeof(int), GFP_KERNEL);
+	if (!pool)
+		return -ENOMEM;
+
+	for (pnum = 0; pnum < ubi->peb_count; pnum++) {
+		if (be32_to_cpu(fmpeb[pnum].vol_id) != UBI_FM_PEB_POOL)
+			continue;
+		if (pool_cnt == pool_size) {
+			kfree(pool);
+			return 1;
+		}
+		pool[pool_cnt++] = pnum;
+	}
+	if (pool_cnt != pool_size) {
+		kfree(pool);
+		return 1;
+	}
+
+	err = ubi_scan_pebs(ubi, si, pool, pool_cnt);
+	kfree(pool);
+	if (err)
+		return err;
+	list_splice_init(&si->free, &si->fm_pool);
+
+	for (pnum = 0; pnum < ubi->peb_count; pnum++) {
+		uint32_t vol_id = be32_to_cpu(fmpeb[pnum].vol_id);
+
+		ec = be32_to_cpu(fmpeb[pnum].ec);
+		if (vol_id == UBI_FM_PEB_BAD) {
+			si->bad_peb_count += 1;
+			continue;
+		}
+		if (vol_id == UBI_FM_PEB_POOL)
+			continue;
+		if (ec < 0 || ec > UBI_MAX_ERASECOUNTER)
+			return 1;
+
+		switch (vol_id) {
+		case UBI_FM_PEB_FM:
+			fm_cnt += 1;
+			err = 0;
+			break;
+		case UBI_FM_PEB_FREE:
+			err = add_seb(&si->free, pnum, ec);
+			break;
+		case UBI_FM_PEB_ERASE:
+			err = add_seb(&si->erase, pnum, ec);
+			break;
+		default:
+			for (v = fmvol; v < fmvol + vol_count; v++)
+				if (be32_to_cpu(v->vol_id) == vol_id)
+					break;
+			if (v == fmvol + vol_count)
+				return 1;
+
+			/*
+			 * Present the LEB the way its VID header looks, but
+			 * with the lowest sequence number: if a pool PEB turns
+			 * out to hold the same LEB, it is the newer one.
+			 */
+			memset(vh, 0, sizeof(struct ubi_vid_hdr));
+			vh->vol_type = v->vol_type;
+			vh->compat = v->compat;
+			vh->vol_id = cpu_to_be32(vol_id);
+			vh->lnum = fmpeb[pnum].lnum;
+			vh->data_pad = v->data_pad;
+			if (v->vol_type == UBI_VID_STATIC) {
+				int used_ebs = be32_to_cpu(v->used_ebs);
+
+				vh->used_ebs = v->used_ebs;
+				if (be32_to_cpu(vh->lnum) == used_ebs - 1)
+					vh->data_size = v->last_data_size;
+				else
+					vh->data_size = cpu_to_be32(
+						ubi->leb_size -
+						be32_to_cpu(v->data_pad));
+			}
+			err = ubi_scan_add_used(ubi, si, pnum, ec, vh, 0);
+			break;
+		}
+		if (err)
+			return err;
+
+		si->ec_sum += ec;
+		si->ec_count += 1;
+		if (ec > si->max_ec)
+			si->max_ec = ec;
+		if (ec < si->min_ec)
+			si->min_ec = ec;
+	}
+
+	if (fm_cnt != block_count)
+		return 1;
+
+	for (i = 0; i < block_count; i++) {
+		pnum = be32_to_cpu(fmsb->block_pnum[i]);
+		if (be32_to_cpu(fmpeb[pnum].vol_id) != UBI_FM_PEB_FM)
+			return 1;
+		err = add_seb(&si->fm, pnum, be32_to_cpu(fmpeb[pnum].ec));
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+/**
+ * read_fastmap - read the fastmap and build scanning information from it.
+ * @ubi: UBI device description object
+ * @si: scanning information to fill
+ * @anchor: the PEB of the fastmap anchor
+ * @anchor_sqnum: sequence number of the anchor VID header
+ * @vh: VID header buffer to use
+ *
+ * This function returns zero in case of success, %1 if the fastmap is not
+ * valid, and a negative error code in case of failure.
+ */
+static int read_fastmap(struct ubi_device *ubi, struct ubi_scan_info *si,
+			int anchor, unsigned long long anchor_sqnum,
+			struct ubi_vid_hdr *vh)
+{
+	int i, err, len, size, block_count;
+	unsigned long long sqnum;
+	struct ubi_fm_sb *fmsb;
+	void *buf;
+	uint32_t crc;
+
+	fmsb = kmalloc(sizeof(struct ubi_fm_sb), GFP_KERNEL);
+	if (!fmsb)
+		return -ENOMEM;
+
+	err = ubi_io_read_data(ubi, fmsb, anchor, 0, sizeof(struct ubi_fm_sb));
+	if (err && err != UBI_IO_BITFLIPS)
+		goto out_fmsb;
+
+	err = check_fm_sb(ubi, fmsb, anchor);
+	if (err)
+		goto out_fmsb;
+
+	sqnum = be64_to_cpu(fmsb->sqnum);
+	if (sqnum >= anchor_sqnum) {
+		err = 1;
+		goto out_fmsb;
+	}
+
+	block_count = be32_to_cpu(fmsb->block_count);
+	size = sizeof(struct ubi_fm_sb) + be32_to_cpu(fmsb->data_size);
+	buf = vmalloc(block_count * ubi->leb_size);
+	if (!buf) {
+		err = -ENOMEM;
+		goto out_fmsb;
+	}
+
+	for (i = 0; i < block_count; i++) {
+		int pnum = be32_to_cpu(fmsb->block_pnum[i]);
+
+		if (i > 0) {
+			err = ubi_io_read_vid_hdr(ubi, pnum, vh, 0);
+			if (err && err != UBI_IO_BITFLIPS) {
+				if (err > 0)
+					err = 1;
+				goto out_buf;
+			}
+			if (be32_to_cpu(vh->vol_id) != UBI_FM_VOLUME_ID ||
+			    be32_to_cpu(vh->lnum) != i ||
+			    be64_to_cpu(vh->sqnum) <= sqnum ||
+			    be64_to_cpu(vh->sqnum) >= anchor_sqnum) {
+				dbg_err("bad fastmap block %d at PEB %d",
+					i, pnum);
+				err = 1;
+				goto out_buf;
+			}
+		}
+
+		len = min(ubi->leb_size, size - i * ubi->leb_size);
+		if (len <= 0)
+			continue;
+		err = ubi_io_read_data(ubi, buf + i * ubi->leb_size, pnum, 0,
+				       len);
+		if (err && err != UBI_IO_BITFLIPS)
+			goto out_buf;
+	}
+
+	crc = crc32(UBI_CRC32_INIT, buf + sizeof(struct ubi_fm_sb),
+		    be32_to_cpu(fmsb->data_size));
+	if (crc != be32_to_cpu(fmsb->data_crc)) {
+		dbg_err("bad fastmap data CRC %#08x, must be %#08x",
+			be32_to_cpu(fmsb->data_crc), crc);
+		err = 1;
+		goto out_buf;
+	}
+
+	err = build_si(ubi, si, fmsb, buf + sizeof(struct ubi_fm_sb), vh);
+	if (err)
+		goto out_buf;
+
+	si->is_empty = 0;
+	if (anchor_sqnum > si->max_sqnum)
+		si->max_sqnum = anchor_sqnum;
+	ubi_scan_finish(si);
+
+out_buf:
+	vfree(buf);
+out_fmsb:
+	kfree(fmsb);
+	return err;
+}
+
+/**
+ * ubi_scan_fastmap - build scanning information from the fastmap.
+ * @ubi: UBI device description object
+ *
+ * This function returns the scanning information in case of success, %NULL
+ * if there is no valid fastmap and the device has to be scanned, and an
+ * error pointer if there is not enough memory.
+ */
+struct ubi_scan_info *ubi_scan_fastmap(struct ubi_device *ubi)
+{
+	int err, anchor;
+	unsigned long long sqnum = 0;
+	struct ubi_scan_info *si;
+	struct ubi_vid_hdr *vh;
+
+	if (ubi->fm_disabled)
+		return NULL;
+
+	vh = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
+	if (!vh)
+		return ERR_PTR(-ENOMEM);
+
+	anchor = find_anchor(ubi, vh, &sqnum);
+	if (anchor < 0) {
+		if (anchor != -ENOENT)
+			ubi_warn("error %d while looking for the fastmap",
+				 anchor);
+		ubi_free_vid_hdr(ubi, vh);
+		return NULL;
+	}
+
+	si = ubi_scan_alloc_si();
+	if (!si) {
+		ubi_free_vid_hdr(ubi, vh);
+		return ERR_PTR(-ENOMEM);
+	}
+
+	err = read_fastmap(ubi, si, anchor, sqnum, vh);
+	ubi_free_vid_hdr(ubi, vh);
+	if (err) {
+		ubi_scan_destroy_si(si);
+		if (err == -ENOMEM)
+			return ERR_PTR(err);
+		ubi_warn("fastmap at PEB %d is not valid (%d), falling back "
+			 "to scanning", anchor, err);
+		return NULL;
+	}
+
+	ubi_msg("fastmap found at PEB %d", anchor);
+	return si;
+}
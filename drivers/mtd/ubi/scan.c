@@ -644,6 +644,37 @@ out_free:
 	return err;
 }
 
+/**
+ * drop_fastmap - invalidate the fastmap the scanning information came from.
+ * @ubi: UBI device description object
+ * @si: scanning information
+ *
+ * The fastmap describes the flash only until something is written to it, so
+ * before the first write at attach time, the fastmap anchor is erased and the
+ * rest of the fastmap eraseblocks are scheduled for erasure. The pool
+ * eraseblocks become ordinary free eraseblocks. Returns zero in case of
+ * success and a negative error code in case of failure.
+ */
+static int drop_fastmap(struct ubi_device *ubi, struct ubi_scan_info *si)
+{
+	int err;
+	struct ubi_scan_leb *seb;
+
+	seb = list_entry(si->fm.next, struct ubi_scan_leb, u.list);
+	dbg_bld("drop the fastmap, erase anchor PEB %d", seb->pnum);
+	err = ubi_scan_erase_peb(ubi, si, seb->pnum, seb->ec + 1);
+	if (err) {
+		ubi_err("cannot erase fastmap anchor PEB %d", seb->pnum);
+		return err;
+	}
+
+	seb->ec += 1;
+	list_move_tail(&seb->u.list, &si->free);
+	list_splice_init(&si->fm, &si->erase);
+	list_splice_init(&si->fm_pool, &si->free);
+	return 0;
+}
+
 /**
  * ubi_scan_get_free_peb - get a free physical eraseblock.
  * @ubi: UBI device description object
@@ -664,6 +695,12 @@ struct ubi_scan_leb *ubi_scan_get_free_peb(struct ubi_device *ubi,
 	int err = 0, i;
 	struct ubi_scan_leb *seb;
 
+	if (!list_empty(&si->fm)) {
+		err = drop_fastmap(ubi, si);
+		if (err)
+			return ERR_PTR(err);
+	}
+
 	if (!list_empty(&si->free)) {
 		seb = list_entry(si->free.next, struct ubi_scan_leb, u.list);
 		list_del(&seb->u.list);
@@ -814,7 +851,7 @@ static int process_eb(struct ubi_device *ubi, struct ubi_scan_info *si,
 			err = add_to_list(si, pnum, ec, &si->corr);
 			if (err)
 				return err;
-			break;
+			goto adjust_mean_ec;
 
 		case UBI_COMPAT_RO:
 			ubi_msg("read-only compatible internal volume %d:%d"
@@ -858,50 +895,85 @@ adjust_mean_ec:
 }
 
 /**
- * ubi_scan - scan an MTD device.
- * @ubi: UBI device description object
+ * ubi_scan_alloc_si - allocate empty scanning information.
  *
- * This function does full scanning of an MTD device and returns complete
- * information about it. In case of failure, an error code is returned.
+ * This function returns a pointer to the allocated scanning information or
+ * %NULL if there is no memory.
  */
-struct ubi_scan_info *ubi_scan(struct ubi_device *ubi)
+struct ubi_scan_info *ubi_scan_alloc_si(void)
 {
-	int err, pnum;
-	struct rb_node *rb1, *rb2;
-	struct ubi_scan_volume *sv;
-	struct ubi_scan_leb *seb;
 	struct ubi_scan_info *si;
 
 	si = kzalloc(sizeof(struct ubi_scan_info), GFP_KERNEL);
 	if (!si)
-		return ERR_PTR(-ENOMEM);
+		return NULL;
 
 	INIT_LIST_HEAD(&si->corr);
 	INIT_LIST_HEAD(&si->free);
 	INIT_LIST_HEAD(&si->erase);
 	INIT_LIST_HEAD(&si->alien);
+	INIT_LIST_HEAD(&si->fm);
+	INIT_LIST_HEAD(&si->fm_pool);
 	si->volumes = RB_ROOT;
 	si->is_empty = 1;
+	return si;
+}
+
+/**
+ * ubi_scan_pebs - scan physical eraseblocks.
+ * @ubi: UBI device description object
+ * @si: scanning information to add the physical eraseblocks to
+ * @pnums: numbers of the physical eraseblocks to scan
+ * @count: how many physical eraseblocks to scan
+ *
+ * This function reads the headers of @count physical eraseblocks and adds
+ * them to the scanning information. If @pnums is %NULL, physical eraseblocks
+ * 0 to @count - 1 are scanned. Returns zero in case of success and a negative
+ * error code in case of failure.
+ */
+int ubi_scan_pebs(struct ubi_device *ubi, struct ubi_scan_info *si,
+		  const int *pnums, int count)
+{
+	int err = -ENOMEM, i, pnum;
 
-	err = -ENOMEM;
 	ech = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
 	if (!ech)
-		goto out_si;
+		return err;
 
 	vidh = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
 	if (!vidh)
 		goto out_ech;
 
-	for (pnum = 0; pnum < ubi->peb_count; pnum++) {
+	err = 0;
+	for (i = 0; i < count; i++) {
 		cond_resched();
 
+		pnum = pnums ? pnums[i] : i;
 		dbg_gen("process PEB %d", pnum);
 		err = process_eb(ubi, si, pnum);
 		if (err < 0)
-			goto out_vidh;
+			break;
 	}
 
-	dbg_msg("scanning is finished");
+	ubi_free_vid_hdr(ubi, vidh);
+out_ech:
+	kfree(ech);
+	return err;
+}
+
+/**
+ * ubi_scan_finish - finish building the scanning information.
+ * @si: scanning information
+ *
+ * This function calculates the mean erase counter and assigns it to the
+ * physical eraseblocks with unknown erase counter. It has to be called after
+ * all the physical eraseblocks were added to @si.
+ */
+void ubi_scan_finish(struct ubi_scan_info *si)
+{
+	struct rb_node *rb1, *rb2;
+	struct ubi_scan_volume *sv;
+	struct ubi_scan_leb *seb;
 
 	/* Calculate mean erase counter */
 	if (si->ec_count) {
@@ -909,9 +981,6 @@ struct ubi_scan_info *ubi_scan(struct ubi_device *ubi)
 		si->mean_ec = si->ec_sum;
 	}
 
-	if (si->is_empty)
-		ubi_msg("empty MTD device detected");
-
 	/*
 	 * In case of unknown erase counter we use the mean erase counter
 	 * value.
@@ -934,23 +1003,44 @@ struct ubi_scan_info *ubi_scan(struct ubi_device *ubi)
 	list_for_each_entry(seb, &si->erase, u.list)
 		if (seb->ec == UBI_SCAN_UNKNOWN_EC)
 			seb->ec = si->mean_ec;
+}
+
+/**
+ * ubi_scan - scan an MTD device.
+ * @ubi: UBI device description object
+ *
+ * This function does full scanning of an MTD device and returns complete
+ * information about it. In case of failure, an error code is returned.
+ */
+struct ubi_scan_info *ubi_scan(struct ubi_device *ubi)
+{
+	int err;
+	struct ubi_scan_info *si;
+
+	si = ubi_scan_alloc_si();
+	if (!si)
+		return ERR_PTR(-ENOMEM);
+
+	err = ubi_scan_pebs(ubi, si, NULL, ubi->peb_count);
+	if (err)
+		goto out_si;
+
+	dbg_msg("scanning is finished");
+
+	if (si->is_empty)
+		ubi_msg("empty MTD device detected");
+
+	ubi_scan_finish(si);
 
 	err = paranoid_check_si(ubi, si);
 	if (err) {
 		if (err > 0)
 			err = -EINVAL;
-		goto out_vidh;
+		goto out_si;
 	}
 
-	ubi_free_vid_hdr(ubi, vidh);
-	kfree(ech);
-
 	return si;
 
-out_vidh:
-	ubi_free_vid_hdr(ubi, vidh);
-out_ech:
-	kfree(ech);
 out_si:
 	ubi_scan_destroy_si(si);
 	return ERR_PTR(err);
@@ -1015,6 +1105,14 @@ void ubi_scan_destroy_si(struct ubi_scan_info *si)
 		list_del(&seb->u.list);
 		kfree(seb);
 	}
+	list_for_each_entry_safe(seb, seb_tmp, &si->fm, u.list) {
+		list_del(&seb->u.list);
+		kfree(seb);
+	}
+	list_for_each_entry_safe(seb, seb_tmp, &si->fm_pool, u.list) {
+		list_del(&seb->u.list);
+		kfree(seb);
+	}
 
 	/* Destroy the volume RB-tree */
 	rb = si->volumes.rb_node;
@@ -91,6 +91,9 @@ struct ubi_scan_volume {
  * @erase: list of physical eraseblocks which have to be erased
  * @alien: list of physical eraseblocks which should not be used by UBI (e.g.,
  *         those belonging to "preserve"-compatible internal volumes)
+ * @fm: physical eraseblocks of the fastmap the information was built from,
+ *      the anchor first
+ * @fm_pool: free physical eraseblocks of the pool of that fastmap
  * @bad_peb_count: count of bad physical eraseblocks
  * @vols_found: number of volumes found during scanning
  * @highest_vol_id: highest volume ID
@@ -113,6 +116,8 @@ struct ubi_scan_info {
 	struct list_head free;
 	struct list_head erase;
 	struct list_head alien;
+	struct list_head fm;
+	struct list_head fm_pool;
 	int bad_peb_count;
 	int vols_found;
 	int highest_vol_id;
@@ -156,6 +161,10 @@ struct ubi_scan_leb *ubi_scan_get_free_peb(struct ubi_device *ubi,
 					   struct ubi_scan_info *si);
 int ubi_scan_erase_peb(struct ubi_device *ubi, const struct ubi_scan_info *si,
 		       int pnum, int ec);
+struct ubi_scan_info *ubi_scan_alloc_si(void);
+int ubi_scan_pebs(struct ubi_device *ubi, struct ubi_scan_info *si,
+		  const int *pnums, int count);
+void ubi_scan_finish(struct ubi_scan_info *si);
 struct ubi_scan_info *ubi_scan(struct ubi_device *ubi);
 void ubi_scan_destroy_si(struct ubi_scan_info *si);
 
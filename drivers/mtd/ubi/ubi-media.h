@@ -302,6 +302,15 @@ struct ubi_vid_hdr {
 #define UBI_LAYOUT_VOLUME_NAME   "layout volume"
 #define UBI_LAYOUT_VOLUME_COMPAT UBI_COMPAT_REJECT
 
+/*
+ * The fastmap volume holds a checkpoint of the erase counters and the EBA
+ * tables, see 'struct ubi_fm_sb'. It is not counted in %UBI_INT_VOL_COUNT:
+ * it has no volume table record, its eraseblocks are managed by the fastmap
+ * code directly. Older UBI binaries delete it.
+ */
+#define UBI_FM_VOLUME_ID         (UBI_INTERNAL_VOL_START + 1)
+#define UBI_FM_VOLUME_COMPAT     UBI_COMPAT_DELETE
+
 /* The maximum number of volumes per one UBI device */
 #define UBI_MAX_VOLUMES 128
 
@@ -365,4 +374,116 @@ struct ubi_vtbl_record {
 	__be32  crc;
 } __attribute__ ((packed));
 
+/* Fastmap super block magic number (ASCII "UBIF") */
+#define UBI_FM_SB_MAGIC 0x55424946
+
+/* The version of the fastmap format */
+#define UBI_FM_FMT_VERSION 1
+
+/* The fastmap anchor has to be in one of the first %UBI_FM_MAX_START PEBs */
+#define UBI_FM_MAX_START 64
+
+/* Maximum number of PEBs a fastmap may take */
+#define UBI_FM_MAX_BLOCKS 32
+
+/* Maximum size of the fastmap pool */
+#define UBI_FM_MAX_POOL_SIZE 256
+
+/*
+ * Special values of the @vol_id field of &struct ubi_fm_peb which describe
+ * physical eraseblocks not mapped to any logical eraseblock.
+ *
+ * UBI_FM_PEB_FREE: free, contains only the EC header
+ * UBI_FM_PEB_ERASE: has to be erased
+ * UBI_FM_PEB_BAD: bad physical eraseblock
+ * UBI_FM_PEB_POOL: belongs to the pool, has to be scanned on attach
+ * UBI_FM_PEB_FM: holds the fastmap itself
+ */
+#define UBI_FM_PEB_FREE  0xFFFFFFFFU
+#define UBI_FM_PEB_ERASE 0xFFFFFFFEU
+#define UBI_FM_PEB_BAD   0xFFFFFFFDU
+#define UBI_FM_PEB_POOL  0xFFFFFFFCU
+#define UBI_FM_PEB_FM    0xFFFFFFFBU
+
+/* Size of the fastmap super block without the ending CRC */
+#define UBI_FM_SB_SIZE_CRC (sizeof(struct ubi_fm_sb) - sizeof(__be32))
+
+/**
+ * struct ubi_fm_sb - fastmap super block.
+ * @magic: fastmap super block magic number (%UBI_FM_SB_MAGIC)
+ * @version: format version of this fastmap (%UBI_FM_FMT_VERSION)
+ * @padding1: reserved for future, zeroes
+ * @data_size: how many bytes of records follow the super block
+ * @data_crc: CRC32 checksum of the records
+ * @peb_count: count of physical eraseblocks on the device
+ * @vol_count: count of &struct ubi_fm_vol records
+ * @pool_size: count of pool physical eraseblocks
+ * @block_count: count of physical eraseblocks the fastmap takes
+ * @block_pnum: physical eraseblocks the fastmap takes, the anchor first
+ * @sqnum: global sequence number at the time the fastmap was written
+ * @padding2: reserved for future, zeroes
+ * @hdr_crc: super block CRC checksum
+ *
+ * The fastmap is written to the logical eraseblocks of the fastmap volume
+ * (%UBI_FM_VOLUME_ID), one physical eraseblock per LEB, and its data is the
+ * super block, followed by @peb_count &struct ubi_fm_peb records, one per
+ * physical eraseblock, and @vol_count &struct ubi_fm_vol records.
+ *
+ * LEB 0 of the fastmap volume, the anchor, is always written last and to
+ * one of the first %UBI_FM_MAX_START physical eraseblocks, so that attaching
+ * only has to look at those to find it. The fastmap describes the flash only
+ * as long as no logical eraseblock is re-mapped: before that happens the
+ * anchor is erased. Logical eraseblocks may still be mapped to the pool
+ * physical eraseblocks without invalidating the fastmap, which is why these
+ * are scanned when the fastmap is used.
+ */
+struct ubi_fm_sb {
+	__be32  magic;
+	__u8    version;
+	__u8    padding1[3];
+	__be32  data_size;
+	__be32  data_crc;
+	__be32  peb_count;
+	__be32  vol_count;
+	__be32  pool_size;
+	__be32  block_count;
+	__be32  block_pnum[UBI_FM_MAX_BLOCKS];
+	__be64  sqnum;
+	__u8    padding2[20];
+	__be32  hdr_crc;
+} __attribute__ ((packed));
+
+/**
+ * struct ubi_fm_vol - fastmap volume record.
+ * @vol_id: volume ID
+ * @used_ebs: the @used_ebs field of the VID headers of this volume
+ * @data_pad: the @data_pad field of the VID headers of this volume
+ * @last_data_size: the @data_size field of the VID header of the last LEB
+ * @vol_type: the @vol_type field of the VID headers of this volume
+ * @compat: the @compat field of the VID headers of this volume
+ * @padding: reserved for future, zeroes
+ */
+struct ubi_fm_vol {
+	__be32  vol_id;
+	__be32  used_ebs;
+	__be32  data_pad;
+	__be32  last_data_size;
+	__u8    vol_type;
+	__u8    compat;
+	__u8    padding[2];
+} __attribute__ ((packed));
+
+/**
+ * struct ubi_fm_peb - fastmap physical eraseblock record.
+ * @ec: erase counter
+ * @vol_id: volume ID of the logical eraseblock mapped to this PEB, or one of
+ *          the %UBI_FM_PEB_* values
+ * @lnum: logical eraseblock number
+ */
+struct ubi_fm_peb {
+	__be32  ec;
+	__be32  vol_id;
+	__be32  lnum;
+} __attribute__ ((packed));
+
 #endif /* !__UBI_MEDIA_H__ */
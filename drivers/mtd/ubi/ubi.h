@@ -36,6 +36,7 @@
 #include <linux/device.h>
 #include <linux/string.h>
 #include <linux/vmalloc.h>
+#include <linux/workqueue.h>
 #include <linux/mtd/mtd.h>
 #include <linux/mtd/ubi.h>
 
@@ -267,6 +268,29 @@ struct ubi_volume_desc {
 
 struct ubi_wl_entry;
 
+/**
+ * struct ubi_wl_stats - statistics of the UBI background works.
+ * @works_max: highest count of pending works seen
+ * @moves: count of logical eraseblocks moved by wear-leveling
+ * @scrubs: count of logical eraseblocks moved because of bit-flips
+ * @erases: count of physical eraseblocks erased by the erase worker
+ * @erase_us: total time of these erasures (microseconds)
+ * @erase_us_max: longest of these erasures (microseconds)
+ * @deferrals: how many times the background thread deferred its works
+ *             because of foreground I/O
+ * @deferred_ms: total time the works were deferred (milliseconds)
+ */
+struct ubi_wl_stats {
+	int works_max;
+	unsigned long moves;
+	unsigned long scrubs;
+	unsigned long erases;
+	unsigned long long erase_us;
+	unsigned int erase_us_max;
+	unsigned long deferrals;
+	unsigned long deferred_ms;
+};
+
 /**
  * struct ubi_device - UBI device description structure
  * @dev: UBI device object to use the the Linux device model
@@ -326,6 +350,9 @@ struct ubi_wl_entry;
  * @bgt_thread: background thread description object
  * @thread_enabled: if the background thread is enabled
  * @bgt_name: background thread name
+ * @fg_ios: count of foreground LEB reads and writes in progress
+ * @fg_last: time (jiffies) the last foreground LEB read or write ended
+ * @wl_stats: background work statistics, protected by @wl_lock
  *
  * @flash_size: underlying MTD device size (in bytes)
  * @peb_count: count of physical eraseblocks on the MTD device
@@ -356,6 +383,27 @@ struct ubi_wl_entry;
  * @mult_mutex: serializes operations on multiple volumes, like re-nameing
  * @dbg_peb_buf: buffer of PEB size used for debugging
  * @dbg_buf_mutex: proptects @dbg_peb_buf
+ * @dbg_dir: debugfs directory of this device
+ *
+ * @fm_mutex: serializes fastmap writing and invalidation, protects @fm_valid,
+ *            @fm_cnt, @fm and @fm_last_change
+ * @fm_busy: count of logical eraseblock changes in progress, the fastmap is
+ *           not written while it is not zero
+ * @fm_disabled: if the fastmap is not used on this device
+ * @fm_valid: if the on-flash fastmap describes the device
+ * @fm_blocks: how many physical eraseblocks a fastmap takes
+ * @fm_cnt: how many physical eraseblocks the current fastmap takes
+ * @fm: physical eraseblocks of the current fastmap, the anchor first
+ * @fm_anchor: erased physical eraseblock kept to write the next anchor to
+ * @fm_pool: physical eraseblocks handed out while the fastmap is valid
+ * @fm_pool_size: count of physical eraseblocks in @fm_pool
+ * @fm_pool_used: how many of them were already handed out
+ * @fm_pool_max: maximum size of the pool
+ * @fm_last_change: time (jiffies) of the last logical eraseblock change
+ * @fm_work: writes the fastmap once the device has been idle for a while
+ *
+ * @fm_anchor, @fm_pool, @fm_pool_size and @fm_pool_used are protected by
+ * @wl_lock.
  */
 struct ubi_device {
 	struct cdev cdev;
@@ -410,6 +458,9 @@ struct ubi_device {
 	struct task_struct *bgt_thread;
 	int thread_enabled;
 	char bgt_name[sizeof(UBI_BGT_NAME_PATTERN)+2];
+	atomic_t fg_ios;
+	unsigned long fg_last;
+	struct ubi_wl_stats wl_stats;
 
 	/* I/O sub-system's stuff */
 	long long flash_size;
@@ -439,6 +490,26 @@ struct ubi_device {
 	void *dbg_peb_buf;
 	struct mutex dbg_buf_mutex;
 #endif
+#ifdef CONFIG_DEBUG_FS
+	struct dentry *dbg_dir;
+#endif
+
+#ifdef CONFIG_MTD_UBI_FASTMAP
+	struct mutex fm_mutex;
+	atomic_t fm_busy;
+	int fm_disabled;
+	int fm_valid;
+	int fm_blocks;
+	int fm_cnt;
+	struct ubi_wl_entry *fm[UBI_FM_MAX_BLOCKS];
+	struct ubi_wl_entry *fm_anchor;
+	struct ubi_wl_entry *fm_pool[UBI_FM_MAX_POOL_SIZE];
+	int fm_pool_size;
+	int fm_pool_used;
+	int fm_pool_max;
+	unsigned long fm_last_change;
+	struct delayed_work fm_work;
+#endif
 };
 
 extern struct kmem_cache *ubi_wl_entry_slab;
@@ -447,6 +518,9 @@ extern struct file_operations ubi_cdev_operations;
 extern struct file_operations ubi_vol_cdev_operations;
 extern struct class *ubi_class;
 extern struct mutex ubi_devices_mutex;
+#ifdef CONFIG_DEBUG_FS
+extern struct dentry *ubi_debugfs_root;
+#endif
 
 /* vtbl.c */
 int ubi_change_vtbl_record(struct ubi_device *ubi, int idx,
@@ -490,7 +564,29 @@ void ubi_gluebi_updated(struct ubi_volume *vol);
 #define ubi_gluebi_updated(vol)
 #endif
 
+/* fastmap.c */
+#ifdef CONFIG_MTD_UBI_FASTMAP
+void ubi_fastmap_init(struct ubi_device *ubi);
+void ubi_fastmap_close(struct ubi_device *ubi);
+struct ubi_scan_info *ubi_scan_fastmap(struct ubi_device *ubi);
+int ubi_update_fastmap(struct ubi_device *ubi);
+int ubi_fastmap_invalidate(struct ubi_device *ubi);
+void ubi_fastmap_schedule(struct ubi_device *ubi);
+void ubi_fastmap_start_change(struct ubi_device *ubi);
+void ubi_fastmap_end_change(struct ubi_device *ubi);
+#else
+#define ubi_fastmap_init(ubi)
+#define ubi_fastmap_close(ubi)
+#define ubi_scan_fastmap(ubi) NULL
+#define ubi_update_fastmap(ubi) 0
+#define ubi_fastmap_invalidate(ubi) 0
+#define ubi_fastmap_schedule(ubi)
+#define ubi_fastmap_start_change(ubi)
+#define ubi_fastmap_end_change(ubi)
+#endif
+
 /* eba.c */
+unsigned long long ubi_next_sqnum(struct ubi_device *ubi);
 int ubi_eba_unmap_leb(struct ubi_device *ubi, struct ubi_volume *vol,
 		      int lnum);
 int ubi_eba_read_leb(struct ubi_device *ubi, struct ubi_volume *vol, int lnum,
@@ -514,6 +610,22 @@ int ubi_wl_scrub_peb(struct ubi_device *ubi, int pnum);
 int ubi_wl_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si);
 void ubi_wl_close(struct ubi_device *ubi);
 int ubi_thread(void *u);
+void ubi_wl_fg_start(struct ubi_device *ubi);
+void ubi_wl_fg_end(struct ubi_device *ubi);
+#ifdef CONFIG_DEBUG_FS
+void ubi_wl_debugfs_init(struct ubi_device *ubi);
+void ubi_wl_debugfs_exit(struct ubi_device *ubi);
+#else
+#define ubi_wl_debugfs_init(ubi)
+#define ubi_wl_debugfs_exit(ubi)
+#endif
+#ifdef CONFIG_MTD_UBI_FASTMAP
+struct ubi_wl_entry *ubi_wl_get_fm_peb(struct ubi_device *ubi, int anchor);
+int ubi_wl_put_fm_peb(struct ubi_device *ubi, struct ubi_wl_entry *e,
+		      int anchor);
+void ubi_wl_fill_pool(struct ubi_device *ubi);
+void ubi_wl_return_pool(struct ubi_device *ubi);
+#endif
 
 /* io.c */
 int ubi_io_read(const struct ubi_device *ubi, void *buf, int pnum, int offset,
@@ -79,6 +79,11 @@
 #include <linux/crc32.h>
 #include <linux/freezer.h>
 #include <linux/kthread.h>
+#include <linux/ioprio.h>
+#include <linux/iocontext.h>
+#include <linux/moduleparam.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include "ubi.h"
 
 /* Number of physical eraseblocks reserved for wear-leveling purposes */
@@ -119,6 +124,20 @@
  */
 #define WL_MAX_FAILURES 32
 
+/*
+ * The background thread defers its works while there is foreground I/O (see
+ * 'bgt_defer()'), but stops deferring them when this many works are pending,
+ * or when it has been deferring them for %WL_DEFER_MAX_MS milliseconds.
+ */
+#define WL_DEFER_MAX_WORKS 32
+#define WL_DEFER_MAX_MS 2000
+
+static int bgt_idle_ms = 20;
+module_param(bgt_idle_ms, int, 0644);
+MODULE_PARM_DESC(bgt_idle_ms, "background wear-leveling and erasure wait "
+			      "until there was no foreground I/O for this "
+			      "many milliseconds, 0 to not wait (default 20)");
+
 /**
  * struct ubi_wl_prot_entry - PEB protection entry.
  * @rb_pnum: link in the @wl->prot.pnum RB-tree
@@ -433,6 +452,28 @@ static struct ubi_wl_entry *find_wl_entry(struct rb_root *root, int max)
 	return e;
 }
 
+#ifdef CONFIG_MTD_UBI_FASTMAP
+/**
+ * fm_pool_get - get a physical eraseblock from the fastmap pool.
+ * @ubi: UBI device description object
+ *
+ * While the fastmap is valid, physical eraseblocks are handed out only from
+ * the pool, because the fastmap tells to scan these on attach. This function
+ * returns %NULL if the pool is empty. @ubi->wl_lock has to be locked.
+ */
+static struct ubi_wl_entry *fm_pool_get(struct ubi_device *ubi)
+{
+	if (ubi->fm_pool_used == ubi->fm_pool_size)
+		return NULL;
+	return ubi->fm_pool[ubi->fm_pool_used++];
+}
+
+#define fm_valid(ubi) ((ubi)->fm_valid)
+#else
+#define fm_pool_get(ubi) NULL
+#define fm_valid(ubi) 0
+#endif
+
 /**
  * ubi_wl_get_peb - get a physical eraseblock.
  * @ubi: UBI device description object
@@ -456,6 +497,26 @@ int ubi_wl_get_peb(struct ubi_device *ubi, int dtype)
 
 retry:
 	spin_lock(&ubi->wl_lock);
+	e = fm_pool_get(ubi);
+	if (e) {
+		protect = U_PROTECTION;
+		goto protect;
+	}
+
+	if (fm_valid(ubi)) {
+		/*
+		 * The pool is used up. Any other physical eraseblock may be
+		 * handed out only after the fastmap has been invalidated.
+		 */
+		spin_unlock(&ubi->wl_lock);
+		err = ubi_fastmap_invalidate(ubi);
+		if (err) {
+			kfree(pe);
+			return err;
+		}
+		goto retry;
+	}
+
 	if (!ubi->free.rb_node) {
 		if (ubi->works_count == 0) {
 			ubi_assert(list_empty(&ubi->works));
@@ -524,6 +585,7 @@ retry:
 	 */
 	paranoid_check_in_wl_tree(e, &ubi->free);
 	rb_erase(&e->rb, &ubi->free);
+protect:
 	prot_tree_add(ubi, e, pe, protect);
 
 	dbg_wl("PEB %d EC %d, protection %d", e->pnum, e->ec, protect);
@@ -689,6 +751,8 @@ static void schedule_ubi_work(struct ubi_device *ubi, struct ubi_work *wrk)
 	list_add_tail(&wrk->list, &ubi->works);
 	ubi_assert(ubi->works_count >= 0);
 	ubi->works_count += 1;
+	if (ubi->works_count > ubi->wl_stats.works_max)
+		ubi->wl_stats.works_max = ubi->works_count;
 	if (ubi->thread_enabled)
 		wake_up_process(ubi->bgt_thread);
 	spin_unlock(&ubi->wl_lock);
@@ -873,6 +937,12 @@ static int wear_leveling_worker(struct ubi_device *ubi, struct ubi_work *wrk,
 			e1->pnum, e2->pnum);
 
 	spin_lock(&ubi->wl_lock);
+	if (!protect) {
+		if (scrubbing)
+			ubi->wl_stats.scrubs += 1;
+		else
+			ubi->wl_stats.moves += 1;
+	}
 	if (protect)
 		prot_tree_add(ubi, e1, pe, protect);
 	if (!ubi->move_to_put)
@@ -1034,6 +1104,8 @@ static int erase_worker(struct ubi_device *ubi, struct ubi_work *wl_wrk,
 {
 	struct ubi_wl_entry *e = wl_wrk->e;
 	int pnum = e->pnum, err, need;
+	unsigned int us;
+	ktime_t start;
 
 	if (cancel) {
 		dbg_wl("cancel erasure of PEB %d EC %d", pnum, e->ec);
@@ -1044,14 +1116,20 @@ static int erase_worker(struct ubi_device *ubi, struct ubi_work *wl_wrk,
 
 	dbg_wl("erase PEB %d EC %d", pnum, e->ec);
 
+	start = ktime_get();
 	err = sync_erase(ubi, e, wl_wrk->torture);
 	if (!err) {
 		/* Fine, we've erased it successfully */
 		kfree(wl_wrk);
+		us = ktime_us_delta(ktime_get(), start);
 
 		spin_lock(&ubi->wl_lock);
 		ubi->abs_ec += 1;
 		wl_tree_add(e, &ubi->free);
+		ubi->wl_stats.erases += 1;
+		ubi->wl_stats.erase_us += us;
+		if (us > ubi->wl_stats.erase_us_max)
+			ubi->wl_stats.erase_us_max = us;
 		spin_unlock(&ubi->wl_lock);
 
 		/*
@@ -1067,7 +1145,6 @@ static int erase_worker(struct ubi_device *ubi, struct ubi_work *wl_wrk,
 
 	ubi_err("failed to erase PEB %d, error %d", pnum, err);
 	kfree(wl_wrk);
-	kmem_cache_free(ubi_wl_entry_slab, e);
 
 	if (err == -EINTR || err == -ENOMEM || err == -EAGAIN ||
 	    err == -EBUSY) {
@@ -1075,12 +1152,18 @@ static int erase_worker(struct ubi_device *ubi, struct ubi_work *wl_wrk,
 
 		/* Re-schedule the LEB for erasure */
 		err1 = schedule_erase(ubi, e, 0);
-		if (err1) {
-			err = err1;
-			goto out_ro;
-		}
-		return err;
-	} else if (err != -EIO) {
+		if (!err1)
+			return err;
+		err = err1;
+	}
+
+	/* The PEB is not going to be used any longer, forget about it */
+	spin_lock(&ubi->wl_lock);
+	ubi->lookuptbl[pnum] = NULL;
+	spin_unlock(&ubi->wl_lock);
+	kmem_cache_free(ubi_wl_entry_slab, e);
+
+	if (err != -EIO) {
 		/*
 		 * If this is not %-EIO, we have no idea what to do. Scheduling
 		 * this physical eraseblock for erasure again would cause
@@ -1156,6 +1239,11 @@ int ubi_wl_put_peb(struct ubi_device *ubi, int pnum, int torture)
 	ubi_assert(pnum >= 0);
 	ubi_assert(pnum < ubi->peb_count);
 
+	/* The fastmap would still describe the PEB as mapped */
+	err = ubi_fastmap_invalidate(ubi);
+	if (err)
+		return err;
+
 retry:
 	spin_lock(&ubi->wl_lock);
 	e = ubi->lookuptbl[pnum];
@@ -1278,6 +1366,231 @@ retry:
 	return ensure_wear_leveling(ubi);
 }
 
+#ifdef CONFIG_MTD_UBI_FASTMAP
+/**
+ * ubi_wl_get_fm_peb - get a physical eraseblock to write the fastmap to.
+ * @ubi: UBI device description object
+ * @anchor: if the PEB is for the fastmap anchor
+ *
+ * This function takes the free physical eraseblock with the lowest erase
+ * counter. The anchor has to be one of the first %UBI_FM_MAX_START PEBs, and
+ * the erased anchor of the previous fastmap is used for it, unless a free PEB
+ * there has lower erase counter. Returns %NULL if there is no suitable PEB.
+ */
+struct ubi_wl_entry *ubi_wl_get_fm_peb(struct ubi_device *ubi, int anchor)
+{
+	struct rb_node *p;
+	struct ubi_wl_entry *e = NULL;
+
+	spin_lock(&ubi->wl_lock);
+	for (p = rb_first(&ubi->free); p; p = rb_next(p)) {
+		e = rb_entry(p, struct ubi_wl_entry, rb);
+		if (!anchor || e->pnum < UBI_FM_MAX_START)
+			break;
+	}
+	if (!p)
+		e = NULL;
+
+	if (anchor && ubi->fm_anchor) {
+		if (!e || e->ec >= ubi->fm_anchor->ec) {
+			e = ubi->fm_anchor;
+			ubi->fm_anchor = NULL;
+			goto out_unlock;
+		}
+		wl_tree_add(ubi->fm_anchor, &ubi->free);
+		ubi->fm_anchor = NULL;
+	}
+
+	if (e) {
+		paranoid_check_in_wl_tree(e, &ubi->free);
+		rb_erase(&e->rb, &ubi->free);
+	}
+out_unlock:
+	spin_unlock(&ubi->wl_lock);
+	return e;
+}
+
+/**
+ * ubi_wl_put_fm_peb - return a physical eraseblock of the fastmap.
+ * @ubi: UBI device description object
+ * @e: the physical eraseblock to return
+ * @anchor: if this is the fastmap anchor
+ *
+ * The anchor is erased synchronously, so that the fastmap is gone when this
+ * function returns, and is kept to write the next anchor to. The other
+ * fastmap PEBs are scheduled for erasure. Returns zero in case of success and
+ * a negative error code in case of failure.
+ */
+int ubi_wl_put_fm_peb(struct ubi_device *ubi, struct ubi_wl_entry *e,
+		      int anchor)
+{
+	int err;
+
+	if (!anchor)
+		return schedule_erase(ubi, e, 0);
+
+	err = sync_erase(ubi, e, 0);
+	if (err) {
+		ubi_err("cannot erase fastmap anchor PEB %d, error %d",
+			e->pnum, err);
+		return err;
+	}
+
+	spin_lock(&ubi->wl_lock);
+	if (ubi->fm_anchor)
+		wl_tree_add(e, &ubi->free);
+	else
+		ubi->fm_anchor = e;
+	spin_unlock(&ubi->wl_lock);
+	return 0;
+}
+
+/**
+ * ubi_wl_fill_pool - fill the fastmap pool.
+ * @ubi: UBI device description object
+ *
+ * This function moves up to @ubi->fm_pool_max free physical eraseblocks to
+ * the fastmap pool, but not more than a half of them, so that the WL worker
+ * still has PEBs to move data to.
+ */
+void ubi_wl_fill_pool(struct ubi_device *ubi)
+{
+	int count = 0;
+	struct rb_node *p;
+	struct ubi_wl_entry *e;
+
+	spin_lock(&ubi->wl_lock);
+	ubi_assert(ubi->fm_pool_used == ubi->fm_pool_size);
+	for (p = rb_first(&ubi->free); p; p = rb_next(p))
+		count += 1;
+
+	ubi->fm_pool_size = ubi->fm_pool_used = 0;
+	while (ubi->fm_pool_size < ubi->fm_pool_max &&
+	       ubi->fm_pool_size < count / 2) {
+		/* The same choice as for data of unknown type */
+		e = find_wl_entry(&ubi->free, WL_FREE_MAX_DIFF / 2);
+		rb_erase(&e->rb, &ubi->free);
+		ubi->fm_pool[ubi->fm_pool_size++] = e;
+	}
+	spin_unlock(&ubi->wl_lock);
+}
+
+/**
+ * ubi_wl_return_pool - return the unused fastmap pool PEBs.
+ * @ubi: UBI device description object
+ */
+void ubi_wl_return_pool(struct ubi_device *ubi)
+{
+	spin_lock(&ubi->wl_lock);
+	while (ubi->fm_pool_used < ubi->fm_pool_size)
+		wl_tree_add(ubi->fm_pool[ubi->fm_pool_used++], &ubi->free);
+	ubi->fm_pool_size = ubi->fm_pool_used = 0;
+	spin_unlock(&ubi->wl_lock);
+}
+
+/**
+ * fm_init_scan - initialize the fastmap part of the WL sub-system.
+ * @ubi: UBI device description object
+ * @si: scanning information
+ *
+ * If @si was built from a fastmap, that fastmap stays valid and its pool is
+ * used until something changes. This function also reserves the PEBs for the
+ * fastmap. Returns zero in case of success and a negative error code in case
+ * of failure.
+ */
+static int fm_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si)
+{
+	int err, anchor = 1;
+	struct ubi_scan_leb *seb;
+	struct ubi_wl_entry *e;
+
+	if (!ubi->fm_disabled && si->alien_peb_count) {
+		/* The fastmap has no way to describe them */
+		ubi_warn("alien PEBs found, fastmap disabled");
+		ubi->fm_disabled = 1;
+	}
+
+	/* Leave a PEB for the EBA sub-system, which reserves after us */
+	if (!ubi->fm_disabled && ubi->avail_pebs < ubi->fm_blocks + 1) {
+		ubi_warn("no enough PEBs for the fastmap (%d, need %d), "
+			 "fastmap disabled", ubi->avail_pebs,
+			 ubi->fm_blocks + 1);
+		ubi->fm_disabled = 1;
+	}
+
+	if (!ubi->fm_disabled) {
+		ubi->avail_pebs -= ubi->fm_blocks;
+		ubi->rsvd_pebs += ubi->fm_blocks;
+	}
+
+	list_for_each_entry(seb, &si->fm, u.list) {
+		e = kmem_cache_alloc(ubi_wl_entry_slab, GFP_KERNEL);
+		if (!e)
+			return -ENOMEM;
+
+		e->pnum = seb->pnum;
+		e->ec = seb->ec;
+		ubi->lookuptbl[e->pnum] = e;
+		if (!ubi->fm_disabled) {
+			ubi->fm[ubi->fm_cnt++] = e;
+			continue;
+		}
+
+		/* Drop the fastmap, the anchor has to be gone right away */
+		if (anchor) {
+			anchor = 0;
+			err = sync_erase(ubi, e, 0);
+			if (!err)
+				wl_tree_add(e, &ubi->free);
+		} else
+			err = schedule_erase(ubi, e, 0);
+		if (err) {
+			ubi->lookuptbl[e->pnum] = NULL;
+			kmem_cache_free(ubi_wl_entry_slab, e);
+			return err;
+		}
+	}
+	ubi->fm_valid = !!ubi->fm_cnt;
+
+	list_for_each_entry(seb, &si->fm_pool, u.list) {
+		e = kmem_cache_alloc(ubi_wl_entry_slab, GFP_KERNEL);
+		if (!e)
+			return -ENOMEM;
+
+		e->pnum = seb->pnum;
+		e->ec = seb->ec;
+		ubi->lookuptbl[e->pnum] = e;
+		if (ubi->fm_valid)
+			ubi->fm_pool[ubi->fm_pool_size++] = e;
+		else
+			wl_tree_add(e, &ubi->free);
+	}
+
+	return 0;
+}
+
+/**
+ * fm_destroy - free the fastmap PEBs which are not in any RB-tree.
+ * @ubi: UBI device description object
+ */
+static void fm_destroy(struct ubi_device *ubi)
+{
+	int i;
+
+	for (i = 0; i < ubi->fm_cnt; i++)
+		kmem_cache_free(ubi_wl_entry_slab, ubi->fm[i]);
+	for (i = ubi->fm_pool_used; i < ubi->fm_pool_size; i++)
+		kmem_cache_free(ubi_wl_entry_slab, ubi->fm_pool[i]);
+	if (ubi->fm_anchor)
+		kmem_cache_free(ubi_wl_entry_slab, ubi->fm_anchor);
+	ubi->fm_cnt = ubi->fm_pool_size = ubi->fm_pool_used = 0;
+	ubi->fm_anchor = NULL;
+}
+#else
+#define fm_init_scan(ubi, si) 0
+#define fm_destroy(ubi)
+#endif
+
 /**
  * ubi_wl_flush - flush all pending works.
  * @ubi: UBI device description object
@@ -1352,13 +1665,79 @@ static void tree_destroy(struct rb_root *root)
 	}
 }
 
+/**
+ * current_io_class - get the I/O scheduling class of the current task.
+ */
+static int current_io_class(void)
+{
+	struct io_context *ioc = current->io_context;
+
+	if (ioc && ioprio_valid(ioc->ioprio))
+		return IOPRIO_PRIO_CLASS(ioc->ioprio);
+	return task_nice_ioclass(current);
+}
+
+/**
+ * ubi_wl_fg_start - note that a foreground LEB read or write starts.
+ * @ubi: UBI device description object
+ */
+void ubi_wl_fg_start(struct ubi_device *ubi)
+{
+	atomic_inc(&ubi->fg_ios);
+}
+
+/**
+ * ubi_wl_fg_end - note that a foreground LEB read or write ended.
+ * @ubi: UBI device description object
+ *
+ * I/O of tasks in the idle I/O scheduling class does not hold back the
+ * background thread once it is done: nobody is waiting for it.
+ */
+void ubi_wl_fg_end(struct ubi_device *ubi)
+{
+	if (current_io_class() != IOPRIO_CLASS_IDLE)
+		ubi->fg_last = jiffies;
+	atomic_dec(&ubi->fg_ios);
+}
+
+/**
+ * bgt_defer - check if the background thread should defer its works.
+ * @ubi: UBI device description object
+ *
+ * Wear-leveling moves and erasures compete with foreground I/O for the flash
+ * chip, and a PEB copy in the middle of a burst of writes shows up as a long
+ * write stall. So the background thread waits until there has been no
+ * foreground I/O for @bgt_idle_ms, and then does all the works which piled up
+ * in one go. Foreground tasks which run out of free PEBs do not wait for it,
+ * they do the pending works themselves, see 'produce_free_peb()'.
+ *
+ * This function returns how long to wait (jiffies), or zero if the works
+ * should be done now. @ubi->wl_lock has to be locked.
+ */
+static long bgt_defer(struct ubi_device *ubi)
+{
+	unsigned long idle_at;
+
+	if (bgt_idle_ms <= 0 || ubi->works_count >= WL_DEFER_MAX_WORKS)
+		return 0;
+
+	if (atomic_read(&ubi->fg_ios))
+		return msecs_to_jiffies(bgt_idle_ms);
+
+	idle_at = ubi->fg_last + msecs_to_jiffies(bgt_idle_ms);
+	if (time_before(jiffies, idle_at))
+		return idle_at - jiffies;
+	return 0;
+}
+
 /**
  * ubi_thread - UBI background thread.
  * @u: the UBI device description object pointer
  */
 int ubi_thread(void *u)
 {
-	int failures = 0;
+	int failures = 0, deferring = 0;
+	unsigned long defer_start = 0;
 	struct ubi_device *ubi = u;
 
 	ubi_msg("background thread \"%s\" started, PID %d",
@@ -1367,6 +1746,7 @@ int ubi_thread(void *u)
 	set_freezable();
 	for (;;) {
 		int err;
+		long delay;
 
 		if (kthread_should_stop())
 			break;
@@ -1382,6 +1762,28 @@ int ubi_thread(void *u)
 			schedule();
 			continue;
 		}
+
+		delay = bgt_defer(ubi);
+		if (delay) {
+			if (!deferring) {
+				deferring = 1;
+				defer_start = jiffies;
+				ubi->wl_stats.deferrals += 1;
+			} else if (time_after_eq(jiffies, defer_start +
+					msecs_to_jiffies(WL_DEFER_MAX_MS)))
+				delay = 0;
+		}
+		if (delay) {
+			set_current_state(TASK_INTERRUPTIBLE);
+			spin_unlock(&ubi->wl_lock);
+			schedule_timeout(delay);
+			continue;
+		}
+		if (deferring) {
+			deferring = 0;
+			ubi->wl_stats.deferred_ms +=
+				jiffies_to_msecs(jiffies - defer_start);
+		}
 		spin_unlock(&ubi->wl_lock);
 
 		err = do_work(ubi);
@@ -1447,6 +1849,7 @@ int ubi_wl_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si)
 	spin_lock_init(&ubi->wl_lock);
 	mutex_init(&ubi->move_mutex);
 	init_rwsem(&ubi->work_sem);
+	ubi->fg_last = jiffies;
 	ubi->max_ec = si->max_ec;
 	INIT_LIST_HEAD(&ubi->works);
 
@@ -1534,6 +1937,10 @@ int ubi_wl_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si)
 	ubi->avail_pebs -= WL_RESERVED_PEBS;
 	ubi->rsvd_pebs += WL_RESERVED_PEBS;
 
+	err = fm_init_scan(ubi, si);
+	if (err)
+		goto out_free;
+
 	/* Schedule wear-leveling if needed */
 	err = ensure_wear_leveling(ubi);
 	if (err)
@@ -1543,6 +1950,7 @@ int ubi_wl_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si)
 
 out_free:
 	cancel_pending(ubi);
+	fm_destroy(ubi);
 	tree_destroy(&ubi->used);
 	tree_destroy(&ubi->free);
 	tree_destroy(&ubi->scrub);
@@ -1590,6 +1998,7 @@ void ubi_wl_close(struct ubi_device *ubi)
 {
 	dbg_wl("close the WL sub-system");
 	cancel_pending(ubi);
+	fm_destroy(ubi);
 	protection_trees_destroy(ubi);
 	tree_destroy(&ubi->used);
 	tree_destroy(&ubi->free);
@@ -1597,6 +2006,78 @@ void ubi_wl_close(struct ubi_device *ubi)
 	kfree(ubi->lookuptbl);
 }
 
+#ifdef CONFIG_DEBUG_FS
+
+static int wl_stats_show(struct seq_file *m, void *v)
+{
+	struct ubi_device *ubi = m->private;
+	struct ubi_wl_stats st;
+	unsigned long long avg;
+	int works;
+
+	spin_lock(&ubi->wl_lock);
+	st = ubi->wl_stats;
+	works = ubi->works_count;
+	spin_unlock(&ubi->wl_lock);
+
+	avg = st.erase_us;
+	if (st.erases)
+		do_div(avg, st.erases);
+
+	seq_printf(m, "pending works:         %d\n", works);
+	seq_printf(m, "max. pending works:    %d\n", st.works_max);
+	seq_printf(m, "wear-leveling moves:   %lu\n", st.moves);
+	seq_printf(m, "scrubbing moves:       %lu\n", st.scrubs);
+	seq_printf(m, "erasures:              %lu\n", st.erases);
+	seq_printf(m, "avg/max erase time:    %llu/%u us\n", avg,
+		   st.erase_us_max);
+	seq_printf(m, "deferrals:             %lu\n", st.deferrals);
+	seq_printf(m, "deferred for:          %lu ms\n", st.deferred_ms);
+	return 0;
+}
+
+static int wl_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wl_stats_show, inode->i_private);
+}
+
+static const struct file_operations wl_stats_fops = {
+	.owner   = THIS_MODULE,
+	.open    = wl_stats_open,
+	.read    = seq_read,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
+/**
+ * ubi_wl_debugfs_init - create the debugfs files of an UBI device.
+ * @ubi: UBI device description object
+ *
+ * The statistics are in "ubi/ubiX/wl_stats". Failures are ignored.
+ */
+void ubi_wl_debugfs_init(struct ubi_device *ubi)
+{
+	if (!ubi_debugfs_root)
+		return;
+
+	ubi->dbg_dir = debugfs_create_dir(ubi->ubi_name, ubi_debugfs_root);
+	if (ubi->dbg_dir)
+		debugfs_create_file("wl_stats", S_IRUGO, ubi->dbg_dir, ubi,
+				    &wl_stats_fops);
+}
+
+/**
+ * ubi_wl_debugfs_exit - remove the debugfs files of an UBI device.
+ * @ubi: UBI device description object
+ */
+void ubi_wl_debugfs_exit(struct ubi_device *ubi)
+{
+	debugfs_remove_recursive(ubi->dbg_dir);
+	ubi->dbg_dir = NULL;
+}
+
+#endif /* CONFIG_DEBUG_FS */
+
 #ifdef CONFIG_MTD_UBI_DEBUG_PARANOID
 
 /**
@@ -33,6 +33,7 @@
 #include <linux/bitops.h>
 #include <linux/mutex.h>
 #include <linux/anon_inodes.h>
+#include <linux/percpu.h>
 #include <asm/uaccess.h>
 #include <asm/system.h>
 #include <asm/io.h>
@@ -46,8 +47,9 @@
  * 1) epmutex (mutex)
  * 2) ep->mtx (mutex)
  * 3) ep->lock (spinlock)
+ * 4) the per-CPU ready list locks (spinlock)
  *
- * The acquire order is the one listed above, from 1 to 3.
+ * The acquire order is the one listed above, from 1 to 4.
  * We need a spinlock (ep->lock) because we manipulate objects
  * from inside the poll callback, that might be triggered from
  * a wake_up() that in turn might be called from IRQ context.
@@ -69,6 +71,11 @@
  * Events that require holding "epmutex" are very rare, while for
  * normal operations the epoll private "ep->mtx" will guarantee
  * a better scalability.
+ * The poll callback does not take "ep->lock" at all: it queues the item
+ * on a ready list of the CPU it runs on, under that list's own lock, and
+ * only takes "ep->lock" to wake up a task sleeping in epoll_wait(). The
+ * per-CPU lists are spliced onto ep->rdllist, in one go, by whoever looks
+ * at the ready list under "ep->lock" (see ep_collect_ready()).
  */
 
 #define DEBUG_EPOLL 0
@@ -100,10 +107,11 @@
 
 #define EP_MAX_EVENTS (INT_MAX / sizeof(struct epoll_event))
 
-#define EP_UNACTIVE_PTR ((void *) -1L)
-
 #define EP_ITEM_COST (sizeof(struct epitem) + sizeof(struct eppoll_entry))
 
+/* Bit in epitem->state: the item is on a ready list (or a txlist) */
+#define EPI_QUEUED 0
+
 struct epoll_filefd {
 	struct file *file;
 	int fd;
@@ -139,14 +147,15 @@ struct epitem {
 	/* RB tree node used to link this structure to the eventpoll RB tree */
 	struct rb_node rbn;
 
-	/* List header used to link this structure to the eventpoll ready list */
-	struct list_head rdllink;
-
 	/*
-	 * Works together "struct eventpoll"->ovflist in keeping the
-	 * single linked chain of items.
+	 * List header used to link this structure to a per-CPU ready list,
+	 * to the eventpoll ready list or to the transfer list of
+	 * ep_send_events(). It is in use while EPI_QUEUED is set in "state".
 	 */
-	struct epitem *next;
+	struct list_head rdllink;
+
+	/* EPI_QUEUED, changed with atomic bitops only */
+	unsigned long state;
 
 	/* The file descriptor information this item refers to */
 	struct epoll_filefd ffd;
@@ -193,20 +202,22 @@ struct eventpoll {
 	/* List of ready file descriptors */
 	struct list_head rdllist;
 
+	/* Ready items queued by the poll callback, on the CPU it ran on */
+	struct ep_cpu_list *cpu_lists;
+
 	/* RB tree root used to store monitored fd structs */
 	struct rb_root rbr;
 
-	/*
-	 * This is a single linked list that chains all the "struct epitem" that
-	 * happened while transfering ready events to userspace w/out
-	 * holding ->lock.
-	 */
-	struct epitem *ovflist;
-
 	/* The user that created the eventpoll descriptor */
 	struct user_struct *user;
 };
 
+/* Per-CPU ready list, see ep_poll_callback() */
+struct ep_cpu_list {
+	spinlock_t lock;
+	struct list_head list;
+};
+
 /* Wait structure used by the poll hooks */
 struct eppoll_entry {
 	/* List header used to link this structure to the "struct epitem" */
@@ -372,6 +383,56 @@ static void ep_poll_safewake(struct poll_safewake *psw, wait_queue_head_t *wq)
 	spin_unlock_irqrestore(&psw->lock, flags);
 }
 
+/*
+ * Moves the items queued on the per-CPU ready lists onto ep->rdllist.
+ * Must be called with "ep->lock" held and irqs disabled.
+ */
+static void ep_collect_ready(struct eventpoll *ep)
+{
+	int cpu;
+	struct ep_cpu_list *cl;
+
+	for_each_possible_cpu(cpu) {
+		cl = per_cpu_ptr(ep->cpu_lists, cpu);
+		/*
+		 * An item that is being added right now will be followed by
+		 * a wakeup, so it is fine to miss it here.
+		 */
+		if (list_empty(&cl->list))
+			continue;
+		spin_lock(&cl->lock);
+		list_splice_tail_init(&cl->list, &ep->rdllist);
+		spin_unlock(&cl->lock);
+	}
+}
+
+/*
+ * Must be called with "ep->lock" held and irqs disabled.
+ */
+static inline int ep_events_available(struct eventpoll *ep)
+{
+	ep_collect_ready(ep);
+	return !list_empty(&ep->rdllist);
+}
+
+/*
+ * Takes the item off the ready list, if it is queued. Must be called with
+ * "mtx" held, so that the item is not on the txlist of ep_send_events(),
+ * and once no poll callback can hit the item anymore.
+ */
+static void ep_unqueue(struct eventpoll *ep, struct epitem *epi)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&ep->lock, flags);
+	if (test_bit(EPI_QUEUED, &epi->state)) {
+		ep_collect_ready(ep);
+		list_del_init(&epi->rdllink);
+		clear_bit(EPI_QUEUED, &epi->state);
+	}
+	spin_unlock_irqrestore(&ep->lock, flags);
+}
+
 /*
  * This function unregister poll callbacks from the associated file descriptor.
  * Since this must be called without holding "ep->lock" the atomic exchange trick
@@ -403,7 +464,6 @@ static void ep_unregister_pollwait(struct eventpoll *ep, struct epitem *epi)
  */
 static int ep_remove(struct eventpoll *ep, struct epitem *epi)
 {
-	unsigned long flags;
 	struct file *file = epi->ffd.file;
 
 	/*
@@ -424,10 +484,7 @@ static int ep_remove(struct eventpoll *ep, struct epitem *epi)
 
 	rb_erase(&epi->rbn, &ep->rbr);
 
-	spin_lock_irqsave(&ep->lock, flags);
-	if (ep_is_linked(&epi->rdllink))
-		list_del_init(&epi->rdllink);
-	spin_unlock_irqrestore(&ep->lock, flags);
+	ep_unqueue(ep, epi);
 
 	/* At this point it is safe to free the eventpoll item */
 	kmem_cache_free(epi_cache, epi);
@@ -482,6 +539,7 @@ static void ep_free(struct eventpoll *ep)
 	mutex_unlock(&epmutex);
 	mutex_destroy(&ep->mtx);
 	free_uid(ep->user);
+	free_percpu(ep->cpu_lists);
 	kfree(ep);
 }
 
@@ -507,7 +565,7 @@ static unsigned int ep_eventpoll_poll(struct file *file, poll_table *wait)
 
 	/* Check our condition */
 	spin_lock_irqsave(&ep->lock, flags);
-	if (!list_empty(&ep->rdllist))
+	if (ep_events_available(ep))
 		pollflags = POLLIN | POLLRDNORM;
 	spin_unlock_irqrestore(&ep->lock, flags);
 
@@ -565,15 +623,24 @@ void eventpoll_release_file(struct file *file)
 
 static int ep_alloc(struct eventpoll **pep)
 {
-	int error;
+	int error, cpu;
 	struct user_struct *user;
 	struct eventpoll *ep;
+	struct ep_cpu_list *cl;
 
 	user = get_current_user();
 	error = -ENOMEM;
 	ep = kzalloc(sizeof(*ep), GFP_KERNEL);
 	if (unlikely(!ep))
 		goto free_uid;
+	ep->cpu_lists = alloc_percpu(struct ep_cpu_list);
+	if (unlikely(!ep->cpu_lists))
+		goto free_ep;
+	for_each_possible_cpu(cpu) {
+		cl = per_cpu_ptr(ep->cpu_lists, cpu);
+		spin_lock_init(&cl->lock);
+		INIT_LIST_HEAD(&cl->list);
+	}
 
 	spin_lock_init(&ep->lock);
 	mutex_init(&ep->mtx);
@@ -581,7 +648,6 @@ static int ep_alloc(struct eventpoll **pep)
 	init_waitqueue_head(&ep->poll_wait);
 	INIT_LIST_HEAD(&ep->rdllist);
 	ep->rbr = RB_ROOT;
-	ep->ovflist = EP_UNACTIVE_PTR;
 	ep->user = user;
 
 	*pep = ep;
@@ -590,6 +656,8 @@ static int ep_alloc(struct eventpoll **pep)
 		     current, ep));
 	return 0;
 
+free_ep:
+	kfree(ep);
 free_uid:
 	free_uid(user);
 	return error;
@@ -627,6 +695,30 @@ static struct epitem *ep_find(struct eventpoll *ep, struct file *file, int fd)
 	return epir;
 }
 
+/*
+ * Wakes up the tasks in epoll_wait() and the ->poll() waiters of the epoll
+ * file, after items have been queued on a per-CPU ready list. "ep->lock"
+ * is only taken when a task is actually sleeping in epoll_wait(); a busy
+ * event loop mostly finds events already queued and never sleeps.
+ */
+static void ep_wakeup(struct eventpoll *ep)
+{
+	unsigned long flags;
+
+	/*
+	 * Pairs with the sleeper, which adds itself to ep->wq before looking
+	 * at the ready lists.
+	 */
+	smp_mb();
+	if (waitqueue_active(&ep->wq)) {
+		spin_lock_irqsave(&ep->lock, flags);
+		wake_up_locked(&ep->wq);
+		spin_unlock_irqrestore(&ep->lock, flags);
+	}
+	if (waitqueue_active(&ep->poll_wait))
+		ep_poll_safewake(&psw, &ep->poll_wait);
+}
+
 /*
  * This is the callback that is passed to the wait queue wakeup
  * machanism. It is called by the stored file descriptors when they
@@ -634,61 +726,40 @@ static struct epitem *ep_find(struct eventpoll *ep, struct file *file, int fd)
  */
 static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *key)
 {
-	int pwake = 0;
 	unsigned long flags;
 	struct epitem *epi = ep_item_from_wait(wait);
 	struct eventpoll *ep = epi->ep;
+	struct ep_cpu_list *cl;
 
 	DNPRINTK(3, (KERN_INFO "[%p] eventpoll: poll_callback(%p) epi=%p ep=%p\n",
 		     current, epi->ffd.file, epi, ep));
 
-	spin_lock_irqsave(&ep->lock, flags);
-
 	/*
 	 * If the event mask does not contain any poll(2) event, we consider the
 	 * descriptor to be disabled. This condition is likely the effect of the
 	 * EPOLLONESHOT bit that disables the descriptor when an event is received,
-	 * until the next EPOLL_CTL_MOD will be issued.
+	 * until the next EPOLL_CTL_MOD will be issued. This is read without
+	 * locks; an item queued by a stale mask is dropped by ep_send_events().
 	 */
 	if (!(epi->event.events & ~EP_PRIVATE_BITS))
-		goto out_unlock;
+		return 1;
 
 	/*
-	 * If we are trasfering events to userspace, we can hold no locks
-	 * (because we're accessing user memory, and because of linux f_op->poll()
-	 * semantics). All the events that happens during that period of time are
-	 * chained in ep->ovflist and requeued later on.
+	 * If the item is already queued, whoever queued it did the wakeups.
+	 * This also covers the items that ep_send_events() is transferring
+	 * to userspace: it polls each item only after clearing the bit.
 	 */
-	if (unlikely(ep->ovflist != EP_UNACTIVE_PTR)) {
-		if (epi->next == EP_UNACTIVE_PTR) {
-			epi->next = ep->ovflist;
-			ep->ovflist = epi;
-		}
-		goto out_unlock;
-	}
+	if (test_and_set_bit(EPI_QUEUED, &epi->state))
+		return 1;
 
-	/* If this file is already in the ready list we exit soon */
-	if (ep_is_linked(&epi->rdllink))
-		goto is_linked;
+	local_irq_save(flags);
+	cl = per_cpu_ptr(ep->cpu_lists, smp_processor_id());
+	spin_lock(&cl->lock);
+	list_add_tail(&epi->rdllink, &cl->list);
+	spin_unlock(&cl->lock);
+	local_irq_restore(flags);
 
-	list_add_tail(&epi->rdllink, &ep->rdllist);
-
-is_linked:
-	/*
-	 * Wake up ( if active ) both the eventpoll wait list and the ->poll()
-	 * wait list.
-	 */
-	if (waitqueue_active(&ep->wq))
-		wake_up_locked(&ep->wq);
-	if (waitqueue_active(&ep->poll_wait))
-		pwake++;
-
-out_unlock:
-	spin_unlock_irqrestore(&ep->lock, flags);
-
-	/* We have to call this outside the lock */
-	if (pwake)
-		ep_poll_safewake(&psw, &ep->poll_wait);
+	ep_wakeup(ep);
 
 	return 1;
 }
@@ -760,7 +831,7 @@ static int ep_insert(struct eventpoll *ep, struct epoll_event *event,
 	ep_set_ffd(&epi->ffd, tfile, fd);
 	epi->event = *event;
 	epi->nwait = 0;
-	epi->next = EP_UNACTIVE_PTR;
+	epi->state = 0;
 
 	/* Initialize the poll table using the queue callback */
 	epq.epi = epi;
@@ -799,7 +870,8 @@ static int ep_insert(struct eventpoll *ep, struct epoll_event *event,
 	spin_lock_irqsave(&ep->lock, flags);
 
 	/* If the file is already "ready" we drop it inside the ready list */
-	if ((revents & event->events) && !ep_is_linked(&epi->rdllink)) {
+	if ((revents & event->events) &&
+	    !test_and_set_bit(EPI_QUEUED, &epi->state)) {
 		list_add_tail(&epi->rdllink, &ep->rdllist);
 
 		/* Notify waiting tasks that events are available */
@@ -827,14 +899,10 @@ error_unregister:
 
 	/*
 	 * We need to do this because an event could have been arrived on some
-	 * allocated wait queue. Note that we don't care about the ep->ovflist
-	 * list, since that is used/cleaned only inside a section bound by "mtx".
-	 * And ep_insert() is called with "mtx" held.
+	 * allocated wait queue. ep_insert() is called with "mtx" held, so the
+	 * item can only be on a ready list.
 	 */
-	spin_lock_irqsave(&ep->lock, flags);
-	if (ep_is_linked(&epi->rdllink))
-		list_del_init(&epi->rdllink);
-	spin_unlock_irqrestore(&ep->lock, flags);
+	ep_unqueue(ep, epi);
 
 	kmem_cache_free(epi_cache, epi);
 
@@ -875,7 +943,7 @@ static int ep_modify(struct eventpoll *ep, struct epitem *epi, struct epoll_even
 	 * list, push it inside.
 	 */
 	if (revents & event->events) {
-		if (!ep_is_linked(&epi->rdllink)) {
+		if (!test_and_set_bit(EPI_QUEUED, &epi->state)) {
 			list_add_tail(&epi->rdllink, &ep->rdllist);
 
 			/* Notify waiting tasks that events are available */
@@ -900,10 +968,11 @@ static int ep_send_events(struct eventpoll *ep, struct epoll_event __user *event
 	int eventcnt, error = -EFAULT, pwake = 0;
 	unsigned int revents;
 	unsigned long flags;
-	struct epitem *epi, *nepi;
-	struct list_head txlist;
+	struct epitem *epi;
+	struct list_head txlist, requeue;
 
 	INIT_LIST_HEAD(&txlist);
+	INIT_LIST_HEAD(&requeue);
 
 	/*
 	 * We need to lock this because we could be hit by
@@ -912,21 +981,17 @@ static int ep_send_events(struct eventpoll *ep, struct epoll_event __user *event
 	mutex_lock(&ep->mtx);
 
 	/*
-	 * Steal the ready list, and re-init the original one to the
-	 * empty list. Also, set ep->ovflist to NULL so that events
-	 * happening while looping w/out locks, are not lost. We cannot
-	 * have the poll callback to queue directly on ep->rdllist,
-	 * because we are doing it in the loop below, in a lockless way.
+	 * Steal the ready list, per-CPU lists included, and re-init the
+	 * original one to the empty list. The items keep EPI_QUEUED, so the
+	 * poll callback leaves them alone until the loop below gets to them.
 	 */
 	spin_lock_irqsave(&ep->lock, flags);
-	list_splice(&ep->rdllist, &txlist);
-	INIT_LIST_HEAD(&ep->rdllist);
-	ep->ovflist = NULL;
+	ep_collect_ready(ep);
+	list_splice_init(&ep->rdllist, &txlist);
 	spin_unlock_irqrestore(&ep->lock, flags);
 
 	/*
 	 * We can loop without lock because this is a task private list.
-	 * We just splice'd out the ep->rdllist in ep_collect_ready_items().
 	 * Items cannot vanish during the loop because we are holding "mtx".
 	 */
 	for (eventcnt = 0; !list_empty(&txlist) && eventcnt < maxevents;) {
@@ -934,6 +999,14 @@ static int ep_send_events(struct eventpoll *ep, struct epoll_event __user *event
 
 		list_del_init(&epi->rdllink);
 
+		/*
+		 * From now on a new event queues the item again through the
+		 * poll callback, and any event that came before is seen by
+		 * the ->poll() below.
+		 */
+		clear_bit(EPI_QUEUED, &epi->state);
+		smp_mb__after_clear_bit();
+
 		/*
 		 * Get the ready file event set. We can safely use the file
 		 * because we are holding the "mtx" and this will guarantee
@@ -952,52 +1025,38 @@ static int ep_send_events(struct eventpoll *ep, struct epoll_event __user *event
 			if (__put_user(revents,
 				       &events[eventcnt].events) ||
 			    __put_user(epi->event.data,
-				       &events[eventcnt].data))
+				       &events[eventcnt].data)) {
+				if (!test_and_set_bit(EPI_QUEUED, &epi->state))
+					list_add(&epi->rdllink, &txlist);
 				goto errxit;
+			}
 			if (epi->event.events & EPOLLONESHOT)
 				epi->event.events &= EP_PRIVATE_BITS;
 			eventcnt++;
 		}
 		/*
-		 * At this point, noone can insert into ep->rdllist besides
-		 * us. The epoll_ctl() callers are locked out by us holding
-		 * "mtx" and the poll callback will queue them in ep->ovflist.
+		 * Level triggered items that are still ready go back on the
+		 * ready list, unless the poll callback already did that.
 		 */
 		if (!(epi->event.events & EPOLLET) &&
-		    (revents & epi->event.events))
-			list_add_tail(&epi->rdllink, &ep->rdllist);
+		    (revents & epi->event.events) &&
+		    !test_and_set_bit(EPI_QUEUED, &epi->state))
+			list_add_tail(&epi->rdllink, &requeue);
 	}
 	error = 0;
 
 errxit:
 
 	spin_lock_irqsave(&ep->lock, flags);
-	/*
-	 * During the time we spent in the loop above, some other events
-	 * might have been queued by the poll callback. We re-insert them
-	 * here (in case they are not already queued, or they're one-shot).
-	 */
-	for (nepi = ep->ovflist; (epi = nepi) != NULL;
-	     nepi = epi->next, epi->next = EP_UNACTIVE_PTR) {
-		if (!ep_is_linked(&epi->rdllink) &&
-		    (epi->event.events & ~EP_PRIVATE_BITS))
-			list_add_tail(&epi->rdllink, &ep->rdllist);
-	}
-	/*
-	 * We need to set back ep->ovflist to EP_UNACTIVE_PTR, so that after
-	 * releasing the lock, events will be queued in the normal way inside
-	 * ep->rdllist.
-	 */
-	ep->ovflist = EP_UNACTIVE_PTR;
-
 	/*
 	 * In case of error in the event-send loop, or in case the number of
 	 * ready events exceeds the userspace limit, we need to splice the
-	 * "txlist" back inside ep->rdllist.
+	 * "txlist" back inside ep->rdllist, ahead of the requeued items.
 	 */
+	list_splice(&requeue, &ep->rdllist);
 	list_splice(&txlist, &ep->rdllist);
 
-	if (!list_empty(&ep->rdllist)) {
+	if (ep_events_available(ep)) {
 		/*
 		 * Wake up (if active) both the eventpoll wait list and the ->poll()
 		 * wait list (delayed after we release the lock).
@@ -1038,7 +1097,7 @@ retry:
 	spin_lock_irqsave(&ep->lock, flags);
 
 	res = 0;
-	if (list_empty(&ep->rdllist)) {
+	if (!ep_events_available(ep)) {
 		/*
 		 * We don't have any available event to return to the caller.
 		 * We need to sleep here, and we will be wake up by
@@ -1055,7 +1114,7 @@ retry:
 			 * to TASK_INTERRUPTIBLE before doing the checks.
 			 */
 			set_current_state(TASK_INTERRUPTIBLE);
-			if (!list_empty(&ep->rdllist) || !jtimeout)
+			if (ep_events_available(ep) || !jtimeout)
 				break;
 			if (signal_pending(current)) {
 				res = -EINTR;
@@ -1072,7 +1131,7 @@ retry:
 	}
 
 	/* Is it worth to try to dig for events ? */
-	eavail = !list_empty(&ep->rdllist);
+	eavail = ep_events_available(ep);
 
 	spin_unlock_irqrestore(&ep->lock, flags);
 
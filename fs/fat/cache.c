@@ -11,12 +11,45 @@
 #include <linux/fs.h>
 #include <linux/msdos_fs.h>
 #include <linux/buffer_head.h>
+#include <linux/module.h>
+#include <linux/rbtree.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
 
 /* this must be > 0. */
 #define FAT_MAX_CACHE	8
 
+/*
+ * Files larger than FAT_MAX_CACHE << FAT_CACHE_CLUSTERS_SHIFT clusters may
+ * keep one extent per 1 << FAT_CACHE_CLUSTERS_SHIFT clusters, up to
+ * FAT_MAX_CACHE_INODE; that is enough to map the whole chain of a large
+ * media file unless it is very badly fragmented.
+ */
+#define FAT_CACHE_CLUSTERS_SHIFT	4
+#define FAT_MAX_CACHE_INODE		4096
+
+/*
+ * Global cap on the extents beyond the first FAT_MAX_CACHE of each inode,
+ * which are always allowed. fat_cache_nr counts only those, fat_cache_total
+ * all of them.
+ */
+static unsigned int fat_cache_max = 16384;
+module_param_named(cache_max, fat_cache_max, uint, 0644);
+MODULE_PARM_DESC(cache_max, "Cached cluster chain extents beyond the first "
+		 __stringify(FAT_MAX_CACHE) " of each file");
+
+static atomic_t fat_cache_nr = ATOMIC_INIT(0);
+static atomic_t fat_cache_total = ATOMIC_INIT(0);
+
+/* statistics, see /proc/fs/fat/cache */
+static atomic_long_t fat_cache_hits = ATOMIC_LONG_INIT(0);
+static atomic_long_t fat_cache_partial = ATOMIC_LONG_INIT(0);
+static atomic_long_t fat_cache_misses = ATOMIC_LONG_INIT(0);
+static atomic_long_t fat_cache_walked = ATOMIC_LONG_INIT(0);
+
 struct fat_cache {
 	struct list_head cache_list;
+	struct rb_node rb_node;	/* in cache_tree, by fcluster */
 	int nr_contig;	/* number of contiguous clusters */
 	int fcluster;	/* cluster number in the file. */
 	int dcluster;	/* cluster number on disk. */
@@ -31,7 +64,23 @@ struct fat_cache_id {
 
 static inline int fat_max_cache(struct inode *inode)
 {
-	return FAT_MAX_CACHE;
+	int bits = MSDOS_SB(inode->i_sb)->cluster_bits + FAT_CACHE_CLUSTERS_SHIFT;
+	loff_t max = i_size_read(inode) >> bits;
+
+	if (max <= FAT_MAX_CACHE)
+		return FAT_MAX_CACHE;
+	return min_t(loff_t, max, FAT_MAX_CACHE_INODE);
+}
+
+/* may one more extent be cached without recycling one? */
+static inline int fat_cache_room(struct inode *inode)
+{
+	int nr = MSDOS_I(inode)->nr_caches;
+
+	if (nr < FAT_MAX_CACHE)
+		return 1;
+	return nr < fat_max_cache(inode) &&
+		atomic_read(&fat_cache_nr) < fat_cache_max;
 }
 
 static struct kmem_cache *fat_cache_cachep;
@@ -43,6 +92,52 @@ static void init_once(void *foo)
 	INIT_LIST_HEAD(&cache->cache_list);
 }
 
+#ifdef CONFIG_PROC_FS
+static int fat_cache_proc_show(struct seq_file *m, void *v)
+{
+	seq_printf(m, "extents:      %u\n", atomic_read(&fat_cache_total));
+	seq_printf(m, "extra_extents: %u\n", atomic_read(&fat_cache_nr));
+	seq_printf(m, "max_extents:  %u\n", fat_cache_max);
+	seq_printf(m, "hits:         %lu\n",
+		   atomic_long_read(&fat_cache_hits));
+	seq_printf(m, "partial_hits: %lu\n",
+		   atomic_long_read(&fat_cache_partial));
+	seq_printf(m, "misses:       %lu\n",
+		   atomic_long_read(&fat_cache_misses));
+	seq_printf(m, "fat_walked:   %lu\n",
+		   atomic_long_read(&fat_cache_walked));
+	return 0;
+}
+
+static int fat_cache_proc_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, fat_cache_proc_show, NULL);
+}
+
+static const struct file_operations fat_cache_proc_fops = {
+	.owner		= THIS_MODULE,
+	.open		= fat_cache_proc_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void __init fat_cache_proc_init(void)
+{
+	if (proc_mkdir("fs/fat", NULL))
+		proc_create("fs/fat/cache", 0, NULL, &fat_cache_proc_fops);
+}
+
+static void fat_cache_proc_exit(void)
+{
+	remove_proc_entry("fs/fat/cache", NULL);
+	remove_proc_entry("fs/fat", NULL);
+}
+#else
+static inline void fat_cache_proc_init(void) { }
+static inline void fat_cache_proc_exit(void) { }
+#endif
+
 int __init fat_cache_init(void)
 {
 	fat_cache_cachep = kmem_cache_create("fat_cache",
@@ -51,25 +146,46 @@ int __init fat_cache_init(void)
 				init_once);
 	if (fat_cache_cachep == NULL)
 		return -ENOMEM;
+	fat_cache_proc_init();
 	return 0;
 }
 
 void fat_cache_destroy(void)
 {
+	fat_cache_proc_exit();
 	kmem_cache_destroy(fat_cache_cachep);
 }
 
 static inline struct fat_cache *fat_cache_alloc(struct inode *inode)
 {
-	return kmem_cache_alloc(fat_cache_cachep, GFP_NOFS);
+	struct fat_cache *cache;
+
+	cache = kmem_cache_alloc(fat_cache_cachep, GFP_NOFS);
+	if (cache)
+		atomic_inc(&fat_cache_total);
+	return cache;
 }
 
 static inline void fat_cache_free(struct fat_cache *cache)
 {
 	BUG_ON(!list_empty(&cache->cache_list));
+	atomic_dec(&fat_cache_total);
 	kmem_cache_free(fat_cache_cachep, cache);
 }
 
+/* nr_caches++ and --, charging fat_cache_nr beyond FAT_MAX_CACHE */
+static inline void fat_cache_nr_inc(struct inode *inode)
+{
+	if (MSDOS_I(inode)->nr_caches++ >= FAT_MAX_CACHE)
+		atomic_inc(&fat_cache_nr);
+}
+
+static inline void fat_cache_nr_dec(struct inode *inode)
+{
+	if (--MSDOS_I(inode)->nr_caches >= FAT_MAX_CACHE)
+		atomic_dec(&fat_cache_nr);
+}
+
 static inline void fat_cache_update_lru(struct inode *inode,
 					struct fat_cache *cache)
 {
@@ -77,29 +193,58 @@ static inline void fat_cache_update_lru(struct inode *inode,
 		list_move(&cache->cache_list, &MSDOS_I(inode)->cache_lru);
 }
 
+/* Find the cache of "fclus" or nearest cache before it. */
+static struct fat_cache *fat_cache_find(struct inode *inode, int fclus)
+{
+	struct rb_node *n = MSDOS_I(inode)->cache_tree.rb_node;
+	struct fat_cache *hit = NULL, *p;
+
+	while (n) {
+		p = rb_entry(n, struct fat_cache, rb_node);
+		if (p->fcluster <= fclus) {
+			hit = p;
+			n = n->rb_right;
+		} else
+			n = n->rb_left;
+	}
+	return hit;
+}
+
+static void fat_cache_insert(struct inode *inode, struct fat_cache *cache)
+{
+	struct rb_node **n = &MSDOS_I(inode)->cache_tree.rb_node;
+	struct rb_node *parent = NULL;
+	struct fat_cache *p;
+
+	while (*n) {
+		parent = *n;
+		p = rb_entry(parent, struct fat_cache, rb_node);
+		if (cache->fcluster < p->fcluster)
+			n = &parent->rb_left;
+		else
+			n = &parent->rb_right;
+	}
+	rb_link_node(&cache->rb_node, parent, n);
+	rb_insert_color(&cache->rb_node, &MSDOS_I(inode)->cache_tree);
+}
+
 static int fat_cache_lookup(struct inode *inode, int fclus,
 			    struct fat_cache_id *cid,
 			    int *cached_fclus, int *cached_dclus)
 {
-	static struct fat_cache nohit = { .fcluster = 0, };
-
-	struct fat_cache *hit = &nohit, *p;
+	struct fat_cache *hit;
 	int offset = -1;
 
 	spin_lock(&MSDOS_I(inode)->cache_lru_lock);
-	list_for_each_entry(p, &MSDOS_I(inode)->cache_lru, cache_list) {
-		/* Find the cache of "fclus" or nearest cache. */
-		if (p->fcluster <= fclus && hit->fcluster < p->fcluster) {
-			hit = p;
-			if ((hit->fcluster + hit->nr_contig) < fclus) {
-				offset = hit->nr_contig;
-			} else {
-				offset = fclus - hit->fcluster;
-				break;
-			}
+	hit = fat_cache_find(inode, fclus);
+	if (hit) {
+		if ((hit->fcluster + hit->nr_contig) < fclus) {
+			offset = hit->nr_contig;
+			atomic_long_inc(&fat_cache_partial);
+		} else {
+			offset = fclus - hit->fcluster;
+			atomic_long_inc(&fat_cache_hits);
 		}
-	}
-	if (hit != &nohit) {
 		fat_cache_update_lru(inode, hit);
 
 		cid->id = MSDOS_I(inode)->cache_valid_id;
@@ -108,7 +253,8 @@ static int fat_cache_lookup(struct inode *inode, int fclus,
 		cid->dcluster = hit->dcluster;
 		*cached_fclus = cid->fcluster + offset;
 		*cached_dclus = cid->dcluster + offset;
-	}
+	} else
+		atomic_long_inc(&fat_cache_misses);
 	spin_unlock(&MSDOS_I(inode)->cache_lru_lock);
 
 	return offset;
@@ -119,19 +265,25 @@ static struct fat_cache *fat_cache_merge(struct inode *inode,
 {
 	struct fat_cache *p;
 
-	list_for_each_entry(p, &MSDOS_I(inode)->cache_lru, cache_list) {
-		/* Find the same part as "new" in cluster-chain. */
-		if (p->fcluster == new->fcluster) {
-			BUG_ON(p->dcluster != new->dcluster);
-			if (new->nr_contig > p->nr_contig)
-				p->nr_contig = new->nr_contig;
-			return p;
-		}
+	/* Find the same part as "new" in cluster-chain. */
+	p = fat_cache_find(inode, new->fcluster);
+	if (p && p->fcluster == new->fcluster) {
+		BUG_ON(p->dcluster != new->dcluster);
+		if (new->nr_contig > p->nr_contig)
+			p->nr_contig = new->nr_contig;
+		return p;
 	}
 	return NULL;
 }
 
-static void fat_cache_add(struct inode *inode, struct fat_cache_id *new)
+/*
+ * Add @new to the cache of @inode. If the inode has no room left, its
+ * least recently used extent is recycled when @evict is set; extents
+ * only walked past on the way to the requested cluster are added
+ * without @evict, so they never push out ones which were asked for.
+ */
+static void fat_cache_add(struct inode *inode, struct fat_cache_id *new,
+			  int evict)
 {
 	struct fat_cache *cache, *tmp;
 
@@ -145,26 +297,40 @@ static void fat_cache_add(struct inode *inode, struct fat_cache_id *new)
 
 	cache = fat_cache_merge(inode, new);
 	if (cache == NULL) {
-		if (MSDOS_I(inode)->nr_caches < fat_max_cache(inode)) {
-			MSDOS_I(inode)->nr_caches++;
+		if (fat_cache_room(inode)) {
+			fat_cache_nr_inc(inode);
 			spin_unlock(&MSDOS_I(inode)->cache_lru_lock);
 
 			tmp = fat_cache_alloc(inode);
 			spin_lock(&MSDOS_I(inode)->cache_lru_lock);
+			if (tmp == NULL) {
+				fat_cache_nr_dec(inode);
+				goto out;
+			}
+			if (new->id != FAT_CACHE_VALID &&
+			    new->id != MSDOS_I(inode)->cache_valid_id) {
+				/* invalidated while we slept */
+				fat_cache_nr_dec(inode);
+				fat_cache_free(tmp);
+				goto out;
+			}
 			cache = fat_cache_merge(inode, new);
 			if (cache != NULL) {
-				MSDOS_I(inode)->nr_caches--;
+				fat_cache_nr_dec(inode);
 				fat_cache_free(tmp);
 				goto out_update_lru;
 			}
 			cache = tmp;
-		} else {
+		} else if (evict && MSDOS_I(inode)->nr_caches) {
 			struct list_head *p = MSDOS_I(inode)->cache_lru.prev;
 			cache = list_entry(p, struct fat_cache, cache_list);
-		}
+			rb_erase(&cache->rb_node, &MSDOS_I(inode)->cache_tree);
+		} else
+			goto out;
 		cache->fcluster = new->fcluster;
 		cache->dcluster = new->dcluster;
 		cache->nr_contig = new->nr_contig;
+		fat_cache_insert(inode, cache);
 	}
 out_update_lru:
 	fat_cache_update_lru(inode, cache);
@@ -184,9 +350,10 @@ static void __fat_cache_inval_inode(struct inode *inode)
 	while (!list_empty(&i->cache_lru)) {
 		cache = list_entry(i->cache_lru.next, struct fat_cache, cache_list);
 		list_del_init(&cache->cache_list);
-		i->nr_caches--;
+		fat_cache_nr_dec(inode);
 		fat_cache_free(cache);
 	}
+	i->cache_tree = RB_ROOT;
 	/* Update. The copy of caches before this id is discarded. */
 	i->cache_valid_id++;
 	if (i->cache_valid_id == FAT_CACHE_VALID)
@@ -220,6 +387,7 @@ int fat_get_cluster(struct inode *inode, int cluster, int *fclus, int *dclus)
 	const int limit = sb->s_maxbytes >> MSDOS_SB(sb)->cluster_bits;
 	struct fat_entry fatent;
 	struct fat_cache_id cid;
+	unsigned long walked = 0;
 	int nr;
 
 	BUG_ON(MSDOS_I(inode)->i_start == 0);
@@ -230,11 +398,8 @@ int fat_get_cluster(struct inode *inode, int cluster, int *fclus, int *dclus)
 		return 0;
 
 	if (fat_cache_lookup(inode, cluster, &cid, fclus, dclus) < 0) {
-		/*
-		 * dummy, always not contiguous
-		 * This is reinitialized by cache_init(), later.
-		 */
-		cache_init(&cid, -1, -1);
+		/* nothing cached before "cluster", start at the head */
+		cache_init(&cid, 0, *dclus);
 	}
 
 	fatent_init(&fatent);
@@ -249,6 +414,7 @@ int fat_get_cluster(struct inode *inode, int cluster, int *fclus, int *dclus)
 		}
 
 		nr = fat_ent_read(inode, &fatent, *dclus);
+		walked++;
 		if (nr < 0)
 			goto out;
 		else if (nr == FAT_ENT_FREE) {
@@ -258,18 +424,24 @@ int fat_get_cluster(struct inode *inode, int cluster, int *fclus, int *dclus)
 			nr = -EIO;
 			goto out;
 		} else if (nr == FAT_ENT_EOF) {
-			fat_cache_add(inode, &cid);
+			fat_cache_add(inode, &cid, 1);
 			goto out;
 		}
 		(*fclus)++;
 		*dclus = nr;
-		if (!cache_contiguous(&cid, *dclus))
+		if (!cache_contiguous(&cid, *dclus)) {
+			/* keep the fragment we walked past, if there is room */
+			cid.nr_contig--;
+			fat_cache_add(inode, &cid, 0);
 			cache_init(&cid, *fclus, *dclus);
+		}
 	}
 	nr = 0;
-	fat_cache_add(inode, &cid);
+	fat_cache_add(inode, &cid, 1);
 out:
 	fatent_brelse(&fatent);
+	if (walked)
+		atomic_long_add(walked, &fat_cache_walked);
 	return nr;
 }
 
@@ -6,6 +6,22 @@
 #include <linux/module.h>
 #include <linux/fs.h>
 #include <linux/msdos_fs.h>
+#include <linux/vmalloc.h>
+#include <linux/kthread.h>
+#include <linux/sched.h>
+
+/*
+ * After mount a kernel thread reads the whole FAT once into a bitmap of
+ * the free clusters (sbi->free_map). Until it is done, allocation scans
+ * the FAT as before; afterwards free space comes from the bitmap, and a
+ * new file starts at the beginning of a free run of FAT_ALLOC_RUN bytes
+ * so that its clusters stay contiguous.
+ */
+static int fat_free_map_enable = 1;
+module_param_named(free_map, fat_free_map_enable, bool, 0644);
+MODULE_PARM_DESC(free_map, "Keep a bitmap of the free clusters in memory");
+
+#define FAT_ALLOC_RUN		(1024 * 1024)
 
 struct fatent_operations {
 	void (*ent_blocknr)(struct super_block *, int, int *, sector_t *);
@@ -438,6 +454,148 @@ static void fat_collect_bhs(struct buffer_head **bhs, int *nr_bhs,
 	}
 }
 
+static inline int fat_free_map_ready(struct msdos_sb_info *sbi)
+{
+	return sbi->free_map && sbi->free_map_scanned >= sbi->max_cluster;
+}
+
+/*
+ * Bits at and above free_map_scanned are still to be read from the FAT
+ * by fat_free_map_scan(), so only the part already scanned is updated.
+ * Called with lock_fat() held.
+ */
+static void fat_free_map_mark(struct msdos_sb_info *sbi, int entry, int free)
+{
+	if (!sbi->free_map || entry >= sbi->free_map_scanned)
+		return;
+	if (free) {
+		if (!__test_and_set_bit(entry, sbi->free_map))
+			sbi->free_map_count++;
+		/* this may join free clusters into a run */
+		sbi->free_map_no_run = 0;
+	} else {
+		if (__test_and_clear_bit(entry, sbi->free_map))
+			sbi->free_map_count--;
+	}
+}
+
+/*
+ * Returns the free cluster to allocate next: @goal if it is free,
+ * otherwise the first cluster of a free run of FAT_ALLOC_RUN bytes
+ * searching from prev_free, otherwise the first free cluster after
+ * prev_free. Directories don't need a run and take the latter. Returns
+ * 0 if the filesystem is full.
+ *
+ * A search which finds no run goes through every free fragment, so once
+ * one has failed, free_map_no_run skips the run search until clusters
+ * are freed again. Otherwise a nearly full, fragmented filesystem would
+ * repeat the whole search at the end of every fragment it fills.
+ */
+static int fat_free_map_find(struct msdos_sb_info *sbi, int goal, int run)
+{
+	unsigned long *map = sbi->free_map;
+	unsigned long max = sbi->max_cluster;
+	unsigned long start, limit, pos, end, first = 0;
+	int wrapped = 0;
+
+	if (goal >= FAT_START_ENT && goal < max && test_bit(goal, map))
+		return goal;
+	if (sbi->free_map_no_run)
+		run = 1;
+
+	start = sbi->prev_free + 1;
+	if (start < FAT_START_ENT || start >= max)
+		start = FAT_START_ENT;
+	pos = start;
+	for (;;) {
+		limit = wrapped ? start : max;
+		pos = find_next_bit(map, limit, pos);
+		if (pos >= limit) {
+			if (wrapped)
+				break;
+			wrapped = 1;
+			pos = FAT_START_ENT;
+			continue;
+		}
+		if (!first)
+			first = pos;
+		if (run <= 1)
+			break;
+		end = find_next_zero_bit(map, max, pos);
+		if (end - pos >= run)
+			return pos;
+		pos = end;
+	}
+	if (run > 1)
+		sbi->free_map_no_run = 1;
+	return first;
+}
+
+/* Makes the free entry at @fatent the new end of @prev_ent's chain. */
+static void fat_alloc_take(struct super_block *sb, struct fat_entry *fatent,
+			   struct fat_entry *prev_ent,
+			   struct buffer_head **bhs, int *nr_bhs)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	struct fatent_operations *ops = sbi->fatent_ops;
+	int entry = fatent->entry;
+
+	/* make the cluster chain */
+	ops->ent_put(fatent, FAT_ENT_EOF);
+	if (prev_ent->nr_bhs)
+		ops->ent_put(prev_ent, entry);
+
+	fat_collect_bhs(bhs, nr_bhs, fatent);
+
+	fat_free_map_mark(sbi, entry, 0);
+	sbi->prev_free = entry;
+	if (sbi->free_clusters != -1)
+		sbi->free_clusters--;
+	sb->s_dirt = 1;
+}
+
+/* Allocation once the free bitmap is complete; see fat_alloc_clusters() */
+static int fat_alloc_from_map(struct inode *inode, int *cluster,
+			      int nr_cluster, struct fat_entry *fatent,
+			      struct buffer_head **bhs, int *nr_bhs,
+			      int *idx_clus)
+{
+	struct super_block *sb = inode->i_sb;
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	struct msdos_inode_info *ei = MSDOS_I(inode);
+	struct fat_entry prev_ent;
+	int run, entry, ent;
+
+	run = S_ISDIR(inode->i_mode) ? 1 : FAT_ALLOC_RUN >> sbi->cluster_bits;
+
+	fatent_init(&prev_ent);
+	while (*idx_clus < nr_cluster) {
+		entry = fat_free_map_find(sbi, ei->i_alloc_goal, run);
+		if (!entry)
+			return -ENOSPC;
+
+		ent = fat_ent_read(inode, fatent, entry);
+		if (ent < 0)
+			return ent;
+		if (ent != FAT_ENT_FREE) {
+			/* shouldn't happen, but don't trust the bitmap */
+			fat_free_map_mark(sbi, entry, 0);
+			continue;
+		}
+
+		fat_alloc_take(sb, fatent, &prev_ent, bhs, nr_bhs);
+		cluster[(*idx_clus)++] = entry;
+		ei->i_alloc_goal = entry + 1;
+
+		/*
+		 * fat_collect_bhs() gets ref-count of bhs,
+		 * so we can still use the prev_ent.
+		 */
+		prev_ent = *fatent;
+	}
+	return 0;
+}
+
 int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 {
 	struct super_block *sb = inode->i_sb;
@@ -457,9 +615,17 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 	}
 
 	err = nr_bhs = idx_clus = 0;
+	fatent_init(&fatent);
+	if (fat_free_map_ready(sbi)) {
+		err = fat_alloc_from_map(inode, cluster, nr_cluster, &fatent,
+					 bhs, &nr_bhs, &idx_clus);
+		if (err != -ENOSPC)
+			goto out;
+		goto nospc;
+	}
+
 	count = FAT_START_ENT;
 	fatent_init(&prev_ent);
-	fatent_init(&fatent);
 	fatent_set_entry(&fatent, sbi->prev_free + 1);
 	while (count < sbi->max_cluster) {
 		if (fatent.entry >= sbi->max_cluster)
@@ -474,17 +640,8 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 			if (ops->ent_get(&fatent) == FAT_ENT_FREE) {
 				int entry = fatent.entry;
 
-				/* make the cluster chain */
-				ops->ent_put(&fatent, FAT_ENT_EOF);
-				if (prev_ent.nr_bhs)
-					ops->ent_put(&prev_ent, entry);
-
-				fat_collect_bhs(bhs, &nr_bhs, &fatent);
-
-				sbi->prev_free = entry;
-				if (sbi->free_clusters != -1)
-					sbi->free_clusters--;
-				sb->s_dirt = 1;
+				fat_alloc_take(sb, &fatent, &prev_ent,
+					       bhs, &nr_bhs);
 
 				cluster[idx_clus] = entry;
 				idx_clus++;
@@ -503,6 +660,7 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 		} while (fat_ent_next(sbi, &fatent));
 	}
 
+nospc:
 	/* Couldn't allocate the free entries */
 	sbi->free_clusters = 0;
 	sbi->free_clus_valid = 1;
@@ -552,6 +710,7 @@ int fat_free_clusters(struct inode *inode, int cluster)
 		}
 
 		ops->ent_put(&fatent, FAT_ENT_FREE);
+		fat_free_map_mark(sbi, fatent.entry, 1);
 		if (sbi->free_clusters != -1) {
 			sbi->free_clusters++;
 			sb->s_dirt = 1;
@@ -606,6 +765,70 @@ static void fat_ent_reada(struct super_block *sb, struct fat_entry *fatent,
 		sb_breadahead(sb, blocknr + i);
 }
 
+/*
+ * Reads the FAT from free_map_scanned to the end into the free bitmap.
+ * Each block is read under lock_fat(), so allocations in between see a
+ * consistent free_map_scanned. When the end is reached, the count of
+ * free clusters is exact and replaces the one from FSINFO.
+ */
+static int fat_free_map_scan(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	struct fatent_operations *ops = sbi->fatent_ops;
+	struct fat_entry fatent;
+	unsigned long reada_blocks;
+	sector_t blocknr, reada_end = 0;
+	int err = 0, offset;
+
+	mutex_lock(&sbi->free_map_mutex);
+	reada_blocks = FAT_READA_SIZE >> sb->s_blocksize_bits;
+
+	fatent_init(&fatent);
+	while (sbi->free_map_scanned < sbi->max_cluster) {
+		if (sbi->free_map_stop)
+			break;
+
+		fatent_set_entry(&fatent, sbi->free_map_scanned);
+		/* readahead of fat blocks */
+		ops->ent_blocknr(sb, fatent.entry, &offset, &blocknr);
+		if (blocknr >= reada_end) {
+			sector_t fat_end = sbi->fat_start + sbi->fat_length;
+			unsigned long rest = fat_end - blocknr;
+
+			fat_ent_reada(sb, &fatent, min(reada_blocks, rest));
+			reada_end = blocknr + reada_blocks;
+		}
+
+		lock_fat(sbi);
+		err = fat_ent_read_block(sb, &fatent);
+		if (err) {
+			unlock_fat(sbi);
+			break;
+		}
+		do {
+			if (ops->ent_get(&fatent) == FAT_ENT_FREE) {
+				__set_bit(fatent.entry, sbi->free_map);
+				sbi->free_map_count++;
+			} else
+				__clear_bit(fatent.entry, sbi->free_map);
+		} while (fat_ent_next(sbi, &fatent));
+
+		sbi->free_map_scanned = min_t(unsigned long, fatent.entry,
+					       sbi->max_cluster);
+		if (sbi->free_map_scanned == sbi->max_cluster) {
+			sbi->free_clusters = sbi->free_map_count;
+			sbi->free_clus_valid = 1;
+			sb->s_dirt = 1;
+		}
+		unlock_fat(sbi);
+		cond_resched();
+	}
+	fatent_brelse(&fatent);
+	mutex_unlock(&sbi->free_map_mutex);
+
+	return err;
+}
+
 int fat_count_free_clusters(struct super_block *sb)
 {
 	struct msdos_sb_info *sbi = MSDOS_SB(sb);
@@ -618,6 +841,12 @@ int fat_count_free_clusters(struct super_block *sb)
 	if (sbi->free_clusters != -1 && sbi->free_clus_valid)
 		goto out;
 
+	/* wait for, or help, the scan of the free bitmap instead */
+	if (sbi->free_map) {
+		unlock_fat(sbi);
+		return fat_free_map_scan(sb);
+	}
+
 	reada_blocks = FAT_READA_SIZE >> sb->s_blocksize_bits;
 	reada_mask = reada_blocks - 1;
 	cur_block = 0;
@@ -650,3 +879,51 @@ out:
 	unlock_fat(sbi);
 	return err;
 }
+
+static int fat_free_map_thread(void *data)
+{
+	struct super_block *sb = data;
+
+	set_user_nice(current, 10);
+	fat_free_map_scan(sb);
+	complete_and_exit(&MSDOS_SB(sb)->free_map_done, 0);
+}
+
+void fat_free_map_init(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	struct task_struct *task;
+
+	mutex_init(&sbi->free_map_mutex);
+	init_completion(&sbi->free_map_done);
+	sbi->free_map_scanned = FAT_START_ENT;
+	sbi->free_map_count = 0;
+	sbi->free_map_stop = 0;
+	sbi->free_map_no_run = 0;
+	sbi->free_map = NULL;
+
+	if (fat_free_map_enable)
+		sbi->free_map = vmalloc(BITS_TO_LONGS(sbi->max_cluster) *
+					sizeof(unsigned long));
+	if (!sbi->free_map) {
+		complete(&sbi->free_map_done);
+		return;
+	}
+	memset(sbi->free_map, 0,
+	       BITS_TO_LONGS(sbi->max_cluster) * sizeof(unsigned long));
+
+	/* without the thread, the first statfs() fills the bitmap */
+	task = kthread_run(fat_free_map_thread, sb, "fat-bitmap/%s", sb->s_id);
+	if (IS_ERR(task))
+		complete(&sbi->free_map_done);
+}
+
+void fat_free_map_exit(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+
+	sbi->free_map_stop = 1;
+	wait_for_completion(&sbi->free_map_done);
+	vfree(sbi->free_map);
+	sbi->free_map = NULL;
+}
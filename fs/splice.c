@@ -361,6 +361,7 @@ __generic_file_splice_read(struct file *in, loff_t *ppos,
 		if (PageReadahead(page))
 			page_cache_async_readahead(mapping, &in->f_ra, in,
 					page, index, req_pages - page_nr);
+		readahead_page_used(mapping, page);
 
 		/*
 		 * If the page isn't uptodate, we may need to start io on it
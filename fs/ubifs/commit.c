@@ -41,62 +41,52 @@
  * latency blips. Note that in any case, the commit does not prevent lookups
  * (as permitted by the TNC mutex), or access to VFS data structures e.g. page
  * cache.
+ *
+ * The buds of the committed journal are not counted against the journal size
+ * limit during commit end, so writers can fill a new journal while the index
+ * is being written. A journal writer which finds the journal full only waits
+ * for commit start, and leaves commit end to the background thread.
  */
 
 #include <linux/freezer.h>
 #include <linux/kthread.h>
+#include <linux/module.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include "ubifs.h"
 
 /**
- * do_commit - commit the journal.
+ * commit_failed - handle a commit failure.
  * @c: UBIFS file-system description object
- *
- * This function implements UBIFS commit. It has to be called with commit lock
- * locked. Returns zero in case of success and a negative error code in case of
- * failure.
+ * @err: error code
  */
-static int do_commit(struct ubifs_info *c)
+static void commit_failed(struct ubifs_info *c, int err)
 {
-	int err, new_ltail_lnum, old_ltail_lnum, i;
-	struct ubifs_zbranch zroot;
-	struct ubifs_lp_stats lst;
-
-	dbg_cmt("start");
-	if (c->ro_media) {
-		err = -EROFS;
-		goto out_up;
-	}
-
-	/* Sync all write buffers (necessary for recovery) */
-	for (i = 0; i < c->jhead_cnt; i++) {
-		err = ubifs_wbuf_sync(&c->jheads[i].wbuf);
-		if (err)
-			goto out_up;
-	}
-
-	c->cmt_no += 1;
-	err = ubifs_gc_start_commit(c);
-	if (err)
-		goto out_up;
-	err = dbg_check_lprops(c);
-	if (err)
-		goto out_up;
-	err = ubifs_log_start_commit(c, &new_ltail_lnum);
-	if (err)
-		goto out_up;
-	err = ubifs_tnc_start_commit(c, &zroot);
-	if (err)
-		goto out_up;
-	err = ubifs_lpt_start_commit(c);
-	if (err)
-		goto out_up;
-	err = ubifs_orphan_start_commit(c);
-	if (err)
-		goto out_up;
-
-	ubifs_get_lp_stats(c, &lst);
+	ubifs_err("commit failed, error %d", err);
+	spin_lock(&c->cs_lock);
+	c->cmt_state = COMMIT_BROKEN;
+	c->cmt_end_bgt = 0;
+	wake_up(&c->cmt_wq);
+	spin_unlock(&c->cs_lock);
+	ubifs_ro_mode(c, err);
+}
 
-	up_write(&c->commit_sem);
+/**
+ * commit_end - write the index and finish the commit.
+ * @c: UBIFS file-system description object
+ *
+ * This function implements the part of the commit which is done without the
+ * commit lock, after 'do_commit()' has prepared it. Returns zero in case of
+ * success and a negative error code in case of failure.
+ */
+static int commit_end(struct ubifs_info *c)
+{
+	int err, new_ltail_lnum = c->cmt_new_ltail_lnum, old_ltail_lnum;
+	struct ubifs_zbranch *zroot = &c->cmt_zroot;
+	struct ubifs_lp_stats *lst = &c->cmt_lst;
+	ktime_t start = ktime_get();
+	unsigned int us;
 
 	err = ubifs_tnc_end_commit(c);
 	if (err)
@@ -111,16 +101,16 @@ static int do_commit(struct ubifs_info *c)
 	err = ubifs_log_end_commit(c, new_ltail_lnum);
 	if (err)
 		goto out;
-	err = dbg_check_old_index(c, &zroot);
+	err = dbg_check_old_index(c, zroot);
 	if (err)
 		goto out;
 
 	mutex_lock(&c->mst_mutex);
 	c->mst_node->cmt_no      = cpu_to_le64(c->cmt_no);
 	c->mst_node->log_lnum    = cpu_to_le32(new_ltail_lnum);
-	c->mst_node->root_lnum   = cpu_to_le32(zroot.lnum);
-	c->mst_node->root_offs   = cpu_to_le32(zroot.offs);
-	c->mst_node->root_len    = cpu_to_le32(zroot.len);
+	c->mst_node->root_lnum   = cpu_to_le32(zroot->lnum);
+	c->mst_node->root_offs   = cpu_to_le32(zroot->offs);
+	c->mst_node->root_len    = cpu_to_le32(zroot->len);
 	c->mst_node->ihead_lnum  = cpu_to_le32(c->ihead_lnum);
 	c->mst_node->ihead_offs  = cpu_to_le32(c->ihead_offs);
 	c->mst_node->index_size  = cpu_to_le64(c->old_idx_sz);
@@ -133,13 +123,13 @@ static int do_commit(struct ubifs_info *c)
 	c->mst_node->lsave_lnum  = cpu_to_le32(c->lsave_lnum);
 	c->mst_node->lsave_offs  = cpu_to_le32(c->lsave_offs);
 	c->mst_node->lscan_lnum  = cpu_to_le32(c->lscan_lnum);
-	c->mst_node->empty_lebs  = cpu_to_le32(lst.empty_lebs);
-	c->mst_node->idx_lebs    = cpu_to_le32(lst.idx_lebs);
-	c->mst_node->total_free  = cpu_to_le64(lst.total_free);
-	c->mst_node->total_dirty = cpu_to_le64(lst.total_dirty);
-	c->mst_node->total_used  = cpu_to_le64(lst.total_used);
-	c->mst_node->total_dead  = cpu_to_le64(lst.total_dead);
-	c->mst_node->total_dark  = cpu_to_le64(lst.total_dark);
+	c->mst_node->empty_lebs  = cpu_to_le32(lst->empty_lebs);
+	c->mst_node->idx_lebs    = cpu_to_le32(lst->idx_lebs);
+	c->mst_node->total_free  = cpu_to_le64(lst->total_free);
+	c->mst_node->total_dirty = cpu_to_le64(lst->total_dirty);
+	c->mst_node->total_used  = cpu_to_le64(lst->total_used);
+	c->mst_node->total_dead  = cpu_to_le64(lst->total_dead);
+	c->mst_node->total_dark  = cpu_to_le64(lst->total_dark);
 	if (c->no_orphs)
 		c->mst_node->flags |= cpu_to_le32(UBIFS_MST_NO_ORPHS);
 	else
@@ -159,7 +149,11 @@ static int do_commit(struct ubifs_info *c)
 	if (err)
 		goto out;
 
+	us = ktime_us_delta(ktime_get(), start);
 	spin_lock(&c->cs_lock);
+	c->cmt_stats.end_us += us;
+	if (us > c->cmt_stats.end_us_max)
+		c->cmt_stats.end_us_max = us;
 	c->cmt_state = COMMIT_RESTING;
 	wake_up(&c->cmt_wq);
 	dbg_cmt("commit end");
@@ -167,15 +161,85 @@ static int do_commit(struct ubifs_info *c)
 
 	return 0;
 
-out_up:
-	up_write(&c->commit_sem);
 out:
-	ubifs_err("commit failed, error %d", err);
+	commit_failed(c, err);
+	return err;
+}
+
+/**
+ * do_commit - commit the journal.
+ * @c: UBIFS file-system description object
+ * @bg_end: leave commit end to the background thread
+ *
+ * This function implements UBIFS commit. It has to be called with commit lock
+ * locked. If @bg_end is not zero, it returns as soon as the commit lock is
+ * released, and the background thread finishes the commit. Returns zero in
+ * case of success and a negative error code in case of failure.
+ */
+static int do_commit(struct ubifs_info *c, int bg_end)
+{
+	int err, i;
+	ktime_t start = ktime_get();
+	unsigned int us;
+
+	dbg_cmt("start");
+	if (c->ro_media) {
+		err = -EROFS;
+		goto out_up;
+	}
+
+	/* Sync all write buffers (necessary for recovery) */
+	for (i = 0; i < c->jhead_cnt; i++) {
+		err = ubifs_wbuf_sync(&c->jheads[i].wbuf);
+		if (err)
+			goto out_up;
+	}
+
+	c->cmt_no += 1;
+	err = ubifs_gc_start_commit(c);
+	if (err)
+		goto out_up;
+	err = dbg_check_lprops(c);
+	if (err)
+		goto out_up;
+	err = ubifs_log_start_commit(c, &c->cmt_new_ltail_lnum);
+	if (err)
+		goto out_up;
+	err = ubifs_tnc_start_commit(c, &c->cmt_zroot);
+	if (err)
+		goto out_up;
+	err = ubifs_lpt_start_commit(c);
+	if (err)
+		goto out_up;
+	err = ubifs_orphan_start_commit(c);
+	if (err)
+		goto out_up;
+
+	ubifs_get_lp_stats(c, &c->cmt_lst);
+
+	up_write(&c->commit_sem);
+
+	us = ktime_us_delta(ktime_get(), start);
 	spin_lock(&c->cs_lock);
-	c->cmt_state = COMMIT_BROKEN;
-	wake_up(&c->cmt_wq);
+	c->cmt_stats.commits += 1;
+	c->cmt_stats.start_us += us;
+	if (us > c->cmt_stats.start_us_max)
+		c->cmt_stats.start_us_max = us;
+	if (bg_end) {
+		c->cmt_stats.bg_ends += 1;
+		c->cmt_end_bgt = 1;
+		spin_unlock(&c->cs_lock);
+		dbg_cmt("commit end left to the background thread");
+		ubifs_wake_up_bgt(c);
+		return 0;
+	}
 	spin_unlock(&c->cs_lock);
-	ubifs_ro_mode(c, err);
+
+	return commit_end(c);
+
+out_up:
+	up_write(&c->commit_sem);
+	commit_failed(c, err);
 	return err;
 }
 
@@ -208,7 +272,7 @@ static int run_bg_commit(struct ubifs_info *c)
 		goto out_cmt_unlock;
 	spin_unlock(&c->cs_lock);
 
-	return do_commit(c);
+	return do_commit(c, 0);
 
 out_cmt_unlock:
 	up_write(&c->commit_sem);
@@ -217,6 +281,23 @@ out:
 	return 0;
 }
 
+/**
+ * run_bg_commit_end - finish a commit left to the background thread.
+ * @c: UBIFS file-system description object
+ */
+static void run_bg_commit_end(struct ubifs_info *c)
+{
+	spin_lock(&c->cs_lock);
+	if (!c->cmt_end_bgt) {
+		spin_unlock(&c->cs_lock);
+		return;
+	}
+	c->cmt_end_bgt = 0;
+	spin_unlock(&c->cs_lock);
+
+	commit_end(c);
+}
+
 /**
  * ubifs_bg_thread - UBIFS background thread function.
  * @info: points to the file-system description object
@@ -224,7 +305,8 @@ out:
  * This function implements various file-system background activities:
  * o when a write-buffer timer expires it synchronizes the appropriate
  *   write-buffer;
- * o when the journal is about to be full, it starts in-advance commit.
+ * o when the journal is about to be full, it starts in-advance commit;
+ * o it finishes the commits started by journal writers.
  *
  * Note, other stuff like background garbage collection may be added here in
  * future.
@@ -239,6 +321,9 @@ int ubifs_bg_thread(void *info)
 	set_freezable();
 
 	while (1) {
+		/* Do not leave a commit half-done when stopping or freezing */
+		run_bg_commit_end(c);
+
 		if (kthread_should_stop())
 			break;
 
@@ -269,6 +354,7 @@ int ubifs_bg_thread(void *info)
 		cond_resched();
 	}
 
+	run_bg_commit_end(c);
 	dbg_msg("background thread \"%s\" stops", c->bgt_name);
 	return 0;
 }
@@ -347,13 +433,16 @@ static int wait_for_commit(struct ubifs_info *c)
 }
 
 /**
- * ubifs_run_commit - run or wait for commit.
+ * run_commit - run or wait for commit.
  * @c: UBIFS file-system description object
+ * @start_only: only wait for commit start
  *
  * This function runs commit and returns zero in case of success and a negative
- * error code in case of failure.
+ * error code in case of failure. If @start_only is not zero, it returns once
+ * the journal has been switched to a new one and commit end is left to the
+ * background thread.
  */
-int ubifs_run_commit(struct ubifs_info *c)
+static int run_commit(struct ubifs_info *c, int start_only)
 {
 	int err = 0;
 
@@ -372,7 +461,12 @@ int ubifs_run_commit(struct ubifs_info *c)
 
 	if (c->cmt_state == COMMIT_RUNNING_REQUIRED) {
 		spin_unlock(&c->cs_lock);
-		return wait_for_commit(c);
+		if (!start_only)
+			return wait_for_commit(c);
+		/* Commit start holds the commit lock */
+		down_read(&c->commit_sem);
+		up_read(&c->commit_sem);
+		return 0;
 	}
 	spin_unlock(&c->cs_lock);
 
@@ -395,12 +489,14 @@ int ubifs_run_commit(struct ubifs_info *c)
 	if (c->cmt_state == COMMIT_RUNNING_REQUIRED) {
 		up_write(&c->commit_sem);
 		spin_unlock(&c->cs_lock);
+		if (start_only)
+			return 0;
 		return wait_for_commit(c);
 	}
 	c->cmt_state = COMMIT_RUNNING_REQUIRED;
 	spin_unlock(&c->cs_lock);
 
-	err = do_commit(c);
+	err = do_commit(c, start_only);
 	return err;
 
 out_cmt_unlock:
@@ -410,6 +506,63 @@ out:
 	return err;
 }
 
+/**
+ * account_wait - account time spent running or waiting for a commit.
+ * @c: UBIFS file-system description object
+ * @start: when the wait started
+ */
+static void account_wait(struct ubifs_info *c, ktime_t start)
+{
+	unsigned int us = ktime_us_delta(ktime_get(), start);
+
+	spin_lock(&c->cs_lock);
+	c->cmt_stats.waits += 1;
+	c->cmt_stats.wait_us += us;
+	if (us > c->cmt_stats.wait_us_max)
+		c->cmt_stats.wait_us_max = us;
+	spin_unlock(&c->cs_lock);
+}
+
+/**
+ * ubifs_run_commit - run or wait for commit.
+ * @c: UBIFS file-system description object
+ *
+ * This function runs commit and returns zero in case of success and a negative
+ * error code in case of failure.
+ */
+int ubifs_run_commit(struct ubifs_info *c)
+{
+	ktime_t start = ktime_get();
+	int err;
+
+	err = run_commit(c, 0);
+	account_wait(c, start);
+	return err;
+}
+
+/**
+ * ubifs_run_commit_start - run or wait for commit start.
+ * @c: UBIFS file-system description object
+ *
+ * This function is used by journal writers which found the journal full. Once
+ * commit start is done, the buds of the old journal do not count against the
+ * journal size limit any more, so writers may go on while the background
+ * thread writes the index. Returns zero in case of success and a negative
+ * error code in case of failure.
+ */
+int ubifs_run_commit_start(struct ubifs_info *c)
+{
+	ktime_t start = ktime_get();
+	int err;
+
+	if (!c->bgt)
+		return ubifs_run_commit(c);
+
+	err = run_commit(c, 1);
+	account_wait(c, start);
+	return err;
+}
+
 /**
  * ubifs_gc_should_commit - determine if it is time for GC to run commit.
  * @c: UBIFS file-system description object
@@ -437,6 +590,92 @@ int ubifs_gc_should_commit(struct ubifs_info *c)
 	return ret;
 }
 
+#ifdef CONFIG_DEBUG_FS
+
+/* The "ubifs" debugfs directory, which has a sub-directory per file-system */
+struct dentry *ubifs_debugfs_root;
+
+static unsigned long long avg_us(unsigned long long us, unsigned long cnt)
+{
+	if (cnt)
+		do_div(us, cnt);
+	return us;
+}
+
+static int cmt_stats_show(struct seq_file *m, void *v)
+{
+	struct ubifs_info *c = m->private;
+	struct ubifs_cmt_stats st;
+	long long bud_bytes, cmt_bud_bytes;
+
+	spin_lock(&c->cs_lock);
+	st = c->cmt_stats;
+	spin_unlock(&c->cs_lock);
+	spin_lock(&c->buds_lock);
+	bud_bytes = c->bud_bytes;
+	cmt_bud_bytes = c->cmt_bud_bytes;
+	spin_unlock(&c->buds_lock);
+
+	seq_printf(m, "journal size:          %lld KiB (%lld KiB committing, "
+		   "%lld KiB max)\n", bud_bytes >> 10, cmt_bud_bytes >> 10,
+		   c->max_bud_bytes >> 10);
+	seq_printf(m, "commits:               %lu\n", st.commits);
+	seq_printf(m, "ends in background:    %lu\n", st.bg_ends);
+	seq_printf(m, "avg/max start time:    %llu/%u us\n",
+		   avg_us(st.start_us, st.commits), st.start_us_max);
+	seq_printf(m, "avg/max end time:      %llu/%u us\n",
+		   avg_us(st.end_us, st.commits), st.end_us_max);
+	seq_printf(m, "waits for commit:      %lu\n", st.waits);
+	seq_printf(m, "avg/max wait time:     %llu/%u us\n",
+		   avg_us(st.wait_us, st.waits), st.wait_us_max);
+	return 0;
+}
+
+static int cmt_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cmt_stats_show, inode->i_private);
+}
+
+static const struct file_operations cmt_stats_fops = {
+	.owner   = THIS_MODULE,
+	.open    = cmt_stats_open,
+	.read    = seq_read,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
+/**
+ * ubifs_cmt_debugfs_init - create the debugfs files of a file-system.
+ * @c: UBIFS file-system description object
+ *
+ * The statistics are in "ubifs/ubiX_Y/commit_stats". Failures are ignored.
+ */
+void ubifs_cmt_debugfs_init(struct ubifs_info *c)
+{
+	char name[sizeof("ubi") + 2 * 10 + 1];
+
+	if (!ubifs_debugfs_root)
+		return;
+
+	sprintf(name, "ubi%d_%d", c->vi.ubi_num, c->vi.vol_id);
+	c->dbg_dir = debugfs_create_dir(name, ubifs_debugfs_root);
+	if (c->dbg_dir)
+		debugfs_create_file("commit_stats", S_IRUGO, c->dbg_dir, c,
+				    &cmt_stats_fops);
+}
+
+/**
+ * ubifs_cmt_debugfs_exit - remove the debugfs files of a file-system.
+ * @c: UBIFS file-system description object
+ */
+void ubifs_cmt_debugfs_exit(struct ubifs_info *c)
+{
+	debugfs_remove_recursive(c->dbg_dir);
+	c->dbg_dir = NULL;
+}
+
+#endif /* CONFIG_DEBUG_FS */
+
 #ifdef CONFIG_UBIFS_FS_DEBUG
 
 /**
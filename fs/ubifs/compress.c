@@ -25,11 +25,43 @@
 /*
  * This file provides a single place to access to compression and
  * decompression.
+ *
+ * Before compressing a block, a sample of it is checked: blocks of already
+ * compressed data (JPEG, MP3, gzip and the like) have almost all the byte
+ * values in the sample, while blocks which LZO or zlib can shrink have
+ * much fewer. Blocks which look incompressible are stored as they are
+ * without running the compressor at all.
+ *
+ * LZO decompression needs no workspace and is done directly with the LZO
+ * library, without locking. zlib needs an inflate workspace, so there is
+ * one inflate stream per CPU, instead of a single one which all the readers
+ * of the system would have to queue for. They are used directly with the
+ * zlib library too: a cryptoapi deflate handle would also carry a deflate
+ * workspace, several times larger, which decompression never touches.
  */
 
 #include <linux/crypto.h>
+#include <linux/lzo.h>
+#include <linux/zlib.h>
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
+#include <linux/debugfs.h>
+#include <linux/module.h>
+#include <linux/math64.h>
 #include "ubifs.h"
 
+/*
+ * The sample is %SAMPLE_CHUNKS runs of %SAMPLE_CHUNK_LEN bytes spread
+ * evenly over the block. Random data has about 160 different byte values
+ * in 256 bytes, text and executable code much fewer; with at least
+ * %SAMPLE_MAX_DISTINCT different values the block is not compressed.
+ * Blocks shorter than %SAMPLE_MIN_LEN are always tried.
+ */
+#define SAMPLE_CHUNKS       32
+#define SAMPLE_CHUNK_LEN    8
+#define SAMPLE_MAX_DISTINCT 140
+#define SAMPLE_MIN_LEN      1024
+
 /* Fake description object for the "none" compressor */
 static struct ubifs_compressor none_compr = {
 	.compr_type = UBIFS_COMPR_NONE,
@@ -46,34 +78,168 @@ static struct ubifs_compressor lzo_compr = {
 	.name = "LZO",
 	.capi_name = "lzo",
 };
+
+static int lzo_decompress(const void *in_buf, int in_len, void *out_buf,
+			  int *out_len)
+{
+	size_t len = *out_len;
+	int err;
+
+	err = lzo1x_decompress_safe(in_buf, in_len, out_buf, &len);
+	if (err != LZO_E_OK)
+		return -EINVAL;
+	*out_len = len;
+	return 0;
+}
 #else
 static struct ubifs_compressor lzo_compr = {
 	.compr_type = UBIFS_COMPR_LZO,
 	.name = "LZO",
 };
+
+static int lzo_decompress(const void *in_buf, int in_len, void *out_buf,
+			  int *out_len)
+{
+	return -EINVAL;
+}
 #endif
 
 #ifdef CONFIG_UBIFS_FS_ZLIB
 static DEFINE_MUTEX(deflate_mutex);
-static DEFINE_MUTEX(inflate_mutex);
 
 static struct ubifs_compressor zlib_compr = {
 	.compr_type = UBIFS_COMPR_ZLIB,
 	.comp_mutex = &deflate_mutex,
-	.decomp_mutex = &inflate_mutex,
+	.percpu_decomp = 1,
 	.name = "zlib",
 	.capi_name = "deflate",
 };
+
+static int zlib_decomp_init(struct ubifs_decompressor *d)
+{
+	d->strm.workspace = vmalloc(zlib_inflate_workspacesize());
+	if (!d->strm.workspace)
+		return -ENOMEM;
+	/* raw deflate, any window size the compressor may have used */
+	if (zlib_inflateInit2(&d->strm, -MAX_WBITS) != Z_OK) {
+		vfree(d->strm.workspace);
+		d->strm.workspace = NULL;
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static void zlib_decomp_exit(struct ubifs_decompressor *d)
+{
+	if (d->strm.workspace) {
+		zlib_inflateEnd(&d->strm);
+		vfree(d->strm.workspace);
+	}
+}
+
+/* This is what the cryptoapi "deflate" decompressor does */
+static int zlib_decompress(struct ubifs_decompressor *d, const void *in_buf,
+			   int in_len, void *out_buf, int *out_len)
+{
+	struct z_stream_s *strm = &d->strm;
+	int err;
+
+	if (zlib_inflateReset(strm) != Z_OK)
+		return -EINVAL;
+
+	strm->next_in = in_buf;
+	strm->avail_in = in_len;
+	strm->next_out = out_buf;
+	strm->avail_out = *out_len;
+
+	err = zlib_inflate(strm, Z_SYNC_FLUSH);
+	/*
+	 * In raw deflate mode zlib sometimes wants to taste an extra byte
+	 * before it reports the end of the stream.
+	 */
+	if (err == Z_OK && !strm->avail_in && strm->avail_out) {
+		u8 zerostuff = 0;
+
+		strm->next_in = &zerostuff;
+		strm->avail_in = 1;
+		err = zlib_inflate(strm, Z_FINISH);
+	}
+	if (err != Z_STREAM_END)
+		return -EINVAL;
+	*out_len = strm->total_out;
+	return 0;
+}
 #else
 static struct ubifs_compressor zlib_compr = {
 	.compr_type = UBIFS_COMPR_ZLIB,
 	.name = "zlib",
 };
+
+static int zlib_decomp_init(struct ubifs_decompressor *d)
+{
+	return -EINVAL;
+}
+
+static void zlib_decomp_exit(struct ubifs_decompressor *d)
+{
+}
+
+static int zlib_decompress(struct ubifs_decompressor *d, const void *in_buf,
+			   int in_len, void *out_buf, int *out_len)
+{
+	return -EINVAL;
+}
 #endif
 
 /* All UBIFS compressors */
 struct ubifs_compressor *ubifs_compressors[UBIFS_COMPR_TYPES_CNT];
 
+/* Protects the statistics of all the compressors */
+static DEFINE_SPINLOCK(compr_stats_lock);
+
+/**
+ * incompressible - check if a sample of a data block looks incompressible.
+ * @buf: data block
+ * @len: length of the data block
+ *
+ * This function returns %1 if the sample of @buf has so many different byte
+ * values that the block is most probably compressed data already, and %0
+ * otherwise.
+ */
+static int incompressible(const unsigned char *buf, int len)
+{
+	DECLARE_BITMAP(seen, 256);
+	int i, j, distinct = 0, step = len / SAMPLE_CHUNKS;
+
+	bitmap_zero(seen, 256);
+	for (i = 0; i < SAMPLE_CHUNKS; i++, buf += step)
+		for (j = 0; j < SAMPLE_CHUNK_LEN; j++)
+			if (!__test_and_set_bit(buf[j], seen))
+				distinct += 1;
+
+	return distinct >= SAMPLE_MAX_DISTINCT;
+}
+
+/**
+ * account - update the statistics of a compressor.
+ * @compr: compressor description object
+ * @in_len: length of the data block
+ * @out_len: length of the data stored on the media
+ * @cnt: counter of the reason why the block was stored uncompressed, or
+ *       %NULL if it was compressed
+ */
+static void account(struct ubifs_compressor *compr, int in_len, int out_len,
+		    unsigned long *cnt)
+{
+	spin_lock(&compr_stats_lock);
+	compr->stats.blocks += 1;
+	compr->stats.in_bytes += in_len;
+	compr->stats.out_bytes += out_len;
+	if (cnt)
+		*cnt += 1;
+	spin_unlock(&compr_stats_lock);
+}
+
 /**
  * ubifs_compress - compress data.
  * @in_buf: data to compress
@@ -85,9 +251,9 @@ struct ubifs_compressor *ubifs_compressors[UBIFS_COMPR_TYPES_CNT];
  *
  * This function compresses input buffer @in_buf of length @in_len and stores
  * the result in the output buffer @out_buf and the resulting length in
- * @out_len. If the input buffer does not compress, it is just copied to the
- * @out_buf. The same happens if @compr_type is %UBIFS_COMPR_NONE or if
- * compression error occurred.
+ * @out_len. If the input buffer does not compress, or a sample of it looks
+ * incompressible, it is just copied to the @out_buf. The same happens if
+ * @compr_type is %UBIFS_COMPR_NONE or if compression error occurred.
  *
  * Note, if the input buffer was not compressed, it is copied to the output
  * buffer and %UBIFS_COMPR_NONE is returned in @compr_type.
@@ -107,6 +273,11 @@ void ubifs_compress(const void *in_buf, int in_len, void *out_buf, int *out_len,
 	if (in_len < UBIFS_MIN_COMPR_LEN)
 		goto no_compr;
 
+	if (in_len >= SAMPLE_MIN_LEN && incompressible(in_buf, in_len)) {
+		account(compr, in_len, in_len, &compr->stats.skipped);
+		goto no_compr;
+	}
+
 	if (compr->comp_mutex)
 		mutex_lock(compr->comp_mutex);
 	err = crypto_comp_compress(compr->cc, in_buf, in_len, out_buf,
@@ -117,16 +288,19 @@ void ubifs_compress(const void *in_buf, int in_len, void *out_buf, int *out_len,
 		ubifs_warn("cannot compress %d bytes, compressor %s, "
 			   "error %d, leave data uncompressed",
 			   in_len, compr->name, err);
-		 goto no_compr;
+		goto no_compr;
 	}
 
 	/*
 	 * Presently, we just require that compression results in less data,
 	 * rather than any defined minimum compression ratio or amount.
 	 */
-	if (ALIGN(*out_len, 8) >= ALIGN(in_len, 8))
+	if (ALIGN(*out_len, 8) >= ALIGN(in_len, 8)) {
+		account(compr, in_len, in_len, &compr->stats.no_gain);
 		goto no_compr;
+	}
 
+	account(compr, in_len, *out_len, NULL);
 	return;
 
 no_compr:
@@ -171,12 +345,20 @@ int ubifs_decompress(const void *in_buf, int in_len, void *out_buf,
 		return 0;
 	}
 
-	if (compr->decomp_mutex)
-		mutex_lock(compr->decomp_mutex);
-	err = crypto_comp_decompress(compr->cc, in_buf, in_len, out_buf,
-				     out_len);
-	if (compr->decomp_mutex)
-		mutex_unlock(compr->decomp_mutex);
+	if (compr_type == UBIFS_COMPR_LZO)
+		err = lzo_decompress(in_buf, in_len, out_buf, out_len);
+	else {
+		struct ubifs_decompressor *d;
+
+		/*
+		 * The task may move to another CPU before it is done, the
+		 * mutex still protects the decompressor it picked.
+		 */
+		d = per_cpu_ptr(compr->decomp, raw_smp_processor_id());
+		mutex_lock(&d->mutex);
+		err = zlib_decompress(d, in_buf, in_len, out_buf, out_len);
+		mutex_unlock(&d->mutex);
+	}
 	if (err)
 		ubifs_err("cannot decompress %d bytes, compressor %s, "
 			  "error %d", in_len, compr->name, err);
@@ -184,6 +366,28 @@ int ubifs_decompress(const void *in_buf, int in_len, void *out_buf,
 	return err;
 }
 
+/**
+ * compr_exit - de-initialize a compressor.
+ * @compr: compressor description object
+ */
+static void compr_exit(struct ubifs_compressor *compr)
+{
+	int cpu;
+	struct ubifs_decompressor *d;
+
+	if (compr->decomp) {
+		for_each_possible_cpu(cpu) {
+			d = per_cpu_ptr(compr->decomp, cpu);
+			zlib_decomp_exit(d);
+		}
+		free_percpu(compr->decomp);
+		compr->decomp = NULL;
+	}
+	if (compr->capi_name)
+		crypto_free_comp(compr->cc);
+	return;
+}
+
 /**
  * compr_init - initialize a compressor.
  * @compr: compressor description object
@@ -193,6 +397,9 @@ int ubifs_decompress(const void *in_buf, int in_len, void *out_buf,
  */
 static int __init compr_init(struct ubifs_compressor *compr)
 {
+	int cpu;
+	struct ubifs_decompressor *d;
+
 	if (compr->capi_name) {
 		compr->cc = crypto_alloc_comp(compr->capi_name, 0, 0);
 		if (IS_ERR(compr->cc)) {
@@ -202,21 +409,32 @@ static int __init compr_init(struct ubifs_compressor *compr)
 		}
 	}
 
+	if (compr->percpu_decomp) {
+		compr->decomp = alloc_percpu(struct ubifs_decompressor);
+		if (!compr->decomp) {
+			compr_exit(compr);
+			return -ENOMEM;
+		}
+		for_each_possible_cpu(cpu) {
+			int err;
+
+			d = per_cpu_ptr(compr->decomp, cpu);
+			mutex_init(&d->mutex);
+			err = zlib_decomp_init(d);
+			if (err) {
+				ubifs_err("cannot initialize %s decompressor "
+					  "of CPU %d, error %d", compr->name,
+					  cpu, err);
+				compr_exit(compr);
+				return err;
+			}
+		}
+	}
+
 	ubifs_compressors[compr->compr_type] = compr;
 	return 0;
 }
 
-/**
- * compr_exit - de-initialize a compressor.
- * @compr: compressor description object
- */
-static void compr_exit(struct ubifs_compressor *compr)
-{
-	if (compr->capi_name)
-		crypto_free_comp(compr->cc);
-	return;
-}
-
 /**
  * ubifs_compressors_init - initialize UBIFS compressors.
  *
@@ -243,6 +461,64 @@ out_lzo:
 	return err;
 }
 
+#ifdef CONFIG_DEBUG_FS
+
+static int compr_stats_show(struct seq_file *m, void *v)
+{
+	int i;
+	struct ubifs_compr_stats st;
+	unsigned int ratio;
+
+	seq_printf(m, "compressor  blocks     skipped    no gain    "
+		   "in KiB     out KiB    out/in\n");
+	for (i = 0; i < UBIFS_COMPR_TYPES_CNT; i++) {
+		struct ubifs_compressor *compr = ubifs_compressors[i];
+
+		if (i == UBIFS_COMPR_NONE || !compr->capi_name)
+			continue;
+		spin_lock(&compr_stats_lock);
+		st = compr->stats;
+		spin_unlock(&compr_stats_lock);
+
+		ratio = 0;
+		if (st.in_bytes)
+			ratio = div64_u64(st.out_bytes * 100, st.in_bytes);
+		seq_printf(m, "%-11s %-10lu %-10lu %-10lu %-10llu %-10llu "
+			   "%u%%\n", compr->name, st.blocks, st.skipped,
+			   st.no_gain, st.in_bytes >> 10, st.out_bytes >> 10,
+			   ratio);
+	}
+	return 0;
+}
+
+static int compr_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, compr_stats_show, NULL);
+}
+
+static const struct file_operations compr_stats_fops = {
+	.owner   = THIS_MODULE,
+	.open    = compr_stats_open,
+	.read    = seq_read,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
+/**
+ * ubifs_compr_debugfs_init - create the compressor statistics file.
+ *
+ * The statistics are in "ubifs/compr_stats" and cover all the mounted
+ * file-systems. Failures are ignored.
+ */
+void __init ubifs_compr_debugfs_init(void)
+{
+	if (ubifs_debugfs_root)
+		debugfs_create_file("compr_stats", S_IRUGO, ubifs_debugfs_root,
+				    NULL, &compr_stats_fops);
+}
+
+#endif /* CONFIG_DEBUG_FS */
+
 /**
  * ubifs_compressors_exit - de-initialize UBIFS compressors.
  */
@@ -75,6 +75,33 @@ static int inherit_flags(const struct inode *dir, int mode)
 	return flags;
 }
 
+/**
+ * inherit_compr - get the compressor of a new inode.
+ * @c: UBIFS file-system description object
+ * @dir: parent directory inode
+ * @mode: new inode mode flags
+ *
+ * Regular files and directories get the compressor set on the parent
+ * directory with the %UBIFS_IOC_SETCOMPR ioctl, if any. Otherwise, regular
+ * files get the default compressor and directories %UBIFS_COMPR_NONE,
+ * which means "the default" for their children.
+ */
+static int inherit_compr(const struct ubifs_info *c, const struct inode *dir,
+			 int mode)
+{
+	int compr_type = UBIFS_COMPR_NONE;
+
+	if (!S_ISREG(mode) && !S_ISDIR(mode))
+		return UBIFS_COMPR_NONE;
+
+	/* Extended attribute inodes have a non-directory parent */
+	if (S_ISDIR(dir->i_mode))
+		compr_type = ubifs_inode(dir)->compr_type;
+	if (compr_type == UBIFS_COMPR_NONE && S_ISREG(mode))
+		compr_type = c->default_compr;
+	return compr_type;
+}
+
 /**
  * ubifs_new_inode - allocate new UBIFS inode object.
  * @c: UBIFS file-system description object
@@ -144,10 +171,7 @@ struct inode *ubifs_new_inode(struct ubifs_info *c, const struct inode *dir,
 
 	ui->flags = inherit_flags(dir, mode);
 	ubifs_set_inode_flags(inode);
-	if (S_ISREG(mode))
-		ui->compr_type = c->default_compr;
-	else
-		ui->compr_type = UBIFS_COMPR_NONE;
+	ui->compr_type = inherit_compr(c, dir, mode);
 	ui->synced_i_size = 0;
 
 	spin_lock(&c->cnt_lock);
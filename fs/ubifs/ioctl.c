@@ -22,11 +22,15 @@
  *          Adrian Hunter
  */
 
-/* This file implements EXT2-compatible extended attribute ioctl() calls */
+/*
+ * This file implements EXT2-compatible extended attribute ioctl() calls and
+ * the UBIFS-specific per-inode compressor selection.
+ */
 
 #include <linux/compat.h>
 #include <linux/smp_lock.h>
 #include <linux/mount.h>
+#include <mtd/ubifs-user.h>
 #include "ubifs.h"
 
 /**
@@ -145,6 +149,42 @@ out_unlock:
 	return err;
 }
 
+/**
+ * setcompr - set the compressor of an inode.
+ * @inode: inode to change
+ * @compr_type: new compressor type
+ *
+ * Regular files use @compr_type for the data written from now on, new
+ * inodes created in a directory get @compr_type, see 'ubifs_new_inode()'.
+ * Returns zero in case of success and a negative error code in case of
+ * failure.
+ */
+static int setcompr(struct inode *inode, int compr_type)
+{
+	int err, release;
+	struct ubifs_inode *ui = ubifs_inode(inode);
+	struct ubifs_info *c = inode->i_sb->s_fs_info;
+	struct ubifs_budget_req req = { .dirtied_ino = 1,
+					.dirtied_ino_d = ui->data_len };
+
+	err = ubifs_budget_space(c, &req);
+	if (err)
+		return err;
+
+	mutex_lock(&ui->ui_mutex);
+	ui->compr_type = compr_type;
+	inode->i_ctime = ubifs_current_time(inode);
+	release = ui->dirty;
+	mark_inode_dirty_sync(inode);
+	mutex_unlock(&ui->ui_mutex);
+
+	if (release)
+		ubifs_release_budget(c, &req);
+	if (IS_SYNC(inode))
+		err = write_inode_now(inode, 1);
+	return err;
+}
+
 long ubifs_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
 	int flags, err;
@@ -181,6 +221,38 @@ long ubifs_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		return err;
 	}
 
+	case UBIFS_IOC_GETCOMPR:
+		return put_user(ubifs_inode(inode)->compr_type,
+				(int32_t __user *) arg);
+
+	case UBIFS_IOC_SETCOMPR: {
+		int32_t compr_type;
+
+		if (!S_ISREG(inode->i_mode) && !S_ISDIR(inode->i_mode))
+			return -ENOTTY;
+
+		if (IS_RDONLY(inode))
+			return -EROFS;
+
+		if (!is_owner_or_cap(inode))
+			return -EACCES;
+
+		if (get_user(compr_type, (int32_t __user *) arg))
+			return -EFAULT;
+
+		if (compr_type < 0 || compr_type >= UBIFS_COMPR_TYPES_CNT)
+			return -EINVAL;
+		if (!ubifs_compr_present(compr_type))
+			return -EOPNOTSUPP;
+
+		err = mnt_want_write(file->f_path.mnt);
+		if (err)
+			return err;
+		err = setcompr(inode, compr_type);
+		mnt_drop_write(file->f_path.mnt);
+		return err;
+	}
+
 	default:
 		return -ENOTTY;
 	}
@@ -196,6 +268,9 @@ long ubifs_compat_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	case FS_IOC32_SETFLAGS:
 		cmd = FS_IOC_SETFLAGS;
 		break;
+	case UBIFS_IOC_GETCOMPR:
+	case UBIFS_IOC_SETCOMPR:
+		break;
 	default:
 		return -ENOIOCTLCMD;
 	}
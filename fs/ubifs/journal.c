@@ -366,7 +366,17 @@ again:
 		cmt_retries);
 	cmt_retries += 1;
 
-	err = ubifs_run_commit(c);
+	/*
+	 * The journal is most probably full. Then it is enough to wait for
+	 * commit start, after which the journal can grow again, and the
+	 * background thread finishes the commit. If this does not help, e.g.
+	 * because the log is full or GC needs the commit, wait for the whole
+	 * commit.
+	 */
+	if (cmt_retries == 1 && !nospc_retries)
+		err = ubifs_run_commit_start(c);
+	else
+		err = ubifs_run_commit(c);
 	if (err)
 		return err;
 	goto again;
@@ -703,7 +713,7 @@ int ubifs_jnl_write_data(struct ubifs_info *c, const struct inode *inode,
 	data->size = cpu_to_le32(len);
 	zero_data_node_unused(data);
 
-	if (!(ui->flags && UBIFS_COMPR_FL))
+	if (!(ui->flags & UBIFS_COMPR_FL))
 		/* Compression is disabled for this inode */
 		compr_type = UBIFS_COMPR_NONE;
 	else
@@ -243,11 +243,17 @@ int ubifs_add_bud_to_log(struct ubifs_info *c, int jhead, int lnum, int offs)
 	 * 'c->max_bud_bytes' limit, because we want to guarantee mount time
 	 * limits.
 	 *
+	 * The buds of a running commit are not counted, so that writers are
+	 * not blocked until the commit ends. This means that after an unclean
+	 * reboot in the middle of a commit, the replay may have to read up to
+	 * twice 'c->max_bud_bytes'.
+	 *
 	 * It is not necessary to hold @c->buds_lock when reading @c->bud_bytes
 	 * because we are holding @c->log_mutex. All @c->bud_bytes take place
 	 * when both @c->log_mutex and @c->bud_bytes are locked.
 	 */
-	if (c->bud_bytes + c->leb_size - offs > c->max_bud_bytes) {
+	if (c->bud_bytes - c->cmt_bud_bytes + c->leb_size - offs >
+	    c->max_bud_bytes) {
 		dbg_log("bud bytes %lld (%lld max), require commit",
 			c->bud_bytes, c->max_bud_bytes);
 		ubifs_commit_required(c);
@@ -516,6 +522,7 @@ int ubifs_log_end_commit(struct ubifs_info *c, int ltail_lnum)
 
 	spin_lock(&c->buds_lock);
 	c->bud_bytes -= c->cmt_bud_bytes;
+	c->cmt_bud_bytes = 0;
 	spin_unlock(&c->buds_lock);
 
 	err = dbg_check_bud_bytes(c);
@@ -34,6 +34,7 @@
 #include <linux/parser.h>
 #include <linux/seq_file.h>
 #include <linux/mount.h>
+#include <linux/debugfs.h>
 #include "ubifs.h"
 
 /* Slab cache for UBIFS inodes */
@@ -1198,6 +1199,7 @@ static int mount_ubifs(struct ubifs_info *c)
 	dbg_msg("max. seq. number:    %llu", c->max_sqnum);
 	dbg_msg("commit number:       %llu", c->cmt_no);
 
+	ubifs_cmt_debugfs_init(c);
 	return 0;
 
 out_infos:
@@ -1243,6 +1245,8 @@ static void ubifs_umount(struct ubifs_info *c)
 	dbg_gen("un-mounting UBI device %d, volume %d", c->vi.ubi_num,
 		c->vi.vol_id);
 
+	ubifs_cmt_debugfs_exit(c);
+
 	spin_lock(&ubifs_infos_lock);
 	list_del(&c->infos_list);
 	spin_unlock(&ubifs_infos_lock);
@@ -1938,6 +1942,11 @@ static int __init ubifs_init(void)
 	if (err)
 		goto out_compr;
 
+#ifdef CONFIG_DEBUG_FS
+	/* Statistics only, UBIFS works without them */
+	ubifs_debugfs_root = debugfs_create_dir("ubifs", NULL);
+	ubifs_compr_debugfs_init();
+#endif
 	return 0;
 
 out_compr:
@@ -1955,6 +1964,9 @@ static void __exit ubifs_exit(void)
 	ubifs_assert(list_empty(&ubifs_infos));
 	ubifs_assert(atomic_long_read(&ubifs_clean_zn_cnt) == 0);
 
+#ifdef CONFIG_DEBUG_FS
+	debugfs_remove_recursive(ubifs_debugfs_root);
+#endif
 	ubifs_compressors_exit();
 	unregister_shrinker(&ubifs_shrinker_info);
 	kmem_cache_destroy(ubifs_inode_slab);
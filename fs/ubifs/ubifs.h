@@ -35,6 +35,7 @@
 #include <linux/mtd/ubi.h>
 #include <linux/pagemap.h>
 #include <linux/backing-dev.h>
+#include <linux/zlib.h>
 #include "ubifs-media.h"
 
 /* Version of this UBIFS implementation */
@@ -759,22 +760,55 @@ struct ubifs_node_range {
 	int max_len;
 };
 
+/**
+ * struct ubifs_decompressor - per-CPU decompressor.
+ * @strm: zlib inflate stream, its workspace is vmalloc'ed
+ * @mutex: serializes the users of @strm
+ */
+struct ubifs_decompressor {
+	struct z_stream_s strm;
+	struct mutex mutex;
+};
+
+/**
+ * struct ubifs_compr_stats - compressor statistics.
+ * @blocks: count of data blocks given to the compressor
+ * @skipped: how many of them were not compressed because a sample of the
+ *           block looked incompressible
+ * @no_gain: how many of them were not compressed because the compressed
+ *           data were not smaller
+ * @in_bytes: total length of the blocks
+ * @out_bytes: total length of the data stored for them
+ */
+struct ubifs_compr_stats {
+	unsigned long blocks;
+	unsigned long skipped;
+	unsigned long no_gain;
+	unsigned long long in_bytes;
+	unsigned long long out_bytes;
+};
+
 /**
  * struct ubifs_compressor - UBIFS compressor description structure.
  * @compr_type: compressor type (%UBIFS_COMPR_LZO, etc)
  * @cc: cryptoapi compressor handle
  * @comp_mutex: mutex used during compression
- * @decomp_mutex: mutex used during decompression
+ * @percpu_decomp: the compressor needs a workspace to decompress, so
+ *                 decompression uses a per-CPU zlib stream from @decomp
+ * @decomp: per-CPU decompressors
  * @name: compressor name
  * @capi_name: cryptoapi compressor name
+ * @stats: compression statistics (protected by a lock in compress.c)
  */
 struct ubifs_compressor {
 	int compr_type;
 	struct crypto_comp *cc;
 	struct mutex *comp_mutex;
-	struct mutex *decomp_mutex;
+	int percpu_decomp;
+	struct ubifs_decompressor *decomp;
 	const char *name;
 	const char *capi_name;
+	struct ubifs_compr_stats stats;
 };
 
 /**
@@ -859,6 +893,33 @@ struct ubifs_orphan {
 	int new;
 };
 
+/**
+ * struct ubifs_cmt_stats - commit statistics.
+ * @commits: number of commits
+ * @bg_ends: number of commit ends left to the background thread by a journal
+ *           writer
+ * @start_us: total time spent in commit start, when writers are blocked
+ * @start_us_max: longest commit start
+ * @end_us: total time spent in commit end
+ * @end_us_max: longest commit end
+ * @waits: number of times a task had to run or wait for a commit
+ * @wait_us: total time tasks spent running or waiting for a commit
+ * @wait_us_max: longest of these waits
+ *
+ * The statistics are protected by @c->cs_lock and shown in debugfs.
+ */
+struct ubifs_cmt_stats {
+	unsigned long commits;
+	unsigned long bg_ends;
+	unsigned long long start_us;
+	unsigned int start_us_max;
+	unsigned long long end_us;
+	unsigned int end_us_max;
+	unsigned long waits;
+	unsigned long long wait_us;
+	unsigned int wait_us_max;
+};
+
 /**
  * struct ubifs_mount_opts - UBIFS-specific mount options information.
  * @unmount_mode: selected unmount mode (%0 default, %1 normal, %2 fast)
@@ -888,7 +949,7 @@ struct ubifs_mount_opts {
  *             @bud_bytes
  * @min_log_bytes: minimum required number of bytes in the log
  * @cmt_bud_bytes: used during commit to temporarily amount of bytes in
- *                 committed buds
+ *                 committed buds; zero when no commit is running
  *
  * @buds: tree of all buds indexed by bud LEB number
  * @bud_bytes: how many bytes of flash is used by buds
@@ -905,6 +966,13 @@ struct ubifs_mount_opts {
  * @cmt_state: commit state
  * @cs_lock: commit state lock
  * @cmt_wq: wait queue to sleep on if the log is full and a commit is running
+ * @cmt_end_bgt: the end of the running commit is left to the background
+ *               thread (protected by @cs_lock)
+ * @cmt_new_ltail_lnum: new log tail of the running commit
+ * @cmt_zroot: new index root of the running commit
+ * @cmt_lst: LEB properties statistics taken at the start of the running commit
+ * @cmt_stats: commit statistics
+ * @dbg_dir: debugfs directory of this file-system
  * @fast_unmount: do not run journal commit before un-mounting
  * @big_lpt: flag that LPT is too big to write whole during commit
  * @check_lpt_free: flag that indicates LPT GC may be needed
@@ -1146,6 +1214,14 @@ struct ubifs_info {
 	int cmt_state;
 	spinlock_t cs_lock;
 	wait_queue_head_t cmt_wq;
+	int cmt_end_bgt;
+	int cmt_new_ltail_lnum;
+	struct ubifs_zbranch cmt_zroot;
+	struct ubifs_lp_stats cmt_lst;
+	struct ubifs_cmt_stats cmt_stats;
+#ifdef CONFIG_DEBUG_FS
+	struct dentry *dbg_dir;
+#endif
 	unsigned int fast_unmount:1;
 	unsigned int big_lpt:1;
 	unsigned int check_lpt_free:1;
@@ -1518,9 +1594,18 @@ int ubifs_bg_thread(void *info);
 void ubifs_commit_required(struct ubifs_info *c);
 void ubifs_request_bg_commit(struct ubifs_info *c);
 int ubifs_run_commit(struct ubifs_info *c);
+int ubifs_run_commit_start(struct ubifs_info *c);
 void ubifs_recovery_commit(struct ubifs_info *c);
 int ubifs_gc_should_commit(struct ubifs_info *c);
 void ubifs_wait_for_commit(struct ubifs_info *c);
+#ifdef CONFIG_DEBUG_FS
+extern struct dentry *ubifs_debugfs_root;
+void ubifs_cmt_debugfs_init(struct ubifs_info *c);
+void ubifs_cmt_debugfs_exit(struct ubifs_info *c);
+#else
+#define ubifs_cmt_debugfs_init(c)
+#define ubifs_cmt_debugfs_exit(c)
+#endif
 
 /* master.c */
 int ubifs_read_master(struct ubifs_info *c);
@@ -1656,6 +1741,11 @@ long ubifs_compat_ioctl(struct file *file, unsigned int cmd, unsigned long arg);
 /* compressor.c */
 int __init ubifs_compressors_init(void);
 void __exit ubifs_compressors_exit(void);
+#ifdef CONFIG_DEBUG_FS
+void __init ubifs_compr_debugfs_init(void);
+#else
+#define ubifs_compr_debugfs_init()
+#endif
 void ubifs_compress(const void *in_buf, int in_len, void *out_buf, int *out_len,
 		    int *compr_type);
 int ubifs_decompress(const void *buf, int len, void *out, int *out_len,
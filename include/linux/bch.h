@@ -0,0 +1,59 @@
+/*
+ * include/linux/bch.h
+ *
+ * Generic binary BCH encoding/decoding library
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#ifndef _BCH_H
+#define _BCH_H
+
+#include <linux/types.h>
+
+struct gf_poly;
+
+/**
+ * struct bch_control - BCH control structure
+ *
+ * @m:		Galois field order, the field is GF(2^m)
+ * @n:		maximum codeword length in bits (= 2^m-1)
+ * @t:		error correction capability in bits
+ * @ecc_bits:	ecc length in bits (degree of the generator polynomial)
+ * @ecc_bytes:	ecc length in bytes
+ *
+ * The other fields are private to lib/bch.c. The decoding buffers live
+ * in the control structure, so callers have to serialize decode_bch()
+ * calls on the same control structure.
+ */
+struct bch_control {
+	unsigned int	m;
+	unsigned int	n;
+	unsigned int	t;
+	unsigned int	ecc_bits;
+	unsigned int	ecc_bytes;
+/* private: */
+	unsigned int	ecc_words;
+	uint16_t	*a_pow_tab;
+	uint16_t	*a_log_tab;
+	uint32_t	*mod_tab;
+	uint32_t	*ecc_buf;
+	unsigned int	*syn;
+	struct gf_poly	*elp;
+	struct gf_poly	*pelp;
+	struct gf_poly	*elp_copy;
+	int		*chien;
+	unsigned int	*xi_tab;
+};
+
+struct bch_control *init_bch(int m, int t, unsigned int prim_poly);
+void free_bch(struct bch_control *bch);
+
+void encode_bch(struct bch_control *bch, const uint8_t *data,
+		unsigned int len, uint8_t *ecc);
+int decode_bch(struct bch_control *bch, unsigned int len,
+	       const uint8_t *recv_ecc, const uint8_t *calc_ecc,
+	       unsigned int *errloc);
+
+#endif /* _BCH_H */
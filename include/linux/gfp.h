@@ -225,6 +225,24 @@ extern struct page *alloc_page_vma(gfp_t gfp_mask,
 #endif
 #define alloc_page(gfp_mask) alloc_pages(gfp_mask, 0)
 
+extern unsigned long __alloc_pages_bulk(gfp_t gfp_mask, unsigned long nr_pages,
+					struct list_head *list,
+					struct page **page_array);
+
+static inline unsigned long
+alloc_pages_bulk_list(gfp_t gfp_mask, unsigned long nr_pages,
+		      struct list_head *list)
+{
+	return __alloc_pages_bulk(gfp_mask, nr_pages, list, NULL);
+}
+
+static inline unsigned long
+alloc_pages_bulk_array(gfp_t gfp_mask, unsigned long nr_pages,
+		       struct page **page_array)
+{
+	return __alloc_pages_bulk(gfp_mask, nr_pages, NULL, page_array);
+}
+
 extern unsigned long __get_free_pages(gfp_t gfp_mask, unsigned int order);
 extern unsigned long get_zeroed_page(gfp_t gfp_mask);
 
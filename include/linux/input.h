@@ -55,6 +55,14 @@ struct input_absinfo {
 	__s32 flat;
 };
 
+struct input_client_stats {
+	__u32 queued;		/* events stored in the client buffer */
+	__u32 coalesced;	/* events merged into an earlier one */
+	__u32 wakeups;		/* times new events were made readable */
+	__u32 reads;		/* read() calls that returned events */
+	__u32 copied;		/* events copied to userspace */
+};
+
 #define EVIOCGVERSION		_IOR('E', 0x01, int)			/* get driver version */
 #define EVIOCGID		_IOR('E', 0x02, struct input_id)	/* get device ID */
 #define EVIOCGREP		_IOR('E', 0x03, int[2])			/* get repeat settings */
@@ -80,6 +88,16 @@ struct input_absinfo {
 #define EVIOCGEFFECTS		_IOR('E', 0x84, int)			/* Report number of effects playable at the same time */
 
 #define EVIOCGRAB		_IOW('E', 0x90, int)			/* Grab/Release device */
+#define EVIOCSBATCH		_IOW('E', 0x91, int)			/* Set per-client batching flags */
+#define EVIOCGSTATS		_IOR('E', 0x92, struct input_client_stats)	/* Get per-client delivery counters */
+
+/*
+ * Per-client batching flags (EVIOCSBATCH)
+ */
+
+#define EVDEV_BATCH_SYN_REPORT	0x01	/* wake readers on SYN_REPORT only */
+#define EVDEV_BATCH_COALESCE_ABS	0x02	/* merge repeated ABS_X/ABS_Y in a frame */
+#define EVDEV_BATCH_MASK	0x03
 
 /*
  * Event types
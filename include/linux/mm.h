@@ -1163,7 +1163,8 @@ int write_one_page(struct page *page, int wait);
 #define VM_MIN_READAHEAD	16	/* kbytes (includes current page) */
 
 int do_page_cache_readahead(struct address_space *mapping, struct file *filp,
-			pgoff_t offset, unsigned long nr_to_read);
+			pgoff_t offset, unsigned long nr_to_read,
+			pgoff_t req_offset);
 int force_page_cache_readahead(struct address_space *mapping, struct file *filp,
 			pgoff_t offset, unsigned long nr_to_read);
 
@@ -1182,6 +1183,18 @@ void page_cache_async_readahead(struct address_space *mapping,
 
 unsigned long max_sane_readahead(unsigned long nr);
 
+void __readahead_page_used(struct address_space *mapping, struct page *page);
+
+/*
+ * Account the use of a page, if it was read ahead and not used before.
+ */
+static inline void readahead_page_used(struct address_space *mapping,
+				       struct page *page)
+{
+	if (unlikely(PagePrefetched(page)))
+		__readahead_page_used(mapping, page);
+}
+
 /* Do stack extension */
 extern int expand_stack(struct vm_area_struct *vma, unsigned long address);
 #ifdef CONFIG_IA64
@@ -205,6 +205,8 @@ struct msdos_dir_slot {
 #include <linux/nls.h>
 #include <linux/fs.h>
 #include <linux/mutex.h>
+#include <linux/rbtree.h>
+#include <linux/completion.h>
 
 /*
  * vfat shortname flags
@@ -263,6 +265,13 @@ struct msdos_sb_info {
 	unsigned int prev_free;      /* previously allocated cluster number */
 	unsigned int free_clusters;  /* -1 if undefined */
 	unsigned int free_clus_valid; /* is free_clusters valid? */
+	unsigned long *free_map;     /* free cluster bitmap, or NULL */
+	unsigned int free_map_scanned; /* free_map is valid below this entry */
+	unsigned int free_map_count; /* free clusters below free_map_scanned */
+	int free_map_stop;	     /* tells the scanner thread to quit */
+	int free_map_no_run;	     /* no free run left, see fat_free_map_find() */
+	struct mutex free_map_mutex; /* serializes free_map scanners */
+	struct completion free_map_done; /* scanner thread has exited */
 	struct fat_mount_options options;
 	struct nls_table *nls_disk;  /* Codepage used on disk */
 	struct nls_table *nls_io;    /* Charset used for input and display */
@@ -285,12 +294,14 @@ struct msdos_sb_info {
 struct msdos_inode_info {
 	spinlock_t cache_lru_lock;
 	struct list_head cache_lru;
+	struct rb_root cache_tree;	/* cluster chain extents by fcluster */
 	int nr_caches;
 	/* for avoiding the race between fat_free() and fat_get_cluster() */
 	unsigned int cache_valid_id;
 
 	loff_t mmu_private;
 	int i_start;		/* first cluster or 0 */
+	int i_alloc_goal;	/* cluster to allocate next, or 0 */
 	int i_logstart;		/* logical first cluster */
 	int i_attrs;		/* unused attribute bits */
 	loff_t i_pos;		/* on-disk position of directory entry or 0 */
@@ -440,6 +451,8 @@ extern int fat_alloc_clusters(struct inode *inode, int *cluster,
 			      int nr_cluster);
 extern int fat_free_clusters(struct inode *inode, int cluster);
 extern int fat_count_free_clusters(struct super_block *sb);
+extern void fat_free_map_init(struct super_block *sb);
+extern void fat_free_map_exit(struct super_block *sb);
 
 /* fat/file.c */
 extern int fat_generic_ioctl(struct inode *inode, struct file *filp,
@@ -23,6 +23,7 @@ struct timed_gpio {
 	unsigned 	gpio;
 	int		 max_timeout;
 	u8 		active_low;
+	unsigned	slack_us;	/* initial timer slack, see slack_us */
 };
 
 struct timed_gpio_platform_data {
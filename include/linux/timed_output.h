@@ -16,6 +16,9 @@
 #ifndef _LINUX_TIMED_OUTPUT_H
 #define _LINUX_TIMED_OUTPUT_H
 
+/* longest on/off sequence accepted through the pattern attribute */
+#define TIMED_OUTPUT_PATTERN_MAX	16
+
 struct timed_output_dev {
 	const char	*name;
 
@@ -25,6 +28,17 @@ struct timed_output_dev {
 	/* returns the current number of milliseconds remaining on the timer */
 	int		(*get_time)(struct timed_output_dev *sdev);
 
+	/*
+	 * optional: play count alternating on/off durations in milliseconds,
+	 * starting with on, repeat + 1 times
+	 */
+	int	(*set_pattern)(struct timed_output_dev *sdev,
+			const unsigned int *ms, int count, int repeat);
+
+	/* optional: how late, in microseconds, a step may be switched */
+	void	(*set_slack)(struct timed_output_dev *sdev, unsigned int slack_us);
+	unsigned int	(*get_slack)(struct timed_output_dev *sdev);
+
 	/* private data */
 	struct device	*dev;
 	int		index;
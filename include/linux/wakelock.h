@@ -73,6 +73,11 @@ int wake_lock_active(struct wake_lock *lock);
  */
 long has_wake_lock(int type);
 
+#ifdef CONFIG_WAKELOCK_STAT
+extern int wakeup_irq_pending;
+void wake_lock_record_wakeup_irq(unsigned int irq, const char *name);
+#endif
+
 #else
 
 static inline void wake_lock_init(struct wake_lock *lock, int type,
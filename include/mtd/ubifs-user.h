@@ -0,0 +1,50 @@
+/*
+ * This file is part of UBIFS.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __UBIFS_USER_H__
+#define __UBIFS_USER_H__
+
+/*
+ * Per-inode compressor selection
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ * The compressor used for the data written to a regular file may be read
+ * with the %UBIFS_IOC_GETCOMPR ioctl command and changed with
+ * %UBIFS_IOC_SETCOMPR; the argument is a pointer to an int32_t holding the
+ * compressor type of the UBIFS media format: 0 for none, 1 for LZO and 2
+ * for zlib. Changing the compressor does not re-compress the data already
+ * in the file.
+ *
+ * On a directory, the compressor is the one which the new files and
+ * sub-directories created in it get; 0 means the default compressor of the
+ * file-system.
+ *
+ * Data is only compressed if the inode has the compression flag
+ * (%FS_COMPR_FL, "chattr +c"), which new inodes inherit from their parent
+ * directory and which is set on the root directory by default.
+ */
+
+/* IOCTL commands of UBIFS files and directories */
+
+#define UBIFS_IOC_MAGIC 'o'
+
+/* Get the compressor of an inode */
+#define UBIFS_IOC_GETCOMPR _IOR(UBIFS_IOC_MAGIC, 128, int32_t)
+/* Set the compressor of an inode */
+#define UBIFS_IOC_SETCOMPR _IOW(UBIFS_IOC_MAGIC, 129, int32_t)
+
+#endif /* __UBIFS_USER_H__ */
@@ -6,6 +6,7 @@
 #include <linux/delay.h>
 #include <linux/string.h>
 #include <linux/syscalls.h>
+#include <linux/hrtimer.h>
 
 static __initdata char *message;
 static void __init error(char *x)
@@ -425,6 +426,8 @@ static void __init flush_window(void)
 
 static char * __init unpack_to_rootfs(char *buf, unsigned len, int check_only)
 {
+	ktime_t start = ktime_get();
+	unsigned size = len;
 	int written;
 	dry_run = check_only;
 	header_buf = kmalloc(110, GFP_KERNEL);
@@ -470,6 +473,9 @@ static char * __init unpack_to_rootfs(char *buf, unsigned len, int check_only)
 	kfree(name_buf);
 	kfree(symlink_buf);
 	kfree(header_buf);
+	if (!check_only && !message && size)
+		printk(KERN_INFO "initramfs: unpacked %u bytes in %lld us\n",
+		       size, ktime_us_delta(ktime_get(), start));
 	return message;
 }
 
@@ -15,6 +15,7 @@
 #include <linux/random.h>
 #include <linux/interrupt.h>
 #include <linux/kernel_stat.h>
+#include <linux/wakelock.h>
 
 #include "internals.h"
 
@@ -133,6 +134,12 @@ irqreturn_t handle_IRQ_event(unsigned int irq, struct irqaction *action)
 
 	handle_dynamic_tick(action);
 
+#ifdef CONFIG_WAKELOCK_STAT
+	/* first device interrupt after suspend: that is what woke us */
+	if (unlikely(wakeup_irq_pending) && !(action->flags & IRQF_TIMER))
+		wake_lock_record_wakeup_irq(irq, action->name);
+#endif
+
 	if (!(action->flags & IRQF_DISABLED))
 		local_irq_enable_in_hardirq();
 
@@ -54,6 +54,200 @@ static struct wake_lock deleted_wake_locks;
 static ktime_t last_sleep_time_update;
 static int wait_for_wakeup;
 
+/*
+ * Wakeup attribution: the interrupt that ended a suspend, the wake locks
+ * taken until the next suspend attempt, how long resume took (wakeup
+ * interrupt to pm_suspend() returning) and how long the system then
+ * stayed awake. Each wakeup is accounted to one row per (irq, lock).
+ */
+#define WAKEUP_LOCKS_MAX	4
+#define WAKEUP_NAME_LEN		32
+#define WAKEUP_STAT_ROWS	32
+
+int wakeup_irq_pending __read_mostly;
+
+static struct {
+	int active;		/* from suspend_late to next suspend attempt */
+	int resumed;
+	int irq;		/* -1 if no interrupt was seen */
+	char irq_name[WAKEUP_NAME_LEN];	/* of the irq action, at wakeup */
+	ktime_t irq_time;
+	ktime_t resume_time;
+	int nr_locks;
+	char locks[WAKEUP_LOCKS_MAX][WAKEUP_NAME_LEN];
+} cur_wakeup;
+
+static struct wakeup_stat {
+	int irq;
+	char irq_name[WAKEUP_NAME_LEN];
+	char lock[WAKEUP_NAME_LEN];
+	int count;
+	ktime_t resume_time;
+	ktime_t max_resume_time;
+	ktime_t awake_time;
+	ktime_t max_awake_time;
+} wakeup_stats[WAKEUP_STAT_ROWS];
+static int nr_wakeup_stats;
+
+/*
+ * Called from the handler of the irq, so the name of its action is
+ * stable here, unlike later when free_irq() may run.
+ */
+void wake_lock_record_wakeup_irq(unsigned int irq, const char *name)
+{
+	unsigned long irqflags;
+
+	spin_lock_irqsave(&list_lock, irqflags);
+	if (wakeup_irq_pending) {
+		wakeup_irq_pending = 0;
+		cur_wakeup.irq = irq;
+		strlcpy(cur_wakeup.irq_name, name ? name : "unknown",
+			WAKEUP_NAME_LEN);
+		cur_wakeup.irq_time = ktime_get();
+	}
+	spin_unlock_irqrestore(&list_lock, irqflags);
+}
+
+static void wakeup_add_lock_locked(struct wake_lock *lock)
+{
+	int i;
+
+	if (!cur_wakeup.active)
+		return;
+	for (i = 0; i < cur_wakeup.nr_locks; i++)
+		if (!strncmp(cur_wakeup.locks[i], lock->name, WAKEUP_NAME_LEN))
+			return;
+	if (cur_wakeup.nr_locks == WAKEUP_LOCKS_MAX)
+		return;
+	strlcpy(cur_wakeup.locks[cur_wakeup.nr_locks++], lock->name,
+		WAKEUP_NAME_LEN);
+}
+
+static struct wakeup_stat *wakeup_stat_row_locked(int irq,
+						  const char *irq_name,
+						  const char *name)
+{
+	struct wakeup_stat *row;
+	int i;
+
+	for (i = 0; i < nr_wakeup_stats; i++) {
+		row = &wakeup_stats[i];
+		if (row->irq == irq && !strcmp(row->lock, name))
+			return row;
+	}
+
+	/* table full: the last row collects everything else */
+	if (nr_wakeup_stats == WAKEUP_STAT_ROWS)
+		return &wakeup_stats[WAKEUP_STAT_ROWS - 1];
+
+	row = &wakeup_stats[nr_wakeup_stats++];
+	row->irq = irq;
+	strlcpy(row->irq_name, irq_name, WAKEUP_NAME_LEN);
+	strlcpy(row->lock, name, WAKEUP_NAME_LEN);
+	if (nr_wakeup_stats == WAKEUP_STAT_ROWS) {
+		row->irq = -1;
+		strlcpy(row->irq_name, "other", WAKEUP_NAME_LEN);
+		strlcpy(row->lock, "other", WAKEUP_NAME_LEN);
+	}
+	return row;
+}
+
+static void wakeup_arm_locked(void)
+{
+	memset(&cur_wakeup, 0, sizeof(cur_wakeup));
+	cur_wakeup.active = 1;
+	cur_wakeup.irq = -1;
+	wakeup_irq_pending = 1;
+}
+
+static void wakeup_resumed_locked(int ret)
+{
+	wakeup_irq_pending = 0;
+	if (ret) {
+		/* the suspend was aborted, nothing woke us */
+		cur_wakeup.active = 0;
+		return;
+	}
+	cur_wakeup.resumed = 1;
+	cur_wakeup.resume_time = ktime_get();
+}
+
+/* called at each suspend attempt: close the current wakeup window */
+static void wakeup_account_locked(void)
+{
+	struct wakeup_stat *row;
+	ktime_t resume, awake;
+	int i;
+
+	if (!cur_wakeup.active || !cur_wakeup.resumed)
+		return;
+	cur_wakeup.active = 0;
+
+	if (cur_wakeup.irq >= 0)
+		resume = ktime_sub(cur_wakeup.resume_time, cur_wakeup.irq_time);
+	else
+		resume = ktime_set(0, 0);
+	awake = ktime_sub(ktime_get(), cur_wakeup.resume_time);
+
+	if (!cur_wakeup.nr_locks)
+		strlcpy(cur_wakeup.locks[cur_wakeup.nr_locks++], "none",
+			WAKEUP_NAME_LEN);
+
+	for (i = 0; i < cur_wakeup.nr_locks; i++) {
+		row = wakeup_stat_row_locked(cur_wakeup.irq,
+					     cur_wakeup.irq_name,
+					     cur_wakeup.locks[i]);
+		row->count++;
+		row->resume_time = ktime_add(row->resume_time, resume);
+		if (resume.tv64 > row->max_resume_time.tv64)
+			row->max_resume_time = resume;
+		row->awake_time = ktime_add(row->awake_time, awake);
+		if (awake.tv64 > row->max_awake_time.tv64)
+			row->max_awake_time = awake;
+	}
+}
+
+static int wakeup_sources_read_proc(char *page, char **start, off_t off,
+				    int count, int *eof, void *data)
+{
+	unsigned long irqflags;
+	struct wakeup_stat *row;
+	int len = 0;
+	char *p = page, *end = page + PAGE_SIZE;
+	int i, n;
+
+	spin_lock_irqsave(&list_lock, irqflags);
+
+	p += snprintf(p, end - p, "irq\tdevice\twake_lock\tcount"
+		      "\tresume_time\tmax_resume_time\tawake_time"
+		      "\tmax_awake_time\n");
+	for (i = 0; i < nr_wakeup_stats; i++) {
+		row = &wakeup_stats[i];
+		n = snprintf(p, end - p, "%d\t\"%s\"\t\"%s\"\t%d\t%lld"
+			     "\t%lld\t%lld\t%lld\n", row->irq, row->irq_name,
+			     row->lock, row->count,
+			     ktime_to_ns(row->resume_time),
+			     ktime_to_ns(row->max_resume_time),
+			     ktime_to_ns(row->awake_time),
+			     ktime_to_ns(row->max_awake_time));
+		/* a line which does not fit is left out whole */
+		if (n >= end - p)
+			break;
+		p += n;
+	}
+	spin_unlock_irqrestore(&list_lock, irqflags);
+
+	*start = page + off;
+
+	len = p - page;
+	if (len > off)
+		len -= off;
+	else
+		len = 0;
+
+	return len < count ? len  : count;
+}
+
 int get_expired_time(struct wake_lock *lock, ktime_t *expire_time)
 {
 	struct timespec ts;
@@ -270,6 +464,13 @@ static void suspend(struct work_struct *work)
 {
 	int ret;
 	int entry_event_num;
+#ifdef CONFIG_WAKELOCK_STAT
+	unsigned long irqflags;
+
+	spin_lock_irqsave(&list_lock, irqflags);
+	wakeup_account_locked();
+	spin_unlock_irqrestore(&list_lock, irqflags);
+#endif
 
 	if (has_wake_lock(WAKE_LOCK_SUSPEND)) {
 		if (debug_mask & DEBUG_SUSPEND)
@@ -282,6 +483,11 @@ static void suspend(struct work_struct *work)
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("suspend: enter suspend\n");
 	ret = pm_suspend(requested_suspend_state);
+#ifdef CONFIG_WAKELOCK_STAT
+	spin_lock_irqsave(&list_lock, irqflags);
+	wakeup_resumed_locked(ret);
+	spin_unlock_irqrestore(&list_lock, irqflags);
+#endif
 	if (debug_mask & DEBUG_EXIT_SUSPEND) {
 		struct timespec ts;
 		struct rtc_time tm;
@@ -322,7 +528,14 @@ static int power_suspend_late(struct platform_device *pdev, pm_message_t state)
 {
 	int ret = has_wake_lock(WAKE_LOCK_SUSPEND) ? -EAGAIN : 0;
 #ifdef CONFIG_WAKELOCK_STAT
+	unsigned long irqflags;
+
 	wait_for_wakeup = 1;
+	if (!ret) {
+		spin_lock_irqsave(&list_lock, irqflags);
+		wakeup_arm_locked();
+		spin_unlock_irqrestore(&list_lock, irqflags);
+	}
 #endif
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("power_suspend_late return %d\n", ret);
@@ -410,6 +623,8 @@ static void wake_lock_internal(
 		wait_for_wakeup = 0;
 		lock->stat.wakeup_count++;
 	}
+	if (type == WAKE_LOCK_SUSPEND && lock != &main_wake_lock)
+		wakeup_add_lock_locked(lock);
 	if ((lock->flags & WAKE_LOCK_AUTO_EXPIRE) &&
 	    (long)(lock->expires - jiffies) <= 0) {
 		wake_unlock_stat_locked(lock, 0);
@@ -562,6 +777,8 @@ static int __init wakelocks_init(void)
 #ifdef CONFIG_WAKELOCK_STAT
 	create_proc_read_entry("wakelocks", S_IRUGO, NULL,
 				wakelocks_read_proc, NULL);
+	create_proc_read_entry("wakeup_sources", S_IRUGO, NULL,
+				wakeup_sources_read_proc, NULL);
 #endif
 
 	return 0;
@@ -582,6 +799,7 @@ err_platform_device_register:
 static void  __exit wakelocks_exit(void)
 {
 #ifdef CONFIG_WAKELOCK_STAT
+	remove_proc_entry("wakeup_sources", NULL);
 	remove_proc_entry("wakelocks", NULL);
 #endif
 	destroy_workqueue(suspend_work_queue);
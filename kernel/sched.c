@@ -116,6 +116,14 @@
  */
 #define RUNTIME_INF	((u64)~0ULL)
 
+#ifdef CONFIG_CFS_BANDWIDTH
+/* default period for cfs group bandwidth: 100ms */
+static inline u64 default_cfs_period(void)
+{
+	return 100000000ULL;
+}
+#endif
+
 #ifdef CONFIG_SMP
 /*
  * Divide a load by a sched group cpu_power : (load / sg->__cpu_power)
@@ -235,6 +243,86 @@ static void destroy_rt_bandwidth(struct rt_bandwidth *rt_b)
 }
 #endif
 
+#ifdef CONFIG_CFS_BANDWIDTH
+/*
+ * CPU bandwidth of a SCHED_OTHER task group: at most 'quota' ns of cpu
+ * time every 'period'. The per-cpu cfs_rqs of the group draw runtime in
+ * slices from the global pool; a cfs_rq that cannot get more is
+ * throttled (its group entity is dequeued) until the period timer
+ * refills the pool.
+ */
+struct cfs_bandwidth {
+	/* nests inside the rq lock: */
+	spinlock_t		lock;
+	ktime_t			period;
+	u64			quota;
+	u64			runtime;
+	int			idle;
+	struct hrtimer		period_timer;
+	struct list_head	throttled_cfs_rq;
+
+	/* statistics */
+	u64			nr_periods;
+	u64			nr_throttled;
+	u64			throttled_time;
+};
+
+static int do_sched_cfs_period_timer(struct cfs_bandwidth *cfs_b, int overrun);
+
+static enum hrtimer_restart sched_cfs_period_timer(struct hrtimer *timer)
+{
+	struct cfs_bandwidth *cfs_b =
+		container_of(timer, struct cfs_bandwidth, period_timer);
+	ktime_t now;
+	int overrun;
+	int idle = 0;
+
+	for (;;) {
+		now = hrtimer_cb_get_time(timer);
+		overrun = hrtimer_forward(timer, now, cfs_b->period);
+
+		if (!overrun)
+			break;
+
+		idle = do_sched_cfs_period_timer(cfs_b, overrun);
+	}
+
+	return idle ? HRTIMER_NORESTART : HRTIMER_RESTART;
+}
+
+static void init_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
+{
+	spin_lock_init(&cfs_b->lock);
+	cfs_b->period = ns_to_ktime(default_cfs_period());
+	cfs_b->quota = RUNTIME_INF;
+	cfs_b->runtime = 0;
+	INIT_LIST_HEAD(&cfs_b->throttled_cfs_rq);
+
+	hrtimer_init(&cfs_b->period_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	cfs_b->period_timer.function = sched_cfs_period_timer;
+	cfs_b->period_timer.cb_mode = HRTIMER_CB_IRQSAFE_UNLOCKED;
+}
+
+/* Called with cfs_b->lock held */
+static void start_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
+{
+	ktime_t now;
+
+	while (!hrtimer_active(&cfs_b->period_timer)) {
+		now = hrtimer_cb_get_time(&cfs_b->period_timer);
+		hrtimer_forward(&cfs_b->period_timer, now, cfs_b->period);
+		hrtimer_start(&cfs_b->period_timer,
+			      cfs_b->period_timer.expires,
+			      HRTIMER_MODE_ABS);
+	}
+}
+
+static void destroy_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
+{
+	hrtimer_cancel(&cfs_b->period_timer);
+}
+#endif /* CONFIG_CFS_BANDWIDTH */
+
 /*
  * sched_domains_mutex serializes calls to arch_init_sched_domains,
  * detach_destroy_domains and partition_sched_domains.
@@ -261,6 +349,12 @@ struct task_group {
 	/* runqueue "owned" by this group on each cpu */
 	struct cfs_rq **cfs_rq;
 	unsigned long shares;
+	/* waking tasks preempt tasks of groups with a lower boost */
+	unsigned long wakeup_boost;
+#endif
+
+#ifdef CONFIG_CFS_BANDWIDTH
+	struct cfs_bandwidth cfs_bandwidth;
 #endif
 
 #ifdef CONFIG_RT_GROUP_SCHED
@@ -434,6 +528,25 @@ struct cfs_rq {
 	 */
 	unsigned long rq_weight;
 #endif
+
+#ifdef CONFIG_SCHEDSTATS
+	/* time tasks of this group waited on this cpu before running */
+	u64 wait_max;
+	u64 wait_sum;
+	unsigned long wait_count;
+#endif
+
+#ifdef CONFIG_CFS_BANDWIDTH
+	int runtime_enabled;
+	s64 runtime_remaining;
+
+	int throttled;
+	u64 throttled_timestamp;
+	struct list_head throttled_list;
+
+	/* tasks queued in this cfs_rq and below, not throttled there */
+	unsigned long h_nr_running;
+#endif
 #endif
 };
 
@@ -1712,8 +1825,9 @@ static void activate_task(struct rq *rq, struct task_struct *p, int wakeup)
 	if (task_contributes_to_load(p))
 		rq->nr_uninterruptible--;
 
-	enqueue_task(rq, p, wakeup);
+	/* counted first: the fair class uncounts tasks of throttled groups */
 	inc_nr_running(rq);
+	enqueue_task(rq, p, wakeup);
 }
 
 /*
@@ -2414,8 +2528,8 @@ void wake_up_new_task(struct task_struct *p, unsigned long clone_flags)
 		 * Let the scheduling class do new task startup
 		 * management (if any):
 		 */
-		p->sched_class->task_new(rq, p);
 		inc_nr_running(rq);
+		p->sched_class->task_new(rq, p);
 	}
 	trace_mark(kernel_sched_wakeup_new,
 		"pid %d state %ld ## rq %p task %p rq->curr %p",
@@ -7981,6 +8095,18 @@ static void init_rt_rq(struct rt_rq *rt_rq, struct rq *rq)
 #endif
 }
 
+#ifdef CONFIG_CFS_BANDWIDTH
+static void init_cfs_rq_runtime(struct cfs_rq *cfs_rq)
+{
+	cfs_rq->runtime_enabled = 0;
+	INIT_LIST_HEAD(&cfs_rq->throttled_list);
+}
+#else
+static inline void init_cfs_rq_runtime(struct cfs_rq *cfs_rq)
+{
+}
+#endif
+
 #ifdef CONFIG_FAIR_GROUP_SCHED
 static void init_tg_cfs_entry(struct task_group *tg, struct cfs_rq *cfs_rq,
 				struct sched_entity *se, int cpu, int add,
@@ -7989,6 +8115,7 @@ static void init_tg_cfs_entry(struct task_group *tg, struct cfs_rq *cfs_rq,
 	struct rq *rq = cpu_rq(cpu);
 	tg->cfs_rq[cpu] = cfs_rq;
 	init_cfs_rq(cfs_rq, rq);
+	init_cfs_rq_runtime(cfs_rq);
 	cfs_rq->tg = tg;
 	if (add)
 		list_add(&cfs_rq->leaf_cfs_rq_list, &rq->leaf_cfs_rq_list);
@@ -8109,6 +8236,10 @@ void __init sched_init(void)
 #endif /* CONFIG_USER_SCHED */
 #endif /* CONFIG_RT_GROUP_SCHED */
 
+#ifdef CONFIG_CFS_BANDWIDTH
+	init_cfs_bandwidth(&init_task_group.cfs_bandwidth);
+#endif
+
 #ifdef CONFIG_GROUP_SCHED
 	list_add(&init_task_group.list, &task_groups);
 	INIT_LIST_HEAD(&init_task_group.children);
@@ -8385,6 +8516,10 @@ static void free_fair_sched_group(struct task_group *tg)
 {
 	int i;
 
+#ifdef CONFIG_CFS_BANDWIDTH
+	destroy_cfs_bandwidth(&tg->cfs_bandwidth);
+#endif
+
 	for_each_possible_cpu(i) {
 		if (tg->cfs_rq)
 			kfree(tg->cfs_rq[i]);
@@ -8404,6 +8539,11 @@ int alloc_fair_sched_group(struct task_group *tg, struct task_group *parent)
 	struct rq *rq;
 	int i;
 
+#ifdef CONFIG_CFS_BANDWIDTH
+	/* before anything can fail: free_fair_sched_group() cancels it */
+	init_cfs_bandwidth(&tg->cfs_bandwidth);
+#endif
+
 	tg->cfs_rq = kzalloc(sizeof(cfs_rq) * nr_cpu_ids, GFP_KERNEL);
 	if (!tg->cfs_rq)
 		goto err;
@@ -9065,8 +9205,186 @@ static u64 cpu_shares_read_u64(struct cgroup *cgrp, struct cftype *cft)
 
 	return (u64) tg->shares;
 }
+
+static int cpu_wakeup_boost_write_u64(struct cgroup *cgrp,
+				      struct cftype *cftype, u64 boost)
+{
+	cgroup_tg(cgrp)->wakeup_boost = boost;
+	return 0;
+}
+
+static u64 cpu_wakeup_boost_read_u64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return cgroup_tg(cgrp)->wakeup_boost;
+}
+
+#ifdef CONFIG_SCHEDSTATS
+static int cpu_wait_stat_show(struct cgroup *cgrp, struct cftype *cft,
+			      struct cgroup_map_cb *cb)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+	u64 wait_max = 0, wait_sum = 0, wait_count = 0;
+	int i;
+
+	for_each_possible_cpu(i) {
+		struct cfs_rq *cfs_rq = tg->cfs_rq[i];
+
+		/*
+		 * Take rq->lock to make 64-bit reads safe on 32-bit
+		 * platforms.
+		 */
+		spin_lock_irq(&cpu_rq(i)->lock);
+		wait_max = max(wait_max, cfs_rq->wait_max);
+		wait_sum += cfs_rq->wait_sum;
+		wait_count += cfs_rq->wait_count;
+		spin_unlock_irq(&cpu_rq(i)->lock);
+	}
+
+	cb->fill(cb, "wait_max", wait_max);
+	cb->fill(cb, "wait_avg", wait_count ? div64_u64(wait_sum, wait_count) : 0);
+	cb->fill(cb, "wait_count", wait_count);
+
+	return 0;
+}
+#endif /* CONFIG_SCHEDSTATS */
 #endif /* CONFIG_FAIR_GROUP_SCHED */
 
+#ifdef CONFIG_CFS_BANDWIDTH
+static DEFINE_MUTEX(cfs_constraints_mutex);
+
+static const u64 max_cfs_quota_period = 1 * NSEC_PER_SEC; /* 1s */
+static const u64 min_cfs_quota_period = 1 * NSEC_PER_MSEC; /* 1ms */
+
+static int tg_set_cfs_bandwidth(struct task_group *tg, u64 period, u64 quota)
+{
+	struct cfs_bandwidth *cfs_b = &tg->cfs_bandwidth;
+	int i;
+
+	/* the root group is never throttled */
+	if (tg == &init_task_group)
+		return -EINVAL;
+
+	if (period < min_cfs_quota_period || period > max_cfs_quota_period)
+		return -EINVAL;
+
+	if (quota != RUNTIME_INF && quota < min_cfs_quota_period)
+		return -EINVAL;
+
+	mutex_lock(&cfs_constraints_mutex);
+
+	spin_lock_irq(&cfs_b->lock);
+	cfs_b->period = ns_to_ktime(period);
+	cfs_b->quota = quota;
+	cfs_b->runtime = quota;
+	/* throttled cfs_rqs are released by the period timer */
+	if (!list_empty(&cfs_b->throttled_cfs_rq))
+		start_cfs_bandwidth(cfs_b);
+	spin_unlock_irq(&cfs_b->lock);
+
+	for_each_possible_cpu(i) {
+		struct cfs_rq *cfs_rq = tg->cfs_rq[i];
+		struct rq *rq = cpu_rq(i);
+
+		spin_lock_irq(&rq->lock);
+		cfs_rq->runtime_enabled = quota != RUNTIME_INF;
+		cfs_rq->runtime_remaining = 0;
+		spin_unlock_irq(&rq->lock);
+	}
+
+	mutex_unlock(&cfs_constraints_mutex);
+
+	return 0;
+}
+
+static int tg_set_cfs_quota(struct task_group *tg, long cfs_quota_us)
+{
+	u64 quota, period;
+
+	period = ktime_to_ns(tg->cfs_bandwidth.period);
+	if (cfs_quota_us < 0)
+		quota = RUNTIME_INF;
+	else
+		quota = (u64)cfs_quota_us * NSEC_PER_USEC;
+
+	return tg_set_cfs_bandwidth(tg, period, quota);
+}
+
+static long tg_get_cfs_quota(struct task_group *tg)
+{
+	u64 quota_us;
+
+	if (tg->cfs_bandwidth.quota == RUNTIME_INF)
+		return -1;
+
+	quota_us = tg->cfs_bandwidth.quota;
+	do_div(quota_us, NSEC_PER_USEC);
+	return quota_us;
+}
+
+static int tg_set_cfs_period(struct task_group *tg, long cfs_period_us)
+{
+	u64 quota, period;
+
+	if (cfs_period_us <= 0)
+		return -EINVAL;
+
+	period = (u64)cfs_period_us * NSEC_PER_USEC;
+	quota = tg->cfs_bandwidth.quota;
+
+	return tg_set_cfs_bandwidth(tg, period, quota);
+}
+
+static long tg_get_cfs_period(struct task_group *tg)
+{
+	u64 cfs_period_us;
+
+	cfs_period_us = ktime_to_ns(tg->cfs_bandwidth.period);
+	do_div(cfs_period_us, NSEC_PER_USEC);
+	return cfs_period_us;
+}
+
+static s64 cpu_cfs_quota_read_s64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return tg_get_cfs_quota(cgroup_tg(cgrp));
+}
+
+static int cpu_cfs_quota_write_s64(struct cgroup *cgrp, struct cftype *cftype,
+				   s64 cfs_quota_us)
+{
+	return tg_set_cfs_quota(cgroup_tg(cgrp), cfs_quota_us);
+}
+
+static u64 cpu_cfs_period_read_u64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return tg_get_cfs_period(cgroup_tg(cgrp));
+}
+
+static int cpu_cfs_period_write_u64(struct cgroup *cgrp, struct cftype *cftype,
+				    u64 cfs_period_us)
+{
+	return tg_set_cfs_period(cgroup_tg(cgrp), cfs_period_us);
+}
+
+static int cpu_cfs_stat_show(struct cgroup *cgrp, struct cftype *cft,
+			     struct cgroup_map_cb *cb)
+{
+	struct cfs_bandwidth *cfs_b = &cgroup_tg(cgrp)->cfs_bandwidth;
+	u64 nr_periods, nr_throttled, throttled_time;
+
+	spin_lock_irq(&cfs_b->lock);
+	nr_periods = cfs_b->nr_periods;
+	nr_throttled = cfs_b->nr_throttled;
+	throttled_time = cfs_b->throttled_time;
+	spin_unlock_irq(&cfs_b->lock);
+
+	cb->fill(cb, "nr_periods", nr_periods);
+	cb->fill(cb, "nr_throttled", nr_throttled);
+	cb->fill(cb, "throttled_time", throttled_time);
+
+	return 0;
+}
+#endif /* CONFIG_CFS_BANDWIDTH */
+
 #ifdef CONFIG_RT_GROUP_SCHED
 static int cpu_rt_runtime_write(struct cgroup *cgrp, struct cftype *cft,
 				s64 val)
@@ -9098,6 +9416,33 @@ static struct cftype cpu_files[] = {
 		.read_u64 = cpu_shares_read_u64,
 		.write_u64 = cpu_shares_write_u64,
 	},
+	{
+		.name = "wakeup_boost",
+		.read_u64 = cpu_wakeup_boost_read_u64,
+		.write_u64 = cpu_wakeup_boost_write_u64,
+	},
+#ifdef CONFIG_SCHEDSTATS
+	{
+		.name = "wait_stat",
+		.read_map = cpu_wait_stat_show,
+	},
+#endif
+#endif
+#ifdef CONFIG_CFS_BANDWIDTH
+	{
+		.name = "cfs_quota_us",
+		.read_s64 = cpu_cfs_quota_read_s64,
+		.write_s64 = cpu_cfs_quota_write_s64,
+	},
+	{
+		.name = "cfs_period_us",
+		.read_u64 = cpu_cfs_period_read_u64,
+		.write_u64 = cpu_cfs_period_write_u64,
+	},
+	{
+		.name = "cfs_stat",
+		.read_map = cpu_cfs_stat_show,
+	},
 #endif
 #ifdef CONFIG_RT_GROUP_SCHED
 	{
@@ -73,6 +73,14 @@ unsigned int sysctl_sched_wakeup_granularity = 5000000UL;
 
 const_debug unsigned int sysctl_sched_migration_cost = 500000UL;
 
+#ifdef CONFIG_CFS_BANDWIDTH
+/*
+ * Amount of runtime a throttled group's cfs_rq takes from the global
+ * pool at a time. (default: 5 msec, units: nanoseconds)
+ */
+static const unsigned int sched_cfs_bandwidth_slice = 5000000UL;
+#endif
+
 /**************************************************************
  * CFS operations on generic schedulable entities:
  */
@@ -466,6 +474,125 @@ calc_delta_asym(unsigned long delta, struct sched_entity *se)
 	return delta;
 }
 
+/**************************************************
+ * CFS bandwidth control:
+ */
+
+#ifdef CONFIG_CFS_BANDWIDTH
+
+static inline struct cfs_bandwidth *tg_cfs_bandwidth(struct task_group *tg)
+{
+	return &tg->cfs_bandwidth;
+}
+
+static inline int cfs_rq_throttled(struct cfs_rq *cfs_rq)
+{
+	return cfs_rq->throttled;
+}
+
+static inline void inc_cfs_h_nr_running(struct cfs_rq *cfs_rq)
+{
+	cfs_rq->h_nr_running++;
+}
+
+static inline void dec_cfs_h_nr_running(struct cfs_rq *cfs_rq)
+{
+	cfs_rq->h_nr_running--;
+}
+
+/*
+ * Is cfs_rq, or one of the cfs_rqs above it, throttled? Its tasks are
+ * then off the cpu and must not be pulled elsewhere by the balancer.
+ */
+static int throttled_hierarchy(struct cfs_rq *cfs_rq)
+{
+	struct sched_entity *se = cfs_rq->tg->se[cpu_of(rq_of(cfs_rq))];
+
+	if (cfs_rq_throttled(cfs_rq))
+		return 1;
+
+	for_each_sched_entity(se) {
+		if (cfs_rq_throttled(cfs_rq_of(se)))
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Refill the local runtime of a cfs_rq from its group's pool, as much
+ * as is left up to one slice.
+ */
+static void assign_cfs_rq_runtime(struct cfs_rq *cfs_rq)
+{
+	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(cfs_rq->tg);
+	u64 amount = 0, min_amount;
+
+	min_amount = sched_cfs_bandwidth_slice - cfs_rq->runtime_remaining;
+
+	spin_lock(&cfs_b->lock);
+	if (cfs_b->quota == RUNTIME_INF)
+		amount = min_amount;
+	else {
+		start_cfs_bandwidth(cfs_b);
+		cfs_b->idle = 0;
+
+		if (cfs_b->runtime > 0) {
+			amount = min(cfs_b->runtime, min_amount);
+			cfs_b->runtime -= amount;
+		}
+	}
+	spin_unlock(&cfs_b->lock);
+
+	cfs_rq->runtime_remaining += amount;
+}
+
+static void account_cfs_rq_runtime(struct cfs_rq *cfs_rq,
+				   unsigned long delta_exec)
+{
+	if (!cfs_rq->runtime_enabled)
+		return;
+
+	cfs_rq->runtime_remaining -= delta_exec;
+	if (likely(cfs_rq->runtime_remaining > 0))
+		return;
+
+	assign_cfs_rq_runtime(cfs_rq);
+
+	/*
+	 * Out of runtime: get the current task off the cpu, the group is
+	 * throttled when it is put back (put_prev_entity).
+	 */
+	if (cfs_rq->runtime_remaining <= 0 && cfs_rq->curr)
+		resched_task(rq_of(cfs_rq)->curr);
+}
+
+#else /* !CONFIG_CFS_BANDWIDTH */
+
+static inline int cfs_rq_throttled(struct cfs_rq *cfs_rq)
+{
+	return 0;
+}
+
+static inline int throttled_hierarchy(struct cfs_rq *cfs_rq)
+{
+	return 0;
+}
+
+static inline void inc_cfs_h_nr_running(struct cfs_rq *cfs_rq)
+{
+}
+
+static inline void dec_cfs_h_nr_running(struct cfs_rq *cfs_rq)
+{
+}
+
+static inline void account_cfs_rq_runtime(struct cfs_rq *cfs_rq,
+					  unsigned long delta_exec)
+{
+}
+
+#endif /* CONFIG_CFS_BANDWIDTH */
+
 /*
  * Update the current task's runtime statistics. Skip current tasks that
  * are not in our scheduling class.
@@ -503,6 +630,8 @@ static void update_curr(struct cfs_rq *cfs_rq)
 	__update_curr(cfs_rq, curr, delta_exec);
 	curr->exec_start = now;
 
+	account_cfs_rq_runtime(cfs_rq, delta_exec);
+
 	if (entity_is_task(curr)) {
 		struct task_struct *curtask = task_of(curr);
 
@@ -529,6 +658,33 @@ static void update_stats_enqueue(struct cfs_rq *cfs_rq, struct sched_entity *se)
 		update_stats_wait_start(cfs_rq, se);
 }
 
+#if defined(CONFIG_SCHEDSTATS) && defined(CONFIG_FAIR_GROUP_SCHED)
+/*
+ * Account how long a task of the group owning cfs_rq waited to run.
+ */
+static void
+update_group_wait_stats(struct cfs_rq *cfs_rq, struct sched_entity *se)
+{
+	u64 delta;
+
+	if (!entity_is_task(se) || !se->wait_start)
+		return;
+
+	delta = rq_of(cfs_rq)->clock - se->wait_start;
+	if ((s64)delta < 0)
+		return;
+
+	cfs_rq->wait_max = max(cfs_rq->wait_max, delta);
+	cfs_rq->wait_sum += delta;
+	cfs_rq->wait_count++;
+}
+#else
+static inline void
+update_group_wait_stats(struct cfs_rq *cfs_rq, struct sched_entity *se)
+{
+}
+#endif
+
 static void
 update_stats_wait_end(struct cfs_rq *cfs_rq, struct sched_entity *se)
 {
@@ -777,6 +933,7 @@ set_next_entity(struct cfs_rq *cfs_rq, struct sched_entity *se)
 		 * a CPU. So account for the time it spent waiting on the
 		 * runqueue.
 		 */
+		update_group_wait_stats(cfs_rq, se);
 		update_stats_wait_end(cfs_rq, se);
 		__dequeue_entity(cfs_rq, se);
 	}
@@ -824,6 +981,145 @@ static struct sched_entity *pick_next_entity(struct cfs_rq *cfs_rq)
 	return se;
 }
 
+#ifdef CONFIG_CFS_BANDWIDTH
+/*
+ * Take the group owning cfs_rq off the cpu: its entity (and any parent
+ * left empty by that) is dequeued, while its own tasks stay queued in
+ * cfs_rq until it is unthrottled. They no longer count as running on
+ * the cpu, in the parents' h_nr_running and in rq->nr_running, so that a
+ * cpu left with throttled tasks only goes idle and balances.
+ */
+static void throttle_cfs_rq(struct cfs_rq *cfs_rq)
+{
+	struct rq *rq = rq_of(cfs_rq);
+	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(cfs_rq->tg);
+	struct sched_entity *se = cfs_rq->tg->se[cpu_of(rq)];
+	unsigned long task_delta = cfs_rq->h_nr_running;
+	int dequeue = 1;
+
+	for_each_sched_entity(se) {
+		struct cfs_rq *qcfs_rq = cfs_rq_of(se);
+
+		/* already off, below a throttled parent */
+		if (!se->on_rq)
+			break;
+
+		if (dequeue)
+			dequeue_entity(qcfs_rq, se, 1);
+		qcfs_rq->h_nr_running -= task_delta;
+
+		if (qcfs_rq->load.weight)
+			dequeue = 0;
+	}
+	if (!se)
+		rq->nr_running -= task_delta;
+
+	cfs_rq->throttled = 1;
+	cfs_rq->throttled_timestamp = rq->clock;
+
+	spin_lock(&cfs_b->lock);
+	list_add_tail(&cfs_rq->throttled_list, &cfs_b->throttled_cfs_rq);
+	cfs_b->nr_throttled++;
+	spin_unlock(&cfs_b->lock);
+}
+
+/*
+ * Called with rq->lock held and cfs_rq already off the throttled list.
+ */
+static void unthrottle_cfs_rq(struct cfs_rq *cfs_rq)
+{
+	struct rq *rq = rq_of(cfs_rq);
+	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(cfs_rq->tg);
+	struct sched_entity *se = cfs_rq->tg->se[cpu_of(rq)];
+	unsigned long task_delta = cfs_rq->h_nr_running;
+	int enqueue = 1;
+
+	cfs_rq->throttled = 0;
+
+	spin_lock(&cfs_b->lock);
+	cfs_b->throttled_time += rq->clock - cfs_rq->throttled_timestamp;
+	spin_unlock(&cfs_b->lock);
+
+	if (!cfs_rq->load.weight)
+		return;
+
+	for_each_sched_entity(se) {
+		struct cfs_rq *qcfs_rq = cfs_rq_of(se);
+
+		if (se->on_rq)
+			enqueue = 0;
+
+		if (enqueue)
+			enqueue_entity(qcfs_rq, se, 1);
+		qcfs_rq->h_nr_running += task_delta;
+
+		/* a throttled parent keeps the tasks off the cpu */
+		if (cfs_rq_throttled(qcfs_rq))
+			break;
+	}
+	if (!se)
+		rq->nr_running += task_delta;
+
+	resched_task(rq->curr);
+}
+
+static void check_cfs_rq_runtime(struct cfs_rq *cfs_rq)
+{
+	if (likely(!cfs_rq->runtime_enabled || cfs_rq->runtime_remaining > 0))
+		return;
+
+	if (cfs_rq_throttled(cfs_rq))
+		return;
+
+	throttle_cfs_rq(cfs_rq);
+}
+
+/*
+ * Period timer: refill the group's pool and unthrottle its cfs_rqs.
+ * Returns non-zero once the group has been idle for a whole period so
+ * that the timer can stop until the group runs again.
+ */
+static int do_sched_cfs_period_timer(struct cfs_bandwidth *cfs_b, int overrun)
+{
+	struct cfs_rq *cfs_rq, *tmp;
+	LIST_HEAD(throttled);
+	int idle;
+
+	spin_lock(&cfs_b->lock);
+	cfs_b->nr_periods += overrun;
+	cfs_b->runtime = cfs_b->quota;
+	list_splice_init(&cfs_b->throttled_cfs_rq, &throttled);
+	idle = cfs_b->idle && list_empty(&throttled);
+	cfs_b->idle = 1;
+	spin_unlock(&cfs_b->lock);
+
+	list_for_each_entry_safe(cfs_rq, tmp, &throttled, throttled_list) {
+		struct rq *rq = rq_of(cfs_rq);
+
+		spin_lock(&rq->lock);
+		list_del_init(&cfs_rq->throttled_list);
+		update_rq_clock(rq);
+		assign_cfs_rq_runtime(cfs_rq);
+		if (cfs_rq->runtime_remaining > 0 || !cfs_rq->runtime_enabled)
+			unthrottle_cfs_rq(cfs_rq);
+		else {
+			/* pool drained by other cpus already: next period */
+			spin_lock(&cfs_b->lock);
+			list_add_tail(&cfs_rq->throttled_list,
+				      &cfs_b->throttled_cfs_rq);
+			spin_unlock(&cfs_b->lock);
+		}
+		spin_unlock(&rq->lock);
+	}
+
+	return idle;
+}
+#else /* !CONFIG_CFS_BANDWIDTH */
+static inline void check_cfs_rq_runtime(struct cfs_rq *cfs_rq)
+{
+}
+#endif /* CONFIG_CFS_BANDWIDTH */
+
 static void put_prev_entity(struct cfs_rq *cfs_rq, struct sched_entity *prev)
 {
 	/*
@@ -833,6 +1129,9 @@ static void put_prev_entity(struct cfs_rq *cfs_rq, struct sched_entity *prev)
 	if (prev->on_rq)
 		update_curr(cfs_rq);
 
+	/* throttle the group here if it ran out of runtime */
+	check_cfs_rq_runtime(cfs_rq);
+
 	check_spread(cfs_rq, prev);
 	if (prev->on_rq) {
 		update_stats_wait_start(cfs_rq, prev);
@@ -912,7 +1211,7 @@ hrtick_start_fair(struct rq *rq, struct task_struct *p)
 #endif
 
 /*
- * The enqueue_task method is called before nr_running is
+ * The enqueue_task method is called after nr_running is
  * increased. Here we update the fair scheduling stats and
  * then put the task into the rbtree:
  */
@@ -926,9 +1225,27 @@ static void enqueue_task_fair(struct rq *rq, struct task_struct *p, int wakeup)
 			break;
 		cfs_rq = cfs_rq_of(se);
 		enqueue_entity(cfs_rq, se, wakeup);
+		/* a throttled group's entity stays off its parent */
+		if (cfs_rq_throttled(cfs_rq))
+			break;
+		inc_cfs_h_nr_running(cfs_rq);
 		wakeup = 1;
 	}
 
+	for_each_sched_entity(se) {
+		cfs_rq = cfs_rq_of(se);
+		inc_cfs_h_nr_running(cfs_rq);
+		if (cfs_rq_throttled(cfs_rq))
+			break;
+	}
+
+	/*
+	 * Below a throttled group the task is not running on the cpu:
+	 * take back the count of the caller.
+	 */
+	if (se)
+		rq->nr_running--;
+
 	hrtick_start_fair(rq, rq->curr);
 }
 
@@ -945,12 +1262,29 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int sleep)
 	for_each_sched_entity(se) {
 		cfs_rq = cfs_rq_of(se);
 		dequeue_entity(cfs_rq, se, sleep);
+		/* nothing to do above a group taken off by throttling */
+		if (cfs_rq_throttled(cfs_rq))
+			break;
+		dec_cfs_h_nr_running(cfs_rq);
 		/* Don't dequeue parent if it has other entities besides us */
-		if (cfs_rq->load.weight)
+		if (cfs_rq->load.weight) {
+			se = parent_entity(se);
 			break;
+		}
 		sleep = 1;
 	}
 
+	for_each_sched_entity(se) {
+		cfs_rq = cfs_rq_of(se);
+		dec_cfs_h_nr_running(cfs_rq);
+		if (cfs_rq_throttled(cfs_rq))
+			break;
+	}
+
+	/* the task was not counted in rq->nr_running, see above */
+	if (se)
+		rq->nr_running++;
+
 	hrtick_start_fair(rq, rq->curr);
 }
 
@@ -1348,6 +1682,10 @@ static void check_preempt_wakeup(struct rq *rq, struct task_struct *p)
 	if (unlikely(se == pse))
 		return;
 
+	/* the woken task may sit in a throttled group, off the tree */
+	if (throttled_hierarchy(cfs_rq_of(pse)))
+		return;
+
 	cfs_rq_of(pse)->next = pse;
 
 	/*
@@ -1360,6 +1698,17 @@ static void check_preempt_wakeup(struct rq *rq, struct task_struct *p)
 	if (!sched_feat(WAKEUP_PREEMPT))
 		return;
 
+#ifdef CONFIG_FAIR_GROUP_SCHED
+	/*
+	 * Tasks of a boosted (foreground) group preempt tasks of less
+	 * boosted groups without waiting for the wakeup granularity.
+	 */
+	if (task_group(p)->wakeup_boost > task_group(curr)->wakeup_boost) {
+		resched_task(curr);
+		return;
+	}
+#endif
+
 	/*
 	 * preemption test can be made between sibling entities who are in the
 	 * same cfs_rq i.e who have a common parent. Walk up the hierarchy of
@@ -1466,6 +1815,10 @@ static struct task_struct *load_balance_start_fair(void *arg)
 {
 	struct cfs_rq *cfs_rq = arg;
 
+	/* the tasks of a throttled group stay where they are */
+	if (throttled_hierarchy(cfs_rq))
+		return NULL;
+
 	return __load_balance_iterator(cfs_rq, cfs_rq->tasks.next);
 }
 
@@ -1519,6 +1872,13 @@ load_balance_fair(struct rq *this_rq, int this_cpu, struct rq *busiest,
 		if (!busiest_cfs_rq->task_weight)
 			continue;
 
+		/*
+		 * throttled group: its tasks may not run anywhere until the
+		 * next period
+		 */
+		if (throttled_hierarchy(busiest_cfs_rq))
+			continue;
+
 		rem_load = (u64)rem_load_move * busiest_weight;
 		rem_load = div_u64(rem_load, busiest_h_load + 1);
 
@@ -80,6 +80,7 @@ extern int min_free_order_shift;
 extern int pid_max_min, pid_max_max;
 extern int sysctl_drop_caches;
 extern int percpu_pagelist_fraction;
+extern int percpu_pagelist_batch;
 extern int compat_log;
 extern int maps_protect;
 extern int latencytop_enabled;
@@ -109,6 +110,7 @@ static int one_hundred = 100;
 static int maxolduid = 65535;
 static int minolduid;
 static int min_percpu_pagelist_fract = 8;
+static int max_percpu_pagelist_batch = 1024;
 
 static int ngroups_max = NGROUPS_MAX;
 
@@ -1045,6 +1047,16 @@ static struct ctl_table vm_table[] = {
 		.strategy	= &sysctl_intvec,
 		.extra1		= &min_percpu_pagelist_fract,
 	},
+	{
+		.ctl_name	= CTL_UNNUMBERED,
+		.procname	= "percpu_pagelist_batch",
+		.data		= &percpu_pagelist_batch,
+		.maxlen		= sizeof(percpu_pagelist_batch),
+		.mode		= 0644,
+		.proc_handler	= &percpu_pagelist_batch_sysctl_handler,
+		.extra1		= &zero,
+		.extra2		= &max_percpu_pagelist_batch,
+	},
 #ifdef CONFIG_MMU
 	{
 		.ctl_name	= VM_MAX_MAP_COUNT,
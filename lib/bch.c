@@ -0,0 +1,676 @@
+/*
+ * lib/bch.c
+ *
+ * Overview:
+ *   Generic binary BCH encoding/decoding library
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Description:
+ *
+ * This library provides runtime configurable encoding and decoding of
+ * binary BCH codes over GF(2^m), 5 <= m <= 15, which correct up to t bit
+ * errors in a codeword of at most 2^m-1 bits. It is meant for MLC NAND
+ * flash, which needs more than the 1-bit correction of the Hamming code
+ * in drivers/mtd/nand/nand_ecc.c: e.g. m = 13 covers 512 byte blocks
+ * and takes 13 ecc bits per correctable bit.
+ *
+ * Each user calls init_bch() for its (m, t) pair on driver init, which
+ * builds the Galois field tables, the generator polynomial and the
+ * encoder tables, and free_bch() on exit.
+ *
+ * Encoding computes the remainder of the data polynomial, multiplied by
+ * x^ecc_bits, modulo the generator polynomial. The remainder register is
+ * updated 32 data bits at a time using four 256-entry remainder tables,
+ * one per data byte position, so it costs four table lookups per data
+ * word and ecc word.
+ *
+ * Decoding takes the received and the recomputed ecc. Their xor is the
+ * remainder of the received codeword; the 2t syndromes are evaluated from
+ * its set bits with the log/antilog tables (the even ones are squares of
+ * the odd ones). The error locator polynomial is found with the
+ * simplified binary Berlekamp-Massey algorithm and its roots with a
+ * Chien search, which keeps the terms of the polynomial in log form so
+ * each step is one subtraction and one table lookup per term, only
+ * scans the bits of the (shortened) codeword and stops as soon as all
+ * roots have been found. One and two errors, the common case on NAND,
+ * are located directly: the roots of a degree 2 polynomial come from a
+ * table of m solutions of y^2 + y = alpha^i.
+ *
+ * The decoding buffers are part of the bch_control structure, so calls
+ * to decode_bch() on the same structure have to be serialized.
+ */
+
+#include <linux/errno.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/bch.h>
+#include <asm/byteorder.h>
+
+#define BCH_MIN_M	5
+#define BCH_MAX_M	15
+
+/* A polynomial over GF(2^m), c[i] is the coefficient of x^i */
+struct gf_poly {
+	unsigned int	deg;
+	unsigned int	c[0];
+};
+
+#define GF_POLY_SZ(d)	(sizeof(struct gf_poly) + ((d) + 1) * sizeof(unsigned int))
+
+/* Default primitive polynomials, for m = 5..15 */
+static const unsigned int prim_poly_tab[] = {
+	0x25, 0x43, 0x83, 0x11d, 0x211, 0x409, 0x805, 0x1053, 0x201b,
+	0x402b, 0x8003
+};
+
+/* Reduce a sum of at most two logs (< 2n) modulo n */
+static inline unsigned int mod_n2(const struct bch_control *bch,
+				  unsigned int v)
+{
+	return v >= bch->n ? v - bch->n : v;
+}
+
+static inline unsigned int gf_mul(const struct bch_control *bch,
+				  unsigned int a, unsigned int b)
+{
+	if (!a || !b)
+		return 0;
+	return bch->a_pow_tab[mod_n2(bch, bch->a_log_tab[a] +
+				     bch->a_log_tab[b])];
+}
+
+static inline unsigned int gf_sqr(const struct bch_control *bch,
+				  unsigned int a)
+{
+	if (!a)
+		return 0;
+	return bch->a_pow_tab[mod_n2(bch, 2 * bch->a_log_tab[a])];
+}
+
+/* The ecc_words words of the remainder tables for byte @b at position @k */
+static inline const uint32_t *mod_tab(const struct bch_control *bch,
+				      unsigned int k, unsigned int b)
+{
+	return bch->mod_tab + (k * 256 + b) * bch->ecc_words;
+}
+
+/*
+ * The remainder register holds the ecc_bits coefficients of the remainder
+ * left-aligned in ecc_words 32-bit words, highest degree in the most
+ * significant bit of word 0, so that it maps directly to the ecc bytes.
+ */
+static void load_ecc(const struct bch_control *bch, uint32_t *r,
+		     const uint8_t *ecc)
+{
+	unsigned int i;
+
+	memset(r, 0, bch->ecc_words * sizeof(*r));
+	for (i = 0; i < bch->ecc_bytes; i++)
+		r[i / 4] |= (uint32_t)ecc[i] << (24 - 8 * (i & 3));
+}
+
+static void store_ecc(const struct bch_control *bch, uint8_t *ecc,
+		      const uint32_t *r)
+{
+	unsigned int i;
+
+	for (i = 0; i < bch->ecc_bytes; i++)
+		ecc[i] = r[i / 4] >> (24 - 8 * (i & 3));
+}
+
+static inline void encode_byte(const struct bch_control *bch, uint32_t *r,
+			       uint8_t data)
+{
+	const unsigned int l = bch->ecc_words;
+	const uint32_t *p = mod_tab(bch, 0, (r[0] >> 24) ^ data);
+	unsigned int i;
+
+	for (i = 0; i < l - 1; i++)
+		r[i] = ((r[i] << 8) | (r[i + 1] >> 24)) ^ p[i];
+	r[l - 1] = (r[l - 1] << 8) ^ p[l - 1];
+}
+
+/*
+ * (S(x).x^32 + D(x).x^ecc_bits) mod g(x) is the register shifted by one
+ * word plus the remainder of (S_hi(x) + D(x)).x^ecc_bits, where S_hi is
+ * the first register word; the latter is the sum of the table entries of
+ * its four bytes. This needs ecc_bits >= 32.
+ */
+static inline void encode_word(const struct bch_control *bch, uint32_t *r,
+			       uint32_t data)
+{
+	const unsigned int l = bch->ecc_words;
+	const uint32_t w = r[0] ^ data;
+	const uint32_t *p0 = mod_tab(bch, 0, w & 0xff);
+	const uint32_t *p1 = mod_tab(bch, 1, (w >> 8) & 0xff);
+	const uint32_t *p2 = mod_tab(bch, 2, (w >> 16) & 0xff);
+	const uint32_t *p3 = mod_tab(bch, 3, w >> 24);
+	unsigned int i;
+
+	for (i = 0; i < l - 1; i++)
+		r[i] = r[i + 1] ^ p0[i] ^ p1[i] ^ p2[i] ^ p3[i];
+	r[l - 1] = p0[l - 1] ^ p1[l - 1] ^ p2[l - 1] ^ p3[l - 1];
+}
+
+/**
+ * encode_bch - calculate the BCH ecc of a data buffer
+ * @bch:	BCH control structure
+ * @data:	data to encode
+ * @len:	length of @data in bytes
+ * @ecc:	ecc buffer, bch->ecc_bytes long
+ *
+ * The ecc is accumulated into @ecc, which has to be zeroed before the
+ * first call; this allows encoding a buffer in several pieces. The data
+ * and ecc together may not exceed bch->n bits.
+ */
+void encode_bch(struct bch_control *bch, const uint8_t *data,
+		unsigned int len, uint8_t *ecc)
+{
+	uint32_t *r = bch->ecc_buf;
+
+	load_ecc(bch, r, ecc);
+
+	if (bch->ecc_bits >= 32) {
+		/* bytes up to the first aligned word */
+		while (len && ((unsigned long)data & 3)) {
+			encode_byte(bch, r, *data++);
+			len--;
+		}
+		for (; len >= 4; len -= 4, data += 4)
+			encode_word(bch, r, be32_to_cpu(*(const __be32 *)data));
+	}
+	while (len--)
+		encode_byte(bch, r, *data++);
+
+	store_ecc(bch, ecc, r);
+}
+EXPORT_SYMBOL_GPL(encode_bch);
+
+/*
+ * Evaluate the syndromes S1..S2t of the received codeword. The xor of the
+ * received and calculated ecc is the remainder R(x) of the codeword, and
+ * since the alpha^j are roots of g(x), S_j = R(alpha^j). Returns 0 if
+ * the remainder is zero, i.e. there are no errors.
+ */
+static int compute_syndromes(struct bch_control *bch, const uint8_t *recv_ecc,
+			     const uint8_t *calc_ecc)
+{
+	const unsigned int t = bch->t;
+	unsigned int *syn = bch->syn;
+	unsigned int i, j, k, d, e, step, nz = 0;
+	uint8_t b;
+
+	memset(syn, 0, 2 * t * sizeof(*syn));
+
+	for (i = 0; i < bch->ecc_bytes; i++) {
+		b = recv_ecc[i] ^ calc_ecc[i];
+		/* the bits past ecc_bits in the last byte are padding */
+		if (i == bch->ecc_bytes - 1)
+			b &= 0xff << (8 * bch->ecc_bytes - bch->ecc_bits);
+		nz |= b;
+		for (j = 0; b; j++, b <<= 1) {
+			if (!(b & 0x80))
+				continue;
+			/* degree of this bit in R(x) */
+			d = bch->ecc_bits - 1 - (8 * i + j);
+			/* add alpha^(d.(2k+1)) to the odd syndromes */
+			step = (2 * d) % bch->n;
+			for (k = 0, e = d; k < t; k++) {
+				syn[2 * k] ^= bch->a_pow_tab[e];
+				e = mod_n2(bch, e + step);
+			}
+		}
+	}
+	if (!nz)
+		return 0;
+
+	/* S(2j) = S(j)^2 */
+	for (j = 1; j <= t; j++)
+		syn[2 * j - 1] = gf_sqr(bch, syn[j - 1]);
+	return 1;
+}
+
+/*
+ * Simplified binary Berlekamp-Massey algorithm. Returns the degree of
+ * the error locator polynomial, or -1 if there are more than t errors.
+ */
+static int compute_error_locator(struct bch_control *bch)
+{
+	const unsigned int t = bch->t;
+	const unsigned int *syn = bch->syn;
+	struct gf_poly *elp = bch->elp;
+	struct gf_poly *pelp = bch->pelp;
+	struct gf_poly *elp_copy = bch->elp_copy;
+	unsigned int i, j, k, d, pd = 1, tmp, l;
+	int pp = -1;
+
+	memset(elp, 0, GF_POLY_SZ(3 * t));
+	memset(pelp, 0, GF_POLY_SZ(3 * t));
+	elp->c[0] = 1;
+	pelp->c[0] = 1;
+	d = syn[0];
+
+	for (i = 0; i < t && elp->deg <= t; i++) {
+		if (d) {
+			k = 2 * i - pp;
+			memcpy(elp_copy, elp, GF_POLY_SZ(elp->deg));
+			/* elp += d/pd . x^k . pelp */
+			tmp = bch->a_log_tab[d] + bch->n - bch->a_log_tab[pd];
+			for (j = 0; j <= pelp->deg; j++) {
+				if (!pelp->c[j])
+					continue;
+				l = bch->a_log_tab[pelp->c[j]];
+				elp->c[j + k] ^= bch->a_pow_tab[(tmp + l) %
+								bch->n];
+			}
+			tmp = pelp->deg + k;
+			if (tmp > elp->deg) {
+				elp->deg = tmp;
+				memcpy(pelp, elp_copy,
+				       GF_POLY_SZ(elp_copy->deg));
+				pd = d;
+				pp = 2 * i;
+			}
+		}
+		/* next discrepancy */
+		if (i < t - 1) {
+			d = syn[2 * i + 2];
+			for (j = 1; j <= elp->deg && j <= 2 * i + 2; j++)
+				d ^= gf_mul(bch, elp->c[j], syn[2 * i + 2 - j]);
+		}
+	}
+	return elp->deg > t ? -1 : (int)elp->deg;
+}
+
+/*
+ * Convert the degree of an error in the codeword polynomial into a bit
+ * number: data bits first, then ecc bits, bit 0 being the LSB of byte 0.
+ */
+static inline unsigned int degree_to_errloc(unsigned int nbits,
+					    unsigned int d)
+{
+	unsigned int p = nbits - 1 - d;
+
+	return (p & ~7) | (7 - (p & 7));
+}
+
+/*
+ * Roots of 1 + c1.x + c2.x^2: with x = (c1/c2).y this is y^2 + y = u,
+ * u = c2/c1^2. y -> y^2 + y is linear over GF(2), so a solution is the
+ * sum of the xi_tab entries of the bits of u, see build_deg2_table(); the
+ * other one is y + 1. Returns 2, or -1 if the roots are not in the
+ * codeword.
+ */
+static int find_deg2_roots(struct bch_control *bch, unsigned int nbits,
+			   unsigned int *errloc)
+{
+	const struct gf_poly *elp = bch->elp;
+	const unsigned int n = bch->n;
+	unsigned int c1 = elp->c[1], c2 = elp->c[2];
+	unsigned int u, y, i, l, d0, d1;
+
+	/* a double root, not a valid error pattern */
+	if (!c1 || !c2)
+		return -1;
+
+	u = bch->a_pow_tab[(bch->a_log_tab[c2] + 2 * (n - bch->a_log_tab[c1]))
+			   % n];
+	for (i = 0, y = 0; u >> i; i++)
+		if (u & (1 << i))
+			y ^= bch->xi_tab[i];
+	/* no solution if the trace of u is 1 */
+	if (y < 2 || (gf_sqr(bch, y) ^ y) != u)
+		return -1;
+
+	/* x = (c1/c2).y is the root alpha^-d */
+	l = mod_n2(bch, bch->a_log_tab[c1] + n - bch->a_log_tab[c2]);
+	d0 = (2 * n - l - bch->a_log_tab[y]) % n;
+	d1 = (2 * n - l - bch->a_log_tab[y ^ 1]) % n;
+	if (d0 >= nbits || d1 >= nbits)
+		return -1;
+	errloc[0] = degree_to_errloc(nbits, d0);
+	errloc[1] = degree_to_errloc(nbits, d1);
+	return 2;
+}
+
+/*
+ * Find the roots alpha^-d of the error locator polynomial for the error
+ * degrees d of the codeword. Returns the number of errors, or -1 if not
+ * all roots are within the codeword.
+ */
+static int chien_search(struct bch_control *bch, unsigned int nbits,
+			unsigned int *errloc)
+{
+	const struct gf_poly *elp = bch->elp;
+	const unsigned int deg = elp->deg;
+	const int n = bch->n;
+	int *lg = bch->chien;
+	unsigned int d, j, sum, found = 0;
+
+	if (deg == 1) {
+		/* 1 + c1.x has its root at x = 1/c1 = alpha^-log(c1) */
+		d = bch->a_log_tab[elp->c[1]];
+		if (d >= nbits)
+			return -1;
+		errloc[0] = degree_to_errloc(nbits, d);
+		return 1;
+	}
+	if (deg == 2)
+		return find_deg2_roots(bch, nbits, errloc);
+
+	/* term j of elp(alpha^-d) is alpha^(log(c[j]) - d.j) */
+	for (j = 1; j <= deg; j++)
+		lg[j] = elp->c[j] ? bch->a_log_tab[elp->c[j]] : -1;
+
+	for (d = 0; d < nbits && found < deg; d++) {
+		sum = 1;
+		for (j = 1; j <= deg; j++) {
+			if (lg[j] < 0)
+				continue;
+			sum ^= bch->a_pow_tab[lg[j]];
+			lg[j] -= j;
+			if (lg[j] < 0)
+				lg[j] += n;
+		}
+		if (!sum)
+			errloc[found++] = degree_to_errloc(nbits, d);
+	}
+	return found == deg ? (int)found : -1;
+}
+
+/**
+ * decode_bch - locate the bit errors of a BCH codeword
+ * @bch:	BCH control structure
+ * @len:	length of the data in bytes
+ * @recv_ecc:	ecc read along with the data
+ * @calc_ecc:	ecc calculated from the data as read, with encode_bch()
+ * @errloc:	output array of bch->t error locations
+ *
+ * The data itself is not needed, the errors are located from the two
+ * ecc values. Returns the number of bit errors, which are listed in
+ * @errloc, or a negative error code: -EINVAL for a too long codeword,
+ * -EBADMSG if the codeword cannot be corrected. An error location is the bit number in
+ * the data followed by the ecc, counting from bit 0 of byte 0; values
+ * of @len * 8 and above are errors in the ecc. So a data error is
+ * corrected with:
+ *
+ *   data[errloc[i] / 8] ^= 1 << (errloc[i] % 8);
+ */
+int decode_bch(struct bch_control *bch, unsigned int len,
+	       const uint8_t *recv_ecc, const uint8_t *calc_ecc,
+	       unsigned int *errloc)
+{
+	const unsigned int nbits = 8 * len + bch->ecc_bits;
+	int deg;
+
+	if (8 * len > bch->n - bch->ecc_bits)
+		return -EINVAL;
+
+	if (!compute_syndromes(bch, recv_ecc, calc_ecc))
+		return 0;
+
+	deg = compute_error_locator(bch);
+	if (deg <= 0)
+		return -EBADMSG;
+
+	if (chien_search(bch, nbits, errloc) < 0)
+		return -EBADMSG;
+	return deg;
+}
+EXPORT_SYMBOL_GPL(decode_bch);
+
+/* Build the antilog and log tables of GF(2^m) */
+static int build_gf_tables(struct bch_control *bch, unsigned int prim_poly)
+{
+	const unsigned int k = 1 << bch->m;
+	unsigned int i, x = 1;
+
+	/* the polynomial has to be of degree m */
+	if ((prim_poly & ~(k - 1)) != k)
+		return -EINVAL;
+
+	for (i = 0; i < bch->n; i++) {
+		/* alpha^i == 1 before i == n: not primitive */
+		if (i && x == 1)
+			return -EINVAL;
+		bch->a_pow_tab[i] = x;
+		bch->a_log_tab[x] = i;
+		x <<= 1;
+		if (x & k)
+			x ^= prim_poly;
+	}
+	bch->a_pow_tab[bch->n] = 1;
+	bch->a_log_tab[0] = 0;
+	return 0;
+}
+
+/*
+ * The generator polynomial is the product of the minimal polynomials of
+ * alpha^1..alpha^2t, i.e. of (x + alpha^r) for all r in the cyclotomic
+ * cosets of 1, 3, ..., 2t-1. Its coefficients are 0 or 1.
+ */
+static struct gf_poly *compute_generator(struct bch_control *bch)
+{
+	const unsigned int n = bch->n, t = bch->t, m = bch->m;
+	struct gf_poly *g;
+	unsigned int i, j, r, a;
+	uint8_t *roots;
+
+	roots = kzalloc(n + 1, GFP_KERNEL);
+	g = kzalloc(GF_POLY_SZ(m * t), GFP_KERNEL);
+	if (!roots || !g)
+		goto fail;
+
+	for (i = 0; i < t; i++)
+		for (j = 0, r = 2 * i + 1; j < m; j++) {
+			roots[r] = 1;
+			r = (2 * r) % n;
+		}
+
+	g->c[0] = 1;
+	for (r = 0; r < n; r++) {
+		if (!roots[r])
+			continue;
+		/* g(x) *= x + alpha^r */
+		a = bch->a_pow_tab[r];
+		g->c[g->deg + 1] = 1;
+		for (j = g->deg; j > 0; j--)
+			g->c[j] = gf_mul(bch, g->c[j], a) ^ g->c[j - 1];
+		g->c[0] = gf_mul(bch, g->c[0], a);
+		g->deg++;
+	}
+
+	for (i = 0; i <= g->deg; i++)
+		if (g->c[i] > 1)
+			goto fail;
+	kfree(roots);
+	return g;
+
+fail:
+	kfree(roots);
+	kfree(g);
+	return NULL;
+}
+
+/*
+ * xi_tab[i] is a solution of y^2 + y = alpha^i if alpha^i has trace 0,
+ * else of y^2 + y = alpha^i + alpha^k, alpha^k being a basis element of
+ * trace 1. For u of trace 0, an even number of its bits have trace 1,
+ * so the alpha^k terms cancel when the xi_tab entries of its bits are
+ * added up.
+ */
+static int build_deg2_table(struct bch_control *bch)
+{
+	const unsigned int m = bch->m;
+	unsigned int i, j, x, y, v, tr, ak = 0, done;
+	unsigned int trace[BCH_MAX_M];
+
+	for (i = 0; i < m; i++) {
+		for (j = 0, tr = 0, x = 1 << i; j < m; j++) {
+			tr ^= x;
+			x = gf_sqr(bch, x);
+		}
+		trace[i] = tr;
+		if (tr && !ak)
+			ak = 1 << i;
+	}
+	if (!ak)
+		return -EINVAL;
+
+	/* alpha^k + alpha^k = 0, solved by y = 0 */
+	memset(bch->xi_tab, 0, m * sizeof(*bch->xi_tab));
+	done = ak;
+	for (y = 2; y <= bch->n && done != (1u << m) - 1; y++) {
+		v = gf_sqr(bch, y) ^ y;
+		for (i = 0; i < m; i++) {
+			if (done & (1 << i))
+				continue;
+			if (v == ((1u << i) ^ (trace[i] ? ak : 0))) {
+				bch->xi_tab[i] = y;
+				done |= 1 << i;
+			}
+		}
+	}
+	return done == (1u << m) - 1 ? 0 : -EINVAL;
+}
+
+/*
+ * Table k, entry b holds (b(x).x^(ecc_bits+8k)) mod g(x), computed with
+ * a bit-serial LFSR, left-aligned like the remainder register.
+ */
+static void build_mod_tables(struct bch_control *bch, const struct gf_poly *g)
+{
+	const unsigned int l = bch->ecc_words;
+	const unsigned int pad = 32 * l - bch->ecc_bits;
+	uint32_t *gl = bch->ecc_buf, *r;
+	unsigned int i, k, b, p;
+	int bit;
+
+	/* g(x) without its x^ecc_bits term */
+	memset(gl, 0, l * sizeof(*gl));
+	for (i = 0; i < bch->ecc_bits; i++) {
+		if (!g->c[i])
+			continue;
+		p = pad + i;
+		gl[l - 1 - p / 32] |= 1u << (p % 32);
+	}
+
+	for (k = 0; k < 4; k++) {
+		for (b = 0; b < 256; b++) {
+			r = bch->mod_tab + (k * 256 + b) * l;
+			memset(r, 0, l * sizeof(*r));
+			for (bit = 8 * k + 7; bit >= 0; bit--) {
+				int fb = (r[0] >> 31) ^
+					 (bit >= 8 * k ? (b >> (bit - 8 * k)) & 1 : 0);
+
+				for (i = 0; i < l - 1; i++)
+					r[i] = (r[i] << 1) | (r[i + 1] >> 31);
+				r[l - 1] <<= 1;
+				if (fb)
+					for (i = 0; i < l; i++)
+						r[i] ^= gl[i];
+			}
+		}
+	}
+}
+
+/**
+ * init_bch - initialize a BCH encoder/decoder
+ * @m:		Galois field order, 5..15
+ * @t:		number of correctable bit errors
+ * @prim_poly:	primitive polynomial of GF(2^m), 0 for the default one
+ *
+ * Returns the control structure, or NULL if the parameters are invalid
+ * or there is not enough memory. The ecc takes bch->ecc_bytes bytes,
+ * at most m*t bits, and a codeword (data and ecc) at most 2^m-1 bits.
+ * This allocates a few tables and may take some time, so it should be
+ * called when a driver is initialized, not on the I/O path.
+ */
+struct bch_control *init_bch(int m, int t, unsigned int prim_poly)
+{
+	struct bch_control *bch;
+	struct gf_poly *g = NULL;
+	unsigned int l;
+
+	if (m < BCH_MIN_M || m > BCH_MAX_M || t < 1 ||
+	    m * t >= (1 << m) - 1)
+		return NULL;
+	if (!prim_poly)
+		prim_poly = prim_poly_tab[m - BCH_MIN_M];
+
+	bch = kzalloc(sizeof(*bch), GFP_KERNEL);
+	if (!bch)
+		return NULL;
+	bch->m = m;
+	bch->t = t;
+	bch->n = (1 << m) - 1;
+
+	bch->a_pow_tab = kmalloc((bch->n + 1) * sizeof(uint16_t), GFP_KERNEL);
+	bch->a_log_tab = kmalloc((bch->n + 1) * sizeof(uint16_t), GFP_KERNEL);
+	if (!bch->a_pow_tab || !bch->a_log_tab)
+		goto fail;
+	if (build_gf_tables(bch, prim_poly))
+		goto fail;
+
+	g = compute_generator(bch);
+	/* the byte-wise encoder needs at least 8 ecc bits */
+	if (!g || g->deg < 8)
+		goto fail;
+	bch->ecc_bits = g->deg;
+	bch->ecc_bytes = DIV_ROUND_UP(bch->ecc_bits, 8);
+	bch->ecc_words = l = DIV_ROUND_UP(bch->ecc_bits, 32);
+
+	bch->mod_tab = kmalloc(4 * 256 * l * sizeof(uint32_t), GFP_KERNEL);
+	bch->ecc_buf = kmalloc(l * sizeof(uint32_t), GFP_KERNEL);
+	bch->syn = kmalloc(2 * t * sizeof(unsigned int), GFP_KERNEL);
+	bch->elp = kmalloc(GF_POLY_SZ(3 * t), GFP_KERNEL);
+	bch->pelp = kmalloc(GF_POLY_SZ(3 * t), GFP_KERNEL);
+	bch->elp_copy = kmalloc(GF_POLY_SZ(3 * t), GFP_KERNEL);
+	bch->chien = kmalloc((3 * t + 1) * sizeof(int), GFP_KERNEL);
+	bch->xi_tab = kmalloc(m * sizeof(unsigned int), GFP_KERNEL);
+	if (!bch->mod_tab || !bch->ecc_buf || !bch->syn || !bch->elp ||
+	    !bch->pelp || !bch->elp_copy || !bch->chien || !bch->xi_tab)
+		goto fail;
+
+	if (build_deg2_table(bch))
+		goto fail;
+	build_mod_tables(bch, g);
+	kfree(g);
+	return bch;
+
+fail:
+	kfree(g);
+	free_bch(bch);
+	return NULL;
+}
+EXPORT_SYMBOL_GPL(init_bch);
+
+/**
+ * free_bch - free a BCH control structure
+ * @bch:	BCH control structure, may be NULL
+ */
+void free_bch(struct bch_control *bch)
+{
+	if (!bch)
+		return;
+	kfree(bch->a_pow_tab);
+	kfree(bch->a_log_tab);
+	kfree(bch->mod_tab);
+	kfree(bch->ecc_buf);
+	kfree(bch->syn);
+	kfree(bch->elp);
+	kfree(bch->pelp);
+	kfree(bch->elp_copy);
+	kfree(bch->chien);
+	kfree(bch->xi_tab);
+	kfree(bch);
+}
+EXPORT_SYMBOL_GPL(free_bch);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Binary BCH encoder/decoder");
@@ -23,11 +23,16 @@
 #include <linux/crc32.h>
 #include <linux/kernel.h>
 #include <linux/module.h>
+#include <linux/moduleparam.h>
 #include <linux/compiler.h>
 #include <linux/types.h>
 #include <linux/slab.h>
+#include <linux/string.h>
 #include <linux/init.h>
 #include <asm/atomic.h>
+#ifdef CONFIG_CRC32_NEON
+#include <asm/neon.h>
+#endif
 #include "crc32defs.h"
 #if CRC_LE_BITS == 8
 #define tole(x) __constant_cpu_to_le32(x)
@@ -42,14 +47,24 @@ MODULE_AUTHOR("Matt Domsch <Matt_Domsch@dell.com>");
 MODULE_DESCRIPTION("Ethernet CRC32 calculations");
 MODULE_LICENSE("GPL");
 
-/**
- * crc32_le() - Calculate bitwise little-endian Ethernet AUTODIN II CRC32
- * @crc: seed value for computation.  ~0 for Ethernet, sometimes 0 for
- *	other uses, or the previous crc32 value if computing incrementally.
- * @p: pointer to buffer over which CRC is run
- * @len: length of buffer @p
+/*
+ * crc32_le/crc32_be dispatch to one of these, chosen with crc32.impl.
+ * "byte" is the classic one table loop, always built.
  */
-u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len);
+enum {
+	CRC32_IMPL_BYTE,
+	CRC32_IMPL_SLICE8,
+	CRC32_IMPL_NEON,
+};
+
+static const char *crc32_impl_names[] = {
+	[CRC32_IMPL_BYTE]	= "byte",
+	[CRC32_IMPL_SLICE8]	= "slice8",
+	[CRC32_IMPL_NEON]	= "neon",
+};
+
+static int crc32_impl __read_mostly =
+	CRC_LE_ROWS == 8 ? CRC32_IMPL_SLICE8 : CRC32_IMPL_BYTE;
 
 #if CRC_LE_BITS == 1
 /*
@@ -57,7 +72,7 @@ u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len);
  * simplified by inlining the table in ?: form.
  */
 
-u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
+static u32 __pure crc32_le_byte(u32 crc, unsigned char const *p, size_t len)
 {
 	int i;
 	while (len--) {
@@ -69,11 +84,11 @@ u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
 }
 #else				/* Table-based approach */
 
-u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
+static u32 __pure crc32_le_byte(u32 crc, unsigned char const *p, size_t len)
 {
 # if CRC_LE_BITS == 8
 	const u32      *b =(u32 *)p;
-	const u32      *tab = crc32table_le;
+	const u32      *tab = crc32table_le[0];
 
 # ifdef __LITTLE_ENDIAN
 #  define DO_CRC(x) crc = tab[ (crc ^ (x)) & 255 ] ^ (crc>>8)
@@ -121,39 +136,30 @@ u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
 # elif CRC_LE_BITS == 4
 	while (len--) {
 		crc ^= *p++;
-		crc = (crc >> 4) ^ crc32table_le[crc & 15];
-		crc = (crc >> 4) ^ crc32table_le[crc & 15];
+		crc = (crc >> 4) ^ crc32table_le[0][crc & 15];
+		crc = (crc >> 4) ^ crc32table_le[0][crc & 15];
 	}
 	return crc;
 # elif CRC_LE_BITS == 2
 	while (len--) {
 		crc ^= *p++;
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
+		crc = (crc >> 2) ^ crc32table_le[0][crc & 3];
+		crc = (crc >> 2) ^ crc32table_le[0][crc & 3];
+		crc = (crc >> 2) ^ crc32table_le[0][crc & 3];
+		crc = (crc >> 2) ^ crc32table_le[0][crc & 3];
 	}
 	return crc;
 # endif
 }
 #endif
 
-/**
- * crc32_be() - Calculate bitwise big-endian Ethernet AUTODIN II CRC32
- * @crc: seed value for computation.  ~0 for Ethernet, sometimes 0 for
- *	other uses, or the previous crc32 value if computing incrementally.
- * @p: pointer to buffer over which CRC is run
- * @len: length of buffer @p
- */
-u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len);
-
 #if CRC_BE_BITS == 1
 /*
  * In fact, the table-based code will work in this case, but it can be
  * simplified by inlining the table in ?: form.
  */
 
-u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
+static u32 __pure crc32_be_byte(u32 crc, unsigned char const *p, size_t len)
 {
 	int i;
 	while (len--) {
@@ -167,11 +173,11 @@ u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
 }
 
 #else				/* Table-based approach */
-u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
+static u32 __pure crc32_be_byte(u32 crc, unsigned char const *p, size_t len)
 {
 # if CRC_BE_BITS == 8
 	const u32      *b =(u32 *)p;
-	const u32      *tab = crc32table_be;
+	const u32      *tab = crc32table_be[0];
 
 # ifdef __LITTLE_ENDIAN
 #  define DO_CRC(x) crc = tab[ (crc ^ (x)) & 255 ] ^ (crc>>8)
@@ -218,26 +224,239 @@ u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
 # elif CRC_BE_BITS == 4
 	while (len--) {
 		crc ^= *p++ << 24;
-		crc = (crc << 4) ^ crc32table_be[crc >> 28];
-		crc = (crc << 4) ^ crc32table_be[crc >> 28];
+		crc = (crc << 4) ^ crc32table_be[0][crc >> 28];
+		crc = (crc << 4) ^ crc32table_be[0][crc >> 28];
 	}
 	return crc;
 # elif CRC_BE_BITS == 2
 	while (len--) {
 		crc ^= *p++ << 24;
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
+		crc = (crc << 2) ^ crc32table_be[0][crc >> 30];
+		crc = (crc << 2) ^ crc32table_be[0][crc >> 30];
+		crc = (crc << 2) ^ crc32table_be[0][crc >> 30];
+		crc = (crc << 2) ^ crc32table_be[0][crc >> 30];
 	}
 	return crc;
 # endif
 }
 #endif
 
+#if CRC_LE_ROWS == 8 || CRC_BE_ROWS == 8
+/*
+ * Slice-by-8: fold 8 bytes into the crc per step with one lookup per
+ * byte in 8 tables, row k advancing its byte by k zero bytes. Works on
+ * the same byte-order-adjusted crc as the byte loop above.
+ */
+#ifdef __LITTLE_ENDIAN
+# define DO_CRC(x) crc = t0[(crc ^ (x)) & 255] ^ (crc >> 8)
+# define DO_CRC4 (t3[(q) & 255] ^ t2[(q >> 8) & 255] ^ \
+		  t1[(q >> 16) & 255] ^ t0[(q >> 24) & 255])
+# define DO_CRC8 (t7[(q) & 255] ^ t6[(q >> 8) & 255] ^ \
+		  t5[(q >> 16) & 255] ^ t4[(q >> 24) & 255])
+#else
+# define DO_CRC(x) crc = t0[((crc >> 24) ^ (x)) & 255] ^ (crc << 8)
+# define DO_CRC4 (t0[(q) & 255] ^ t1[(q >> 8) & 255] ^ \
+		  t2[(q >> 16) & 255] ^ t3[(q >> 24) & 255])
+# define DO_CRC8 (t4[(q) & 255] ^ t5[(q >> 8) & 255] ^ \
+		  t6[(q >> 16) & 255] ^ t7[(q >> 24) & 255])
+#endif
+
+static inline u32 crc32_body(u32 crc, unsigned char const *buf, size_t len,
+			     const u32 (*tab)[256])
+{
+	const u32 *t0 = tab[0], *t1 = tab[1], *t2 = tab[2], *t3 = tab[3];
+	const u32 *t4 = tab[4], *t5 = tab[5], *t6 = tab[6], *t7 = tab[7];
+	const u32 *b;
+	size_t rem_len;
+	u32 q;
+
+	/* Align it */
+	if (unlikely((long)buf & 3 && len)) {
+		do {
+			DO_CRC(*buf++);
+		} while ((--len) && ((long)buf) & 3);
+	}
+
+	rem_len = len & 7;
+	len = len >> 3;
+	b = (const u32 *)buf;
+	for (--b; len; --len) {
+		q = crc ^ *++b; /* use pre increment for speed */
+		crc = DO_CRC8;
+		q = *++b;
+		crc ^= DO_CRC4;
+	}
+
+	/* And the last few bytes */
+	len = rem_len;
+	if (len) {
+		const u8 *p = (const u8 *)(b + 1) - 1;
+
+		do {
+			DO_CRC(*++p); /* use pre increment for speed */
+		} while (--len);
+	}
+
+	return crc;
+}
+#undef DO_CRC
+#undef DO_CRC4
+#undef DO_CRC8
+#endif
+
+#if CRC_LE_ROWS == 8
+static u32 __pure crc32_le_slice8(u32 crc, unsigned char const *p, size_t len)
+{
+	crc = __cpu_to_le32(crc);
+	crc = crc32_body(crc, p, len, crc32table_le);
+	return __le32_to_cpu(crc);
+}
+#define crc32_le_table	crc32_le_slice8
+#else
+#define crc32_le_table	crc32_le_byte
+#endif
+
+#if CRC_BE_ROWS == 8
+static u32 __pure crc32_be_slice8(u32 crc, unsigned char const *p, size_t len)
+{
+	crc = __cpu_to_be32(crc);
+	crc = crc32_body(crc, p, len, crc32table_be);
+	return __be32_to_cpu(crc);
+}
+#endif
+
+#ifdef CONFIG_CRC32_NEON
+/*
+ * Below this the NEON state save and restore outweighs the faster loop.
+ */
+#define CRC32_NEON_MIN	256
+
+/* set once the NEON code has been checked against the tables */
+static int crc32_neon_ok;
+
+/*
+ * The crc of a message is the crc, from 0, of the message with the seed
+ * xored into its first word. crc32_le_fold_neon() folds the message 16
+ * bytes at a time into one 16 byte block with the same crc, which the
+ * table code then finishes along with the tail.
+ */
+static u32 __pure crc32_le_neon(u32 crc, unsigned char const *p, size_t len)
+{
+	size_t blocks = len / 16;
+	u32 acc[4];
+
+	memcpy(acc, p, sizeof(acc));
+	acc[0] ^= __cpu_to_le32(crc);
+
+	kernel_neon_begin();
+	crc32_le_fold_neon(acc, p + 16, blocks - 1);
+	kernel_neon_end();
+
+	crc = crc32_le_table(0, (unsigned char const *)acc, sizeof(acc));
+	return crc32_le_table(crc, p + blocks * 16, len - blocks * 16);
+}
+#endif
+
+/* crc32_le/crc32_be with implementation impl, for the self test too */
+static inline u32 __crc32_le(int impl, u32 crc, unsigned char const *p,
+			     size_t len)
+{
+#ifdef CONFIG_CRC32_NEON
+	if (impl == CRC32_IMPL_NEON && len >= CRC32_NEON_MIN &&
+	    kernel_neon_allowed())
+		return crc32_le_neon(crc, p, len);
+#endif
+#if CRC_LE_ROWS == 8
+	if (impl != CRC32_IMPL_BYTE)
+		return crc32_le_slice8(crc, p, len);
+#endif
+	return crc32_le_byte(crc, p, len);
+}
+
+static inline u32 __crc32_be(int impl, u32 crc, unsigned char const *p,
+			     size_t len)
+{
+#if CRC_BE_ROWS == 8
+	/* there is no NEON crc32_be, it uses slice-by-8 too */
+	if (impl != CRC32_IMPL_BYTE)
+		return crc32_be_slice8(crc, p, len);
+#endif
+	return crc32_be_byte(crc, p, len);
+}
+
+/**
+ * crc32_le() - Calculate bitwise little-endian Ethernet AUTODIN II CRC32
+ * @crc: seed value for computation.  ~0 for Ethernet, sometimes 0 for
+ *	other uses, or the previous crc32 value if computing incrementally.
+ * @p: pointer to buffer over which CRC is run
+ * @len: length of buffer @p
+ */
+u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
+{
+	return __crc32_le(crc32_impl, crc, p, len);
+}
+
+/**
+ * crc32_be() - Calculate bitwise big-endian Ethernet AUTODIN II CRC32
+ * @crc: seed value for computation.  ~0 for Ethernet, sometimes 0 for
+ *	other uses, or the previous crc32 value if computing incrementally.
+ * @p: pointer to buffer over which CRC is run
+ * @len: length of buffer @p
+ */
+u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
+{
+	return __crc32_be(crc32_impl, crc, p, len);
+}
+
 EXPORT_SYMBOL(crc32_le);
 EXPORT_SYMBOL(crc32_be);
 
+static int crc32_impl_available(int impl)
+{
+	switch (impl) {
+	case CRC32_IMPL_BYTE:
+		return 1;
+	case CRC32_IMPL_SLICE8:
+		return CRC_LE_ROWS == 8;
+#ifdef CONFIG_CRC32_NEON
+	case CRC32_IMPL_NEON:
+		return crc32_neon_ok;
+#endif
+	}
+	return 0;
+}
+
+static int crc32_initialized;
+static int crc32_impl_boot = -1;
+
+static int crc32_impl_set(const char *val, struct kernel_param *kp)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(crc32_impl_names); i++) {
+		if (!sysfs_streq(val, crc32_impl_names[i]))
+			continue;
+		/* before crc32_init() only remember the choice */
+		if (!crc32_initialized) {
+			crc32_impl_boot = i;
+			return 0;
+		}
+		if (!crc32_impl_available(i))
+			return -ENODEV;
+		crc32_impl = i;
+		return 0;
+	}
+	return -EINVAL;
+}
+
+static int crc32_impl_get(char *buffer, struct kernel_param *kp)
+{
+	return sprintf(buffer, "%s", crc32_impl_names[crc32_impl]);
+}
+
+module_param_call(impl, crc32_impl_set, crc32_impl_get, NULL, 0644);
+MODULE_PARM_DESC(impl, "crc32 implementation: byte, slice8 or neon");
+
 /*
  * A brief CRC tutorial.
  *
@@ -365,10 +584,26 @@ EXPORT_SYMBOL(crc32_be);
  * the same way on decoding, it doesn't make a difference.
  */
 
+#if defined(CONFIG_CRC32_SELFTEST) || defined(UNITTEST)
 #ifdef UNITTEST
-
 #include <stdlib.h>
 #include <stdio.h>
+#define crc32_test_print	printf
+#define crc32_test_random()	random()
+#else
+#include <linux/random.h>
+#define crc32_test_print	printk
+#define crc32_test_random()	random32()
+#endif
+
+static int crc32_test_errors __initdata;
+static const char *crc32_test_name __initdata;
+
+#define crc32_test_fail(fmt, args...)					\
+	do {								\
+		crc32_test_errors++;					\
+		crc32_test_print("crc32: %s: " fmt, crc32_test_name, ##args); \
+	} while (0)
 
 #if 0				/*Not used at present */
 static void
@@ -382,7 +617,7 @@ buf_dump(char const *prefix, unsigned char const *buf, size_t len)
 }
 #endif
 
-static void bytereverse(unsigned char *buf, size_t len)
+static void __init bytereverse(unsigned char *buf, size_t len)
 {
 	while (len--) {
 		unsigned char x = bitrev8(*buf);
@@ -390,10 +625,10 @@ static void bytereverse(unsigned char *buf, size_t len)
 	}
 }
 
-static void random_garbage(unsigned char *buf, size_t len)
+static void __init random_garbage(unsigned char *buf, size_t len)
 {
 	while (len--)
-		*buf++ = (unsigned char) random();
+		*buf++ = (unsigned char) crc32_test_random();
 }
 
 #if 0				/* Not used at present */
@@ -406,7 +641,7 @@ static void store_le(u32 x, unsigned char *buf)
 }
 #endif
 
-static void store_be(u32 x, unsigned char *buf)
+static void __init store_be(u32 x, unsigned char *buf)
 {
 	buf[0] = (unsigned char) (x >> 24);
 	buf[1] = (unsigned char) (x >> 16);
@@ -420,23 +655,23 @@ static void store_be(u32 x, unsigned char *buf)
  * of bytewise bit-reversing the input buffer, and returns
  * the CRC of the reversed buffer.
  */
-static u32 test_step(u32 init, unsigned char *buf, size_t len)
+static u32 __init test_step(int impl, u32 init, unsigned char *buf, size_t len)
 {
 	u32 crc1, crc2;
 	size_t i;
 
-	crc1 = crc32_be(init, buf, len);
+	crc1 = __crc32_be(impl, init, buf, len);
 	store_be(crc1, buf + len);
-	crc2 = crc32_be(init, buf, len + 4);
+	crc2 = __crc32_be(impl, init, buf, len + 4);
 	if (crc2)
-		printf("\nCRC cancellation fail: 0x%08x should be 0\n",
-		       crc2);
+		crc32_test_fail("CRC cancellation fail: 0x%08x should be 0\n",
+				crc2);
 
 	for (i = 0; i <= len + 4; i++) {
-		crc2 = crc32_be(init, buf, i);
-		crc2 = crc32_be(crc2, buf + i, len + 4 - i);
+		crc2 = __crc32_be(impl, init, buf, i);
+		crc2 = __crc32_be(impl, crc2, buf + i, len + 4 - i);
 		if (crc2)
-			printf("\nCRC split fail: 0x%08x\n", crc2);
+			crc32_test_fail("CRC split fail: 0x%08x\n", crc2);
 	}
 
 	/* Now swap it around for the other test */
@@ -445,57 +680,244 @@ static u32 test_step(u32 init, unsigned char *buf, size_t len)
 	init = bitrev32(init);
 	crc2 = bitrev32(crc1);
 	if (crc1 != bitrev32(crc2))
-		printf("\nBit reversal fail: 0x%08x -> 0x%08x -> 0x%08x\n",
-		       crc1, crc2, bitrev32(crc2));
-	crc1 = crc32_le(init, buf, len);
+		crc32_test_fail("Bit reversal fail: 0x%08x -> 0x%08x -> "
+				"0x%08x\n", crc1, crc2, bitrev32(crc2));
+	crc1 = __crc32_le(impl, init, buf, len);
 	if (crc1 != crc2)
-		printf("\nCRC endianness fail: 0x%08x != 0x%08x\n", crc1,
-		       crc2);
-	crc2 = crc32_le(init, buf, len + 4);
+		crc32_test_fail("CRC endianness fail: 0x%08x != 0x%08x\n",
+				crc1, crc2);
+	crc2 = __crc32_le(impl, init, buf, len + 4);
 	if (crc2)
-		printf("\nCRC cancellation fail: 0x%08x should be 0\n",
-		       crc2);
+		crc32_test_fail("CRC cancellation fail: 0x%08x should be 0\n",
+				crc2);
 
 	for (i = 0; i <= len + 4; i++) {
-		crc2 = crc32_le(init, buf, i);
-		crc2 = crc32_le(crc2, buf + i, len + 4 - i);
+		crc2 = __crc32_le(impl, init, buf, i);
+		crc2 = __crc32_le(impl, crc2, buf + i, len + 4 - i);
 		if (crc2)
-			printf("\nCRC split fail: 0x%08x\n", crc2);
+			crc32_test_fail("CRC split fail: 0x%08x\n", crc2);
 	}
 
 	return crc1;
 }
 
-#define SIZE 64
-#define INIT1 0
-#define INIT2 0
-
-int main(void)
+/*
+ * The algebraic checks of test_step() for every length up to size, and
+ * CRC(buf1 ^ buf2) = CRC(buf1) ^ CRC(buf2). The buffers hold size + 4
+ * bytes.
+ */
+static void __init crc32_unittest(int impl, unsigned char *buf1,
+				  unsigned char *buf2, unsigned char *buf3,
+				  size_t size)
 {
-	unsigned char buf1[SIZE + 4];
-	unsigned char buf2[SIZE + 4];
-	unsigned char buf3[SIZE + 4];
-	int i, j;
+	size_t i, j;
 	u32 crc1, crc2, crc3;
 
-	for (i = 0; i <= SIZE; i++) {
-		printf("\rTesting length %d...", i);
-		fflush(stdout);
+	for (i = 0; i <= size; i++) {
 		random_garbage(buf1, i);
 		random_garbage(buf2, i);
 		for (j = 0; j < i; j++)
 			buf3[j] = buf1[j] ^ buf2[j];
 
-		crc1 = test_step(INIT1, buf1, i);
-		crc2 = test_step(INIT2, buf2, i);
+		crc1 = test_step(impl, 0, buf1, i);
+		crc2 = test_step(impl, 0, buf2, i);
 		/* Now check that CRC(buf1 ^ buf2) = CRC(buf1) ^ CRC(buf2) */
-		crc3 = test_step(INIT1 ^ INIT2, buf3, i);
+		crc3 = test_step(impl, 0, buf3, i);
 		if (crc3 != (crc1 ^ crc2))
-			printf("CRC XOR fail: 0x%08x != 0x%08x ^ 0x%08x\n",
-			       crc3, crc1, crc2);
+			crc32_test_fail("CRC XOR fail: 0x%08x != 0x%08x ^ "
+					"0x%08x\n", crc3, crc1, crc2);
 	}
-	printf("\nAll test complete.  No failures expected.\n");
+}
+#endif /* CONFIG_CRC32_SELFTEST || UNITTEST */
+
+#ifdef CONFIG_CRC32_SELFTEST
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/math64.h>
+
+#define CRC32_TEST_LEN		512
+#define CRC32_BENCH_LEN		4096
+#define CRC32_BENCH_LOOPS	256
+
+static u32 __init crc32_le_bitwise(u32 crc, unsigned char const *p, size_t len)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *p++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ ((crc & 1) ? CRCPOLY_LE : 0);
+	}
+	return crc;
+}
+
+static u32 __init crc32_be_bitwise(u32 crc, unsigned char const *p, size_t len)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *p++ << 24;
+		for (i = 0; i < 8; i++)
+			crc = (crc << 1) ^ ((crc & 0x80000000) ? CRCPOLY_BE : 0);
+	}
+	return crc;
+}
+
+/*
+ * Check implementation impl against the bitwise one for every length up
+ * to CRC32_TEST_LEN at every alignment, and for splitting a buffer in two
+ * at every point. impl is called directly: crc32_impl, which the other
+ * users of crc32 go through, is left alone.
+ */
+static void __init crc32_test_impl(int impl, unsigned char *buf)
+{
+	unsigned int len, align, i;
+	u32 init, le, be;
+
+	for (len = 0; len <= CRC32_TEST_LEN; len++) {
+		for (align = 0; align < 8; align++) {
+			init = random32();
+			le = crc32_le_bitwise(init, buf + align, len);
+			be = crc32_be_bitwise(init, buf + align, len);
+			if (__crc32_le(impl, init, buf + align, len) != le)
+				crc32_test_fail("le mismatch, length %u "
+						"offset %u\n", len, align);
+			if (__crc32_be(impl, init, buf + align, len) != be)
+				crc32_test_fail("be mismatch, length %u "
+						"offset %u\n", len, align);
+		}
+	}
+
+	len = CRC32_TEST_LEN;
+	le = crc32_le_bitwise(~0, buf, len);
+	for (i = 0; i <= len; i++)
+		if (__crc32_le(impl, __crc32_le(impl, ~0, buf, i), buf + i,
+			       len - i) != le)
+			crc32_test_fail("split mismatch at %u\n", i);
+}
+
+static void __init crc32_bench_impl(int impl, unsigned char *buf)
+{
+	ktime_t start;
+	u64 ns;
+	u32 crc = 0;
+	int i;
+
+	start = ktime_get();
+	for (i = 0; i < CRC32_BENCH_LOOPS; i++)
+		crc = __crc32_le(impl, crc, buf, CRC32_BENCH_LEN);
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start)) ? : 1;
+
+	/* bytes per ns * 1000 is MB/s */
+	printk(KERN_INFO "crc32: %-6s %4d bytes: %llu MB/s\n",
+	       crc32_impl_names[impl], CRC32_BENCH_LEN,
+	       div64_u64((u64)CRC32_BENCH_LEN * CRC32_BENCH_LOOPS * 1000, ns));
+}
+
+static void __init crc32_selftest(void)
+{
+	unsigned char *buf;
+	int impl;
+
+	/* bench buffer, then the three buffers of crc32_unittest() */
+	buf = kmalloc(CRC32_BENCH_LEN + 8 + 3 * (CRC32_TEST_LEN + 4),
+		      GFP_KERNEL);
+	if (!buf)
+		return;
+
+	for (impl = 0; impl < ARRAY_SIZE(crc32_impl_names); impl++) {
+		unsigned char *ubuf = buf + CRC32_BENCH_LEN + 8;
+
+		if (!crc32_impl_available(impl))
+			continue;
+		crc32_test_name = crc32_impl_names[impl];
+		crc32_test_errors = 0;
+
+		random_garbage(buf, CRC32_BENCH_LEN + 8);
+		crc32_test_impl(impl, buf);
+		crc32_unittest(impl, ubuf, ubuf + CRC32_TEST_LEN + 4,
+			       ubuf + 2 * (CRC32_TEST_LEN + 4), CRC32_TEST_LEN);
+
+		if (crc32_test_errors)
+			printk(KERN_ERR "crc32: %s: %d self-test failures\n",
+			       crc32_impl_names[impl], crc32_test_errors);
+		else
+			crc32_bench_impl(impl, buf);
+	}
+	kfree(buf);
+}
+#else
+static inline void crc32_selftest(void) { }
+#endif
+
+#ifdef CONFIG_CRC32_NEON
+/* Only hand out the NEON folding once it agrees with the tables. */
+static int __init crc32_neon_check(void)
+{
+	unsigned char *buf;
+	size_t len;
+	int ok = 1;
+
+	if (!kernel_neon_allowed())
+		return 0;
+	buf = kmalloc(2048, GFP_KERNEL);
+	if (!buf)
+		return 0;
+	get_random_bytes(buf, 2048);
+	for (len = CRC32_NEON_MIN; len <= 2048; len += 37)
+		if (crc32_le_neon(~0, buf, len) != crc32_le_table(~0, buf, len))
+			ok = 0;
+	kfree(buf);
+	if (!ok)
+		printk(KERN_ERR "crc32: NEON folding is broken, not using it\n");
+	return ok;
+}
+#endif
+
+/*
+ * Runs after vfp_init() so the NEON code can be checked, which is also
+ * when a crc32.impl= given on the command line takes effect.
+ */
+static int __init crc32_init(void)
+{
+#ifdef CONFIG_CRC32_NEON
+	crc32_neon_ok = crc32_neon_check();
+#endif
+	crc32_initialized = 1;
+	if (crc32_impl_boot >= 0) {
+		if (crc32_impl_available(crc32_impl_boot))
+			crc32_impl = crc32_impl_boot;
+		else
+			printk(KERN_WARNING "crc32: %s not available, using %s\n",
+			       crc32_impl_names[crc32_impl_boot],
+			       crc32_impl_names[crc32_impl]);
+	}
+	crc32_selftest();
 	return 0;
 }
+late_initcall(crc32_init);
+
+#ifdef UNITTEST
+
+#define SIZE 64
+
+int main(void)
+{
+	unsigned char buf1[SIZE + 4];
+	unsigned char buf2[SIZE + 4];
+	unsigned char buf3[SIZE + 4];
+	int impl;
+
+	for (impl = 0; impl < ARRAY_SIZE(crc32_impl_names); impl++) {
+		if (!crc32_impl_available(impl))
+			continue;
+		printf("Testing %s...\n", crc32_impl_names[impl]);
+		crc32_test_name = crc32_impl_names[impl];
+		crc32_unittest(impl, buf1, buf2, buf3, SIZE);
+	}
+	printf("All test complete.  %d failures, none expected.\n",
+	       crc32_test_errors);
+	return crc32_test_errors != 0;
+}
 
 #endif				/* UNITTEST */
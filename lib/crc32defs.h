@@ -15,6 +15,22 @@
 # define CRC_BE_BITS 8
 #endif
 
+/*
+ * Slice-by-8 processes 8 bytes per step with 8 tables of 256 entries
+ * (8KiB per direction), each row being the previous one advanced by a
+ * zero byte. It needs the byte-wide tables.
+ */
+#if defined(CONFIG_CRC32_SLICEBY8) && CRC_LE_BITS == 8
+# define CRC_LE_ROWS 8
+#else
+# define CRC_LE_ROWS 1
+#endif
+#if defined(CONFIG_CRC32_SLICEBY8) && CRC_BE_BITS == 8
+# define CRC_BE_ROWS 8
+#else
+# define CRC_BE_ROWS 1
+#endif
+
 /*
  * Little-endian CRC computation.  Used with serial bit streams sent
  * lsbit-first.  Be sure to use cpu_to_le32() to append the computed CRC.
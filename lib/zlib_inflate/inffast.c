@@ -10,6 +10,8 @@
 
 #ifndef ASMINF
 
+#ifndef CONFIG_ZLIB_INFLATE_FAST
+
 /* Allow machine dependent optimization for post-increment or pre-increment.
    Based on testing to date,
    Pre-increment preferred for:
@@ -309,4 +311,245 @@ void inflate_fast(z_streamp strm, unsigned start)
    - Moving len -= 3 statement into middle of loop
  */
 
+#else /* CONFIG_ZLIB_INFLATE_FAST */
+
+#include <linux/string.h>
+#include <asm/unaligned.h>
+
+/*
+   inflate_fast() with a 64-bit bit accumulator.  It is refilled once per
+   code to hold at least 56 bits, which covers a whole length/distance
+   pair (at most 48 bits, see below), so the per-field "bits < n" checks
+   of the classic loop go away.  On machines with cheap unaligned loads
+   the refill is a single little-endian 64-bit load.  Match copies that
+   don't overlap their own output use memcpy(), runs use memset().
+
+   The output is bit-exact with the classic decoder; the only difference
+   in the entry assumptions is strm->avail_in >= INFLATE_FAST_MIN_IN, as
+   a refill may read up to 8 bytes ahead.
+ */
+typedef u64 inf_bitbuf;
+
+#if defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS) && defined(__LITTLE_ENDIAN)
+#  define REFILL() \
+    do { \
+        hold |= get_unaligned_le64(in) << bits; \
+        in += (63 - bits) >> 3; \
+        bits |= 56; \
+    } while (0)
+#else
+#  define REFILL() \
+    do { \
+        while (bits < 56) { \
+            hold |= (inf_bitbuf)(*in++) << bits; \
+            bits += 8; \
+        } \
+    } while (0)
+#endif
+
+/* shorter matches are cheaper to copy by hand than through memcpy() */
+#define INFLATE_FAST_MEMCPY     16
+
+/* copy len bytes from dist bytes back in the output, which may overlap */
+static inline unsigned char *copy_match(unsigned char *out, unsigned dist,
+                                        unsigned len)
+{
+    const unsigned char *from = out - dist;
+
+    if (len < INFLATE_FAST_MEMCPY) {
+        do {
+            *out++ = *from++;
+        } while (--len);
+        return out;
+    }
+    if (dist == 1) {
+        memset(out, *from, len);
+        return out + len;
+    }
+    /* the copied pattern repeats, so each pass can copy twice as much */
+    while (len > dist) {
+        memcpy(out, from, dist);
+        out += dist;
+        len -= dist;
+        dist += dist;
+    }
+    memcpy(out, from, len);
+    return out + len;
+}
+
+void inflate_fast(z_streamp strm, unsigned start)
+{
+    struct inflate_state *state;
+    const unsigned char *in;    /* local strm->next_in */
+    const unsigned char *last;  /* while in < last, enough input available */
+    unsigned char *out;         /* local strm->next_out */
+    unsigned char *beg;         /* inflate()'s initial strm->next_out */
+    unsigned char *end;         /* while out < end, enough space available */
+#ifdef INFLATE_STRICT
+    unsigned dmax;              /* maximum distance from zlib header */
+#endif
+    unsigned wsize;             /* window size or zero if not using window */
+    unsigned whave;             /* valid bytes in the window */
+    unsigned write;             /* window write index */
+    unsigned char *window;      /* allocated sliding window, if wsize != 0 */
+    inf_bitbuf hold;            /* local strm->hold */
+    unsigned bits;              /* local strm->bits */
+    code const *lcode;          /* local strm->lencode */
+    code const *dcode;          /* local strm->distcode */
+    unsigned lmask;             /* mask for first level of length codes */
+    unsigned dmask;             /* mask for first level of distance codes */
+    code this;                  /* retrieved table entry */
+    unsigned op;                /* code bits, operation, extra bits, or */
+                                /*  window position, window bytes to copy */
+    unsigned len;               /* match length, unused bytes */
+    unsigned dist;              /* match distance */
+    unsigned char *from;        /* where to copy match from */
+
+    /* copy state to local variables */
+    state = (struct inflate_state *)strm->state;
+    in = strm->next_in;
+    last = in + (strm->avail_in - (INFLATE_FAST_MIN_IN - 1));
+    out = strm->next_out;
+    beg = out - (start - strm->avail_out);
+    end = out + (strm->avail_out - 257);
+#ifdef INFLATE_STRICT
+    dmax = state->dmax;
+#endif
+    wsize = state->wsize;
+    whave = state->whave;
+    write = state->write;
+    window = state->window;
+    hold = state->hold;
+    bits = state->bits;
+    lcode = state->lencode;
+    dcode = state->distcode;
+    lmask = (1U << state->lenbits) - 1;
+    dmask = (1U << state->distbits) - 1;
+
+    /* decode literals and length/distances until end-of-block or not enough
+       input data or output space */
+    do {
+        REFILL();
+        this = lcode[hold & lmask];
+      dolen:
+        op = (unsigned)(this.bits);
+        hold >>= op;
+        bits -= op;
+        op = (unsigned)(this.op);
+        if (op == 0) {                          /* literal */
+            *out++ = (unsigned char)(this.val);
+        }
+        else if (op & 16) {                     /* length base */
+            len = (unsigned)(this.val);
+            op &= 15;                           /* number of extra bits */
+            if (op) {
+                len += (unsigned)hold & ((1U << op) - 1);
+                hold >>= op;
+                bits -= op;
+            }
+            this = dcode[hold & dmask];
+          dodist:
+            op = (unsigned)(this.bits);
+            hold >>= op;
+            bits -= op;
+            op = (unsigned)(this.op);
+            if (op & 16) {                      /* distance base */
+                dist = (unsigned)(this.val);
+                op &= 15;                       /* number of extra bits */
+                dist += (unsigned)hold & ((1U << op) - 1);
+#ifdef INFLATE_STRICT
+                if (dist > dmax) {
+                    strm->msg = (char *)"invalid distance too far back";
+                    state->mode = BAD;
+                    break;
+                }
+#endif
+                hold >>= op;
+                bits -= op;
+                op = (unsigned)(out - beg);     /* max distance in output */
+                if (dist > op) {                /* see if copy from window */
+                    op = dist - op;             /* distance back in window */
+                    if (op > whave) {
+                        strm->msg = (char *)"invalid distance too far back";
+                        state->mode = BAD;
+                        break;
+                    }
+                    from = window;
+                    if (write == 0) {           /* very common case */
+                        from += wsize - op;
+                    }
+                    else if (write < op) {      /* wrap around window */
+                        from += wsize + write - op;
+                        op -= write;
+                        if (op < len) {         /* some from end of window */
+                            len -= op;
+                            memcpy(out, from, op);
+                            out += op;
+                            from = window;
+                            op = write;         /* rest from start of window */
+                        }
+                    }
+                    else {                      /* contiguous in window */
+                        from += write - op;
+                    }
+                    /* the window never overlaps the output */
+                    if (op >= len) {
+                        memcpy(out, from, len);
+                        out += len;
+                    }
+                    else {
+                        memcpy(out, from, op);
+                        out += op;
+                        out = copy_match(out, dist, len - op);
+                    }
+                }
+                else
+                    out = copy_match(out, dist, len);
+            }
+            else if ((op & 64) == 0) {          /* 2nd level distance code */
+                this = dcode[this.val + (hold & ((1U << op) - 1))];
+                goto dodist;
+            }
+            else {
+                strm->msg = (char *)"invalid distance code";
+                state->mode = BAD;
+                break;
+            }
+        }
+        else if ((op & 64) == 0) {              /* 2nd level length code */
+            this = lcode[this.val + (hold & ((1U << op) - 1))];
+            goto dolen;
+        }
+        else if (op & 32) {                     /* end-of-block */
+            state->mode = TYPE;
+            break;
+        }
+        else {
+            strm->msg = (char *)"invalid literal/length code";
+            state->mode = BAD;
+            break;
+        }
+    } while (in < last && out < end);
+
+    /* return unused bytes, leaving fewer than 8 bits in hold */
+    len = bits >> 3;
+    in -= len;
+    bits -= len << 3;
+    hold &= (1U << bits) - 1;
+
+    /* update state and return */
+    strm->next_in = in;
+    strm->next_out = out;
+    strm->avail_in = (unsigned)(in < last ?
+                                (INFLATE_FAST_MIN_IN - 1) + (last - in) :
+                                (INFLATE_FAST_MIN_IN - 1) - (in - last));
+    strm->avail_out = (unsigned)(out < end ?
+                                 257 + (end - out) : 257 - (out - end));
+    state->hold = (unsigned long)hold;
+    state->bits = bits;
+    return;
+}
+
+#endif /* CONFIG_ZLIB_INFLATE_FAST */
+
 #endif /* !ASMINF */
@@ -8,4 +8,11 @@
    subject to change. Applications should only use zlib.h.
  */
 
+/* input inflate() must have available before calling inflate_fast() */
+#ifdef CONFIG_ZLIB_INFLATE_FAST
+#define INFLATE_FAST_MIN_IN 8
+#else
+#define INFLATE_FAST_MIN_IN 6
+#endif
+
 void inflate_fast (z_streamp strm, unsigned start);
@@ -0,0 +1,266 @@
+/*
+ * lib/zlib_inflate_bench.c
+ *
+ * Decompression throughput of zlib_inflate.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Loading the module builds a small corpus (log-like text, instruction-like
+ * words and a sparse, mostly zero image), compresses it with
+ * zlib_deflate at the best compression level and prints the MB/s of
+ * inflating it back, both as one stream and as independently compressed
+ * pages the way cramfs stores files. Every result is compared with the
+ * original, so the module also checks that the decoder is bit-exact.
+ */
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/vmalloc.h>
+#include <linux/hrtimer.h>
+#include <linux/math64.h>
+#include <linux/string.h>
+#include <linux/zlib.h>
+
+#include <asm/page.h>
+
+static unsigned int corpus_size = 256 << 10;
+module_param(corpus_size, uint, 0);
+MODULE_PARM_DESC(corpus_size, "bytes of each corpus (default 256KiB)");
+
+static unsigned int loops = 8;
+module_param(loops, uint, 0);
+MODULE_PARM_DESC(loops, "times each corpus is inflated (default 8)");
+
+#ifdef CONFIG_ZLIB_INFLATE_FAST
+#define BENCH_DECODER	"fast"
+#else
+#define BENCH_DECODER	"classic"
+#endif
+
+static u32 bench_seed;
+
+static u32 bench_random(void)
+{
+	bench_seed = bench_seed * 1664525 + 1013904223;
+	return bench_seed >> 8;
+}
+
+static void __init corpus_text(u8 *buf, unsigned int size)
+{
+	static const char *words[] = {
+		"usb", "mmc0:", "card", "irq", "wakeup", "suspend", "resume",
+		"ubi0:", "attached", "mtd", "volume", "error", "timeout",
+		"request", "done", "the", "of", "at", "for", "device",
+	};
+	unsigned int n = 0;
+
+	bench_seed = 1;
+	while (n < size) {
+		char line[96];
+		int len, i;
+
+		len = snprintf(line, sizeof(line), "<%u>[%5u.%06u] ",
+			       bench_random() % 8, n >> 10, bench_random() % 1000000);
+		for (i = bench_random() % 8 + 2; i; i--)
+			len += snprintf(line + len, sizeof(line) - len, "%s ",
+					words[bench_random() % ARRAY_SIZE(words)]);
+		len += snprintf(line + len, sizeof(line) - len, "%x\n",
+				bench_random() & 0xffff);
+		len = min_t(unsigned int, len, size - n);
+		memcpy(buf + n, line, len);
+		n += len;
+	}
+}
+
+/* instruction-like words: a few common opcodes with varying operands */
+static void __init corpus_code(u8 *buf, unsigned int size)
+{
+	static const u32 ops[] = {
+		0xe59f0000, 0xe1a00000, 0xeb000000, 0xe5900000, 0xe3500000,
+		0x0a000000, 0xe92d4000, 0xe8bd8000, 0xe2800000, 0xe5800000,
+	};
+	unsigned int i;
+
+	bench_seed = 3;
+	for (i = 0; i + 4 <= size; i += 4) {
+		u32 r = bench_random();
+		u32 op = ops[r % ARRAY_SIZE(ops)];
+
+		/* mostly small register/offset fields, like real code */
+		op |= (r >> 4) & ((r & 8) ? 0xffff : 0x0fff);
+		memcpy(buf + i, &op, 4);
+	}
+	memset(buf + i, 0, size - i);
+}
+
+static void __init corpus_sparse(u8 *buf, unsigned int size)
+{
+	unsigned int i;
+
+	memset(buf, 0, size);
+	bench_seed = 2;
+	for (i = 0; i < size / 64; i++)
+		buf[bench_random() % size] = bench_random();
+}
+
+static const struct {
+	const char *name;
+	void (*fill)(u8 *buf, unsigned int size);
+} corpus[] = {
+	{ "text", corpus_text },
+	{ "code", corpus_code },
+	{ "sparse", corpus_sparse },
+};
+
+static int __init bench_deflate(z_stream *s, const u8 *src, unsigned int slen,
+				u8 *dst, unsigned int dlen)
+{
+	int ret;
+
+	if (zlib_deflateInit(s, Z_BEST_COMPRESSION) != Z_OK)
+		return -EINVAL;
+	s->next_in = src;
+	s->avail_in = slen;
+	s->next_out = dst;
+	s->avail_out = dlen;
+	ret = zlib_deflate(s, Z_FINISH);
+	zlib_deflateEnd(s);
+
+	return ret == Z_STREAM_END ? s->total_out : -EINVAL;
+}
+
+static int __init bench_inflate(z_stream *s, const u8 *src, unsigned int slen,
+				u8 *dst, unsigned int dlen)
+{
+	int ret;
+
+	/* cramfs resets one stream for every page, do the same */
+	zlib_inflateReset(s);
+	s->next_in = (u8 *)src;
+	s->avail_in = slen;
+	s->next_out = dst;
+	s->avail_out = dlen;
+	ret = zlib_inflate(s, Z_FINISH);
+
+	return ret == Z_STREAM_END ? s->total_out : -EINVAL;
+}
+
+struct bench_bufs {
+	u8 *src, *comp, *out;
+	unsigned int *clen;
+	unsigned int comp_size;
+	z_stream def, inf;
+};
+
+/* compress in blocks of @block bytes and time inflating them back */
+static int __init bench_one(struct bench_bufs *b, const char *name,
+			    unsigned int block)
+{
+	unsigned int nblocks = DIV_ROUND_UP(corpus_size, block);
+	unsigned int i, l, off, total = 0;
+	ktime_t start;
+	u64 ns;
+	int ret;
+
+	for (i = 0, off = 0; i < nblocks; i++, off += block) {
+		unsigned int len = min(block, corpus_size - off);
+
+		ret = bench_deflate(&b->def, b->src + off, len, b->comp + total,
+				    b->comp_size - total);
+		if (ret < 0)
+			return ret;
+		b->clen[i] = ret;
+		total += ret;
+	}
+
+	memset(b->out, 0, corpus_size);
+	start = ktime_get();
+	for (l = 0; l < loops; l++) {
+		const u8 *in = b->comp;
+
+		for (i = 0, off = 0; i < nblocks; i++, off += block) {
+			ret = bench_inflate(&b->inf, in, b->clen[i], b->out + off,
+					    min(block, corpus_size - off));
+			if (ret < 0)
+				return ret;
+			in += b->clen[i];
+		}
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start)) ? : 1;
+
+	if (memcmp(b->out, b->src, corpus_size)) {
+		printk(KERN_ERR "zlib_inflate_bench: %s: output differs\n",
+		       name);
+		return -EIO;
+	}
+
+	/* bytes per ns * 1000 = MB/s */
+	printk(KERN_INFO "zlib_inflate_bench: %-6s %7u -> %7u bytes, "
+	       "%7u byte streams: %llu MB/s\n", name, corpus_size, total,
+	       block, div64_u64((u64)corpus_size * loops * 1000, ns));
+	return 0;
+}
+
+static int __init zlib_inflate_bench_init(void)
+{
+	struct bench_bufs b;
+	unsigned int i, nblocks;
+	int ret = -ENOMEM;
+
+	if (!corpus_size || !loops)
+		return -EINVAL;
+
+	memset(&b, 0, sizeof(b));
+	nblocks = DIV_ROUND_UP(corpus_size, PAGE_SIZE);
+	/* deflate adds a few bytes per stream even on incompressible data */
+	b.comp_size = corpus_size + corpus_size / 8 + nblocks * 64;
+	b.src = vmalloc(corpus_size);
+	b.out = vmalloc(corpus_size);
+	b.comp = vmalloc(b.comp_size);
+	b.clen = vmalloc(nblocks * sizeof(*b.clen));
+	b.def.workspace = vmalloc(zlib_deflate_workspacesize());
+	b.inf.workspace = vmalloc(zlib_inflate_workspacesize());
+	if (!b.src || !b.out || !b.comp || !b.clen || !b.def.workspace ||
+	    !b.inf.workspace)
+		goto out;
+
+	ret = -EINVAL;
+	if (zlib_inflateInit(&b.inf) != Z_OK)
+		goto out;
+
+	printk(KERN_INFO "zlib_inflate_bench: %s decoder, %u loops\n",
+	       BENCH_DECODER, loops);
+	for (i = 0; i < ARRAY_SIZE(corpus); i++) {
+		corpus[i].fill(b.src, corpus_size);
+		ret = bench_one(&b, corpus[i].name, corpus_size);
+		if (!ret)
+			ret = bench_one(&b, corpus[i].name, PAGE_SIZE);
+		if (ret)
+			break;
+	}
+	zlib_inflateEnd(&b.inf);
+
+	/* nothing to keep in memory, like tcrypt */
+	if (!ret)
+		ret = -EAGAIN;
+out:
+	vfree(b.inf.workspace);
+	vfree(b.def.workspace);
+	vfree(b.clen);
+	vfree(b.comp);
+	vfree(b.out);
+	vfree(b.src);
+	return ret;
+}
+
+static void __exit zlib_inflate_bench_exit(void)
+{
+}
+
+module_init(zlib_inflate_bench_init);
+module_exit(zlib_inflate_bench_exit);
+
+MODULE_DESCRIPTION("zlib_inflate decompression benchmark");
+MODULE_LICENSE("GPL");
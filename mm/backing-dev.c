@@ -150,12 +150,37 @@ static ssize_t max_ratio_store(struct device *dev,
 }
 BDI_SHOW(max_ratio, bdi->max_ratio)
 
+static ssize_t read_ahead_context_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct backing_dev_info *bdi = dev_get_drvdata(dev);
+	char *end;
+	unsigned long val;
+	ssize_t ret = -EINVAL;
+
+	val = simple_strtoul(buf, &end, 10);
+	if (*buf && (end[0] == '\0' || (end[0] == '\n' && end[1] == '\0'))) {
+		bdi->ra_context = !!val;
+		ret = count;
+	}
+	return ret;
+}
+BDI_SHOW(read_ahead_context, bdi->ra_context)
+
+BDI_SHOW(read_ahead_pages, bdi_stat_sum(bdi, BDI_RA_PAGES))
+BDI_SHOW(read_ahead_hits, bdi_stat_sum(bdi, BDI_RA_HITS))
+BDI_SHOW(read_ahead_wasted, bdi_stat_sum(bdi, BDI_RA_WASTED))
+
 #define __ATTR_RW(attr) __ATTR(attr, 0644, attr##_show, attr##_store)
 
 static struct device_attribute bdi_dev_attrs[] = {
 	__ATTR_RW(read_ahead_kb),
 	__ATTR_RW(min_ratio),
 	__ATTR_RW(max_ratio),
+	__ATTR_RW(read_ahead_context),
+	__ATTR_RO(read_ahead_pages),
+	__ATTR_RO(read_ahead_hits),
+	__ATTR_RO(read_ahead_wasted),
 	__ATTR_NULL,
 };
 
@@ -215,6 +240,7 @@ int bdi_init(struct backing_dev_info *bdi)
 
 	bdi->dev = NULL;
 
+	bdi->ra_context = 1;
 	bdi->min_ratio = 0;
 	bdi->max_ratio = 100;
 	bdi->max_prop_frac = PROP_FRAC_BASE;
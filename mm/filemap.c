@@ -133,6 +133,10 @@ void __remove_from_page_cache(struct page *page)
 		dec_zone_page_state(page, NR_FILE_DIRTY);
 		dec_bdi_stat(mapping->backing_dev_info, BDI_RECLAIMABLE);
 	}
+
+	/* Read ahead for nothing */
+	if (unlikely(PagePrefetched(page)) && TestClearPagePrefetched(page))
+		inc_bdi_stat(mapping->backing_dev_info, BDI_RA_WASTED);
 }
 
 void remove_from_page_cache(struct page *page)
@@ -474,6 +478,9 @@ int add_to_page_cache_locked(struct page *page, struct address_space *mapping,
 		if (likely(!error)) {
 			mapping->nrpages++;
 			__inc_zone_page_state(page, NR_FILE_PAGES);
+			if (unlikely(PagePrefetched(page)))
+				__inc_bdi_stat(mapping->backing_dev_info,
+					       BDI_RA_PAGES);
 		} else {
 			page->mapping = NULL;
 			mem_cgroup_uncharge_cache_page(page);
@@ -493,8 +500,13 @@ int add_to_page_cache_lru(struct page *page, struct address_space *mapping,
 				pgoff_t offset, gfp_t gfp_mask)
 {
 	int ret = add_to_page_cache(page, mapping, offset, gfp_mask);
-	if (ret == 0)
-		lru_cache_add(page);
+	if (ret == 0) {
+		/* pages refaulting soon after their eviction go active */
+		if (workingset_refault(mapping, offset))
+			lru_cache_add_active(page);
+		else
+			lru_cache_add(page);
+	}
 	return ret;
 }
 
@@ -1023,6 +1035,7 @@ find_page:
 					ra, filp, page,
 					index, last_index - index);
 		}
+		readahead_page_used(mapping, page);
 		if (!PageUptodate(page)) {
 			if (inode->i_blkbits == PAGE_CACHE_SHIFT ||
 					!mapping->a_ops->is_partially_uptodate)
@@ -1497,7 +1510,8 @@ retry_find:
 
 			if (vmf->pgoff > ra_pages / 2)
 				start = vmf->pgoff - ra_pages / 2;
-			do_page_cache_readahead(mapping, file, start, ra_pages);
+			do_page_cache_readahead(mapping, file, start, ra_pages,
+						vmf->pgoff);
 		}
 		page = find_lock_page(mapping, vmf->pgoff);
 		if (!page)
@@ -1526,6 +1540,7 @@ retry_find:
 	 * Found the page and have a reference on it.
 	 */
 	mark_page_accessed(page);
+	readahead_page_used(mapping, page);
 	ra->prev_pos = (loff_t)page->index << PAGE_CACHE_SHIFT;
 	vmf->page = page;
 	return ret | VM_FAULT_LOCKED;
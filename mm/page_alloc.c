@@ -71,6 +71,7 @@ unsigned long totalram_pages __read_mostly;
 unsigned long totalreserve_pages __read_mostly;
 long nr_swap_pages;
 int percpu_pagelist_fraction;
+int percpu_pagelist_batch;
 
 #ifdef CONFIG_HUGETLB_PAGE_SIZE_VARIABLE
 int pageblock_order __read_mostly;
@@ -629,7 +630,8 @@ static int prep_new_page(struct page *page, int order, gfp_t gfp_flags)
 
 	page->flags &= ~(1 << PG_uptodate | 1 << PG_error | 1 << PG_reclaim |
 			1 << PG_referenced | 1 << PG_arch_1 |
-			1 << PG_owner_priv_1 | 1 << PG_mappedtodisk);
+			1 << PG_owner_priv_1 | 1 << PG_mappedtodisk |
+			1 << PG_prefetched);
 	set_page_private(page, 0);
 	set_page_refcounted(page);
 
@@ -1657,6 +1659,115 @@ got_pg:
 }
 EXPORT_SYMBOL(__alloc_pages_internal);
 
+static void bulk_add_page(struct page *page, struct list_head *list,
+			  struct page **page_array, unsigned long *slot)
+{
+	if (list) {
+		list_add_tail(&page->lru, list);
+		return;
+	}
+	while (page_array[*slot])
+		(*slot)++;
+	page_array[(*slot)++] = page;
+}
+
+/**
+ * __alloc_pages_bulk - allocate a number of order-0 pages at once
+ * @gfp_mask: GFP flags of the allocation
+ * @nr_pages: number of pages wanted
+ * @list: list to add the pages to, or NULL
+ * @page_array: array of @nr_pages entries to store the pages in, or NULL
+ *
+ * The pages are taken off the buddy lists under a single hold of
+ * zone->lock per zone, rather than one at a time through the per-cpu
+ * lists, and come out in physical order as far as the free lists allow.
+ * They are added to the tail of @list if it is given; otherwise they fill
+ * the NULL entries of @page_array, so a partly filled array can be passed
+ * again.
+ *
+ * Only the pages above the low watermark of the zones are used. If there
+ * are none, a single page is allocated the usual way, which may reclaim,
+ * so that a caller looping until it has all its pages makes progress.
+ * Returns the number of pages allocated, which may be less than wanted.
+ */
+unsigned long __alloc_pages_bulk(gfp_t gfp_mask, unsigned long nr_pages,
+				 struct list_head *list,
+				 struct page **page_array)
+{
+	enum zone_type high_zoneidx = gfp_zone(gfp_mask);
+	int migratetype = allocflags_to_migratetype(gfp_mask);
+	struct zone *zone, *preferred_zone;
+	struct zonelist *zonelist;
+	struct page *page, *next;
+	struct zoneref *z;
+	unsigned long flags, wanted, nr = 0, slot = 0, i;
+	int classzone_idx;
+	LIST_HEAD(pages);
+
+	wanted = nr_pages;
+	if (!list)
+		for (i = 0; i < nr_pages; i++)
+			if (page_array[i])
+				wanted--;
+	if (!wanted || should_fail_alloc_page(gfp_mask, 0))
+		return 0;
+
+	zonelist = node_zonelist(numa_node_id(), gfp_mask);
+	(void)first_zones_zonelist(zonelist, high_zoneidx, NULL,
+							&preferred_zone);
+	if (!preferred_zone)
+		return 0;
+	classzone_idx = zone_idx(preferred_zone);
+
+	for_each_zone_zonelist(zone, z, zonelist, high_zoneidx) {
+		unsigned long free, mark, taken = 0;
+
+		if (!cpuset_zone_allowed_hardwall(zone, gfp_mask))
+			continue;
+
+		local_irq_save(flags);
+		spin_lock(&zone->lock);
+		free = zone_page_state(zone, NR_FREE_PAGES);
+		mark = zone->pages_low + zone->lowmem_reserve[classzone_idx];
+		while (nr + taken < wanted && free - taken > mark) {
+			page = __rmqueue(zone, 0, migratetype);
+			if (unlikely(!page))
+				break;
+			list_add_tail(&page->lru, &pages);
+			zone_statistics(preferred_zone, zone);
+			taken++;
+		}
+		spin_unlock(&zone->lock);
+		__count_zone_vm_events(PGALLOC, zone, taken);
+		local_irq_restore(flags);
+
+		nr += taken;
+		if (nr == wanted)
+			break;
+	}
+
+	list_for_each_entry_safe(page, next, &pages, lru) {
+		list_del(&page->lru);
+		VM_BUG_ON(bad_range(page_zone(page), page));
+		/* a bad page is left alone, as buffered_rmqueue() does */
+		if (prep_new_page(page, 0, gfp_mask)) {
+			nr--;
+			continue;
+		}
+		bulk_add_page(page, list, page_array, &slot);
+	}
+
+	if (!nr) {
+		page = alloc_pages(gfp_mask, 0);
+		if (!page)
+			return 0;
+		bulk_add_page(page, list, page_array, &slot);
+		nr = 1;
+	}
+	return nr;
+}
+EXPORT_SYMBOL(__alloc_pages_bulk);
+
 /*
  * Common helper functions.
  */
@@ -2720,6 +2831,24 @@ static void setup_pagelist_highmark(struct per_cpu_pageset *p,
 	pcp->batch = max(1UL, high/4);
 	if ((high/4) > (PAGE_SHIFT * 8))
 		pcp->batch = PAGE_SHIFT * 8;
+	if (percpu_pagelist_batch)
+		pcp->batch = min(percpu_pagelist_batch, pcp->high);
+}
+
+/*
+ * setup_pagelist_batch() sets the batch of the pageset p of zone to
+ * percpu_pagelist_batch, or back to the batch it would have without it.
+ */
+static void setup_pagelist_batch(struct zone *zone, struct per_cpu_pageset *p)
+{
+	struct per_cpu_pages *pcp = &p->pcp;
+
+	if (percpu_pagelist_fraction)
+		setup_pagelist_highmark(p, pcp->high);
+	else if (percpu_pagelist_batch)
+		pcp->batch = min(percpu_pagelist_batch, pcp->high);
+	else
+		pcp->batch = max(1, zone_batchsize(zone));
 }
 
 
@@ -2769,6 +2898,8 @@ static int __cpuinit process_zones(int cpu)
 		if (percpu_pagelist_fraction)
 			setup_pagelist_highmark(zone_pcp(zone, cpu),
 			 	(zone->present_pages / percpu_pagelist_fraction));
+		else if (percpu_pagelist_batch)
+			setup_pagelist_batch(zone, zone_pcp(zone, cpu));
 	}
 
 	return 0;
@@ -4433,6 +4564,31 @@ int percpu_pagelist_fraction_sysctl_handler(ctl_table *table, int write,
 	return 0;
 }
 
+/*
+ * percpu_pagelist_batch - changes the pcp->batch for each zone on each cpu:
+ * the number of pages moved at a time between a per cpu pagelist and the
+ * buddy allocator. Zero restores the default.
+ */
+
+int percpu_pagelist_batch_sysctl_handler(ctl_table *table, int write,
+	struct file *file, void __user *buffer, size_t *length, loff_t *ppos)
+{
+	struct zone *zone;
+	unsigned int cpu;
+	int ret;
+
+	ret = proc_dointvec_minmax(table, write, file, buffer, length, ppos);
+	if (!write || (ret == -EINVAL))
+		return ret;
+	for_each_zone(zone) {
+		if (!populated_zone(zone))
+			continue;
+		for_each_online_cpu(cpu)
+			setup_pagelist_batch(zone, zone_pcp(zone, cpu));
+	}
+	return 0;
+}
+
 int hashdist = HASHDIST_DEFAULT;
 
 #ifdef CONFIG_NUMA
@@ -0,0 +1,138 @@
+/*
+ * mm/page_alloc_bench.c - single versus bulk page allocation speed
+ *
+ * Allocates nr_pages order-0 pages, once with alloc_page() per page and
+ * once with alloc_pages_bulk_array(), loops times each, and prints the
+ * pages per second of both, the way a camera or video driver fills its
+ * buffers. The pages are freed between the rounds, outside the timing.
+ *
+ * Everything is done at load time, after which the module refuses to
+ * stay loaded, so it is simply loaded again for another run:
+ *
+ *   modprobe page_alloc_bench nr_pages=8192
+ *   echo 63 > /proc/sys/vm/percpu_pagelist_batch
+ *   modprobe page_alloc_bench nr_pages=8192
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/gfp.h>
+#include <linux/vmalloc.h>
+#include <linux/hrtimer.h>
+#include <linux/math64.h>
+
+static unsigned long nr_pages = 4096;
+module_param(nr_pages, ulong, 0);
+MODULE_PARM_DESC(nr_pages, "Pages allocated per round (default 4096)");
+
+static unsigned int loops = 16;
+module_param(loops, uint, 0);
+MODULE_PARM_DESC(loops, "Rounds of each kind of allocation (default 16)");
+
+static void free_all(struct page **pages)
+{
+	unsigned long i;
+
+	for (i = 0; i < nr_pages; i++) {
+		if (pages[i])
+			__free_page(pages[i]);
+		pages[i] = NULL;
+	}
+}
+
+/* Returns the nanoseconds taken, or 0 if memory ran out */
+static u64 alloc_single(struct page **pages)
+{
+	ktime_t start = ktime_get();
+	unsigned long i;
+
+	for (i = 0; i < nr_pages; i++) {
+		pages[i] = alloc_page(GFP_KERNEL);
+		if (!pages[i])
+			return 0;
+	}
+	return ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+static u64 alloc_bulk(struct page **pages)
+{
+	ktime_t start = ktime_get();
+	unsigned long done = 0, nr;
+
+	while (done < nr_pages) {
+		nr = alloc_pages_bulk_array(GFP_KERNEL, nr_pages, pages);
+		if (!nr)
+			return 0;
+		done += nr;
+	}
+	return ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+static void report(const char *name, u64 ns)
+{
+	u64 pages = (u64)nr_pages * loops;
+
+	printk(KERN_INFO "page_alloc_bench: %-6s %llu pages/s, %llu ns/page\n",
+	       name,
+	       (unsigned long long)div64_u64(pages * NSEC_PER_SEC, ns ? : 1),
+	       (unsigned long long)div64_u64(ns, pages));
+}
+
+static int __init page_alloc_bench_init(void)
+{
+	struct per_cpu_pages *pcp;
+	struct zone *zone = NULL;
+	struct page **pages;
+	u64 single = 0, bulk = 0, ns;
+	unsigned int i;
+	int cpu;
+
+	if (!nr_pages || !loops)
+		return -EINVAL;
+	pages = vmalloc(nr_pages * sizeof(*pages));
+	if (!pages)
+		return -ENOMEM;
+	memset(pages, 0, nr_pages * sizeof(*pages));
+
+	for (i = 0; i < loops; i++) {
+		ns = alloc_single(pages);
+		if (!ns)
+			goto nomem;
+		single += ns;
+		free_all(pages);
+
+		ns = alloc_bulk(pages);
+		if (!ns)
+			goto nomem;
+		bulk += ns;
+		zone = page_zone(pages[0]);
+		free_all(pages);
+	}
+
+	cpu = get_cpu();
+	pcp = &zone_pcp(zone, cpu)->pcp;
+	printk(KERN_INFO "page_alloc_bench: %lu pages x %u, %s pcp batch %d "
+	       "high %d\n", nr_pages, loops, zone->name, pcp->batch, pcp->high);
+	put_cpu();
+	report("single", single);
+	report("bulk", bulk);
+	goto out;
+
+nomem:
+	printk(KERN_ERR "page_alloc_bench: out of memory, lower nr_pages\n");
+out:
+	free_all(pages);
+	vfree(pages);
+	/* all the work is done, do not stay loaded */
+	return -EAGAIN;
+}
+module_init(page_alloc_bench_init);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Single versus bulk page allocation benchmark");
@@ -30,6 +30,20 @@ struct backing_dev_info default_backing_dev_info = {
 };
 EXPORT_SYMBOL_GPL(default_backing_dev_info);
 
+/**
+ * __readahead_page_used - account the first use of a page read ahead
+ * @mapping: address_space the page belongs to
+ * @page: the page, which has PG_prefetched set
+ *
+ * Pages read ahead which are used count as hits of the readahead of their
+ * backing device, the ones which leave the page cache unused as wasted.
+ */
+void __readahead_page_used(struct address_space *mapping, struct page *page)
+{
+	if (TestClearPagePrefetched(page))
+		inc_bdi_stat(mapping->backing_dev_info, BDI_RA_HITS);
+}
+
 /*
  * Initialise a struct file's readahead state.  Assumes that the caller has
  * memset *ra to zero.
@@ -119,11 +133,15 @@ out:
  *
  * do_page_cache_readahead() returns -1 if it encountered request queue
  * congestion.
+ *
+ * The @req_size pages from @req_offset are the ones the caller is about to
+ * use; only the others are marked PG_prefetched and count as read ahead.
  */
 static int
 __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 			pgoff_t offset, unsigned long nr_to_read,
-			unsigned long lookahead_size)
+			unsigned long lookahead_size,
+			pgoff_t req_offset, unsigned long req_size)
 {
 	struct inode *inode = mapping->host;
 	struct page *page;
@@ -157,6 +175,8 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 		if (!page)
 			break;
 		page->index = page_offset;
+		if (page_offset - req_offset >= req_size)
+			__SetPagePrefetched(page);
 		list_add(&page->lru, &page_pool);
 		if (page_idx == nr_to_read - lookahead_size)
 			SetPageReadahead(page);
@@ -195,7 +215,7 @@ int force_page_cache_readahead(struct address_space *mapping, struct file *filp,
 		if (this_chunk > nr_to_read)
 			this_chunk = nr_to_read;
 		err = __do_page_cache_readahead(mapping, filp,
-						offset, this_chunk, 0);
+						offset, this_chunk, 0, 0, 0);
 		if (err < 0) {
 			ret = err;
 			break;
@@ -213,14 +233,18 @@ int force_page_cache_readahead(struct address_space *mapping, struct file *filp,
  *
  * force_page_cache_readahead() will ignore queue congestion and will block on
  * request queues.
+ *
+ * @req_offset is the page the caller needs, the others are read ahead.
  */
 int do_page_cache_readahead(struct address_space *mapping, struct file *filp,
-			pgoff_t offset, unsigned long nr_to_read)
+			pgoff_t offset, unsigned long nr_to_read,
+			pgoff_t req_offset)
 {
 	if (bdi_read_congested(mapping->backing_dev_info))
 		return -1;
 
-	return __do_page_cache_readahead(mapping, filp, offset, nr_to_read, 0);
+	return __do_page_cache_readahead(mapping, filp, offset, nr_to_read, 0,
+					 req_offset, 1);
 }
 
 /*
@@ -246,15 +270,18 @@ static int __init readahead_init(void)
 subsys_initcall(readahead_init);
 
 /*
- * Submit IO for the read-ahead request in file_ra_state.
+ * Submit IO for the read-ahead request in file_ra_state. The read of
+ * @req_size pages at @offset which triggered it may overlap the window.
  */
 static unsigned long ra_submit(struct file_ra_state *ra,
-		       struct address_space *mapping, struct file *filp)
+		       struct address_space *mapping, struct file *filp,
+		       pgoff_t offset, unsigned long req_size)
 {
 	int actual;
 
 	actual = __do_page_cache_readahead(mapping, filp,
-					ra->start, ra->size, ra->async_size);
+					ra->start, ra->size, ra->async_size,
+					offset, req_size);
 
 	return actual;
 }
@@ -327,6 +354,15 @@ static unsigned long get_next_ra_size(struct file_ra_state *ra,
  * for sequential patterns. Hence interleaved reads might be served as
  * sequential ones.
  *
+ * A read which is neither the expected one nor sequential to prev_pos may
+ * still continue a stream: one of several interleaved streams on the same
+ * file (a media player reading the audio and the video of a file), whose
+ * readahead state got overwritten by the others. Such a stream leaves the
+ * pages it has read behind it in the page cache, so the run of cached
+ * pages just before the read tells how long the stream has been going and
+ * its readahead is sized from it. This keeps a readahead state for any
+ * number of streams, kept in the page cache instead of the file.
+ *
  * There is a special-case: if the first page which the application tries to
  * read happens to be the first page of the file, it is assumed that a linear
  * read is about to happen and the window is immediately set to the initial size
@@ -336,6 +372,51 @@ static unsigned long get_next_ra_size(struct file_ra_state *ra,
  * it approaches max_readhead.
  */
 
+/*
+ * Count the pages cached contiguously before @offset, up to @max.
+ */
+static unsigned long count_history_pages(struct address_space *mapping,
+					 pgoff_t offset, unsigned long max)
+{
+	pgoff_t head;
+
+	rcu_read_lock();
+	head = radix_tree_prev_hole(&mapping->page_tree, offset - 1, max);
+	rcu_read_unlock();
+
+	return offset - 1 - head;
+}
+
+/*
+ * Page cache context based readahead, see above. Sets up the readahead
+ * window in @ra and returns 1 if the read at @offset continues a stream,
+ * returns 0 if it looks random.
+ */
+static int try_context_readahead(struct address_space *mapping,
+				 struct file_ra_state *ra, pgoff_t offset,
+				 unsigned long req_size, unsigned long max)
+{
+	unsigned long size;
+
+	if (!offset)
+		return 0;
+
+	size = count_history_pages(mapping, offset, max);
+
+	/* no history: a random read */
+	if (!size)
+		return 0;
+
+	/* the stream started at the beginning of the file, a long one */
+	if (size >= offset)
+		size *= 2;
+
+	ra->start = offset;
+	ra->size = get_init_ra_size(size + req_size, max);
+	ra->async_size = ra->size;
+	return 1;
+}
+
 /*
  * A minimal readahead algorithm for trivial sequential/random reads.
  */
@@ -364,13 +445,22 @@ ondemand_readahead(struct address_space *mapping,
 	prev_offset = ra->prev_pos >> PAGE_CACHE_SHIFT;
 	sequential = offset - prev_offset <= 1UL || req_size > max;
 
-	/*
-	 * Standalone, small read.
-	 * Read as is, and do not pollute the readahead state.
-	 */
 	if (!hit_readahead_marker && !sequential) {
+		/*
+		 * Continuation of an interleaved stream, which has left
+		 * its history in the page cache.
+		 */
+		if (mapping->backing_dev_info->ra_context &&
+		    try_context_readahead(mapping, ra, offset, req_size, max))
+			goto readit;
+
+		/*
+		 * Standalone, small read.
+		 * Read as is, and do not pollute the readahead state.
+		 */
 		return __do_page_cache_readahead(mapping, filp,
-						offset, req_size, 0);
+						offset, req_size, 0,
+						offset, req_size);
 	}
 
 	/*
@@ -408,7 +498,7 @@ ondemand_readahead(struct address_space *mapping,
 	ra->async_size = ra->size > req_size ? ra->size - req_size : ra->size;
 
 readit:
-	return ra_submit(ra, mapping, filp);
+	return ra_submit(ra, mapping, filp, offset, req_size);
 }
 
 /**
@@ -163,6 +163,7 @@ void activate_page(struct page *page)
 		add_page_to_active_list(zone, page);
 		__count_vm_event(PGACTIVATE);
 		mem_cgroup_move_lists(page, true);
+		workingset_activation(page);
 	}
 	spin_unlock_irq(&zone->lru_lock);
 }
@@ -671,6 +671,8 @@ static const char * const vmstat_text[] = {
 	"allocstall",
 
 	"pgrotated",
+	"workingset_refault",
+	"workingset_activate",
 #ifdef CONFIG_HUGETLB_PAGE
 	"htlb_buddy_alloc_success",
 	"htlb_buddy_alloc_fail",
@@ -0,0 +1,193 @@
+/*
+ * mm/workingset.c - detection of page cache refaults
+ *
+ * When memory is tight, the inactive list can be too short for the pages
+ * which are used over and over, but less often than the inactive list
+ * takes to go through: the code of the applications the user switches
+ * between, for example. These pages are evicted from the inactive list
+ * before their second access could activate them, get read back in on
+ * that access, onto the inactive list again, and are evicted again.
+ *
+ * To notice this, every page cache page evicted by reclaim leaves a shadow
+ * entry behind, with the "inactive age" at the time of its eviction. The
+ * inactive age counts the evictions and the activations, the two ways a
+ * page leaves the inactive list. When the page is read back in, the
+ * difference between the current age and the age in its shadow is its
+ * refault distance: how much longer the inactive list would have had to
+ * be for the page to stay in memory until its second access.
+ *
+ * If the refault distance is no more than the size of the active list,
+ * the page would have been kept if it had competed with the active pages
+ * for the memory, so it is activated right away. Otherwise it is added
+ * to the inactive list as a new page.
+ *
+ * The shadow entries are kept in a hash table of fixed size, rather than
+ * in the page cache radix trees, with room for about half as many pages
+ * as there are in memory: a refault distance cannot usefully be larger
+ * than the active list. A bucket holds %SHADOWS_PER_BUCKET entries and
+ * the oldest one is replaced when a bucket is full. A shadow is a hash of
+ * the mapping and the index of the page, so a collision may activate an
+ * unrelated page now and then, which is harmless.
+ */
+
+#include <linux/mm.h>
+#include <linux/swap.h>
+#include <linux/pagemap.h>
+#include <linux/bootmem.h>
+#include <linux/jhash.h>
+#include <linux/vmstat.h>
+#include <linux/init.h>
+
+#define SHADOWS_PER_BUCKET	8
+#define SHADOW_LOCKS		64
+
+struct shadow {
+	u32 cookie;	/* 0 for an unused entry */
+	u32 age;	/* inactive age at eviction */
+};
+
+struct shadow_bucket {
+	struct shadow shadows[SHADOWS_PER_BUCKET];
+};
+
+static struct shadow_bucket *shadow_table;
+static unsigned int shadow_mask;
+static spinlock_t shadow_locks[SHADOW_LOCKS];
+
+/* Evictions and activations so far */
+static atomic_t inactive_age = ATOMIC_INIT(0);
+
+/*
+ * Hash the page at @index of @mapping to a bucket and to a non-zero
+ * cookie which identifies it in the bucket.
+ */
+static struct shadow_bucket *shadow_hash(struct address_space *mapping,
+					 pgoff_t index, u32 *cookie)
+{
+	u32 hash = jhash_2words((u32)(unsigned long)mapping, index, 0);
+
+	*cookie = jhash_2words((u32)(unsigned long)mapping, index, hash) | 1;
+	return &shadow_table[hash & shadow_mask];
+}
+
+static spinlock_t *shadow_lock(struct shadow_bucket *b)
+{
+	return &shadow_locks[(b - shadow_table) % SHADOW_LOCKS];
+}
+
+/**
+ * workingset_eviction - note the eviction of a page cache page
+ * @mapping: address_space the page is evicted from
+ * @page: the page, still locked and in @mapping
+ *
+ * Called by reclaim, under the tree_lock of @mapping.
+ */
+void workingset_eviction(struct address_space *mapping, struct page *page)
+{
+	struct shadow_bucket *b;
+	struct shadow *s, *victim;
+	unsigned long flags;
+	u32 cookie, age;
+	int i;
+
+	if (!shadow_table)
+		return;
+
+	b = shadow_hash(mapping, page->index, &cookie);
+	age = atomic_inc_return(&inactive_age);
+
+	spin_lock_irqsave(shadow_lock(b), flags);
+	victim = NULL;
+	for (i = 0; i < SHADOWS_PER_BUCKET; i++) {
+		s = &b->shadows[i];
+		if (s->cookie == cookie) {
+			victim = s;
+			break;
+		}
+		/* else an unused entry, else the oldest one */
+		if (!victim || (victim->cookie && (!s->cookie ||
+				age - s->age > age - victim->age)))
+			victim = s;
+	}
+	victim->cookie = cookie;
+	victim->age = age;
+	spin_unlock_irqrestore(shadow_lock(b), flags);
+}
+
+/**
+ * workingset_refault - check if a page being added was recently evicted
+ * @mapping: address_space the page is added to
+ * @index: index of the page in @mapping
+ *
+ * Returns 1 if the page refaults within the size of the active list and
+ * should be activated, 0 otherwise. The shadow of the page, if any, is
+ * dropped.
+ */
+int workingset_refault(struct address_space *mapping, pgoff_t index)
+{
+	struct shadow_bucket *b;
+	struct shadow *s;
+	unsigned long flags, distance;
+	u32 cookie, age = 0;
+	int i, found = 0;
+
+	if (!shadow_table)
+		return 0;
+
+	b = shadow_hash(mapping, index, &cookie);
+	spin_lock_irqsave(shadow_lock(b), flags);
+	for (i = 0; i < SHADOWS_PER_BUCKET; i++) {
+		s = &b->shadows[i];
+		if (s->cookie == cookie) {
+			age = s->age;
+			s->cookie = 0;
+			found = 1;
+			break;
+		}
+	}
+	spin_unlock_irqrestore(shadow_lock(b), flags);
+
+	if (!found)
+		return 0;
+
+	count_vm_event(WORKINGSET_REFAULT);
+	distance = (u32)atomic_read(&inactive_age) - age;
+	if (distance > global_page_state(NR_ACTIVE))
+		return 0;
+
+	count_vm_event(WORKINGSET_ACTIVATE);
+	atomic_inc(&inactive_age);
+	return 1;
+}
+
+/**
+ * workingset_activation - note a page activation
+ * @page: the page moved from the inactive to the active list
+ */
+void workingset_activation(struct page *page)
+{
+	atomic_inc(&inactive_age);
+}
+
+static int __init workingset_init(void)
+{
+	struct shadow_bucket *table;
+	unsigned int shift;
+	int i;
+
+	for (i = 0; i < SHADOW_LOCKS; i++)
+		spin_lock_init(&shadow_locks[i]);
+
+	table = alloc_large_system_hash("Workingset shadow",
+				sizeof(struct shadow_bucket),
+				max(totalram_pages / 2 / SHADOWS_PER_BUCKET,
+				    (unsigned long)SHADOW_LOCKS),
+				0, 0, &shift, &shadow_mask, 0);
+	memset(table, 0, sizeof(struct shadow_bucket) << shift);
+
+	/* reclaim may be running already */
+	smp_wmb();
+	shadow_table = table;
+	return 0;
+}
+module_init(workingset_init);